@@ -0,0 +1,562 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferDecodedDataCache.h"
+#include "vtkSlicerFreeSurferImporterLogic.h"
+
+// MRML includes
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSegmentationNode.h>
+#include <vtkMRMLStorageNode.h>
+#include <vtkMRMLTableNode.h>
+
+// Segmentations includes
+#include <vtkSegment.h>
+#include <vtkSegmentation.h>
+#include <vtkSegmentationConverter.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemInformation.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+
+#include "FreeSurferBatchImportCLP.h"
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  struct SubjectReport
+    {
+    std::string Subject;
+    bool Success = false;
+    int NumberOfFiles = 0;
+    int NumberOfFilesLoaded = 0;
+    double MegabytesRead = 0.0;
+    double ImportSeconds = 0.0;
+    double StatisticsSeconds = 0.0;
+    double WriteSeconds = 0.0;
+    double TotalSeconds = 0.0;
+    /// Memory of the data objects of the imported nodes
+    double DataMegabytes = 0.0;
+    /// Memory of the whole process when the subject was completed
+    double ProcessMegabytes = 0.0;
+    };
+
+  //----------------------------------------------------------------------------
+  double GetSeconds(std::chrono::steady_clock::time_point start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  //----------------------------------------------------------------------------
+  double GetProcessMegabytes()
+  {
+    vtksys::SystemInformation systemInformation;
+    return systemInformation.GetProcMemoryUsed() / 1024.0;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetPeakProcessMegabytes()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      {
+      return 0.0;
+      }
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      {
+      return 0.0;
+      }
+# ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+# else
+    return usage.ru_maxrss / 1024.0;
+# endif
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<std::string> GetSubjects(const std::string& subjectsDirectory,
+    const std::vector<std::string>& subjects, const std::string& subjectListFile)
+  {
+    std::vector<std::string> allSubjects = subjects;
+    if (!subjectListFile.empty())
+      {
+      std::ifstream subjectList(subjectListFile.c_str());
+      std::string line;
+      while (std::getline(subjectList, line))
+        {
+        line = vtksys::SystemTools::TrimWhitespace(line);
+        if (!line.empty() && line[0] != '#')
+          {
+          allSubjects.push_back(line);
+          }
+        }
+      }
+    if (!allSubjects.empty())
+      {
+      return allSubjects;
+      }
+
+    // Every directory that looks like a subject
+    vtksys::Directory directory;
+    directory.Load(subjectsDirectory);
+    for (unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i)
+      {
+      std::string name = directory.GetFile(i);
+      std::string subjectDirectory = subjectsDirectory + "/" + name;
+      if (name != "." && name != ".."
+        && (vtksys::SystemTools::FileIsDirectory(subjectDirectory + "/mri")
+          || vtksys::SystemTools::FileIsDirectory(subjectDirectory + "/surf")))
+        {
+        allSubjects.push_back(name);
+        }
+      }
+    std::sort(allSubjects.begin(), allSubjects.end());
+    return allSubjects;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetDataMegabytes(const std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem>& items)
+  {
+    // Data objects shared between nodes (e.g. the labelmap of all segments) are counted once
+    std::set<vtkDataObject*> dataObjects;
+    for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : items)
+      {
+      if (vtkMRMLScalarVolumeNode::SafeDownCast(item.Node))
+        {
+        dataObjects.insert(vtkMRMLScalarVolumeNode::SafeDownCast(item.Node)->GetImageData());
+        }
+      else if (vtkMRMLModelNode::SafeDownCast(item.Node))
+        {
+        dataObjects.insert(vtkMRMLModelNode::SafeDownCast(item.Node)->GetPolyData());
+        }
+      else if (vtkMRMLSegmentationNode::SafeDownCast(item.Node))
+        {
+        vtkSegmentation* segmentation = vtkMRMLSegmentationNode::SafeDownCast(item.Node)->GetSegmentation();
+        for (int i = 0; i < segmentation->GetNumberOfSegments(); ++i)
+          {
+          dataObjects.insert(segmentation->GetNthSegment(i)->GetRepresentation(
+            vtkSegmentationConverter::GetBinaryLabelmapRepresentationName()));
+          }
+        }
+      }
+    dataObjects.erase(nullptr);
+
+    unsigned long kilobytes = 0;
+    for (vtkDataObject* dataObject : dataObjects)
+      {
+      kilobytes += dataObject->GetActualMemorySize();
+      }
+    return kilobytes / 1024.0;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetOutputFileName(const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item)
+  {
+    switch (item.Type)
+      {
+      case vtkSlicerFreeSurferImporterLogic::VolumeFile:
+        return vtksys::SystemTools::GetFilenameWithoutLastExtension(item.Name) + ".nrrd";
+      case vtkSlicerFreeSurferImporterLogic::SegmentationFile:
+        return vtksys::SystemTools::GetFilenameWithoutLastExtension(item.Name) + ".seg.nrrd";
+      case vtkSlicerFreeSurferImporterLogic::ModelFile:
+        // Overlays are written as point data of the models
+        return item.Name + ".vtk";
+      default:
+        return std::string();
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Tables of statistics and the names of their output files
+  typedef std::vector<std::pair<vtkMRMLTableNode*, std::string> > StatisticsTableList;
+
+  //----------------------------------------------------------------------------
+  /// Add a parcel statistics table for each annotation and each surface of its hemisphere,
+  /// over all overlays of the hemisphere that were attached to the surface.
+  bool AddParcelStatisticsTables(vtkSlicerFreeSurferImporterLogic* logic,
+    const std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem>& items, StatisticsTableList& tables)
+  {
+    bool success = true;
+    for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& annotation : items)
+      {
+      if (annotation.Type != vtkSlicerFreeSurferImporterLogic::AnnotationFile || !annotation.Success)
+        {
+        continue;
+        }
+      std::string hemisphere = vtksys::SystemTools::GetFilenameWithoutExtension(annotation.Name);
+      for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& model : items)
+        {
+        vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(model.Node);
+        if (!modelNode || !modelNode->GetPolyData()
+          || !modelNode->GetPolyData()->GetPointData()->GetArray(annotation.Name.c_str()))
+          {
+          continue;
+          }
+        std::vector<std::string> overlayNames;
+        for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& overlay : items)
+          {
+          if (overlay.Type == vtkSlicerFreeSurferImporterLogic::ScalarOverlayFile
+            && vtksys::SystemTools::GetFilenameWithoutExtension(overlay.Name) == hemisphere
+            && modelNode->GetPolyData()->GetPointData()->GetArray(overlay.Name.c_str()))
+            {
+            overlayNames.push_back(overlay.Name);
+            }
+          }
+        vtkMRMLTableNode* tableNode = logic->addFreeSurferParcelStatisticsTable(modelNode, annotation.Name, overlayNames);
+        if (!tableNode)
+          {
+          success = false;
+          continue;
+          }
+        // e.g. lh.aparc.white.stats.tsv, like the lh.aparc.stats file of FreeSurfer
+        tables.push_back(std::make_pair(tableNode, vtksys::SystemTools::GetFilenameWithoutLastExtension(annotation.Name)
+          + vtksys::SystemTools::GetFilenameLastExtension(model.Name) + ".stats.tsv"));
+        }
+      }
+    return success;
+  }
+
+  //----------------------------------------------------------------------------
+  bool WriteNode(vtkMRMLStorableNode* storableNode, const std::string& outputDirectory, const std::string& outputFileName)
+  {
+    vtkSmartPointer<vtkMRMLStorageNode> storageNode = vtkSmartPointer<vtkMRMLStorageNode>::Take(storableNode->CreateDefaultStorageNode());
+    if (!storageNode)
+      {
+      return false;
+      }
+    storageNode->SetFileName((outputDirectory + "/" + outputFileName).c_str());
+    if (!storageNode->WriteData(storableNode))
+      {
+      std::cerr << "Could not write " << outputDirectory << "/" << outputFileName << std::endl;
+      return false;
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  bool WriteItems(const std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem>& items,
+    const StatisticsTableList& statisticsTables, const std::string& outputDirectory)
+  {
+    if (!vtksys::SystemTools::MakeDirectory(outputDirectory))
+      {
+      std::cerr << "Could not create output directory " << outputDirectory << std::endl;
+      return false;
+      }
+
+    bool success = true;
+    for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : items)
+      {
+      vtkMRMLStorableNode* storableNode = vtkMRMLStorableNode::SafeDownCast(item.Node);
+      std::string outputFileName = GetOutputFileName(item);
+      if (!storableNode || outputFileName.empty())
+        {
+        continue;
+        }
+      success &= WriteNode(storableNode, outputDirectory, outputFileName);
+      }
+    for (const std::pair<vtkMRMLTableNode*, std::string>& table : statisticsTables)
+      {
+      success &= WriteNode(table.first, outputDirectory, table.second);
+      }
+    return success;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Items for the files of a subject. Surfaces that are in the space of the conformed
+  /// volume (pial, white, orig) are placed in RAS using the header of mri/orig.mgz.
+  std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> GetSubjectItems(vtkSlicerFreeSurferImporterLogic* logic,
+    const std::string& subjectsDirectory, const std::string& subject, const std::vector<std::string>& files, SubjectReport& report)
+  {
+    std::string subjectDirectory = subjectsDirectory + "/" + subject + "/";
+    vtkSmartPointer<vtkMatrix4x4> surfaceToRAS = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (!logic->getFreeSurferSurfaceToRASTransform(subjectDirectory + "mri/orig.mgz", surfaceToRAS))
+      {
+      surfaceToRAS = nullptr;
+      }
+
+    std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> items;
+    for (const std::string& file : files)
+      {
+      int type = vtkSlicerFreeSurferImporterLogic::getFreeSurferFileType(file);
+      if (type < 0)
+        {
+        std::cerr << subject << ": Unsupported file " << file << std::endl;
+        continue;
+        }
+      vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem item;
+      item.Type = type;
+      item.Directory = subjectDirectory + vtksys::SystemTools::GetFilenamePath(file) + "/";
+      item.Name = vtksys::SystemTools::GetFilenameName(file);
+      std::string extension = vtksys::SystemTools::GetFilenameLastExtension(item.Name);
+      if (type == vtkSlicerFreeSurferImporterLogic::ModelFile
+        && (extension == ".pial" || extension == ".white" || extension == ".orig"))
+        {
+        item.SurfaceToRAS = surfaceToRAS;
+        }
+      report.MegabytesRead += vtksys::SystemTools::FileLength(item.Directory + item.Name) / (1024.0 * 1024.0);
+      items.push_back(item);
+      }
+    report.NumberOfFiles = static_cast<int>(items.size());
+    return items;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Add the decoded files of a subject to the scene, then compute the statistics and write the output.
+  /// Must be called on the main thread, like all methods of the logic that create nodes.
+  void AddSubjectToScene(vtkSlicerFreeSurferImporterLogic* logic, std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem>& items,
+    const std::string& outputDirectory, bool parcelStatistics, SubjectReport& report)
+  {
+    std::chrono::steady_clock::time_point sceneStart = std::chrono::steady_clock::now();
+    logic->addFreeSurferFilesToScene(items);
+    report.ImportSeconds += GetSeconds(sceneStart);
+    // The stage measurements are not part of the subject report, drop them so they do not accumulate
+    logic->clearFreeSurferImportReport();
+
+    for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : items)
+      {
+      report.NumberOfFilesLoaded += item.Success ? 1 : 0;
+      }
+    report.Success = (report.NumberOfFilesLoaded == report.NumberOfFiles);
+    report.DataMegabytes = GetDataMegabytes(items);
+    report.ProcessMegabytes = GetProcessMegabytes();
+
+    StatisticsTableList statisticsTables;
+    if (parcelStatistics)
+      {
+      std::chrono::steady_clock::time_point statisticsStart = std::chrono::steady_clock::now();
+      report.Success &= AddParcelStatisticsTables(logic, items, statisticsTables);
+      report.StatisticsSeconds = GetSeconds(statisticsStart);
+      }
+
+    if (!outputDirectory.empty())
+      {
+      std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+      report.Success &= WriteItems(items, statisticsTables, outputDirectory + "/" + report.Subject);
+      report.WriteSeconds = GetSeconds(writeStart);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Files of a subject decoded by a worker thread, waiting to be added to the scene
+  struct DecodedSubject
+    {
+    int Index = 0;
+    int Worker = 0;
+    std::chrono::steady_clock::time_point Start;
+    std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> Items;
+    SubjectReport Report;
+    };
+
+  //----------------------------------------------------------------------------
+  void WriteReportHeader(std::ostream& stream)
+  {
+    stream << "Subject\tSuccess\tNumberOfFiles\tNumberOfFilesLoaded\tMegabytesRead\tImportSeconds\tStatisticsSeconds\tWriteSeconds\tTotalSeconds"
+      << "\tThroughputMBps\tDataMegabytes\tProcessMegabytes" << std::endl;
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteReportLine(std::ostream& stream, const SubjectReport& report)
+  {
+    stream << std::fixed << std::setprecision(3)
+      << report.Subject << "\t" << (report.Success ? 1 : 0) << "\t"
+      << report.NumberOfFiles << "\t" << report.NumberOfFilesLoaded << "\t"
+      << report.MegabytesRead << "\t" << report.ImportSeconds << "\t" << report.StatisticsSeconds << "\t"
+      << report.WriteSeconds << "\t" << report.TotalSeconds << "\t"
+      << (report.ImportSeconds > 0.0 ? report.MegabytesRead / report.ImportSeconds : 0.0) << "\t"
+      << report.DataMegabytes << "\t" << report.ProcessMegabytes << std::endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  if (!vtksys::SystemTools::FileIsDirectory(subjectsDirectory))
+    {
+    std::cerr << "Subjects directory " << subjectsDirectory << " does not exist" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::vector<std::string> subjectNames = GetSubjects(subjectsDirectory, subjects, subjectListFile);
+  if (subjectNames.empty())
+    {
+    std::cerr << "No subjects found in " << subjectsDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::string lutFile = colorTable;
+  if (lutFile.empty())
+    {
+    std::string executableDirectory = vtksys::SystemTools::GetFilenamePath(vtksys::SystemTools::CollapseFullPath(argv[0]));
+    lutFile = executableDirectory + "/FreeSurferColorLUT.txt";
+    }
+
+  int numberOfSubjectsInFlight = std::max(1, std::min(maximumSubjectsInFlight, static_cast<int>(subjectNames.size())));
+  int totalNumberOfThreads = numberOfThreads > 0 ? numberOfThreads : static_cast<int>(std::thread::hardware_concurrency());
+  int numberOfThreadsPerSubject = std::max(1, totalNumberOfThreads / numberOfSubjectsInFlight);
+
+  // Each subject in flight has its own scene and logic
+  std::vector<vtkSmartPointer<vtkMRMLScene> > scenes;
+  std::vector<vtkSmartPointer<vtkSlicerFreeSurferImporterLogic> > logics;
+  for (int i = 0; i < numberOfSubjectsInFlight; ++i)
+    {
+    vtkSmartPointer<vtkMRMLScene> scene = vtkSmartPointer<vtkMRMLScene>::New();
+    vtkSmartPointer<vtkSlicerFreeSurferImporterLogic> logic = vtkSmartPointer<vtkSlicerFreeSurferImporterLogic>::New();
+    logic->SetMRMLScene(scene);
+    logic->SetNumberOfThreads(numberOfThreadsPerSubject);
+    logic->registerFreeSurferColorLUT(vtkSlicerFreeSurferImporterLogic::DefaultColorLUTName, lutFile);
+    logic->GetDecodedDataCache()->SetMaximumSize(static_cast<unsigned long long>(cacheSize));
+    logic->GetDecodedDataCache()->SetCacheDirectory(cacheDirectory);
+    scenes.push_back(scene);
+    logics.push_back(logic);
+    }
+
+  std::ofstream reportStream;
+  if (!reportFile.empty())
+    {
+    reportStream.open(reportFile.c_str());
+    WriteReportHeader(reportStream);
+    }
+  WriteReportHeader(std::cout);
+
+  // Subjects are decoded in parallel by one worker thread per subject in flight, each with the thread
+  // pool of its logic. Nodes can only be created on the main thread, so the decoded subjects are added
+  // to their scene, written and released here, one at a time. A worker decodes its next subject once
+  // its previous one is released, which bounds the number of subjects in memory.
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<SubjectReport> reports(subjectNames.size());
+  std::atomic<int> nextSubject(0);
+  std::mutex decodedSubjectsMutex;
+  std::condition_variable decodedSubjectsCondition;
+  std::deque<DecodedSubject> decodedSubjects;
+  std::vector<int> numberOfSubjectsToRelease(numberOfSubjectsInFlight, 0);
+  std::vector<std::thread> workers;
+  for (int worker = 0; worker < numberOfSubjectsInFlight; ++worker)
+    {
+    workers.push_back(std::thread([&, worker]()
+      {
+      for (int index = nextSubject++; index < static_cast<int>(subjectNames.size()); index = nextSubject++)
+        {
+        DecodedSubject decodedSubject;
+        decodedSubject.Index = index;
+        decodedSubject.Worker = worker;
+        decodedSubject.Start = std::chrono::steady_clock::now();
+        decodedSubject.Report.Subject = subjectNames[index];
+        decodedSubject.Items = GetSubjectItems(logics[worker], subjectsDirectory, subjectNames[index], files, decodedSubject.Report);
+        logics[worker]->readFreeSurferFiles(decodedSubject.Items);
+        decodedSubject.Report.ImportSeconds = GetSeconds(decodedSubject.Start);
+
+        std::unique_lock<std::mutex> lock(decodedSubjectsMutex);
+        decodedSubjects.push_back(std::move(decodedSubject));
+        ++numberOfSubjectsToRelease[worker];
+        decodedSubjectsCondition.notify_all();
+        decodedSubjectsCondition.wait(lock, [&]() { return numberOfSubjectsToRelease[worker] == 0; });
+        }
+      }));
+    }
+
+  for (size_t numberOfSubjectsCompleted = 1; numberOfSubjectsCompleted <= subjectNames.size(); ++numberOfSubjectsCompleted)
+    {
+    DecodedSubject decodedSubject;
+      {
+      std::unique_lock<std::mutex> lock(decodedSubjectsMutex);
+      decodedSubjectsCondition.wait(lock, [&]() { return !decodedSubjects.empty(); });
+      decodedSubject = std::move(decodedSubjects.front());
+      decodedSubjects.pop_front();
+      }
+
+    SubjectReport& report = decodedSubject.Report;
+    AddSubjectToScene(logics[decodedSubject.Worker], decodedSubject.Items, outputDirectory, parcelStatistics, report);
+    // Release the data of the subject before the worker decodes the next one
+    decodedSubject.Items.clear();
+    scenes[decodedSubject.Worker]->Clear(true);
+      {
+      std::lock_guard<std::mutex> lock(decodedSubjectsMutex);
+      numberOfSubjectsToRelease[decodedSubject.Worker] = 0;
+      }
+    decodedSubjectsCondition.notify_all();
+    report.TotalSeconds = GetSeconds(decodedSubject.Start);
+
+    reports[decodedSubject.Index] = report;
+    WriteReportLine(std::cout, report);
+    if (reportStream.is_open())
+      {
+      WriteReportLine(reportStream, report);
+      }
+    std::cout << "<filter-progress>" << static_cast<double>(numberOfSubjectsCompleted) / subjectNames.size()
+      << "</filter-progress>" << std::endl;
+    }
+  for (std::thread& worker : workers)
+    {
+    worker.join();
+    }
+
+  double totalSeconds = GetSeconds(start);
+  int numberOfSubjectsFailed = 0;
+  double megabytesRead = 0.0;
+  for (const SubjectReport& report : reports)
+    {
+    numberOfSubjectsFailed += report.Success ? 0 : 1;
+    megabytesRead += report.MegabytesRead;
+    }
+
+  std::cout << std::fixed << std::setprecision(3)
+    << "Imported " << subjectNames.size() - numberOfSubjectsFailed << "/" << subjectNames.size() << " subjects"
+    << " in " << totalSeconds << " s (" << (totalSeconds > 0.0 ? subjectNames.size() / totalSeconds : 0.0) << " subjects/s, "
+    << (totalSeconds > 0.0 ? megabytesRead / totalSeconds : 0.0) << " MB/s) with "
+    << numberOfSubjectsInFlight << " subjects in flight and " << numberOfThreadsPerSubject << " threads per subject,"
+    << " peak process memory " << GetPeakProcessMegabytes() << " MB" << std::endl;
+
+  return numberOfSubjectsFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
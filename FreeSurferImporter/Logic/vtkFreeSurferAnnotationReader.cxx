@@ -0,0 +1,302 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferAnnotationReader.h"
+#include "vtkFreeSurferByteSwap.h"
+#include "vtkFreeSurferColorLUT.h"
+
+// VTK includes
+#include <vtkIntArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  /// Version of the color table format that stores the parcel index of each entry
+  const int ColorTableVersion = 2;
+
+  //----------------------------------------------------------------------------
+  class FileCloser
+  {
+  public:
+    FileCloser(FILE* file) : File(file) {}
+    ~FileCloser()
+    {
+      if (this->File)
+        {
+        fclose(this->File);
+        }
+    }
+    FILE* File;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Bounds-checked sequential reads of big-endian values from a file loaded in memory
+  class BigEndianBuffer
+  {
+  public:
+    BigEndianBuffer(const std::vector<unsigned char>& data, size_t position)
+      : Data(data)
+      , Position(position)
+    {
+    }
+
+    bool ReadInt(int& value)
+    {
+      if (this->Position + 4 > this->Data.size())
+        {
+        return false;
+        }
+      value = vtkFreeSurferByteSwap::ReadBigEndian<int>(this->Data.data() + this->Position);
+      this->Position += 4;
+      return true;
+    }
+
+    /// Read a string of the specified length, stopping at the first null character
+    bool ReadString(int length, std::string& value)
+    {
+      if (length < 0 || this->Position + length > this->Data.size())
+        {
+        return false;
+        }
+      const char* begin = reinterpret_cast<const char*>(this->Data.data() + this->Position);
+      value.assign(begin, std::find(begin, begin + length, '\0'));
+      this->Position += length;
+      return true;
+    }
+
+  protected:
+    const std::vector<unsigned char>& Data;
+    size_t Position;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Read a color table entry: name length, name, red, green, blue and transparency.
+  /// Vertices refer to the entry by its packed color, red + green * 256 + blue * 65536.
+  bool ReadColorTableEntry(BigEndianBuffer& buffer, vtkFreeSurferColorLUT::LabelInfo& info, int& packedColor)
+  {
+    int nameLength = 0;
+    int rgbt[4] = { 0 };
+    if (!buffer.ReadInt(nameLength) || !buffer.ReadString(nameLength, info.Name))
+      {
+      return false;
+      }
+    for (int i = 0; i < 4; ++i)
+      {
+      if (!buffer.ReadInt(rgbt[i]))
+        {
+        return false;
+        }
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      info.Color[i] = rgbt[i] / 255.0;
+      }
+    packedColor = rgbt[0] + (rgbt[1] << 8) + (rgbt[2] << 16);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Read the color table that follows the vertex labels
+  bool ReadColorTable(BigEndianBuffer& buffer, std::vector<vtkFreeSurferColorLUT::LabelInfo>& labels,
+    std::unordered_map<int, int>& packedColorToIndex)
+  {
+    int hasColorTable = 0;
+    int numberOfEntries = 0;
+    if (!buffer.ReadInt(hasColorTable) || !hasColorTable || !buffer.ReadInt(numberOfEntries))
+      {
+      return false;
+      }
+
+    std::string tableName;
+    int tableNameLength = 0;
+    bool indexedEntries = numberOfEntries < 0;
+    if (indexedEntries)
+      {
+      // Current format: version, maximum index, table name and the entries with their index
+      int maximumNumberOfEntries = 0;
+      if (-numberOfEntries != ColorTableVersion || !buffer.ReadInt(maximumNumberOfEntries))
+        {
+        return false;
+        }
+      }
+    if (!buffer.ReadInt(tableNameLength) || !buffer.ReadString(tableNameLength, tableName)
+      || (indexedEntries && !buffer.ReadInt(numberOfEntries)))
+      {
+      return false;
+      }
+
+    for (int entry = 0; entry < numberOfEntries; ++entry)
+      {
+      vtkFreeSurferColorLUT::LabelInfo info;
+      info.Value = entry;
+      int packedColor = 0;
+      if ((indexedEntries && !buffer.ReadInt(info.Value))
+        || !ReadColorTableEntry(buffer, info, packedColor) || info.Value < 0)
+        {
+        return false;
+        }
+      labels.push_back(info);
+      packedColorToIndex.insert(std::make_pair(packedColor, info.Value));
+      }
+    return !labels.empty();
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferAnnotationReader);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferAnnotationReader::vtkFreeSurferAnnotationReader()
+  : FileName(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferAnnotationReader::~vtkFreeSurferAnnotationReader()
+{
+  this->SetFileName(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferAnnotationReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << (this->FileName ? this->FileName : "(none)") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkIntArray* vtkFreeSurferAnnotationReader::GetOutput()
+{
+  return this->Output;
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferColorLUT* vtkFreeSurferAnnotationReader::GetColorTable()
+{
+  return this->ColorTable;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferAnnotationReader::CanReadFile(const std::string& fileName)
+{
+  return vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(fileName)) == ".annot";
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferAnnotationReader::ReadAnnotationInfo(const std::string& fileName, int& numberOfVertices)
+{
+  FILE* file = vtksys::SystemTools::Fopen(fileName, "rb");
+  FileCloser fileCloser(file);
+  unsigned char count[4];
+  if (!file || fread(count, 1, 4, file) != 4)
+    {
+    return false;
+    }
+  numberOfVertices = vtkFreeSurferByteSwap::ReadBigEndian<int>(count);
+  return numberOfVertices > 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferAnnotationReader::Read()
+{
+  this->Output = nullptr;
+  this->ColorTable = nullptr;
+  if (!this->FileName)
+    {
+    vtkErrorMacro("Read: FileName is not set");
+    return false;
+    }
+
+  // Annotations are a few megabytes at most, the whole file is read at once
+  FILE* file = vtksys::SystemTools::Fopen(this->FileName, "rb");
+  FileCloser fileCloser(file);
+  std::vector<unsigned char> contents(static_cast<size_t>(vtksys::SystemTools::FileLength(this->FileName)));
+  if (!file || contents.size() < 4 || fread(contents.data(), 1, contents.size(), file) != contents.size())
+    {
+    vtkErrorMacro("Read: Could not read " << this->FileName);
+    return false;
+    }
+
+  int numberOfVertices = vtkFreeSurferByteSwap::ReadBigEndian<int>(contents.data());
+  size_t labelsSize = 8 * static_cast<size_t>(std::max(numberOfVertices, 0));
+  if (numberOfVertices <= 0 || 4 + labelsSize > contents.size())
+    {
+    vtkErrorMacro("Read: " << this->FileName << " is not a FreeSurfer annotation file");
+    return false;
+    }
+
+  // The color table follows the (vertex, packed color) pairs
+  std::vector<vtkFreeSurferColorLUT::LabelInfo> labels;
+  std::unordered_map<int, int> packedColorToIndex;
+  BigEndianBuffer buffer(contents, 4 + labelsSize);
+  if (!ReadColorTable(buffer, labels, packedColorToIndex))
+    {
+    vtkErrorMacro("Read: Could not read the color table of " << this->FileName);
+    return false;
+    }
+
+  std::vector<vtkTypeInt32> vertexLabels(2 * static_cast<size_t>(numberOfVertices));
+  std::memcpy(vertexLabels.data(), contents.data() + 4, labelsSize);
+  vtkFreeSurferByteSwap::SwapBigEndianRange(vertexLabels.data(), vertexLabels.size(), sizeof(vtkTypeInt32));
+
+  vtkSmartPointer<vtkIntArray> parcelIndices = vtkSmartPointer<vtkIntArray>::New();
+  parcelIndices->SetName(vtksys::SystemTools::GetFilenameName(this->FileName).c_str());
+  parcelIndices->SetNumberOfValues(numberOfVertices);
+  int* parcelIndex = parcelIndices->GetPointer(0);
+  std::fill(parcelIndex, parcelIndex + numberOfVertices, -1);
+
+  // Neighboring vertices are mostly in the same parcel, so the last color is checked before the hash table
+  const vtkTypeInt32* vertexLabel = vertexLabels.data();
+  vtkSMPTools::For(0, numberOfVertices, [&](vtkIdType begin, vtkIdType end)
+    {
+    bool hasLastColor = false;
+    vtkTypeInt32 lastColor = 0;
+    int lastIndex = -1;
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      vtkTypeInt32 vertex = vertexLabel[2 * i];
+      vtkTypeInt32 color = vertexLabel[2 * i + 1];
+      if (vertex < 0 || vertex >= numberOfVertices)
+        {
+        continue;
+        }
+      if (!hasLastColor || color != lastColor)
+        {
+        std::unordered_map<int, int>::const_iterator indexIt = packedColorToIndex.find(color);
+        lastIndex = indexIt != packedColorToIndex.end() ? indexIt->second : -1;
+        lastColor = color;
+        hasLastColor = true;
+        }
+      parcelIndex[vertex] = lastIndex;
+      }
+    });
+
+  this->ColorTable = vtkSmartPointer<vtkFreeSurferColorLUT>::New();
+  this->ColorTable->SetLabels(labels);
+  this->Output = parcelIndices;
+  return true;
+}
@@ -0,0 +1,85 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferAnnotationReader - reader for FreeSurfer surface annotation files
+// .SECTION Description
+// Reads .annot parcellations (lh.aparc.annot, rh.aparc.a2009s.annot, ...).
+// Vertices are labeled in the file by the packed RGB color of their parcel.
+// The embedded color table is read first and a hash table from packed color
+// to parcel index is built once, so each vertex is labeled with a single
+// lookup. The output is one vtkIntArray of parcel indices, meant to be shared
+// by reference by every surface of the hemisphere, and the color table with
+// one entry per parcel index. Vertices without a parcel are labeled -1.
+
+#ifndef __vtkFreeSurferAnnotationReader_h
+#define __vtkFreeSurferAnnotationReader_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkIntArray;
+
+// FreeSurferImporter includes
+class vtkFreeSurferColorLUT;
+
+// STD includes
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferAnnotationReader : public vtkObject
+{
+public:
+  static vtkFreeSurferAnnotationReader* New();
+  vtkTypeMacro(vtkFreeSurferAnnotationReader, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// File to read
+  vtkSetStringMacro(FileName);
+  vtkGetStringMacro(FileName);
+
+  /// Read the file. The output array is named after the file.
+  /// Returns false if the file could not be read or has no color table.
+  bool Read();
+
+  /// Parcel index of each vertex, read by the last call to Read
+  vtkIntArray* GetOutput();
+
+  /// Name and color of each parcel index, read by the last call to Read
+  vtkFreeSurferColorLUT* GetColorTable();
+
+  /// Returns true if the file has the annotation extension
+  static bool CanReadFile(const std::string& fileName);
+
+  /// Read only the number of vertices of an annotation file
+  static bool ReadAnnotationInfo(const std::string& fileName, int& numberOfVertices);
+
+protected:
+  vtkFreeSurferAnnotationReader();
+  ~vtkFreeSurferAnnotationReader() override;
+
+  char* FileName;
+  vtkSmartPointer<vtkIntArray> Output;
+  vtkSmartPointer<vtkFreeSurferColorLUT> ColorTable;
+
+private:
+  vtkFreeSurferAnnotationReader(const vtkFreeSurferAnnotationReader&); // Not implemented
+  void operator=(const vtkFreeSurferAnnotationReader&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferByteSwap - byte order helpers for FreeSurfer file formats
+// .SECTION Description
+// FreeSurfer files are stored big-endian. These helpers swap contiguous ranges
+// in place, 16 bytes at a time using SSE2 where available. The scalar loops
+// handle the remainder and other architectures.
+// This header is internal to the logic library.
+
+#ifndef __vtkFreeSurferByteSwap_h
+#define __vtkFreeSurferByteSwap_h
+
+// STD includes
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define VTK_FREESURFER_BYTESWAP_SSE2
+#endif
+
+namespace vtkFreeSurferByteSwap
+{
+  //----------------------------------------------------------------------------
+  inline bool IsHostLittleEndian()
+  {
+    const std::uint16_t one = 1;
+    unsigned char firstByte = 0;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+  }
+
+  // Values are loaded and stored through memcpy so that the buffers can hold any
+  // scalar type without violating strict aliasing, compilers turn these into plain loads.
+
+#ifdef VTK_FREESURFER_BYTESWAP_SSE2
+  //----------------------------------------------------------------------------
+  inline __m128i SwapBytesIn16BitLanes(__m128i x)
+  {
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  inline void Swap2Range(void* data, std::size_t count)
+  {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    std::size_t i = 0;
+#ifdef VTK_FREESURFER_BYTESWAP_SSE2
+    for (; i + 8 <= count; i += 8)
+      {
+      __m128i* block = reinterpret_cast<__m128i*>(bytes + 2 * i);
+      _mm_storeu_si128(block, SwapBytesIn16BitLanes(_mm_loadu_si128(block)));
+      }
+#endif
+    for (; i < count; ++i)
+      {
+      std::uint16_t v;
+      std::memcpy(&v, bytes + 2 * i, 2);
+      v = static_cast<std::uint16_t>((v >> 8) | (v << 8));
+      std::memcpy(bytes + 2 * i, &v, 2);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  inline void Swap4Range(void* data, std::size_t count)
+  {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    std::size_t i = 0;
+#ifdef VTK_FREESURFER_BYTESWAP_SSE2
+    for (; i + 4 <= count; i += 4)
+      {
+      __m128i* block = reinterpret_cast<__m128i*>(bytes + 4 * i);
+      __m128i x = SwapBytesIn16BitLanes(_mm_loadu_si128(block));
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128(block, x);
+      }
+#endif
+    for (; i < count; ++i)
+      {
+      std::uint32_t v;
+      std::memcpy(&v, bytes + 4 * i, 4);
+      v = (v >> 24)
+        | ((v >> 8) & 0x0000FF00u)
+        | ((v << 8) & 0x00FF0000u)
+        | (v << 24);
+      std::memcpy(bytes + 4 * i, &v, 4);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  inline void Swap8Range(void* data, std::size_t count)
+  {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    std::size_t i = 0;
+#ifdef VTK_FREESURFER_BYTESWAP_SSE2
+    for (; i + 2 <= count; i += 2)
+      {
+      __m128i* block = reinterpret_cast<__m128i*>(bytes + 8 * i);
+      __m128i x = SwapBytesIn16BitLanes(_mm_loadu_si128(block));
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+      _mm_storeu_si128(block, x);
+      }
+#endif
+    for (; i < count; ++i)
+      {
+      std::uint64_t v;
+      std::memcpy(&v, bytes + 8 * i, 8);
+      v = ((v & 0x00000000FFFFFFFFull) << 32) | ((v & 0xFFFFFFFF00000000ull) >> 32);
+      v = ((v & 0x0000FFFF0000FFFFull) << 16) | ((v & 0xFFFF0000FFFF0000ull) >> 16);
+      v = ((v & 0x00FF00FF00FF00FFull) << 8) | ((v & 0xFF00FF00FF00FF00ull) >> 8);
+      std::memcpy(bytes + 8 * i, &v, 8);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Convert a range of big-endian values of the given size to host byte order, in place.
+  inline void SwapBigEndianRange(void* data, std::size_t count, int valueSize)
+  {
+    if (!IsHostLittleEndian())
+      {
+      return;
+      }
+    switch (valueSize)
+      {
+      case 2: Swap2Range(data, count); break;
+      case 4: Swap4Range(data, count); break;
+      case 8: Swap8Range(data, count); break;
+      default: break;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  typedef void (*RangeSwapper)(void* data, std::size_t count);
+
+  /// Get the function that converts ranges of big-endian values of the given size to host byte order,
+  /// so that the value size is dispatched once per file instead of once per range.
+  /// Returns nullptr if the values need no conversion (single bytes, or big-endian host).
+  inline RangeSwapper GetBigEndianRangeSwapper(int valueSize)
+  {
+    if (!IsHostLittleEndian())
+      {
+      return nullptr;
+      }
+    switch (valueSize)
+      {
+      case 2: return &Swap2Range;
+      case 4: return &Swap4Range;
+      case 8: return &Swap8Range;
+      default: return nullptr;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Read a big-endian value from an unaligned buffer.
+  template<typename T>
+  T ReadBigEndian(const unsigned char* buffer)
+  {
+    T value;
+    std::memcpy(&value, buffer, sizeof(T));
+    SwapBigEndianRange(&value, 1, sizeof(T));
+    return value;
+  }
+}
+
+#endif
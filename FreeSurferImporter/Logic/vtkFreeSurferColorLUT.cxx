@@ -0,0 +1,273 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferColorLUT.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool IsBlank(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  //----------------------------------------------------------------------------
+  const char* SkipBlanks(const char* pos, const char* end)
+  {
+    while (pos < end && IsBlank(*pos))
+      {
+      ++pos;
+      }
+    return pos;
+  }
+
+  //----------------------------------------------------------------------------
+  // Parses a decimal integer with an optional minus sign. Returns false if no digits were found
+  // or the value does not fit in an int.
+  bool ParseInt(const char*& pos, const char* end, int& value)
+  {
+    pos = SkipBlanks(pos, end);
+    bool negative = false;
+    if (pos < end && *pos == '-')
+      {
+      negative = true;
+      ++pos;
+      }
+    const char* start = pos;
+    int result = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9')
+      {
+      int digit = *pos - '0';
+      if (result > (std::numeric_limits<int>::max() - digit) / 10)
+        {
+        return false;
+        }
+      result = 10 * result + digit;
+      ++pos;
+      }
+    value = negative ? -result : result;
+    return pos != start && (pos == end || IsBlank(*pos) || *pos == '\n');
+  }
+
+  //----------------------------------------------------------------------------
+  std::mutex CacheMutex;
+  std::map<std::string, vtkSmartPointer<vtkFreeSurferColorLUT> > Cache;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferColorLUT);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferColorLUT::vtkFreeSurferColorLUT()
+  : MaximumLabelValue(-1)
+  , FileModifiedTime(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferColorLUT::~vtkFreeSurferColorLUT()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferColorLUT::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "FileModifiedTime: " << this->FileModifiedTime << std::endl;
+  os << indent << "NumberOfLabels: " << this->Labels.size() << std::endl;
+  os << indent << "MaximumLabelValue: " << this->GetMaximumLabelValue() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferColorLUT::Read(const std::string& fileName)
+{
+  std::ifstream lutFile(fileName, std::ios::in | std::ios::binary);
+  if (!lutFile.is_open())
+    {
+    vtkErrorMacro("Read: Could not open color table " << fileName);
+    return false;
+    }
+
+  // Read the whole file at once, it is small and this avoids per-line stream overhead
+  lutFile.seekg(0, std::ios::end);
+  std::streamoff fileSize = lutFile.tellg();
+  lutFile.seekg(0, std::ios::beg);
+  std::vector<char> contents(static_cast<size_t>(fileSize > 0 ? fileSize : 0));
+  if (!contents.empty() && !lutFile.read(contents.data(), contents.size()))
+    {
+    vtkErrorMacro("Read: Could not read color table " << fileName);
+    return false;
+    }
+
+  this->FileName = fileName;
+  this->FileModifiedTime = vtksys::SystemTools::ModifiedTime(fileName);
+  this->Parse(contents.data(), contents.data() + contents.size());
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferColorLUT::Parse(const char* begin, const char* end)
+{
+  this->ClearLabels();
+
+  const char* lineStart = begin;
+  while (lineStart < end)
+    {
+    const char* lineEnd = lineStart;
+    while (lineEnd < end && *lineEnd != '\n')
+      {
+      ++lineEnd;
+      }
+
+    const char* pos = SkipBlanks(lineStart, lineEnd);
+    lineStart = lineEnd + 1;
+    if (pos == lineEnd || *pos == '#')
+      {
+      continue;
+      }
+
+    // Each entry is: value name R G B A
+    LabelInfo info;
+    if (!ParseInt(pos, lineEnd, info.Value) || info.Value < 0)
+      {
+      continue;
+      }
+
+    pos = SkipBlanks(pos, lineEnd);
+    const char* nameStart = pos;
+    while (pos < lineEnd && !IsBlank(*pos))
+      {
+      ++pos;
+      }
+    if (pos == nameStart)
+      {
+      continue;
+      }
+    info.Name.assign(nameStart, pos);
+
+    int rgba[4] = { 0 };
+    bool valid = true;
+    for (int i = 0; i < 4 && valid; ++i)
+      {
+      valid = ParseInt(pos, lineEnd, rgba[i]);
+      }
+    if (!valid || SkipBlanks(pos, lineEnd) != lineEnd)
+      {
+      continue;
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      info.Color[i] = rgba[i] / 255.0;
+      }
+
+    this->AddLabel(info);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferColorLUT::SetLabels(const std::vector<LabelInfo>& labels)
+{
+  this->ClearLabels();
+  for (const LabelInfo& info : labels)
+    {
+    if (info.Value >= 0)
+      {
+      this->AddLabel(info);
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferColorLUT::ClearLabels()
+{
+  this->Labels.clear();
+  this->LabelIndex.clear();
+  this->SparseLabelIndex.clear();
+  this->MaximumLabelValue = -1;
+}
+
+//----------------------------------------------------------------------------
+const vtkFreeSurferColorLUT::LabelInfo* vtkFreeSurferColorLUT::GetSparseLabelInfo(int value) const
+{
+  std::unordered_map<int, int>::const_iterator it = this->SparseLabelIndex.find(value);
+  return it == this->SparseLabelIndex.end() ? nullptr : &this->Labels[it->second];
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferColorLUT::AddLabel(const LabelInfo& info)
+{
+  this->MaximumLabelValue = std::max(this->MaximumLabelValue, info.Value);
+  if (info.Value > MaximumDenseLabelValue)
+    {
+    this->SparseLabelIndex.emplace(info.Value, -1);
+    }
+  else if (info.Value >= static_cast<int>(this->LabelIndex.size()))
+    {
+    this->LabelIndex.resize(info.Value + 1, -1);
+    }
+  int& index = info.Value > MaximumDenseLabelValue ? this->SparseLabelIndex[info.Value] : this->LabelIndex[info.Value];
+  if (index < 0)
+    {
+    index = static_cast<int>(this->Labels.size());
+    this->Labels.push_back(info);
+    }
+  else
+    {
+    // Later definitions override earlier ones
+    this->Labels[index] = info;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFreeSurferColorLUT> vtkFreeSurferColorLUT::GetCachedLUT(const std::string& fileName)
+{
+  std::string path = vtksys::SystemTools::CollapseFullPath(fileName);
+  long int modifiedTime = vtksys::SystemTools::ModifiedTime(path);
+
+  std::lock_guard<std::mutex> lock(CacheMutex);
+  vtkSmartPointer<vtkFreeSurferColorLUT>& lut = Cache[path];
+  if (lut && lut->GetFileModifiedTime() == modifiedTime)
+    {
+    return lut;
+    }
+
+  // Tables already handed out are left untouched, a changed file results in a new instance
+  vtkSmartPointer<vtkFreeSurferColorLUT> newLUT = vtkSmartPointer<vtkFreeSurferColorLUT>::New();
+  if (!newLUT->Read(path))
+    {
+    Cache.erase(path);
+    return nullptr;
+    }
+  lut = newLUT;
+  return lut;
+}
@@ -0,0 +1,127 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferColorLUT - parsed FreeSurfer color lookup table
+// .SECTION Description
+// Holds the contents of a FreeSurferColorLUT.txt style file as a dense table
+// indexed by label value, label values above MaximumDenseLabelValue are kept in
+// a hash table instead. Instances are immutable once read, so they can be
+// shared between loads (and threads). Use GetCachedLUT to get a process-wide
+// instance that is only re-parsed when the file modification time changes.
+
+#ifndef __vtkFreeSurferColorLUT_h
+#define __vtkFreeSurferColorLUT_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferColorLUT : public vtkObject
+{
+public:
+  static vtkFreeSurferColorLUT* New();
+  vtkTypeMacro(vtkFreeSurferColorLUT, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  struct LabelInfo
+    {
+    int Value = 0;
+    std::string Name = "Unknown";
+    double Color[3] = { 0.5, 0.5, 0.5 };
+    };
+
+  /// Parse the lookup table from the specified file.
+  /// Returns false if the file could not be read.
+  bool Read(const std::string& fileName);
+
+  /// Parse the lookup table from the contents of a file.
+  void Parse(const char* begin, const char* end);
+
+  /// Set the table from a list of labels, e.g. the color table embedded in an annotation file.
+  /// Later definitions of a label value override earlier ones.
+  void SetLabels(const std::vector<LabelInfo>& labels);
+
+  /// Get the entry of the specified label value.
+  /// Returns nullptr if the label is not defined in the table.
+  const LabelInfo* GetLabelInfo(int value) const
+    {
+    if (value < 0)
+      {
+      return nullptr;
+      }
+    if (value >= static_cast<int>(this->LabelIndex.size()))
+      {
+      return this->GetSparseLabelInfo(value);
+      }
+    int index = this->LabelIndex[value];
+    return index < 0 ? nullptr : &this->Labels[index];
+    }
+
+  /// Number of labels defined in the table
+  int GetNumberOfLabels() const { return static_cast<int>(this->Labels.size()); }
+
+  /// Get the n-th defined label, in file order
+  const LabelInfo& GetNthLabelInfo(int n) const { return this->Labels[n]; }
+
+  /// Largest label value defined in the table
+  int GetMaximumLabelValue() const { return this->MaximumLabelValue; }
+
+  /// Label values up to this one are indexed by a dense table, so that a single large
+  /// value (e.g. a packed RGB value) cannot allocate gigabytes of index.
+  static const int MaximumDenseLabelValue = 1 << 20;
+
+  /// File that the table was read from and its modification time at the time of reading
+  std::string GetFileName() const { return this->FileName; }
+  long int GetFileModifiedTime() const { return this->FileModifiedTime; }
+
+  /// Get the shared lookup table parsed from the specified file.
+  /// The file is parsed on first request and whenever its modification time changes.
+  /// Returns nullptr if the file could not be read.
+  static vtkSmartPointer<vtkFreeSurferColorLUT> GetCachedLUT(const std::string& fileName);
+
+protected:
+  vtkFreeSurferColorLUT();
+  ~vtkFreeSurferColorLUT() override;
+
+  void AddLabel(const LabelInfo& info);
+  void ClearLabels();
+  const LabelInfo* GetSparseLabelInfo(int value) const;
+
+  std::vector<LabelInfo> Labels;
+  /// Index in Labels by label value, -1 for undefined values
+  std::vector<int> LabelIndex;
+  /// Index in Labels of the values above MaximumDenseLabelValue
+  std::unordered_map<int, int> SparseLabelIndex;
+  int MaximumLabelValue;
+
+  std::string FileName;
+  long int FileModifiedTime;
+
+private:
+  vtkFreeSurferColorLUT(const vtkFreeSurferColorLUT&); // Not implemented
+  void operator=(const vtkFreeSurferColorLUT&); // Not implemented
+};
+
+#endif
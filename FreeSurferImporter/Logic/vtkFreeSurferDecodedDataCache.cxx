@@ -0,0 +1,746 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferDecodedDataCache.h"
+#include "vtkFreeSurferHash.h"
+#include "vtkFreeSurferMappedFile.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+
+namespace
+{
+  const char EntryMagic[8] = { 'F', 'S', 'C', 'A', 'C', 'H', 'E', '\0' };
+  /// Also detects entries written on a host with a different byte order
+  const std::uint32_t EntryVersion = 1;
+  const char* EntryExtension = ".fscache";
+  /// Arrays are aligned for vector loads of any value type
+  const std::uint64_t ArrayAlignment = 64;
+  /// Size of the blocks at the start and the end of the source file that are hashed
+  const size_t SourceSampleSize = 64 * 1024;
+  const int MaximumArrayNameLength = 255;
+
+  enum EntryKind
+    {
+    ImageEntry = 1,
+    SurfaceEntry,
+    ArrayEntry
+    };
+
+  enum ArrayRole
+    {
+    ScalarsArray = 1,
+    PointsArray,
+    NormalsArray,
+    OffsetsArray,
+    ConnectivityArray,
+    ValuesArray
+    };
+
+  struct EntryHeader
+    {
+    char Magic[8];
+    std::uint32_t Version;
+    std::uint32_t Kind;
+    std::uint64_t SourceSize;
+    std::int64_t SourceModifiedTime;
+    std::uint64_t SourceHash;
+    std::int32_t Extent[6];
+    double Spacing[3];
+    double Origin[3];
+    double Matrix[16];
+    std::uint32_t NumberOfArrays;
+    std::uint32_t SourcePathLength;
+    };
+
+  struct ArrayHeader
+    {
+    std::int32_t Role;
+    std::int32_t DataType;
+    std::int32_t NumberOfComponents;
+    std::int32_t NameLength;
+    std::uint64_t NumberOfValues;
+    std::uint64_t Offset;
+    char Name[MaximumArrayNameLength + 1];
+    };
+
+  struct SourceFingerprint
+    {
+    std::string Path;
+    std::uint64_t Size = 0;
+    std::int64_t ModifiedTime = 0;
+    std::uint64_t Hash = 0;
+    };
+
+  struct EntryArray
+    {
+    int Role;
+    vtkDataArray* Array;
+    };
+
+  //----------------------------------------------------------------------------
+  class FileCloser
+  {
+  public:
+    FileCloser(FILE* file) : File(file) {}
+    ~FileCloser()
+    {
+      if (this->File)
+        {
+        fclose(this->File);
+        }
+    }
+    FILE* File;
+  };
+
+  //----------------------------------------------------------------------------
+  long GetProcessId()
+  {
+#ifdef _WIN32
+    return static_cast<long>(_getpid());
+#else
+    return static_cast<long>(getpid());
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetSourceFingerprint(const std::string& fileName, SourceFingerprint& fingerprint)
+  {
+    fingerprint.Path = vtksys::SystemTools::CollapseFullPath(fileName);
+    vtksys::SystemTools::Stat_t status;
+    if (vtksys::SystemTools::Stat(fingerprint.Path, &status) != 0)
+      {
+      return false;
+      }
+    fingerprint.Size = static_cast<std::uint64_t>(status.st_size);
+    fingerprint.ModifiedTime = static_cast<std::int64_t>(status.st_mtime);
+
+    // Hashing the whole file would cost as much as decoding it
+    FILE* file = vtksys::SystemTools::Fopen(fingerprint.Path, "rb");
+    FileCloser fileCloser(file);
+    if (!file)
+      {
+      return false;
+      }
+    return vtkFreeSurferHash::HashFileSamples(file, fingerprint.Size, SourceSampleSize, fingerprint.Hash);
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetEntryFileName(const std::string& cacheDirectory, const SourceFingerprint& fingerprint)
+  {
+    std::ostringstream name;
+    name << cacheDirectory << "/" << std::hex;
+    name.width(16);
+    name.fill('0');
+    name << vtkFreeSurferHash::HashBytes(fingerprint.Path.c_str(), fingerprint.Path.size()) << EntryExtension;
+    return name.str();
+  }
+
+  //----------------------------------------------------------------------------
+  std::uint64_t Align(std::uint64_t position)
+  {
+    return (position + ArrayAlignment - 1) / ArrayAlignment * ArrayAlignment;
+  }
+
+  //----------------------------------------------------------------------------
+  bool WritePadding(FILE* file, std::uint64_t& position, std::uint64_t alignedPosition)
+  {
+    static const char zeros[ArrayAlignment] = { 0 };
+    size_t size = static_cast<size_t>(alignedPosition - position);
+    position = alignedPosition;
+    return size == 0 || fwrite(zeros, 1, size, file) == size;
+  }
+
+  //----------------------------------------------------------------------------
+  bool WriteEntry(const std::string& entryFileName, EntryHeader header,
+    const SourceFingerprint& fingerprint, const std::vector<EntryArray>& arrays)
+  {
+    std::memcpy(header.Magic, EntryMagic, sizeof(EntryMagic));
+    header.Version = EntryVersion;
+    header.SourceSize = fingerprint.Size;
+    header.SourceModifiedTime = fingerprint.ModifiedTime;
+    header.SourceHash = fingerprint.Hash;
+    header.NumberOfArrays = static_cast<std::uint32_t>(arrays.size());
+    header.SourcePathLength = static_cast<std::uint32_t>(fingerprint.Path.size());
+
+    std::vector<ArrayHeader> arrayHeaders(arrays.size());
+    std::uint64_t position = sizeof(EntryHeader) + fingerprint.Path.size() + arrays.size() * sizeof(ArrayHeader);
+    for (size_t i = 0; i < arrays.size(); ++i)
+      {
+      vtkDataArray* array = arrays[i].Array;
+      ArrayHeader& arrayHeader = arrayHeaders[i];
+      std::memset(&arrayHeader, 0, sizeof(ArrayHeader));
+      arrayHeader.Role = arrays[i].Role;
+      arrayHeader.DataType = array->GetDataType();
+      arrayHeader.NumberOfComponents = array->GetNumberOfComponents();
+      arrayHeader.NumberOfValues = static_cast<std::uint64_t>(array->GetNumberOfValues());
+      if (array->GetName())
+        {
+        std::strncpy(arrayHeader.Name, array->GetName(), MaximumArrayNameLength);
+        arrayHeader.NameLength = static_cast<std::int32_t>(std::strlen(arrayHeader.Name));
+        }
+      arrayHeader.Offset = Align(position);
+      position = arrayHeader.Offset + arrayHeader.NumberOfValues * array->GetDataTypeSize();
+      }
+
+    // Written under a temporary name so that readers never see a partial entry. The name is unique
+    // to the thread and the process, several processes can share a cache directory.
+    std::ostringstream temporaryFileName;
+    temporaryFileName << entryFileName << "." << GetProcessId() << "."
+      << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    FILE* file = vtksys::SystemTools::Fopen(temporaryFileName.str(), "wb");
+    if (!file)
+      {
+      return false;
+      }
+    bool success = fwrite(&header, sizeof(EntryHeader), 1, file) == 1
+      && fwrite(fingerprint.Path.c_str(), 1, fingerprint.Path.size(), file) == fingerprint.Path.size()
+      && (arrayHeaders.empty() || fwrite(arrayHeaders.data(), sizeof(ArrayHeader), arrayHeaders.size(), file) == arrayHeaders.size());
+    position = sizeof(EntryHeader) + fingerprint.Path.size() + arrays.size() * sizeof(ArrayHeader);
+    for (size_t i = 0; success && i < arrays.size(); ++i)
+      {
+      size_t size = static_cast<size_t>(arrayHeaders[i].NumberOfValues) * arrays[i].Array->GetDataTypeSize();
+      success = WritePadding(file, position, arrayHeaders[i].Offset)
+        && (size == 0 || fwrite(arrays[i].Array->GetVoidPointer(0), 1, size, file) == size);
+      position += size;
+      }
+    success = (fclose(file) == 0) && success;
+
+    if (!success || !vtksys::SystemTools::RenameFile(temporaryFileName.str(), entryFileName))
+      {
+      vtksys::SystemTools::RemoveFile(temporaryFileName.str());
+      return false;
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Map an entry and check that it was created from the current version of the source file
+  bool ReadEntry(const std::string& entryFileName, const SourceFingerprint& fingerprint, int kind,
+    vtkFreeSurferMappedFile* mappedFile, EntryHeader& header, std::vector<ArrayHeader>& arrayHeaders)
+  {
+    if (!vtksys::SystemTools::FileExists(entryFileName, true) || !mappedFile->Open(entryFileName))
+      {
+      return false;
+      }
+    const unsigned char* data = mappedFile->GetData();
+    size_t length = mappedFile->GetLength();
+    if (length < sizeof(EntryHeader))
+      {
+      return false;
+      }
+    std::memcpy(&header, data, sizeof(EntryHeader));
+    if (std::memcmp(header.Magic, EntryMagic, sizeof(EntryMagic)) != 0
+      || header.Version != EntryVersion
+      || header.Kind != static_cast<std::uint32_t>(kind)
+      || header.SourceSize != fingerprint.Size
+      || header.SourceModifiedTime != fingerprint.ModifiedTime
+      || header.SourceHash != fingerprint.Hash
+      || header.SourcePathLength != fingerprint.Path.size())
+      {
+      return false;
+      }
+
+    size_t position = sizeof(EntryHeader);
+    if (length < position + header.SourcePathLength + header.NumberOfArrays * sizeof(ArrayHeader)
+      || std::memcmp(data + position, fingerprint.Path.c_str(), header.SourcePathLength) != 0)
+      {
+      return false;
+      }
+    position += header.SourcePathLength;
+
+    arrayHeaders.resize(header.NumberOfArrays);
+    for (ArrayHeader& arrayHeader : arrayHeaders)
+      {
+      std::memcpy(&arrayHeader, data + position, sizeof(ArrayHeader));
+      arrayHeader.Name[MaximumArrayNameLength] = '\0';
+      position += sizeof(ArrayHeader);
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkDataArray> WrapEntryArray(vtkFreeSurferMappedFile* mappedFile,
+    const std::vector<ArrayHeader>& arrayHeaders, int role)
+  {
+    for (const ArrayHeader& arrayHeader : arrayHeaders)
+      {
+      if (arrayHeader.Role != role)
+        {
+        continue;
+        }
+      vtkSmartPointer<vtkDataArray> array = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(arrayHeader.DataType));
+      if (!array || arrayHeader.NumberOfComponents < 1)
+        {
+        return nullptr;
+        }
+      array->SetNumberOfComponents(arrayHeader.NumberOfComponents);
+      if (!mappedFile->WrapArray(array, arrayHeader.Offset, static_cast<vtkIdType>(arrayHeader.NumberOfValues)))
+        {
+        return nullptr;
+        }
+      if (arrayHeader.NameLength > 0)
+        {
+        array->SetName(arrayHeader.Name);
+        }
+      return array;
+      }
+    return nullptr;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferDecodedDataCache);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferDecodedDataCache::vtkFreeSurferDecodedDataCache()
+  : MaximumSize(10240)
+  , EntriesListed(false)
+  , TotalSize(0)
+  , UseCount(0)
+  , NumberOfHits(0)
+  , NumberOfMisses(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferDecodedDataCache::~vtkFreeSurferDecodedDataCache() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "CacheDirectory: " << this->GetCacheDirectory() << std::endl;
+  os << indent << "MaximumSize: " << this->GetMaximumSize() << " MB" << std::endl;
+  os << indent << "NumberOfHits: " << this->NumberOfHits << std::endl;
+  os << indent << "NumberOfMisses: " << this->NumberOfMisses << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::SetCacheDirectory(const std::string& cacheDirectory)
+{
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::string directory = cacheDirectory.empty() ? std::string() : vtksys::SystemTools::CollapseFullPath(cacheDirectory);
+    if (directory == this->CacheDirectory)
+      {
+      return;
+      }
+    if (!directory.empty() && !vtksys::SystemTools::MakeDirectory(directory))
+      {
+      vtkErrorMacro("SetCacheDirectory: Could not create " << directory);
+      return;
+      }
+    this->CacheDirectory = directory;
+    this->Entries.clear();
+    this->EntriesListed = false;
+    this->TotalSize = 0;
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFreeSurferDecodedDataCache::GetCacheDirectory()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->CacheDirectory;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::IsEnabled()
+{
+  return !this->GetCacheDirectory().empty();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::SetMaximumSize(unsigned long long megabytes)
+{
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (megabytes == this->MaximumSize)
+      {
+      return;
+      }
+    this->MaximumSize = megabytes;
+    }
+  this->Modified();
+  this->RemoveLeastRecentlyUsedEntries();
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkFreeSurferDecodedDataCache::GetMaximumSize()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MaximumSize;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::LoadImage(const std::string& sourceFileName, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !imageData || !ijkToRAS || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return false;
+    }
+
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  vtkNew<vtkFreeSurferMappedFile> mappedFile;
+  EntryHeader header;
+  std::vector<ArrayHeader> arrayHeaders;
+  vtkSmartPointer<vtkDataArray> scalars;
+  if (!ReadEntry(entryFileName, fingerprint, ImageEntry, mappedFile, header, arrayHeaders)
+    || !(scalars = WrapEntryArray(mappedFile, arrayHeaders, ScalarsArray)))
+    {
+    ++this->NumberOfMisses;
+    return false;
+    }
+
+  imageData->Initialize();
+  imageData->SetExtent(header.Extent);
+  imageData->SetSpacing(header.Spacing);
+  imageData->SetOrigin(header.Origin);
+  imageData->GetPointData()->SetScalars(scalars);
+  ijkToRAS->DeepCopy(header.Matrix);
+
+  // The modification time of the entry is its last use, for the next processes that list the directory
+  vtksys::SystemTools::Touch(entryFileName, false);
+  this->UpdateEntry(entryFileName);
+  ++this->NumberOfHits;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::StoreImage(const std::string& sourceFileName, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !imageData || !imageData->GetPointData()->GetScalars() || !ijkToRAS
+    || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return false;
+    }
+
+  EntryHeader header;
+  std::memset(&header, 0, sizeof(EntryHeader));
+  header.Kind = ImageEntry;
+  int extent[6];
+  imageData->GetExtent(extent);
+  std::copy(extent, extent + 6, header.Extent);
+  imageData->GetSpacing(header.Spacing);
+  imageData->GetOrigin(header.Origin);
+  std::copy(&ijkToRAS->Element[0][0], &ijkToRAS->Element[0][0] + 16, header.Matrix);
+
+  std::vector<EntryArray> arrays;
+  arrays.push_back({ ScalarsArray, imageData->GetPointData()->GetScalars() });
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  if (!WriteEntry(entryFileName, header, fingerprint, arrays))
+    {
+    return false;
+    }
+  this->UpdateEntry(entryFileName, static_cast<long long>(vtksys::SystemTools::FileLength(entryFileName)));
+  this->RemoveLeastRecentlyUsedEntries();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::LoadSurface(const std::string& sourceFileName, vtkPolyData* surface)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !surface || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return false;
+    }
+
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  vtkNew<vtkFreeSurferMappedFile> mappedFile;
+  EntryHeader header;
+  std::vector<ArrayHeader> arrayHeaders;
+  vtkSmartPointer<vtkDataArray> coordinates;
+  vtkSmartPointer<vtkDataArray> offsets;
+  vtkSmartPointer<vtkDataArray> connectivity;
+  if (!ReadEntry(entryFileName, fingerprint, SurfaceEntry, mappedFile, header, arrayHeaders)
+    || !(coordinates = WrapEntryArray(mappedFile, arrayHeaders, PointsArray))
+    || !(offsets = WrapEntryArray(mappedFile, arrayHeaders, OffsetsArray))
+    || !(connectivity = WrapEntryArray(mappedFile, arrayHeaders, ConnectivityArray)))
+    {
+    ++this->NumberOfMisses;
+    return false;
+    }
+
+  vtkNew<vtkPoints> points;
+  points->SetData(coordinates);
+  vtkNew<vtkCellArray> polys;
+  if (!polys->SetData(offsets, connectivity))
+    {
+    ++this->NumberOfMisses;
+    return false;
+    }
+
+  surface->Initialize();
+  surface->SetPoints(points);
+  surface->SetPolys(polys);
+  vtkSmartPointer<vtkDataArray> normals = WrapEntryArray(mappedFile, arrayHeaders, NormalsArray);
+  if (normals)
+    {
+    surface->GetPointData()->SetNormals(normals);
+    }
+
+  vtksys::SystemTools::Touch(entryFileName, false);
+  this->UpdateEntry(entryFileName);
+  ++this->NumberOfHits;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::StoreSurface(const std::string& sourceFileName, vtkPolyData* surface)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !surface || !surface->GetPoints() || !surface->GetPolys()
+    || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return false;
+    }
+
+  EntryHeader header;
+  std::memset(&header, 0, sizeof(EntryHeader));
+  header.Kind = SurfaceEntry;
+
+  std::vector<EntryArray> arrays;
+  arrays.push_back({ PointsArray, surface->GetPoints()->GetData() });
+  arrays.push_back({ OffsetsArray, surface->GetPolys()->GetOffsetsArray() });
+  arrays.push_back({ ConnectivityArray, surface->GetPolys()->GetConnectivityArray() });
+  if (surface->GetPointData()->GetNormals())
+    {
+    arrays.push_back({ NormalsArray, surface->GetPointData()->GetNormals() });
+    }
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  if (!WriteEntry(entryFileName, header, fingerprint, arrays))
+    {
+    return false;
+    }
+  this->UpdateEntry(entryFileName, static_cast<long long>(vtksys::SystemTools::FileLength(entryFileName)));
+  this->RemoveLeastRecentlyUsedEntries();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkDataArray> vtkFreeSurferDecodedDataCache::LoadArray(const std::string& sourceFileName)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return nullptr;
+    }
+
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  vtkNew<vtkFreeSurferMappedFile> mappedFile;
+  EntryHeader header;
+  std::vector<ArrayHeader> arrayHeaders;
+  vtkSmartPointer<vtkDataArray> values;
+  if (!ReadEntry(entryFileName, fingerprint, ArrayEntry, mappedFile, header, arrayHeaders)
+    || !(values = WrapEntryArray(mappedFile, arrayHeaders, ValuesArray)))
+    {
+    ++this->NumberOfMisses;
+    return nullptr;
+    }
+
+  vtksys::SystemTools::Touch(entryFileName, false);
+  this->UpdateEntry(entryFileName);
+  ++this->NumberOfHits;
+  return values;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferDecodedDataCache::StoreArray(const std::string& sourceFileName, vtkDataArray* array)
+{
+  std::string cacheDirectory = this->GetCacheDirectory();
+  SourceFingerprint fingerprint;
+  if (cacheDirectory.empty() || !array || !GetSourceFingerprint(sourceFileName, fingerprint))
+    {
+    return false;
+    }
+
+  EntryHeader header;
+  std::memset(&header, 0, sizeof(EntryHeader));
+  header.Kind = ArrayEntry;
+
+  std::vector<EntryArray> arrays;
+  arrays.push_back({ ValuesArray, array });
+  std::string entryFileName = GetEntryFileName(cacheDirectory, fingerprint);
+  if (!WriteEntry(entryFileName, header, fingerprint, arrays))
+    {
+    return false;
+    }
+  this->UpdateEntry(entryFileName, static_cast<long long>(vtksys::SystemTools::FileLength(entryFileName)));
+  this->RemoveLeastRecentlyUsedEntries();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  vtksys::Directory directory;
+  if (this->CacheDirectory.empty() || !directory.Load(this->CacheDirectory))
+    {
+    return;
+    }
+  for (unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i)
+    {
+    std::string fileName = directory.GetFile(i);
+    if (vtksys::SystemTools::StringEndsWith(fileName, EntryExtension))
+      {
+      vtksys::SystemTools::RemoveFile(this->CacheDirectory + "/" + fileName);
+      }
+    }
+  this->Entries.clear();
+  this->EntriesListed = true;
+  this->TotalSize = 0;
+}
+
+//----------------------------------------------------------------------------
+double vtkFreeSurferDecodedDataCache::GetSizeInMegabytes()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->ListEntries();
+  return this->TotalSize / (1024.0 * 1024.0);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::ListEntries()
+{
+  vtksys::Directory directory;
+  if (this->EntriesListed || this->CacheDirectory.empty() || !directory.Load(this->CacheDirectory))
+    {
+    return;
+    }
+
+  // Entries left by previous sessions are ordered by their last use, the modification time of their file
+  std::vector<std::pair<long long, std::string> > entriesByTime;
+  for (unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i)
+    {
+    std::string fileName = this->CacheDirectory + "/" + directory.GetFile(i);
+    vtksys::SystemTools::Stat_t status;
+    if (!vtksys::SystemTools::StringEndsWith(fileName, EntryExtension) || vtksys::SystemTools::Stat(fileName, &status) != 0)
+      {
+      continue;
+      }
+    entriesByTime.push_back(std::make_pair(static_cast<long long>(status.st_mtime), fileName));
+    EntryInfo& entry = this->Entries[fileName];
+    entry.Size = static_cast<unsigned long long>(status.st_size);
+    this->TotalSize += entry.Size;
+    }
+  std::sort(entriesByTime.begin(), entriesByTime.end());
+  for (const std::pair<long long, std::string>& entryByTime : entriesByTime)
+    {
+    this->Entries[entryByTime.second].LastUse = ++this->UseCount;
+    }
+  this->EntriesListed = true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::UpdateEntry(const std::string& entryFileName, long long size/*=-1*/)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->CacheDirectory.empty())
+    {
+    return;
+    }
+  this->ListEntries();
+  std::map<std::string, EntryInfo>::iterator entryIt = this->Entries.find(entryFileName);
+  if (entryIt == this->Entries.end())
+    {
+    // Written by another process since the entries were listed
+    entryIt = this->Entries.insert(std::make_pair(entryFileName, EntryInfo())).first;
+    if (size < 0)
+      {
+      size = static_cast<long long>(vtksys::SystemTools::FileLength(entryFileName));
+      }
+    }
+  EntryInfo& entry = entryIt->second;
+  if (size >= 0)
+    {
+    this->TotalSize = this->TotalSize - entry.Size + static_cast<unsigned long long>(size);
+    entry.Size = static_cast<unsigned long long>(size);
+    }
+  entry.LastUse = ++this->UseCount;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferDecodedDataCache::RemoveLeastRecentlyUsedEntries()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->ListEntries();
+  unsigned long long maximumSize = this->MaximumSize * 1024 * 1024;
+  if (this->MaximumSize == 0 || this->TotalSize <= maximumSize)
+    {
+    return;
+    }
+
+  std::vector<std::pair<unsigned long long, std::string> > entriesByUse;
+  for (const std::pair<const std::string, EntryInfo>& entry : this->Entries)
+    {
+    entriesByUse.push_back(std::make_pair(entry.second.LastUse, entry.first));
+    }
+  std::sort(entriesByUse.begin(), entriesByUse.end());
+  for (const std::pair<unsigned long long, std::string>& entryByUse : entriesByUse)
+    {
+    if (this->TotalSize <= maximumSize)
+      {
+      break;
+      }
+    // Entries that are still mapped stay valid until they are unmapped. Entries removed by
+    // another process are only forgotten.
+    if (vtksys::SystemTools::RemoveFile(entryByUse.second) || !vtksys::SystemTools::FileExists(entryByUse.second))
+      {
+      std::map<std::string, EntryInfo>::iterator entryIt = this->Entries.find(entryByUse.second);
+      this->TotalSize -= entryIt->second.Size;
+      this->Entries.erase(entryIt);
+      }
+    }
+}
@@ -0,0 +1,126 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferDecodedDataCache - persistent cache of decoded FreeSurfer files
+// .SECTION Description
+// Stores decoded volumes, surfaces and overlays on disk, uncompressed and in
+// host byte order, with every array aligned so that it can be used directly
+// from a memory mapping. Entries are keyed by the path of the source file and
+// validated against its size, modification time and a hash of its first and
+// last blocks, so a modified source is decoded again. The least recently used
+// entries are removed when the total size exceeds MaximumSize. The size and
+// last use of the entries are listed from the cache directory once and then
+// kept up to date, so storing an entry does not list the directory again.
+// All methods are thread-safe.
+
+#ifndef __vtkFreeSurferDecodedDataCache_h
+#define __vtkFreeSurferDecodedDataCache_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+// STD includes
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferDecodedDataCache : public vtkObject
+{
+public:
+  static vtkFreeSurferDecodedDataCache* New();
+  vtkTypeMacro(vtkFreeSurferDecodedDataCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Directory of the cache entries. The cache is disabled if the directory is empty (default).
+  void SetCacheDirectory(const std::string& cacheDirectory);
+  std::string GetCacheDirectory();
+
+  /// Returns true if a cache directory is set
+  bool IsEnabled();
+
+  /// Maximum total size of the cache entries in megabytes. 0 means no limit. Default is 10240.
+  void SetMaximumSize(unsigned long long megabytes);
+  unsigned long long GetMaximumSize();
+
+  /// Get a decoded volume. The voxels are used from the mapped cache entry without copying.
+  /// Returns false if there is no valid entry for the source file.
+  bool LoadImage(const std::string& sourceFileName, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS);
+  bool StoreImage(const std::string& sourceFileName, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS);
+
+  /// Get a decoded surface with its point normals, in surface coordinates.
+  bool LoadSurface(const std::string& sourceFileName, vtkPolyData* surface);
+  bool StoreSurface(const std::string& sourceFileName, vtkPolyData* surface);
+
+  /// Get a decoded per-vertex array. Returns nullptr if there is no valid entry.
+  vtkSmartPointer<vtkDataArray> LoadArray(const std::string& sourceFileName);
+  bool StoreArray(const std::string& sourceFileName, vtkDataArray* array);
+
+  /// Remove all entries
+  void Clear();
+
+  /// Total size of the entries in megabytes
+  double GetSizeInMegabytes();
+
+  int GetNumberOfHits() const { return this->NumberOfHits; }
+  int GetNumberOfMisses() const { return this->NumberOfMisses; }
+
+protected:
+  vtkFreeSurferDecodedDataCache();
+  ~vtkFreeSurferDecodedDataCache() override;
+
+  /// Remove the least recently used entries until the cache fits in MaximumSize
+  void RemoveLeastRecentlyUsedEntries();
+
+  /// Record that an entry was written or used. The size is only updated if it is not negative.
+  void UpdateEntry(const std::string& entryFileName, long long size = -1);
+
+  /// List the entries of the cache directory if they are not listed yet. Must be called with the mutex locked.
+  void ListEntries();
+
+  struct EntryInfo
+    {
+    unsigned long long Size = 0;
+    /// Entries with a lower value were used less recently
+    unsigned long long LastUse = 0;
+    };
+
+  std::mutex Mutex;
+  std::string CacheDirectory;
+  unsigned long long MaximumSize;
+  /// Entries of the cache directory, by file name
+  std::map<std::string, EntryInfo> Entries;
+  bool EntriesListed;
+  unsigned long long TotalSize;
+  unsigned long long UseCount;
+  std::atomic<int> NumberOfHits;
+  std::atomic<int> NumberOfMisses;
+
+private:
+  vtkFreeSurferDecodedDataCache(const vtkFreeSurferDecodedDataCache&); // Not implemented
+  void operator=(const vtkFreeSurferDecodedDataCache&); // Not implemented
+};
+
+#endif
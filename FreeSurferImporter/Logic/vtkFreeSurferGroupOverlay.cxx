@@ -0,0 +1,375 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferGroupOverlay.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace
+{
+  /// Rows start on a cache line
+  const vtkIdType AlignmentInFloats = 64 / sizeof(float);
+
+  /// Vertices reduced together, small enough for the accumulators of a block to stay in cache
+  const vtkIdType VertexBlockSize = 1024;
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferGroupOverlay);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferGroupOverlay::vtkFreeSurferGroupOverlay()
+  : Name(nullptr)
+  , NumberOfSubjects(0)
+  , NumberOfVertices(0)
+  , RowStride(0)
+  , Values(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferGroupOverlay::~vtkFreeSurferGroupOverlay()
+{
+  this->SetName(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferGroupOverlay::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Name: " << (this->Name ? this->Name : "(none)") << std::endl;
+  os << indent << "NumberOfSubjects: " << this->NumberOfSubjects << std::endl;
+  os << indent << "NumberOfValidSubjects: " << this->GetNumberOfValidSubjects() << std::endl;
+  os << indent << "NumberOfVertices: " << this->NumberOfVertices << std::endl;
+  os << indent << "RowStride: " << this->RowStride << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferGroupOverlay::Allocate(int numberOfSubjects, vtkIdType numberOfVertices)
+{
+  this->NumberOfSubjects = 0;
+  this->NumberOfVertices = 0;
+  this->RowStride = 0;
+  this->Values = nullptr;
+  this->Buffer.clear();
+  this->Buffer.shrink_to_fit();
+  this->SubjectValid.clear();
+  this->SubjectNames.clear();
+  if (numberOfSubjects < 0 || numberOfVertices < 0)
+    {
+    vtkErrorMacro("Allocate: Invalid size " << numberOfSubjects << " x " << numberOfVertices);
+    return false;
+    }
+
+  vtkIdType rowStride = (numberOfVertices + AlignmentInFloats - 1) / AlignmentInFloats * AlignmentInFloats;
+  try
+    {
+    this->Buffer.assign(static_cast<size_t>(numberOfSubjects) * rowStride + AlignmentInFloats, 0.0f);
+    }
+  catch (const std::bad_alloc&)
+    {
+    vtkErrorMacro("Allocate: Not enough memory for " << numberOfSubjects << " x " << numberOfVertices << " values");
+    return false;
+    }
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(this->Buffer.data());
+  std::uintptr_t alignment = AlignmentInFloats * sizeof(float);
+  this->Values = this->Buffer.data() + ((alignment - address % alignment) % alignment) / sizeof(float);
+
+  this->NumberOfSubjects = numberOfSubjects;
+  this->NumberOfVertices = numberOfVertices;
+  this->RowStride = rowStride;
+  this->SubjectValid.assign(numberOfSubjects, 0);
+  this->SubjectNames.assign(numberOfSubjects, std::string());
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferGroupOverlay::GetNumberOfSubjects() const
+{
+  return this->NumberOfSubjects;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkFreeSurferGroupOverlay::GetNumberOfVertices() const
+{
+  return this->NumberOfVertices;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkFreeSurferGroupOverlay::GetRowStride() const
+{
+  return this->RowStride;
+}
+
+//----------------------------------------------------------------------------
+float* vtkFreeSurferGroupOverlay::GetSubjectValues(int subject)
+{
+  if (subject < 0 || subject >= this->NumberOfSubjects)
+    {
+    return nullptr;
+    }
+  return this->Values + subject * this->RowStride;
+}
+
+//----------------------------------------------------------------------------
+const float* vtkFreeSurferGroupOverlay::GetSubjectValues(int subject) const
+{
+  if (subject < 0 || subject >= this->NumberOfSubjects)
+    {
+    return nullptr;
+    }
+  return this->Values + subject * this->RowStride;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferGroupOverlay::SetSubjectValues(int subject, vtkDataArray* values)
+{
+  float* row = this->GetSubjectValues(subject);
+  if (!row || !values || values->GetNumberOfTuples() != this->NumberOfVertices)
+    {
+    return false;
+    }
+  vtkFloatArray* floatValues = vtkFloatArray::SafeDownCast(values);
+  if (floatValues && floatValues->GetNumberOfComponents() == 1)
+    {
+    memcpy(row, floatValues->GetPointer(0), this->NumberOfVertices * sizeof(float));
+    }
+  else
+    {
+    for (vtkIdType i = 0; i < this->NumberOfVertices; ++i)
+      {
+      row[i] = static_cast<float>(values->GetComponent(i, 0));
+      }
+    }
+  this->SubjectValid[subject] = 1;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferGroupOverlay::SetSubjectValid(int subject, bool valid)
+{
+  if (subject >= 0 && subject < this->NumberOfSubjects)
+    {
+    this->SubjectValid[subject] = valid ? 1 : 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferGroupOverlay::GetSubjectValid(int subject) const
+{
+  return subject >= 0 && subject < this->NumberOfSubjects && this->SubjectValid[subject];
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferGroupOverlay::GetNumberOfValidSubjects() const
+{
+  return static_cast<int>(std::count(this->SubjectValid.begin(), this->SubjectValid.end(), 1));
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferGroupOverlay::SetSubjectName(int subject, const std::string& name)
+{
+  if (subject >= 0 && subject < this->NumberOfSubjects)
+    {
+    this->SubjectNames[subject] = name;
+    }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFreeSurferGroupOverlay::GetSubjectName(int subject) const
+{
+  if (subject < 0 || subject >= this->NumberOfSubjects)
+    {
+    return std::string();
+    }
+  return this->SubjectNames[subject];
+}
+
+//----------------------------------------------------------------------------
+std::vector<int> vtkFreeSurferGroupOverlay::GetValidSubjectGroups() const
+{
+  std::vector<int> groups(this->NumberOfSubjects, 0);
+  for (int subject = 0; subject < this->NumberOfSubjects; ++subject)
+    {
+    groups[subject] = this->SubjectValid[subject] ? 0 : -1;
+    }
+  return groups;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferGroupOverlay::ComputeMoments(const std::vector<int>& groups, int numberOfGroups,
+  std::vector<std::vector<float> >& means, std::vector<std::vector<float> >& variances,
+  std::vector<std::vector<int> >& counts) const
+{
+  means.assign(numberOfGroups, std::vector<float>(this->NumberOfVertices, 0.0f));
+  variances.assign(numberOfGroups, std::vector<float>(this->NumberOfVertices, 0.0f));
+  counts.assign(numberOfGroups, std::vector<int>(this->NumberOfVertices, 0));
+
+  std::vector<int> subjects;
+  for (int subject = 0; subject < this->NumberOfSubjects; ++subject)
+    {
+    if (this->SubjectValid[subject] && groups[subject] >= 0 && groups[subject] < numberOfGroups)
+      {
+      subjects.push_back(subject);
+      }
+    }
+
+  vtkSMPTools::For(0, this->NumberOfVertices, VertexBlockSize, [&](vtkIdType begin, vtkIdType end)
+    {
+    // Running count, mean and sum of squared deviations of each group (Welford), in double precision.
+    // Non-finite values (e.g. vertices of a resampled overlay outside the subject sphere) are left out.
+    std::vector<double> accumulators(3 * numberOfGroups * VertexBlockSize);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (vtkIdType blockBegin = begin; blockBegin < end; blockBegin += VertexBlockSize)
+      {
+      vtkIdType blockSize = std::min(VertexBlockSize, end - blockBegin);
+      std::fill(accumulators.begin(), accumulators.end(), 0.0);
+      for (int subject : subjects)
+        {
+        int group = groups[subject];
+        double* count = &accumulators[3 * group * VertexBlockSize];
+        double* mean = count + VertexBlockSize;
+        double* squaredDeviations = mean + VertexBlockSize;
+        const float* row = this->Values + subject * this->RowStride + blockBegin;
+        for (vtkIdType i = 0; i < blockSize; ++i)
+          {
+          // Selects rather than a branch, so that the loop is still vectorized
+          bool finite = std::isfinite(row[i]);
+          double value = finite ? row[i] : mean[i];
+          count[i] += finite ? 1.0 : 0.0;
+          double delta = value - mean[i];
+          mean[i] += delta / std::max(count[i], 1.0);
+          squaredDeviations[i] += delta * (value - mean[i]);
+          }
+        }
+      for (int group = 0; group < numberOfGroups; ++group)
+        {
+        const double* count = &accumulators[3 * group * VertexBlockSize];
+        const double* mean = count + VertexBlockSize;
+        const double* squaredDeviations = mean + VertexBlockSize;
+        float* groupMeans = means[group].data() + blockBegin;
+        float* groupVariances = variances[group].data() + blockBegin;
+        int* groupCounts = counts[group].data() + blockBegin;
+        for (vtkIdType i = 0; i < blockSize; ++i)
+          {
+          groupCounts[i] = static_cast<int>(count[i]);
+          if (count[i] == 0.0)
+            {
+            groupMeans[i] = nan;
+            groupVariances[i] = nan;
+            continue;
+            }
+          groupMeans[i] = static_cast<float>(mean[i]);
+          groupVariances[i] = count[i] > 1.0 ? static_cast<float>(squaredDeviations[i] / (count[i] - 1.0)) : 0.0f;
+          }
+        }
+      }
+    });
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferGroupOverlay::CreateOutput(const char* suffix, const std::vector<float>& values) const
+{
+  vtkSmartPointer<vtkFloatArray> output = vtkSmartPointer<vtkFloatArray>::New();
+  output->SetName((std::string(this->Name ? this->Name : "") + suffix).c_str());
+  output->SetNumberOfValues(this->NumberOfVertices);
+  std::copy(values.begin(), values.end(), output->GetPointer(0));
+  return output;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferGroupOverlay::ComputeMean()
+{
+  std::vector<std::vector<float> > means;
+  std::vector<std::vector<float> > variances;
+  std::vector<std::vector<int> > vertexCounts;
+  this->ComputeMoments(this->GetValidSubjectGroups(), 1, means, variances, vertexCounts);
+  return this->CreateOutput(".mean", means[0]);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferGroupOverlay::ComputeStandardDeviation()
+{
+  std::vector<std::vector<float> > means;
+  std::vector<std::vector<float> > variances;
+  std::vector<std::vector<int> > vertexCounts;
+  this->ComputeMoments(this->GetValidSubjectGroups(), 1, means, variances, vertexCounts);
+  float* variance = variances[0].data();
+  for (vtkIdType i = 0; i < this->NumberOfVertices; ++i)
+    {
+    variance[i] = std::sqrt(variance[i]);
+    }
+  return this->CreateOutput(".std", variances[0]);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferGroupOverlay::ComputeTStatistic(const std::vector<int>& groups)
+{
+  if (groups.size() != static_cast<size_t>(this->NumberOfSubjects))
+    {
+    vtkErrorMacro("ComputeTStatistic: Expected " << this->NumberOfSubjects << " groups, got " << groups.size());
+    return nullptr;
+    }
+  int counts[2] = { 0, 0 };
+  for (int subject = 0; subject < this->NumberOfSubjects; ++subject)
+    {
+    if (this->SubjectValid[subject] && (groups[subject] == 0 || groups[subject] == 1))
+      {
+      ++counts[groups[subject]];
+      }
+    }
+  if (counts[0] < 2 || counts[1] < 2)
+    {
+    vtkErrorMacro("ComputeTStatistic: Each group needs at least 2 valid subjects, got " << counts[0] << " and " << counts[1]);
+    return nullptr;
+    }
+
+  std::vector<std::vector<float> > means;
+  std::vector<std::vector<float> > variances;
+  std::vector<std::vector<int> > vertexCounts;
+  this->ComputeMoments(groups, 2, means, variances, vertexCounts);
+  std::vector<float> t(this->NumberOfVertices, std::numeric_limits<float>::quiet_NaN());
+  const float* mean0 = means[0].data();
+  const float* mean1 = means[1].data();
+  const float* variance0 = variances[0].data();
+  const float* variance1 = variances[1].data();
+  const int* count0 = vertexCounts[0].data();
+  const int* count1 = vertexCounts[1].data();
+  for (vtkIdType i = 0; i < this->NumberOfVertices; ++i)
+    {
+    if (count0[i] < 2 || count1[i] < 2)
+      {
+      continue;
+      }
+    float standardError = std::sqrt(variance1[i] / count1[i] + variance0[i] / count0[i]);
+    t[i] = standardError > 0.0f ? (mean1[i] - mean0[i]) / standardError : 0.0f;
+    }
+  return this->CreateOutput(".t", t);
+}
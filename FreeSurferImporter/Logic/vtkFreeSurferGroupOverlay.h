@@ -0,0 +1,129 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferGroupOverlay - per-vertex overlays of a group of subjects
+// .SECTION Description
+// Holds one overlay per subject on a common surface, usually fsaverage
+// (?h.thickness.fwhm10.fsaverage.mgh, or overlays resampled through
+// sphere.reg), as a single subjects x vertices float matrix. Each subject is
+// one row, rows start on a cache line, so that subjects can be filled from
+// several threads at once and reductions stream through whole rows.
+// Per-vertex mean, standard deviation and the Welch t-statistic between two
+// groups of subjects are computed in parallel over blocks of vertices, with
+// inner loops over contiguous vertices that the compiler vectorizes.
+// Subjects that could not be loaded are marked invalid and left out, as are
+// non-finite values (e.g. vertices that could not be resampled).
+
+#ifndef __vtkFreeSurferGroupOverlay_h
+#define __vtkFreeSurferGroupOverlay_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkFloatArray;
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferGroupOverlay : public vtkObject
+{
+public:
+  static vtkFreeSurferGroupOverlay* New();
+  vtkTypeMacro(vtkFreeSurferGroupOverlay, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Name of the overlay (e.g. "lh.thickness"), used as prefix of the names of the computed arrays
+  vtkSetStringMacro(Name);
+  vtkGetStringMacro(Name);
+
+  /// Allocate the matrix. All values are set to 0 and all subjects are invalid.
+  /// Returns false if the matrix could not be allocated.
+  bool Allocate(int numberOfSubjects, vtkIdType numberOfVertices);
+
+  int GetNumberOfSubjects() const;
+  vtkIdType GetNumberOfVertices() const;
+
+  /// Number of floats from the start of a subject row to the start of the next one
+  vtkIdType GetRowStride() const;
+
+  /// Values of a subject, GetNumberOfVertices floats aligned on a cache line
+  float* GetSubjectValues(int subject);
+  const float* GetSubjectValues(int subject) const;
+
+  /// Copy the values of a subject and mark it valid.
+  /// Can be called from several threads at once for different subjects.
+  /// Returns false if the subject is out of range or the number of values is not the number of vertices.
+  bool SetSubjectValues(int subject, vtkDataArray* values);
+
+  /// Only valid subjects are used by the reductions.
+  /// Can be called from several threads at once for different subjects.
+  void SetSubjectValid(int subject, bool valid);
+  bool GetSubjectValid(int subject) const;
+  int GetNumberOfValidSubjects() const;
+
+  /// Identifier of a subject, e.g. the file its values were read from
+  void SetSubjectName(int subject, const std::string& name);
+  std::string GetSubjectName(int subject) const;
+
+  /// Mean of the finite values of the valid subjects at each vertex, named "<Name>.mean".
+  /// Vertices without finite values are NaN, as for the standard deviation.
+  vtkSmartPointer<vtkFloatArray> ComputeMean();
+
+  /// Sample standard deviation of the finite values of the valid subjects at each vertex, named "<Name>.std"
+  vtkSmartPointer<vtkFloatArray> ComputeStandardDeviation();
+
+  /// Welch t-statistic of group 1 against group 0 at each vertex, named "<Name>.t".
+  /// groups has one entry per subject: 0 or 1, any other value leaves the subject out.
+  /// Vertices with less than 2 finite values in a group are set to NaN, vertices where neither group
+  /// varies (e.g. the medial wall) are set to 0.
+  /// Returns nullptr if groups does not have one entry per subject or a group has less than 2 valid subjects.
+  vtkSmartPointer<vtkFloatArray> ComputeTStatistic(const std::vector<int>& groups);
+
+protected:
+  vtkFreeSurferGroupOverlay();
+  ~vtkFreeSurferGroupOverlay() override;
+
+  /// Mean, sample variance and number of finite values of the subjects of each group at each vertex.
+  /// groups has one entry per subject, subjects in a group other than 0..numberOfGroups-1 are left out.
+  /// Non-finite values are left out, the mean and variance of a vertex without finite values are NaN.
+  void ComputeMoments(const std::vector<int>& groups, int numberOfGroups,
+    std::vector<std::vector<float> >& means, std::vector<std::vector<float> >& variances,
+    std::vector<std::vector<int> >& counts) const;
+
+  std::vector<int> GetValidSubjectGroups() const;
+  vtkSmartPointer<vtkFloatArray> CreateOutput(const char* suffix, const std::vector<float>& values) const;
+
+  char* Name;
+  int NumberOfSubjects;
+  vtkIdType NumberOfVertices;
+  vtkIdType RowStride;
+  std::vector<float> Buffer;
+  /// Start of the first row within Buffer
+  float* Values;
+  std::vector<char> SubjectValid;
+  std::vector<std::string> SubjectNames;
+
+private:
+  vtkFreeSurferGroupOverlay(const vtkFreeSurferGroupOverlay&); // Not implemented
+  void operator=(const vtkFreeSurferGroupOverlay&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferHash - content hashing for deduplication and cache keys
+// .SECTION Description
+// 64-bit non-cryptographic hash that processes 8 bytes per step, fast enough
+// to hash the connectivity of a full-resolution surface in a few milliseconds.
+// This header is internal to the logic library.
+
+#ifndef __vtkFreeSurferHash_h
+#define __vtkFreeSurferHash_h
+
+// STD includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace vtkFreeSurferHash
+{
+  //----------------------------------------------------------------------------
+  inline std::uint64_t Mix(std::uint64_t value)
+  {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Hash a block of memory, optionally continuing from a previous hash value.
+  inline std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed = 0)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hash = seed ^ (size * 0x9E3779B97F4A7C15ull);
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+      {
+      std::uint64_t word;
+      std::memcpy(&word, bytes + i, 8);
+      hash = (hash ^ Mix(word)) * 0x9E3779B97F4A7C15ull;
+      }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, size - i);
+    return Mix(hash ^ Mix(tail));
+  }
+
+  //----------------------------------------------------------------------------
+  /// Hash the size and the first and last sampleSize bytes of an open file of the specified size,
+  /// to detect that a file was replaced without reading all of it. Returns false if the file cannot be read.
+  inline bool HashFileSamples(FILE* file, std::uint64_t fileSize, std::size_t sampleSize, std::uint64_t& hash)
+  {
+    sampleSize = static_cast<std::size_t>(std::min<std::uint64_t>(sampleSize, fileSize));
+    std::vector<unsigned char> sample(sampleSize);
+    if (fseek(file, 0, SEEK_SET) != 0 || fread(sample.data(), 1, sampleSize, file) != sampleSize)
+      {
+      return false;
+      }
+    hash = HashBytes(sample.data(), sampleSize, fileSize);
+    if (fileSize > sampleSize)
+      {
+      if (fseek(file, -static_cast<long>(sampleSize), SEEK_END) != 0
+        || fread(sample.data(), 1, sampleSize, file) != sampleSize)
+        {
+        return false;
+        }
+      hash = HashBytes(sample.data(), sampleSize, hash);
+      }
+    return true;
+  }
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferImageHistogram.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+  struct HistogramResult
+    {
+    double Range[2] = { 0.0, 0.0 };
+    double BinOrigin = 0.0;
+    double BinSpacing = 1.0;
+    bool DiscreteBins = false;
+    std::vector<vtkIdType> Bins;
+    };
+
+  //----------------------------------------------------------------------------
+  /// 8-bit values: one bin per value, counted in a single pass
+  template<typename T>
+  bool ComputeHistogram(const T* values, vtkIdType numberOfValues, vtkIdType step, int vtkNotUsed(numberOfBins),
+    HistogramResult& result, std::true_type vtkNotUsed(isByteType))
+  {
+    std::array<vtkIdType, 256> zeroCounts;
+    zeroCounts.fill(0);
+    vtkSMPThreadLocal<std::array<vtkIdType, 256> > threadCounts(zeroCounts);
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      std::array<vtkIdType, 256>& counts = threadCounts.Local();
+      // Counted in a local table first so that the loop does not go through the thread-local storage
+      std::array<vtkIdType, 256> chunkCounts;
+      chunkCounts.fill(0);
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        ++chunkCounts[static_cast<unsigned char>(values[i * step])];
+        }
+      for (int value = 0; value < 256; ++value)
+        {
+        counts[value] += chunkCounts[value];
+        }
+      });
+
+    // Bins are ordered by value, so signed types start at their lowest value
+    const int lowest = static_cast<int>(std::numeric_limits<T>::lowest());
+    result.Bins.assign(256, 0);
+    for (const std::array<vtkIdType, 256>& counts : threadCounts)
+      {
+      for (int value = lowest; value < lowest + 256; ++value)
+        {
+        result.Bins[value - lowest] += counts[static_cast<unsigned char>(static_cast<T>(value))];
+        }
+      }
+    result.BinOrigin = lowest;
+    result.BinSpacing = 1.0;
+    result.DiscreteBins = true;
+    auto first = std::find_if(result.Bins.begin(), result.Bins.end(), [](vtkIdType count) { return count > 0; });
+    if (first == result.Bins.end())
+      {
+      return false;
+      }
+    auto last = std::find_if(result.Bins.rbegin(), result.Bins.rend(), [](vtkIdType count) { return count > 0; });
+    result.Range[0] = lowest + static_cast<double>(first - result.Bins.begin());
+    result.Range[1] = lowest + static_cast<double>(result.Bins.rend() - last - 1);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Other types: a pass for the range, then a pass for the bins
+  template<typename T>
+  bool ComputeHistogram(const T* values, vtkIdType numberOfValues, vtkIdType step, int numberOfBins,
+    HistogramResult& result, std::false_type vtkNotUsed(isByteType))
+  {
+    struct Range
+      {
+      T Minimum = std::numeric_limits<T>::max();
+      T Maximum = std::numeric_limits<T>::lowest();
+      };
+    vtkSMPThreadLocal<Range> threadRanges;
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      Range& range = threadRanges.Local();
+      T minimum = range.Minimum;
+      T maximum = range.Maximum;
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        // Written so that NaN values are skipped
+        T value = values[i * step];
+        minimum = value < minimum ? value : minimum;
+        maximum = value > maximum ? value : maximum;
+        }
+      range.Minimum = minimum;
+      range.Maximum = maximum;
+      });
+    T minimum = std::numeric_limits<T>::max();
+    T maximum = std::numeric_limits<T>::lowest();
+    for (const Range& range : threadRanges)
+      {
+      minimum = std::min(minimum, range.Minimum);
+      maximum = std::max(maximum, range.Maximum);
+      }
+    if (minimum > maximum)
+      {
+      return false;
+      }
+    result.Range[0] = static_cast<double>(minimum);
+    result.Range[1] = static_cast<double>(maximum);
+
+    // Integers with a small range get one bin per value
+    double width = result.Range[1] - result.Range[0];
+    result.DiscreteBins = std::is_integral<T>::value && width < numberOfBins;
+    if (result.DiscreteBins)
+      {
+      numberOfBins = static_cast<int>(width) + 1;
+      }
+    result.BinOrigin = result.Range[0];
+    result.BinSpacing = result.DiscreteBins ? 1.0 : std::max(width, 1e-30) / numberOfBins;
+    const double binScale = 1.0 / result.BinSpacing;
+    const double origin = result.BinOrigin;
+    const int lastBin = numberOfBins - 1;
+
+    vtkSMPThreadLocal<std::vector<vtkIdType> > threadBins;
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      std::vector<vtkIdType>& bins = threadBins.Local();
+      if (bins.empty())
+        {
+        bins.assign(numberOfBins, 0);
+        }
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        T value = values[i * step];
+        if (value != value)
+          {
+          continue;
+          }
+        int bin = static_cast<int>((static_cast<double>(value) - origin) * binScale);
+        ++bins[std::min(bin, lastBin)];
+        }
+      });
+    result.Bins.assign(numberOfBins, 0);
+    for (const std::vector<vtkIdType>& bins : threadBins)
+      {
+      for (size_t bin = 0; bin < bins.size(); ++bin)
+        {
+        result.Bins[bin] += bins[bin];
+        }
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  bool ComputeHistogram(const T* values, vtkIdType numberOfValues, vtkIdType step, int numberOfBins, HistogramResult& result)
+  {
+    return ComputeHistogram(values, numberOfValues, step, numberOfBins, result,
+      std::integral_constant<bool, std::is_integral<T>::value && sizeof(T) == 1>());
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferImageHistogram);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferImageHistogram::vtkFreeSurferImageHistogram()
+  : NumberOfBins(1024)
+  , BinOrigin(0.0)
+  , BinSpacing(1.0)
+  , DiscreteBins(false)
+  , NumberOfValues(0)
+{
+  this->Range[0] = 0.0;
+  this->Range[1] = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferImageHistogram::~vtkFreeSurferImageHistogram() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferImageHistogram::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfBins: " << this->NumberOfBins << std::endl;
+  os << indent << "Range: " << this->Range[0] << " " << this->Range[1] << std::endl;
+  os << indent << "BinOrigin: " << this->BinOrigin << std::endl;
+  os << indent << "BinSpacing: " << this->BinSpacing << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferImageHistogram::Compute(vtkImageData* image)
+{
+  this->Bins.clear();
+  this->NumberOfValues = 0;
+  this->Range[0] = 0.0;
+  this->Range[1] = 0.0;
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : nullptr;
+  if (!scalars || scalars->GetNumberOfTuples() == 0)
+    {
+    return false;
+    }
+
+  HistogramResult result;
+  bool success = false;
+  void* values = scalars->GetVoidPointer(0);
+  vtkIdType numberOfTuples = scalars->GetNumberOfTuples();
+  vtkIdType step = scalars->GetNumberOfComponents();
+  switch (scalars->GetDataType())
+    {
+    vtkTemplateMacro(success = ComputeHistogram(static_cast<const VTK_TT*>(values), numberOfTuples, step,
+      this->NumberOfBins, result));
+    default:
+      vtkErrorMacro("Compute: Unsupported scalar type " << scalars->GetDataTypeAsString());
+      return false;
+    }
+  if (!success)
+    {
+    return false;
+    }
+
+  this->Range[0] = result.Range[0];
+  this->Range[1] = result.Range[1];
+  this->BinOrigin = result.BinOrigin;
+  this->BinSpacing = result.BinSpacing;
+  this->DiscreteBins = result.DiscreteBins;
+  this->Bins.swap(result.Bins);
+  for (vtkIdType count : this->Bins)
+    {
+    this->NumberOfValues += count;
+    }
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkFreeSurferImageHistogram::GetPercentile(double percent) const
+{
+  if (this->NumberOfValues == 0)
+    {
+    return 0.0;
+    }
+  double target = std::min(std::max(percent, 0.0), 100.0) / 100.0 * this->NumberOfValues;
+  double cumulative = 0.0;
+  for (size_t bin = 0; bin < this->Bins.size(); ++bin)
+    {
+    if (this->Bins[bin] == 0 || cumulative + this->Bins[bin] < target)
+      {
+      cumulative += this->Bins[bin];
+      continue;
+      }
+    if (this->DiscreteBins)
+      {
+      return this->BinOrigin + bin * this->BinSpacing;
+      }
+    // Values are assumed uniform within a bin
+    double fraction = (target - cumulative) / this->Bins[bin];
+    double value = this->BinOrigin + (bin + fraction) * this->BinSpacing;
+    return std::min(std::max(value, this->Range[0]), this->Range[1]);
+    }
+  return this->Range[1];
+}
@@ -0,0 +1,84 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferImageHistogram - parallel intensity histogram of a volume
+// .SECTION Description
+// Computes the range and the histogram of the first component of an image,
+// in parallel with vtkSMPTools, with kernels instantiated per scalar type and
+// dispatched once per volume. 8-bit volumes, such as the conformed UCHAR
+// volumes of a subject (orig.mgz, T1.mgz, brain.mgz), are counted in a single
+// pass with one bin per value. Other types take one pass for the range and one
+// pass for the bins. Percentiles of the histogram give the initial window/level
+// of imported volumes without another scan of the voxels.
+
+#ifndef __vtkFreeSurferImageHistogram_h
+#define __vtkFreeSurferImageHistogram_h
+
+// VTK includes
+#include <vtkObject.h>
+class vtkImageData;
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferImageHistogram : public vtkObject
+{
+public:
+  static vtkFreeSurferImageHistogram* New();
+  vtkTypeMacro(vtkFreeSurferImageHistogram, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Number of bins of the histogram of types larger than 8 bits. Default is 1024.
+  vtkSetClampMacro(NumberOfBins, int, 2, 65536);
+  vtkGetMacro(NumberOfBins, int);
+
+  /// Compute the range and histogram of the first component of the image, NaN values are ignored.
+  /// Returns false if the image has no scalars or no valid values.
+  bool Compute(vtkImageData* image);
+
+  /// Smallest and largest value found by the last call to Compute
+  vtkGetVector2Macro(Range, double);
+
+  /// Counts of the bins, bin i starts at BinOrigin + i * BinSpacing
+  const std::vector<vtkIdType>& GetBins() const { return this->Bins; }
+  vtkGetMacro(BinOrigin, double);
+  vtkGetMacro(BinSpacing, double);
+
+  /// Value below which the specified percentage of the voxels lie
+  double GetPercentile(double percent) const;
+
+protected:
+  vtkFreeSurferImageHistogram();
+  ~vtkFreeSurferImageHistogram() override;
+
+  int NumberOfBins;
+  double Range[2];
+  double BinOrigin;
+  double BinSpacing;
+  /// True if each bin holds a single integer value
+  bool DiscreteBins;
+  std::vector<vtkIdType> Bins;
+  vtkIdType NumberOfValues;
+
+private:
+  vtkFreeSurferImageHistogram(const vtkFreeSurferImageHistogram&); // Not implemented
+  void operator=(const vtkFreeSurferImageHistogram&); // Not implemented
+};
+
+#endif
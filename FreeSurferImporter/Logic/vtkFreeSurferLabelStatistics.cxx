@@ -0,0 +1,334 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferLabelStatistics.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <unordered_map>
+
+namespace
+{
+  typedef std::unordered_map<int, vtkFreeSurferLabelStatistics::LabelInfo> LabelInfoMap;
+
+  //----------------------------------------------------------------------------
+  void AddRun(vtkFreeSurferLabelStatistics::LabelInfo& info, int iBegin, int iEnd, int j, int k)
+  {
+    info.NumberOfVoxels += iEnd - iBegin + 1;
+    info.Extent[0] = std::min(info.Extent[0], iBegin);
+    info.Extent[1] = std::max(info.Extent[1], iEnd);
+    info.Extent[2] = std::min(info.Extent[2], j);
+    info.Extent[3] = std::max(info.Extent[3], j);
+    info.Extent[4] = std::min(info.Extent[4], k);
+    info.Extent[5] = std::max(info.Extent[5], k);
+  }
+
+  //----------------------------------------------------------------------------
+  void MergeInfo(vtkFreeSurferLabelStatistics::LabelInfo& info, const vtkFreeSurferLabelStatistics::LabelInfo& other)
+  {
+    info.NumberOfVoxels += other.NumberOfVoxels;
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      info.Extent[2 * axis] = std::min(info.Extent[2 * axis], other.Extent[2 * axis]);
+      info.Extent[2 * axis + 1] = std::max(info.Extent[2 * axis + 1], other.Extent[2 * axis + 1]);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Each work unit is a row of voxels along the I axis
+  template<typename T>
+  class LabelScanFunctor
+  {
+  public:
+    LabelScanFunctor(const T* scalars, const int extent[6], int numberOfComponents, int backgroundValue)
+      : Scalars(scalars)
+      , NumberOfComponents(numberOfComponents)
+      , BackgroundValue(backgroundValue)
+    {
+      std::copy(extent, extent + 6, this->Extent);
+      this->RowLength = extent[1] - extent[0] + 1;
+      this->NumberOfRowsPerSlice = extent[3] - extent[2] + 1;
+    }
+
+    void Initialize()
+    {
+    }
+
+    void operator()(vtkIdType beginRow, vtkIdType endRow)
+    {
+      LabelInfoMap& labels = this->Labels.Local();
+      const int step = this->NumberOfComponents;
+      for (vtkIdType row = beginRow; row < endRow; ++row)
+        {
+        const T* voxel = this->Scalars + row * this->RowLength * step;
+        int j = this->Extent[2] + static_cast<int>(row % this->NumberOfRowsPerSlice);
+        int k = this->Extent[4] + static_cast<int>(row / this->NumberOfRowsPerSlice);
+        int i = 0;
+        while (i < this->RowLength)
+          {
+          T value = voxel[i * step];
+          int runBegin = i;
+          while (++i < this->RowLength && voxel[i * step] == value)
+            {
+            }
+          int label = static_cast<int>(value);
+          if (label == this->BackgroundValue)
+            {
+            continue;
+            }
+          LabelInfoMap::iterator it = labels.find(label);
+          if (it == labels.end())
+            {
+            it = labels.emplace(label, vtkFreeSurferLabelStatistics::LabelInfo()).first;
+            it->second.Value = label;
+            }
+          AddRun(it->second, this->Extent[0] + runBegin, this->Extent[0] + i - 1, j, k);
+          }
+        }
+    }
+
+    void Reduce()
+    {
+    }
+
+    vtkSMPThreadLocal<LabelInfoMap> Labels;
+
+  protected:
+    const T* Scalars;
+    int Extent[6];
+    vtkIdType RowLength;
+    vtkIdType NumberOfRowsPerSlice;
+    int NumberOfComponents;
+    int BackgroundValue;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Label scan of 8-bit volumes (e.g. conformed UCHAR volumes): every possible value
+  /// has a slot in a table, so runs are counted without hashing
+  template<typename T>
+  class ByteLabelScanFunctor
+  {
+  public:
+    typedef std::array<vtkFreeSurferLabelStatistics::LabelInfo, 256> LabelInfoTable;
+
+    ByteLabelScanFunctor(const T* scalars, const int extent[6], int numberOfComponents)
+      : Scalars(scalars)
+      , NumberOfComponents(numberOfComponents)
+    {
+      std::copy(extent, extent + 6, this->Extent);
+      this->RowLength = extent[1] - extent[0] + 1;
+      this->NumberOfRowsPerSlice = extent[3] - extent[2] + 1;
+    }
+
+    void Initialize()
+    {
+      LabelInfoTable& labels = this->Labels.Local();
+      for (int index = 0; index < 256; ++index)
+        {
+        labels[index] = vtkFreeSurferLabelStatistics::LabelInfo();
+        labels[index].Value = static_cast<int>(static_cast<T>(index));
+        }
+    }
+
+    void operator()(vtkIdType beginRow, vtkIdType endRow)
+    {
+      LabelInfoTable& labels = this->Labels.Local();
+      const int step = this->NumberOfComponents;
+      for (vtkIdType row = beginRow; row < endRow; ++row)
+        {
+        const T* voxel = this->Scalars + row * this->RowLength * step;
+        int j = this->Extent[2] + static_cast<int>(row % this->NumberOfRowsPerSlice);
+        int k = this->Extent[4] + static_cast<int>(row / this->NumberOfRowsPerSlice);
+        int i = 0;
+        while (i < this->RowLength)
+          {
+          T value = voxel[i * step];
+          int runBegin = i;
+          while (++i < this->RowLength && voxel[i * step] == value)
+            {
+            }
+          AddRun(labels[static_cast<unsigned char>(value)], this->Extent[0] + runBegin, this->Extent[0] + i - 1, j, k);
+          }
+        }
+    }
+
+    void Reduce()
+    {
+    }
+
+    vtkSMPThreadLocal<LabelInfoTable> Labels;
+
+  protected:
+    const T* Scalars;
+    int Extent[6];
+    vtkIdType RowLength;
+    vtkIdType NumberOfRowsPerSlice;
+    int NumberOfComponents;
+  };
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void ScanLabels(const T* scalars, const int extent[6], int numberOfComponents, int backgroundValue, LabelInfoMap& labels,
+    std::true_type vtkNotUsed(isByteType))
+  {
+    ByteLabelScanFunctor<T> functor(scalars, extent, numberOfComponents);
+    vtkIdType numberOfRows = static_cast<vtkIdType>(extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+    vtkSMPTools::For(0, numberOfRows, functor);
+
+    for (const typename ByteLabelScanFunctor<T>::LabelInfoTable& threadLabels : functor.Labels)
+      {
+      for (const vtkFreeSurferLabelStatistics::LabelInfo& threadLabel : threadLabels)
+        {
+        if (threadLabel.NumberOfVoxels == 0 || threadLabel.Value == backgroundValue)
+          {
+          continue;
+          }
+        auto inserted = labels.emplace(threadLabel.Value, threadLabel);
+        if (!inserted.second)
+          {
+          MergeInfo(inserted.first->second, threadLabel);
+          }
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void ScanLabels(const T* scalars, const int extent[6], int numberOfComponents, int backgroundValue, LabelInfoMap& labels,
+    std::false_type vtkNotUsed(isByteType))
+  {
+    LabelScanFunctor<T> functor(scalars, extent, numberOfComponents, backgroundValue);
+    vtkIdType numberOfRows = static_cast<vtkIdType>(extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+    vtkSMPTools::For(0, numberOfRows, functor);
+
+    for (const LabelInfoMap& threadLabels : functor.Labels)
+      {
+      for (const auto& threadLabel : threadLabels)
+        {
+        auto inserted = labels.emplace(threadLabel.first, threadLabel.second);
+        if (!inserted.second)
+          {
+          MergeInfo(inserted.first->second, threadLabel.second);
+          }
+        }
+      }
+  }
+  //----------------------------------------------------------------------------
+  /// The label type is dispatched once per volume, 8-bit integer volumes use the table scan
+  template<typename T>
+  void ScanLabels(const T* scalars, const int extent[6], int numberOfComponents, int backgroundValue, LabelInfoMap& labels)
+  {
+    ScanLabels(scalars, extent, numberOfComponents, backgroundValue, labels,
+      std::integral_constant<bool, std::is_integral<T>::value && sizeof(T) == 1>());
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferLabelStatistics);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferLabelStatistics::vtkFreeSurferLabelStatistics()
+  : BackgroundValue(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferLabelStatistics::~vtkFreeSurferLabelStatistics() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferLabelStatistics::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "BackgroundValue: " << this->BackgroundValue << std::endl;
+  os << indent << "NumberOfLabels: " << this->Labels.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferLabelStatistics::Compute(vtkImageData* labelImage)
+{
+  this->Labels.clear();
+  this->LabelIndex.clear();
+  if (!labelImage || !labelImage->GetPointData()->GetScalars())
+    {
+    vtkErrorMacro("Compute: Label image has no scalars");
+    return false;
+    }
+
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  labelImage->GetExtent(extent);
+  if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+    {
+    return true;
+    }
+
+  LabelInfoMap labels;
+  void* scalars = labelImage->GetScalarPointer();
+  int numberOfComponents = labelImage->GetNumberOfScalarComponents();
+  switch (labelImage->GetScalarType())
+    {
+    vtkTemplateMacro(ScanLabels(static_cast<const VTK_TT*>(scalars), extent, numberOfComponents, this->BackgroundValue, labels));
+    default:
+      vtkErrorMacro("Compute: Unsupported scalar type " << labelImage->GetScalarTypeAsString());
+      return false;
+    }
+
+  this->Labels.reserve(labels.size());
+  for (const auto& label : labels)
+    {
+    this->Labels.push_back(label.second);
+    }
+  std::sort(this->Labels.begin(), this->Labels.end(),
+    [](const LabelInfo& a, const LabelInfo& b) { return a.Value < b.Value; });
+  for (size_t index = 0; index < this->Labels.size(); ++index)
+    {
+    this->LabelIndex[this->Labels[index].Value] = static_cast<int>(index);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+const vtkFreeSurferLabelStatistics::LabelInfo* vtkFreeSurferLabelStatistics::GetLabelInfo(int value) const
+{
+  std::map<int, int>::const_iterator it = this->LabelIndex.find(value);
+  return it == this->LabelIndex.end() ? nullptr : &this->Labels[it->second];
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferLabelStatistics::GetLabelsExtent(int extent[6]) const
+{
+  if (this->Labels.empty())
+    {
+    return false;
+    }
+  LabelInfo all;
+  for (const LabelInfo& info : this->Labels)
+    {
+    MergeInfo(all, info);
+    }
+  std::copy(all.Extent, all.Extent + 6, extent);
+  return true;
+}
@@ -0,0 +1,89 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferLabelStatistics - single-pass statistics of a label volume
+// .SECTION Description
+// Scans a label volume (aseg.mgz, aparc+aseg.mgz, ...) once, in parallel with
+// vtkSMPTools, and collects the voxel count and the bounding extent of every
+// label. Voxels are visited row by row and runs of equal labels are counted
+// at once, so the cost is close to a single read of the voxel buffer.
+
+#ifndef __vtkFreeSurferLabelStatistics_h
+#define __vtkFreeSurferLabelStatistics_h
+
+// VTK includes
+#include <vtkObject.h>
+class vtkImageData;
+
+// STD includes
+#include <map>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferLabelStatistics : public vtkObject
+{
+public:
+  static vtkFreeSurferLabelStatistics* New();
+  vtkTypeMacro(vtkFreeSurferLabelStatistics, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  struct LabelInfo
+    {
+    int Value = 0;
+    vtkIdType NumberOfVoxels = 0;
+    /// Extent of the voxels of the label, in the index space of the image
+    int Extent[6] = { VTK_INT_MAX, VTK_INT_MIN, VTK_INT_MAX, VTK_INT_MIN, VTK_INT_MAX, VTK_INT_MIN };
+    };
+
+  /// Voxels with this value are not reported. Default is 0.
+  vtkSetMacro(BackgroundValue, int);
+  vtkGetMacro(BackgroundValue, int);
+
+  /// Scan the first component of the label image.
+  /// Returns false if the image has no scalars.
+  bool Compute(vtkImageData* labelImage);
+
+  /// Number of labels found, excluding the background
+  int GetNumberOfLabels() const { return static_cast<int>(this->Labels.size()); }
+
+  /// Get the n-th label, in increasing label value order
+  const LabelInfo& GetNthLabelInfo(int n) const { return this->Labels[n]; }
+
+  /// Get the statistics of the specified label value.
+  /// Returns nullptr if the label is not present in the image.
+  const LabelInfo* GetLabelInfo(int value) const;
+
+  /// Get the union of the extents of all labels.
+  /// Returns false if the image contains only background.
+  bool GetLabelsExtent(int extent[6]) const;
+
+protected:
+  vtkFreeSurferLabelStatistics();
+  ~vtkFreeSurferLabelStatistics() override;
+
+  int BackgroundValue;
+  std::vector<LabelInfo> Labels;
+  std::map<int, int> LabelIndex;
+
+private:
+  vtkFreeSurferLabelStatistics(const vtkFreeSurferLabelStatistics&); // Not implemented
+  void operator=(const vtkFreeSurferLabelStatistics&); // Not implemented
+};
+
+#endif
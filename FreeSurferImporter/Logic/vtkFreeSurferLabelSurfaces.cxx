@@ -0,0 +1,208 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferLabelSurfaces.h"
+#include "vtkFreeSurferLabelStatistics.h"
+
+// VTK includes
+#include <vtkAlgorithmOutput.h>
+#include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkImageConstantPad.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkSMPTools.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferLabelSurfaces);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferLabelSurfaces::vtkFreeSurferLabelSurfaces()
+  : BackgroundValue(0)
+  , SmoothingFactor(0.5)
+  , ComputeNormals(true)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferLabelSurfaces::~vtkFreeSurferLabelSurfaces() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferLabelSurfaces::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfLabelValues: " << this->LabelValues.size() << std::endl;
+  os << indent << "BackgroundValue: " << this->BackgroundValue << std::endl;
+  os << indent << "SmoothingFactor: " << this->SmoothingFactor << std::endl;
+  os << indent << "ComputeNormals: " << (this->ComputeNormals ? "true" : "false") << std::endl;
+  os << indent << "NumberOfOutputs: " << this->Outputs.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferLabelSurfaces::SetLabelValues(const std::vector<int>& labelValues)
+{
+  this->LabelValues = labelValues;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferLabelSurfaces::Compute(vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS)
+{
+  this->OutputLabelValues.clear();
+  this->Outputs.clear();
+  if (!ijkToRAS)
+    {
+    vtkErrorMacro("Compute: IJK to RAS matrix is not set");
+    return false;
+    }
+
+  vtkNew<vtkFreeSurferLabelStatistics> labelStatistics;
+  labelStatistics->SetBackgroundValue(this->BackgroundValue);
+  if (!labelImage || !labelStatistics->Compute(labelImage))
+    {
+    vtkErrorMacro("Compute: Label image has no scalars");
+    return false;
+    }
+
+  std::vector<const vtkFreeSurferLabelStatistics::LabelInfo*> labels;
+  for (int i = 0; i < labelStatistics->GetNumberOfLabels(); ++i)
+    {
+    const vtkFreeSurferLabelStatistics::LabelInfo& info = labelStatistics->GetNthLabelInfo(i);
+    if (this->LabelValues.empty()
+      || std::find(this->LabelValues.begin(), this->LabelValues.end(), info.Value) != this->LabelValues.end())
+      {
+      labels.push_back(&info);
+      }
+    }
+  int numberOfLabels = static_cast<int>(labels.size());
+
+  // Large structures are started first so that the threads finish at about the same time
+  std::vector<int> labelOrder(numberOfLabels);
+  for (int i = 0; i < numberOfLabels; ++i)
+    {
+    labelOrder[i] = i;
+    }
+  std::stable_sort(labelOrder.begin(), labelOrder.end(), [&labels](int a, int b)
+    {
+    return labels[a]->NumberOfVoxels > labels[b]->NumberOfVoxels;
+    });
+
+  // Each structure reads the voxels through its own image object, the pipeline information of
+  // a data object must not be shared between threads. The voxel array itself is shared.
+  std::vector<vtkSmartPointer<vtkImageData> > inputs(numberOfLabels);
+  for (int i = 0; i < numberOfLabels; ++i)
+    {
+    inputs[i] = vtkSmartPointer<vtkImageData>::New();
+    inputs[i]->ShallowCopy(labelImage);
+    inputs[i]->SetOrigin(0.0, 0.0, 0.0);
+    inputs[i]->SetSpacing(1.0, 1.0, 1.0);
+    }
+
+  std::vector<vtkSmartPointer<vtkPolyData> > surfaces(numberOfLabels);
+  double smoothingFactor = this->SmoothingFactor;
+  bool computeNormals = this->ComputeNormals;
+  int backgroundValue = this->BackgroundValue;
+  vtkSMPTools::For(0, numberOfLabels, 1, [&](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType orderIndex = begin; orderIndex < end; ++orderIndex)
+      {
+      int i = labelOrder[orderIndex];
+      const vtkFreeSurferLabelStatistics::LabelInfo* label = labels[i];
+
+      // A background border around the extent of the structure closes its surface
+      int paddedExtent[6] = { 0 };
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        paddedExtent[2 * axis] = label->Extent[2 * axis] - 1;
+        paddedExtent[2 * axis + 1] = label->Extent[2 * axis + 1] + 1;
+        }
+      vtkNew<vtkImageConstantPad> padding;
+      padding->SetInputData(inputs[i]);
+      padding->SetOutputWholeExtent(paddedExtent);
+      padding->SetConstant(backgroundValue);
+
+      vtkNew<vtkDiscreteFlyingEdges3D> flyingEdges;
+      flyingEdges->SetInputConnection(padding->GetOutputPort());
+      flyingEdges->SetValue(0, label->Value);
+      flyingEdges->ComputeNormalsOff();
+      flyingEdges->ComputeGradientsOff();
+      flyingEdges->ComputeScalarsOff();
+      vtkAlgorithmOutput* surfacePort = flyingEdges->GetOutputPort();
+
+      // Same smoothing as the closed surface representation of segmentations
+      vtkNew<vtkWindowedSincPolyDataFilter> smoother;
+      if (smoothingFactor > 0.0)
+        {
+        smoother->SetInputConnection(surfacePort);
+        smoother->SetNumberOfIterations(20);
+        smoother->SetPassBand(std::pow(10.0, -4.0 * smoothingFactor));
+        smoother->BoundarySmoothingOff();
+        smoother->FeatureEdgeSmoothingOff();
+        smoother->NonManifoldSmoothingOn();
+        smoother->NormalizeCoordinatesOn();
+        surfacePort = smoother->GetOutputPort();
+        }
+
+      vtkNew<vtkTransform> ijkToRASTransform;
+      ijkToRASTransform->SetMatrix(ijkToRAS);
+      vtkNew<vtkTransformPolyDataFilter> transformer;
+      transformer->SetInputConnection(surfacePort);
+      transformer->SetTransform(ijkToRASTransform);
+      surfacePort = transformer->GetOutputPort();
+
+      vtkNew<vtkPolyDataNormals> normals;
+      if (computeNormals)
+        {
+        // Smoothing of non-manifold edges can invert normals, they are oriented outwards again
+        normals->SetInputConnection(surfacePort);
+        normals->ConsistencyOn();
+        normals->AutoOrientNormalsOn();
+        normals->SplittingOff();
+        surfacePort = normals->GetOutputPort();
+        }
+
+      vtkAlgorithm* lastFilter = surfacePort->GetProducer();
+      lastFilter->Update();
+      vtkPolyData* surface = vtkPolyData::SafeDownCast(lastFilter->GetOutputDataObject(0));
+      if (surface && surface->GetNumberOfPoints() > 0)
+        {
+        surfaces[i] = vtkSmartPointer<vtkPolyData>::New();
+        surfaces[i]->ShallowCopy(surface);
+        }
+      }
+    });
+
+  for (int i = 0; i < numberOfLabels; ++i)
+    {
+    if (surfaces[i])
+      {
+      this->OutputLabelValues.push_back(labels[i]->Value);
+      this->Outputs.push_back(surfaces[i]);
+      }
+    }
+  return true;
+}
@@ -0,0 +1,100 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferLabelSurfaces - surface models of the structures of a label volume
+// .SECTION Description
+// Extracts a closed, smoothed surface for each label of a label volume
+// (aseg.mgz, aparc+aseg.mgz, ...) in a single pass over the voxels. The
+// labels and their bounding extents are found with vtkFreeSurferLabelStatistics,
+// then every structure is extracted from its own padded extent with
+// vtkDiscreteFlyingEdges3D, smoothed with vtkWindowedSincPolyDataFilter and
+// transformed to RAS. Structures are processed in parallel with vtkSMPTools,
+// largest first, so the total time is close to that of the largest structure.
+
+#ifndef __vtkFreeSurferLabelSurfaces_h
+#define __vtkFreeSurferLabelSurfaces_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferLabelSurfaces : public vtkObject
+{
+public:
+  static vtkFreeSurferLabelSurfaces* New();
+  vtkTypeMacro(vtkFreeSurferLabelSurfaces, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Labels to extract. If empty (default), all labels except the background are extracted.
+  void SetLabelValues(const std::vector<int>& labelValues);
+  const std::vector<int>& GetLabelValues() const { return this->LabelValues; }
+
+  /// Voxels with this value are not extracted. Default is 0.
+  vtkSetMacro(BackgroundValue, int);
+  vtkGetMacro(BackgroundValue, int);
+
+  /// Amount of smoothing between 0 (none) and 1, as in the closed surface
+  /// representation of segmentations. Default is 0.5.
+  vtkSetClampMacro(SmoothingFactor, double, 0.0, 1.0);
+  vtkGetMacro(SmoothingFactor, double);
+
+  /// If enabled (default), point normals are computed for shading.
+  vtkSetMacro(ComputeNormals, bool);
+  vtkGetMacro(ComputeNormals, bool);
+  vtkBooleanMacro(ComputeNormals, bool);
+
+  /// Extract the surfaces of the first component of the label image.
+  /// Voxel (i, j, k) is mapped by ijkToRAS, the origin and spacing of the image are ignored.
+  /// Returns false if the image has no scalars.
+  bool Compute(vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS);
+
+  /// Number of surfaces extracted by the last call to Compute.
+  /// Requested labels that are not in the image are skipped.
+  int GetNumberOfOutputs() const { return static_cast<int>(this->Outputs.size()); }
+
+  /// Label value of the n-th surface, in increasing label value order
+  int GetOutputLabelValue(int n) const { return this->OutputLabelValues[n]; }
+
+  /// Get the n-th surface, in RAS coordinates
+  vtkPolyData* GetOutput(int n) const { return this->Outputs[n]; }
+
+protected:
+  vtkFreeSurferLabelSurfaces();
+  ~vtkFreeSurferLabelSurfaces() override;
+
+  std::vector<int> LabelValues;
+  int BackgroundValue;
+  double SmoothingFactor;
+  bool ComputeNormals;
+
+  std::vector<int> OutputLabelValues;
+  std::vector<vtkSmartPointer<vtkPolyData> > Outputs;
+
+private:
+  vtkFreeSurferLabelSurfaces(const vtkFreeSurferLabelSurfaces&); // Not implemented
+  void operator=(const vtkFreeSurferLabelSurfaces&); // Not implemented
+};
+
+#endif
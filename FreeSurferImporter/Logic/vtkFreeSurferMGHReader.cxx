@@ -0,0 +1,389 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferMGHReader.h"
+#include "vtkFreeSurferByteSwap.h"
+#include "vtkFreeSurferMappedFile.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+#include <vtk_zlib.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+  /// Amount of voxel data inflated per call, small enough to stay in cache for the byte swap
+  const size_t ChunkSize = 1 << 22;
+
+  //----------------------------------------------------------------------------
+  double GetSecondsSince(const std::chrono::steady_clock::time_point& start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  //----------------------------------------------------------------------------
+  class GzFileCloser
+  {
+  public:
+    GzFileCloser(gzFile file) : File(file) {}
+    ~GzFileCloser()
+    {
+      if (this->File)
+        {
+        gzclose(this->File);
+        }
+    }
+    gzFile File;
+  };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferMGHReader);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferMGHReader::vtkFreeSurferMGHReader()
+  : FileName(nullptr)
+  , MemoryMapping(false)
+  , ReadSeconds(0.0)
+  , ByteSwapSeconds(0.0)
+  , IJKToRASMatrix(vtkMatrix4x4::New())
+{
+  this->SetNumberOfInputPorts(0);
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferMGHReader::~vtkFreeSurferMGHReader()
+{
+  this->SetFileName(nullptr);
+  this->IJKToRASMatrix->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferMGHReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << (this->FileName ? this->FileName : "(none)") << std::endl;
+  os << indent << "MemoryMapping: " << this->MemoryMapping << std::endl;
+  os << indent << "ReadSeconds: " << this->ReadSeconds << std::endl;
+  os << indent << "ByteSwapSeconds: " << this->ByteSwapSeconds << std::endl;
+  os << indent << "Dimensions: " << this->FileHeader.Dimensions[0] << " " << this->FileHeader.Dimensions[1]
+    << " " << this->FileHeader.Dimensions[2] << std::endl;
+  os << indent << "NumberOfFrames: " << this->FileHeader.NumberOfFrames << std::endl;
+  os << indent << "Type: " << this->FileHeader.Type << std::endl;
+  os << indent << "IJKToRASMatrix:" << std::endl;
+  this->IJKToRASMatrix->PrintSelf(os, indent.GetNextIndent());
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::CanReadFile(const std::string& fileName)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(fileName));
+  return extension == ".mgz" || extension == ".mgh";
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::IsCompressedFile(const std::string& fileName)
+{
+  FILE* file = vtksys::SystemTools::Fopen(fileName, "rb");
+  if (!file)
+    {
+    return false;
+    }
+  unsigned char magic[2] = { 0, 0 };
+  size_t bytesRead = fread(magic, 1, 2, file);
+  fclose(file);
+  return bytesRead == 2 && magic[0] == 0x1F && magic[1] == 0x8B;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::GetScalarTypeInfo(int mghType, int& vtkScalarType, int& valueSize)
+{
+  switch (mghType)
+    {
+    case MRI_UCHAR: vtkScalarType = VTK_UNSIGNED_CHAR; valueSize = 1; return true;
+    case MRI_INT: vtkScalarType = VTK_INT; valueSize = 4; return true;
+    case MRI_LONG: vtkScalarType = VTK_INT; valueSize = 4; return true;
+    case MRI_FLOAT: vtkScalarType = VTK_FLOAT; valueSize = 4; return true;
+    case MRI_SHORT: vtkScalarType = VTK_SHORT; valueSize = 2; return true;
+    default: return false;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::ReadHeader(const std::string& fileName, Header& header)
+{
+  // Only the first block of a compressed file needs to be inflated to get the header
+  gzFile file = gzopen(fileName.c_str(), "rb");
+  GzFileCloser fileCloser(file);
+  unsigned char headerBuffer[HeaderSize];
+  if (!file || gzread(file, headerBuffer, HeaderSize) != HeaderSize)
+    {
+    return false;
+    }
+  return ParseHeader(headerBuffer, header);
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::ParseHeader(const unsigned char* buffer, Header& header)
+{
+  using vtkFreeSurferByteSwap::ReadBigEndian;
+
+  header = Header();
+  header.Version = ReadBigEndian<int>(buffer);
+  for (int i = 0; i < 3; ++i)
+    {
+    header.Dimensions[i] = ReadBigEndian<int>(buffer + 4 + 4 * i);
+    }
+  header.NumberOfFrames = ReadBigEndian<int>(buffer + 16);
+  header.Type = ReadBigEndian<int>(buffer + 20);
+  header.DegreesOfFreedom = ReadBigEndian<int>(buffer + 24);
+  header.GoodRASFlag = ReadBigEndian<short>(buffer + 28) > 0;
+  if (header.GoodRASFlag)
+    {
+    for (int i = 0; i < 3; ++i)
+      {
+      header.Spacing[i] = ReadBigEndian<float>(buffer + 30 + 4 * i);
+      header.CenterRAS[i] = ReadBigEndian<float>(buffer + 78 + 4 * i);
+      for (int j = 0; j < 3; ++j)
+        {
+        header.Directions[i][j] = ReadBigEndian<float>(buffer + 42 + 12 * i + 4 * j);
+        }
+      }
+    }
+
+  int vtkScalarType = VTK_VOID;
+  int valueSize = 0;
+  if (header.Version != 1 || !GetScalarTypeInfo(header.Type, vtkScalarType, valueSize))
+    {
+    return false;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    if (header.Dimensions[i] <= 0)
+      {
+      return false;
+      }
+    }
+  return header.NumberOfFrames > 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferMGHReader::ComputeIJKToRASMatrix(const Header& header, vtkMatrix4x4* ijkToRAS)
+{
+  if (!ijkToRAS)
+    {
+    return;
+    }
+  ijkToRAS->Identity();
+  for (int row = 0; row < 3; ++row)
+    {
+    double origin = header.CenterRAS[row];
+    for (int column = 0; column < 3; ++column)
+      {
+      double element = header.Directions[column][row] * header.Spacing[column];
+      ijkToRAS->SetElement(row, column, element);
+      origin -= element * header.Dimensions[column] / 2.0;
+      }
+    ijkToRAS->SetElement(row, 3, origin);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferMGHReader::RequestInformation(vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector), vtkInformationVector* outputVector)
+{
+  if (!this->FileName)
+    {
+    vtkErrorMacro("RequestInformation: FileName is not set");
+    return 0;
+    }
+
+  if (!ReadHeader(this->FileName, this->FileHeader))
+    {
+    vtkErrorMacro("RequestInformation: Could not read MGH header of " << this->FileName);
+    return 0;
+    }
+  ComputeIJKToRASMatrix(this->FileHeader, this->IJKToRASMatrix);
+  this->IJKToRASMatrix->Modified();
+
+  int vtkScalarType = VTK_VOID;
+  int valueSize = 0;
+  GetScalarTypeInfo(this->FileHeader.Type, vtkScalarType, valueSize);
+
+  const int* dimensions = this->FileHeader.Dimensions;
+  int extent[6] = { 0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1 };
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent, 6);
+  outInfo->Set(vtkDataObject::SPACING(), spacing, 3);
+  outInfo->Set(vtkDataObject::ORIGIN(), origin, 3);
+  vtkDataObject::SetPointDataActiveScalarInfo(outInfo, vtkScalarType, 1);
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferMGHReader::RequestData(vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector), vtkInformationVector* outputVector)
+{
+  vtkImageData* output = vtkImageData::GetData(outputVector);
+  if (!output || !this->FileName)
+    {
+    return 0;
+    }
+
+  this->ReadSeconds = 0.0;
+  this->ByteSwapSeconds = 0.0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (this->MemoryMapping && !IsCompressedFile(this->FileName) && this->ReadMappedVoxels(output))
+    {
+    // Mapping does not read the file, pages are faulted in by the byte swap or when first used
+    this->ReadSeconds = std::max(0.0, GetSecondsSince(start) - this->ByteSwapSeconds);
+    ComputeIJKToRASMatrix(this->FileHeader, this->IJKToRASMatrix);
+    this->IJKToRASMatrix->Modified();
+    return 1;
+    }
+
+  gzFile file = gzopen(this->FileName, "rb");
+  GzFileCloser fileCloser(file);
+  unsigned char headerBuffer[HeaderSize];
+  if (!file || gzread(file, headerBuffer, HeaderSize) != HeaderSize
+    || !ParseHeader(headerBuffer, this->FileHeader))
+    {
+    vtkErrorMacro("RequestData: Could not read header of " << this->FileName);
+    return 0;
+    }
+  gzbuffer(file, 1 << 18);
+
+  int vtkScalarType = VTK_VOID;
+  int valueSize = 0;
+  GetScalarTypeInfo(this->FileHeader.Type, vtkScalarType, valueSize);
+
+  const int* dimensions = this->FileHeader.Dimensions;
+  output->SetExtent(0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1);
+  output->SetSpacing(1.0, 1.0, 1.0);
+  output->SetOrigin(0.0, 0.0, 0.0);
+  output->AllocateScalars(vtkScalarType, 1);
+  output->GetPointData()->GetScalars()->SetName("ImageScalars");
+
+  // Inflate straight into the scalar buffer and swap each chunk while it is still in cache.
+  // Conformed UCHAR volumes (orig.mgz, T1.mgz, brain.mgz) need no swap and are only inflated.
+  vtkFreeSurferByteSwap::RangeSwapper swapRange = vtkFreeSurferByteSwap::GetBigEndianRangeSwapper(valueSize);
+  unsigned char* voxels = static_cast<unsigned char*>(output->GetScalarPointer());
+  size_t totalSize = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2] * valueSize;
+  size_t position = 0;
+  while (position < totalSize)
+    {
+    unsigned int chunkSize = static_cast<unsigned int>(std::min(ChunkSize, totalSize - position));
+    std::chrono::steady_clock::time_point readStart = std::chrono::steady_clock::now();
+    int bytesRead = gzread(file, voxels + position, chunkSize);
+    this->ReadSeconds += GetSecondsSince(readStart);
+    if (bytesRead != static_cast<int>(chunkSize))
+      {
+      vtkErrorMacro("RequestData: Unexpected end of voxel data in " << this->FileName);
+      output->Initialize();
+      return 0;
+      }
+    if (swapRange)
+      {
+      std::chrono::steady_clock::time_point swapStart = std::chrono::steady_clock::now();
+      swapRange(voxels + position, chunkSize / valueSize);
+      this->ByteSwapSeconds += GetSecondsSince(swapStart);
+      }
+    position += chunkSize;
+    }
+
+  ComputeIJKToRASMatrix(this->FileHeader, this->IJKToRASMatrix);
+  this->IJKToRASMatrix->Modified();
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMGHReader::ReadMappedVoxels(vtkImageData* output)
+{
+  vtkNew<vtkFreeSurferMappedFile> mappedFile;
+  if (!mappedFile->Open(this->FileName) || mappedFile->GetLength() < static_cast<size_t>(HeaderSize)
+    || !ParseHeader(mappedFile->GetData(), this->FileHeader))
+    {
+    return false;
+    }
+
+  int vtkScalarType = VTK_VOID;
+  int valueSize = 0;
+  GetScalarTypeInfo(this->FileHeader.Type, vtkScalarType, valueSize);
+
+  const int* dimensions = this->FileHeader.Dimensions;
+  vtkIdType numberOfVoxels = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] * dimensions[2];
+  if (static_cast<size_t>(numberOfVoxels) * valueSize > mappedFile->GetLength() - HeaderSize)
+    {
+    // Truncated file, the regular read reports the error
+    return false;
+    }
+
+  vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(vtkScalarType));
+  scalars->SetNumberOfComponents(1);
+  if (!mappedFile->WrapArray(scalars, HeaderSize, numberOfVoxels))
+    {
+    return false;
+    }
+  scalars->SetName("ImageScalars");
+
+  vtkFreeSurferByteSwap::RangeSwapper swapRange = vtkFreeSurferByteSwap::GetBigEndianRangeSwapper(valueSize);
+  if (swapRange)
+    {
+    // Writing to the private mapping copies only the touched pages, the file is not modified.
+    // Chunks are swapped in parallel so that page faults are spread over the threads.
+    std::chrono::steady_clock::time_point swapStart = std::chrono::steady_clock::now();
+    unsigned char* voxels = static_cast<unsigned char*>(scalars->GetVoidPointer(0));
+    size_t totalSize = static_cast<size_t>(numberOfVoxels) * valueSize;
+    vtkIdType numberOfChunks = static_cast<vtkIdType>((totalSize + ChunkSize - 1) / ChunkSize);
+    vtkSMPTools::For(0, numberOfChunks, [&](vtkIdType begin, vtkIdType end)
+      {
+      for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+        size_t position = static_cast<size_t>(chunk) * ChunkSize;
+        size_t chunkSize = std::min(ChunkSize, totalSize - position);
+        swapRange(voxels + position, chunkSize / valueSize);
+        }
+      });
+    this->ByteSwapSeconds = GetSecondsSince(swapStart);
+    }
+
+  output->SetExtent(0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1);
+  output->SetSpacing(1.0, 1.0, 1.0);
+  output->SetOrigin(0.0, 0.0, 0.0);
+  output->GetPointData()->SetScalars(scalars);
+  return true;
+}
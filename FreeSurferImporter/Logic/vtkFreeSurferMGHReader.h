@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferMGHReader - reader for FreeSurfer MGH/MGZ volumes
+// .SECTION Description
+// Reads .mgh and .mgz volumes. The voxel data is inflated in chunks directly
+// into the scalar buffer of the output image and converted from big-endian in
+// place, so the volume is decompressed in a single pass without intermediate
+// copies. UpdateInformation only reads the header. The output image has unit
+// spacing and zero origin, the geometry is available through
+// GetIJKToRASMatrix, as expected by vtkMRMLVolumeNode.
+// Uncompressed .mgh files can be memory-mapped instead of read, see MemoryMapping.
+// Only UCHAR volumes are then used without copying: multi-byte volumes are
+// swapped to host byte order right away, which copies every page of the mapping.
+// Only the first frame of multi-frame volumes is read.
+
+#ifndef __vtkFreeSurferMGHReader_h
+#define __vtkFreeSurferMGHReader_h
+
+// VTK includes
+#include <vtkImageAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+// STD includes
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferMGHReader : public vtkImageAlgorithm
+{
+public:
+  static vtkFreeSurferMGHReader* New();
+  vtkTypeMacro(vtkFreeSurferMGHReader, vtkImageAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// MGH voxel data types
+  enum
+    {
+    MRI_UCHAR = 0,
+    MRI_INT = 1,
+    MRI_LONG = 2, // 4-byte integers, like MRI_INT
+    MRI_FLOAT = 3,
+    MRI_SHORT = 4
+    };
+
+  /// Contents of the fixed-size MGH header
+  struct Header
+    {
+    int Version = 0;
+    int Dimensions[3] = { 0, 0, 0 };
+    int NumberOfFrames = 0;
+    int Type = MRI_UCHAR;
+    int DegreesOfFreedom = 0;
+    bool GoodRASFlag = false;
+    double Spacing[3] = { 1.0, 1.0, 1.0 };
+    /// Direction cosines of the column, row and slice axes
+    double Directions[3][3] = { { -1.0, 0.0, 0.0 }, { 0.0, 0.0, -1.0 }, { 0.0, 1.0, 0.0 } };
+    double CenterRAS[3] = { 0.0, 0.0, 0.0 };
+    };
+
+  /// Size in bytes of the header, voxel data starts at this offset
+  static const int HeaderSize = 284;
+
+  /// File to read (.mgh or .mgz)
+  vtkSetStringMacro(FileName);
+  vtkGetStringMacro(FileName);
+
+  /// Memory-map uncompressed files instead of reading them (off by default).
+  /// The mapping is private: single-byte volumes, or any volume on a big-endian
+  /// host, are used in place; otherwise the voxels are swapped to host byte
+  /// order in the mapping, which copies all of its pages.
+  /// Pages that are used in place are read from the file while the output exists:
+  /// if the file is rewritten they change, and if it is truncated accessing them
+  /// raises SIGBUS. Only enable this for files that are not modified while loaded.
+  /// Compressed files are always read.
+  vtkSetMacro(MemoryMapping, bool);
+  vtkGetMacro(MemoryMapping, bool);
+  vtkBooleanMacro(MemoryMapping, bool);
+
+  /// Time spent by the last update reading voxel data, including decompression of compressed files
+  vtkGetMacro(ReadSeconds, double);
+
+  /// Time spent by the last update converting voxel data to host byte order
+  vtkGetMacro(ByteSwapSeconds, double);
+
+  /// Header of the last file read
+  const Header& GetHeader() const { return this->FileHeader; }
+
+  /// Voxel to RAS transform of the last file read
+  vtkGetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+
+  /// Returns true if the file extension is one handled by the reader
+  static bool CanReadFile(const std::string& fileName);
+
+  /// Returns true if the file is gzip compressed (.mgz, or .mgh.gz).
+  static bool IsCompressedFile(const std::string& fileName);
+
+  /// Read only the header of a file, without decompressing any voxel data.
+  static bool ReadHeader(const std::string& fileName, Header& header);
+
+  /// Parse the header from the first HeaderSize bytes of a file.
+  static bool ParseHeader(const unsigned char* buffer, Header& header);
+
+  /// Get the VTK scalar type and size in bytes of an MGH data type.
+  /// Returns false for unknown types.
+  static bool GetScalarTypeInfo(int mghType, int& vtkScalarType, int& valueSize);
+
+  /// Compute the voxel to RAS transform described by the header
+  static void ComputeIJKToRASMatrix(const Header& header, vtkMatrix4x4* ijkToRAS);
+
+protected:
+  vtkFreeSurferMGHReader();
+  ~vtkFreeSurferMGHReader() override;
+
+  int RequestInformation(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector) override;
+  int RequestData(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector) override;
+
+  /// Map the file and use its voxel block as the scalars of the output.
+  /// Returns false if the file cannot be used in place, it is then read instead.
+  bool ReadMappedVoxels(vtkImageData* output);
+
+  char* FileName;
+  bool MemoryMapping;
+  double ReadSeconds;
+  double ByteSwapSeconds;
+  Header FileHeader;
+  vtkMatrix4x4* IJKToRASMatrix;
+
+private:
+  vtkFreeSurferMGHReader(const vtkFreeSurferMGHReader&); // Not implemented
+  void operator=(const vtkFreeSurferMGHReader&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferMappedFile.h"
+
+// VTK includes
+#include <vtkAOSDataArrayTemplate.h>
+#include <vtkDataArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <vtksys/Encoding.hxx>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Arrays only pass their buffer pointer to the free function, so the mapping
+  // that each wrapped buffer belongs to is kept here.
+  std::mutex WrappedBuffersMutex;
+  std::map<void*, vtkSmartPointer<vtkFreeSurferMappedFile> > WrappedBuffers;
+
+  //----------------------------------------------------------------------------
+  void ReleaseWrappedBuffer(void* buffer)
+  {
+    vtkSmartPointer<vtkFreeSurferMappedFile> mappedFile;
+      {
+      std::lock_guard<std::mutex> lock(WrappedBuffersMutex);
+      std::map<void*, vtkSmartPointer<vtkFreeSurferMappedFile> >::iterator it = WrappedBuffers.find(buffer);
+      if (it == WrappedBuffers.end())
+        {
+        return;
+        }
+      mappedFile = it->second;
+      WrappedBuffers.erase(it);
+      }
+    // The mapping is released here, outside of the lock, if this was the last user
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void SetArrayBuffer(vtkAOSDataArrayTemplate<T>* array, unsigned char* buffer, vtkIdType numberOfValues)
+  {
+    array->SetArray(reinterpret_cast<T*>(buffer), numberOfValues, 0);
+    array->SetArrayFreeFunction(&ReleaseWrappedBuffer);
+  }
+
+  //----------------------------------------------------------------------------
+  bool MapFile(const std::string& fileName, unsigned char*& data, size_t& length)
+  {
+    data = nullptr;
+    length = static_cast<size_t>(vtksys::SystemTools::FileLength(fileName));
+    if (length == 0)
+      {
+      return false;
+      }
+#ifdef _WIN32
+    HANDLE file = CreateFileW(vtksys::Encoding::ToWide(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      {
+      return false;
+      }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+      {
+      return false;
+      }
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, length);
+    CloseHandle(mapping);
+    data = static_cast<unsigned char*>(view);
+#else
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0)
+      {
+      return false;
+      }
+    void* view = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    data = (view == MAP_FAILED) ? nullptr : static_cast<unsigned char*>(view);
+#endif
+    return data != nullptr;
+  }
+
+  //----------------------------------------------------------------------------
+  void UnmapFile(unsigned char* data, size_t length)
+  {
+#ifdef _WIN32
+    (void)length;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, length);
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferMappedFile);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferMappedFile::vtkFreeSurferMappedFile()
+  : Data(nullptr)
+  , Length(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferMappedFile::~vtkFreeSurferMappedFile()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferMappedFile::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Length: " << this->Length << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMappedFile::Open(const std::string& fileName)
+{
+  this->Close();
+  if (!MapFile(fileName, this->Data, this->Length))
+    {
+    this->Length = 0;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferMappedFile::Close()
+{
+  if (this->Data)
+    {
+    UnmapFile(this->Data, this->Length);
+    }
+  this->Data = nullptr;
+  this->Length = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferMappedFile::WrapArray(vtkDataArray* array, size_t offset, vtkIdType numberOfValues)
+{
+  if (!array || !this->Data || numberOfValues < 0)
+    {
+    return false;
+    }
+  size_t size = static_cast<size_t>(numberOfValues) * array->GetDataTypeSize();
+  if (offset > this->Length || size > this->Length - offset)
+    {
+    vtkErrorMacro("WrapArray: Range is outside of the mapped file");
+    return false;
+    }
+
+  unsigned char* buffer = this->Data + offset;
+  if (numberOfValues == 0)
+    {
+    array->SetNumberOfTuples(0);
+    return true;
+    }
+    {
+    std::lock_guard<std::mutex> lock(WrappedBuffersMutex);
+    if (WrappedBuffers.count(buffer))
+      {
+      vtkErrorMacro("WrapArray: This range is already used by another array");
+      return false;
+      }
+    WrappedBuffers[buffer] = this;
+    }
+
+  switch (array->GetDataType())
+    {
+    vtkTemplateMacro(
+      vtkAOSDataArrayTemplate<VTK_TT>* typedArray = vtkAOSDataArrayTemplate<VTK_TT>::FastDownCast(array);
+      if (typedArray)
+        {
+        SetArrayBuffer(typedArray, buffer, numberOfValues);
+        return true;
+        }
+      );
+    default:
+      break;
+    }
+
+  vtkErrorMacro("WrapArray: Unsupported array type " << array->GetClassName());
+  std::lock_guard<std::mutex> lock(WrappedBuffersMutex);
+  WrappedBuffers.erase(buffer);
+  return false;
+}
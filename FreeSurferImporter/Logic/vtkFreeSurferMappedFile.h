@@ -0,0 +1,78 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferMappedFile - copy-on-write memory mapping of a file
+// .SECTION Description
+// Maps a whole file into memory with a private copy-on-write mapping, so the
+// mapped memory can be modified without changing the file. Data arrays can
+// use ranges of the mapping as their buffer without copying (WrapArray).
+// The mapping is kept alive until the last array that uses it is released.
+// Pages that were not modified are still backed by the file: they change if the
+// file is rewritten, and accessing them raises SIGBUS if it is truncated.
+
+#ifndef __vtkFreeSurferMappedFile_h
+#define __vtkFreeSurferMappedFile_h
+
+// VTK includes
+#include <vtkObject.h>
+class vtkDataArray;
+
+// STD includes
+#include <cstddef>
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferMappedFile : public vtkObject
+{
+public:
+  static vtkFreeSurferMappedFile* New();
+  vtkTypeMacro(vtkFreeSurferMappedFile, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Map the whole file. Any previous mapping is released.
+  /// Returns false if the file could not be mapped.
+  bool Open(const std::string& fileName);
+
+  /// Release the mapping. Arrays that use the mapping keep it alive.
+  void Close();
+
+  /// Start of the mapped memory, nullptr if no file is mapped
+  unsigned char* GetData() const { return this->Data; }
+  /// Size of the mapped file in bytes
+  size_t GetLength() const { return this->Length; }
+
+  /// Make the array use the mapped memory at the specified offset as its buffer.
+  /// The array must be an AOS array (e.g. vtkFloatArray) with the number of components set,
+  /// and the offset must be aligned for its value type.
+  /// Returns false if the range is outside of the mapping.
+  bool WrapArray(vtkDataArray* array, size_t offset, vtkIdType numberOfValues);
+
+protected:
+  vtkFreeSurferMappedFile();
+  ~vtkFreeSurferMappedFile() override;
+
+  unsigned char* Data;
+  size_t Length;
+
+private:
+  vtkFreeSurferMappedFile(const vtkFreeSurferMappedFile&); // Not implemented
+  void operator=(const vtkFreeSurferMappedFile&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,260 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferOverlayReader.h"
+#include "vtkFreeSurferByteSwap.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkTypeInt16Array.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cstdio>
+
+namespace
+{
+  const int NewCurvFileMagicNumber = 0xFFFFFF;
+
+  /// Legacy curvature values are stored as 16-bit integers scaled by 100
+  const float OldCurvFileScale = 0.01f;
+
+  //----------------------------------------------------------------------------
+  class FileCloser
+  {
+  public:
+    FileCloser(FILE* file) : File(file) {}
+    ~FileCloser()
+    {
+      if (this->File)
+        {
+        fclose(this->File);
+        }
+    }
+    FILE* File;
+  };
+
+  //----------------------------------------------------------------------------
+  bool ReadInt24(FILE* file, int& value)
+  {
+    unsigned char bytes[3] = { 0 };
+    if (fread(bytes, 1, 3, file) != 3)
+      {
+      return false;
+      }
+    value = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Reads the header of a curvature file and leaves the file positioned at the values
+  bool ReadCurvFileHeader(FILE* file, int& numberOfVertices, bool& newFormat)
+  {
+    int first = 0;
+    if (!ReadInt24(file, first))
+      {
+      return false;
+      }
+    newFormat = (first == NewCurvFileMagicNumber);
+    if (!newFormat)
+      {
+      // Legacy format: 3-byte vertex count and face count
+      int numberOfFaces = 0;
+      numberOfVertices = first;
+      return ReadInt24(file, numberOfFaces) && numberOfVertices > 0;
+      }
+
+    unsigned char counts[12];
+    if (fread(counts, 1, 12, file) != 12)
+      {
+      return false;
+      }
+    numberOfVertices = vtkFreeSurferByteSwap::ReadBigEndian<int>(counts);
+    int valuesPerVertex = vtkFreeSurferByteSwap::ReadBigEndian<int>(counts + 8);
+    return numberOfVertices > 0 && valuesPerVertex == 1;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferOverlayReader);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferOverlayReader::vtkFreeSurferOverlayReader()
+  : FileName(nullptr)
+  , NumberOfVertices(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferOverlayReader::~vtkFreeSurferOverlayReader()
+{
+  this->SetFileName(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferOverlayReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << (this->FileName ? this->FileName : "(none)") << std::endl;
+  os << indent << "NumberOfVertices: " << this->NumberOfVertices << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkFloatArray* vtkFreeSurferOverlayReader::GetOutput()
+{
+  return this->Output;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferOverlayReader::CanReadFile(const std::string& fileName)
+{
+  int numberOfVertices = 0;
+  return ReadOverlayInfo(fileName, numberOfVertices);
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferOverlayReader::ReadOverlayInfo(const std::string& fileName, int& numberOfVertices)
+{
+  FILE* file = vtksys::SystemTools::Fopen(fileName, "rb");
+  FileCloser fileCloser(file);
+  bool newFormat = false;
+  if (!file || !ReadCurvFileHeader(file, numberOfVertices, newFormat))
+    {
+    return false;
+    }
+
+  // The legacy format has no magic number, check that the file size matches the header
+  unsigned long expectedSize = newFormat
+    ? 15 + 4 * static_cast<unsigned long>(numberOfVertices)
+    : 6 + 2 * static_cast<unsigned long>(numberOfVertices);
+  return vtksys::SystemTools::FileLength(fileName) == expectedSize;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferOverlayReader::IsPaintFile(const std::string& fileName)
+{
+  return vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(fileName)) == ".w";
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferOverlayReader::Read()
+{
+  this->Output = nullptr;
+  if (!this->FileName)
+    {
+    vtkErrorMacro("Read: FileName is not set");
+    return false;
+    }
+
+  FILE* file = vtksys::SystemTools::Fopen(this->FileName, "rb");
+  FileCloser fileCloser(file);
+  if (file && IsPaintFile(this->FileName))
+    {
+    return this->ReadPaintFile(file);
+    }
+  int numberOfVertices = 0;
+  bool newFormat = false;
+  if (!file || !ReadCurvFileHeader(file, numberOfVertices, newFormat))
+    {
+    vtkErrorMacro("Read: " << this->FileName << " is not a FreeSurfer curvature file");
+    return false;
+    }
+
+  vtkSmartPointer<vtkFloatArray> values = vtkSmartPointer<vtkFloatArray>::New();
+  values->SetName(vtksys::SystemTools::GetFilenameName(this->FileName).c_str());
+  values->SetNumberOfValues(numberOfVertices);
+  float* value = values->GetPointer(0);
+  size_t count = static_cast<size_t>(numberOfVertices);
+  if (newFormat)
+    {
+    // Values are read straight into the output array
+    if (fread(value, sizeof(float), count, file) != count)
+      {
+      vtkErrorMacro("Read: Could not read values from " << this->FileName);
+      return false;
+      }
+    vtkFreeSurferByteSwap::SwapBigEndianRange(value, count, sizeof(float));
+    }
+  else
+    {
+    vtkNew<vtkTypeInt16Array> scaledValues;
+    scaledValues->SetNumberOfValues(numberOfVertices);
+    if (fread(scaledValues->GetPointer(0), sizeof(vtkTypeInt16), count, file) != count)
+      {
+      vtkErrorMacro("Read: Could not read values from " << this->FileName);
+      return false;
+      }
+    vtkFreeSurferByteSwap::SwapBigEndianRange(scaledValues->GetPointer(0), count, sizeof(vtkTypeInt16));
+    const vtkTypeInt16* scaledValue = scaledValues->GetPointer(0);
+    for (size_t i = 0; i < count; ++i)
+      {
+      value[i] = scaledValue[i] * OldCurvFileScale;
+      }
+    }
+
+  this->Output = values;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferOverlayReader::ReadPaintFile(FILE* file)
+{
+  if (this->NumberOfVertices <= 0)
+    {
+    vtkErrorMacro("ReadPaintFile: NumberOfVertices is not set for " << this->FileName);
+    return false;
+    }
+
+  // 2-byte latency, not used, followed by the number of painted vertices
+  unsigned char latency[2];
+  int numberOfPaintedVertices = 0;
+  if (fread(latency, 1, 2, file) != 2 || !ReadInt24(file, numberOfPaintedVertices))
+    {
+    vtkErrorMacro("ReadPaintFile: " << this->FileName << " is not a FreeSurfer paint file");
+    return false;
+    }
+
+  vtkSmartPointer<vtkFloatArray> values = vtkSmartPointer<vtkFloatArray>::New();
+  values->SetName(vtksys::SystemTools::GetFilenameName(this->FileName).c_str());
+  values->SetNumberOfValues(this->NumberOfVertices);
+  values->FillValue(0.0f);
+  float* value = values->GetPointer(0);
+  for (int i = 0; i < numberOfPaintedVertices; ++i)
+    {
+    // 3-byte vertex index and big-endian float value
+    int vertexIndex = 0;
+    unsigned char vertexValue[4];
+    if (!ReadInt24(file, vertexIndex) || fread(vertexValue, 1, 4, file) != 4)
+      {
+      vtkErrorMacro("ReadPaintFile: Could not read values from " << this->FileName);
+      return false;
+      }
+    if (vertexIndex >= this->NumberOfVertices)
+      {
+      vtkErrorMacro("ReadPaintFile: Vertex " << vertexIndex << " of " << this->FileName
+        << " is out of range, the surface has " << this->NumberOfVertices << " vertices");
+      return false;
+      }
+    value[vertexIndex] = vtkFreeSurferByteSwap::ReadBigEndian<float>(vertexValue);
+    }
+
+  this->Output = values;
+  return true;
+}
@@ -0,0 +1,89 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferOverlayReader - reader for FreeSurfer per-vertex scalar files
+// .SECTION Description
+// Reads curvature format files (lh.curv, lh.sulc, lh.thickness, lh.area, ...)
+// into a single vtkFloatArray with one value per vertex. Both the current
+// float format and the legacy 16-bit format are supported, as well as paint
+// files (.w), which only list the vertices that have a value. The output array
+// is meant to be attached by reference to every surface of the hemisphere.
+
+#ifndef __vtkFreeSurferOverlayReader_h
+#define __vtkFreeSurferOverlayReader_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkFloatArray;
+
+// STD includes
+#include <cstdio>
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferOverlayReader : public vtkObject
+{
+public:
+  static vtkFreeSurferOverlayReader* New();
+  vtkTypeMacro(vtkFreeSurferOverlayReader, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// File to read
+  vtkSetStringMacro(FileName);
+  vtkGetStringMacro(FileName);
+
+  /// Number of vertices of the surface a paint file applies to. Paint files do not
+  /// store it, vertices that are not listed in the file are set to 0.
+  vtkSetMacro(NumberOfVertices, int);
+  vtkGetMacro(NumberOfVertices, int);
+
+  /// Read the file. The output array is named after the file.
+  /// Returns false if the file could not be read.
+  bool Read();
+
+  /// Values read by the last call to Read
+  vtkFloatArray* GetOutput();
+
+  /// Returns true if the file is in one of the curvature formats
+  static bool CanReadFile(const std::string& fileName);
+
+  /// Read only the number of vertices of a curvature file
+  static bool ReadOverlayInfo(const std::string& fileName, int& numberOfVertices);
+
+  /// Returns true if the file is a paint file (.w)
+  static bool IsPaintFile(const std::string& fileName);
+
+protected:
+  vtkFreeSurferOverlayReader();
+  ~vtkFreeSurferOverlayReader() override;
+
+  /// Read the vertex indices and values of a paint file into the output
+  bool ReadPaintFile(FILE* file);
+
+  char* FileName;
+  int NumberOfVertices;
+  vtkSmartPointer<vtkFloatArray> Output;
+
+private:
+  vtkFreeSurferOverlayReader(const vtkFreeSurferOverlayReader&); // Not implemented
+  void operator=(const vtkFreeSurferOverlayReader&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferParcelStatistics.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkStringArray.h>
+#include <vtkTable.h>
+#include <vtkTriangle.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+  /// Sums of a parcel: number of vertices and area, then for each overlay the number of finite values,
+  /// their running mean and sum of squared deviations (Welford), their area and their area-weighted sum
+  const int NumberOfParcelSums = 2;
+  const int NumberOfOverlaySums = 5;
+
+  //----------------------------------------------------------------------------
+  /// Each thread accumulates the sums of all parcels in its own buffer.
+  /// Non-finite overlay values are left out of the statistics of their overlay.
+  class ParcelSumFunctor
+  {
+  public:
+    ParcelSumFunctor(const int* parcelIndices, const std::vector<const float*>& overlays, const float* vertexAreas,
+      int numberOfParcels)
+      : ParcelIndices(parcelIndices)
+      , Overlays(overlays)
+      , VertexAreas(vertexAreas)
+      , NumberOfParcels(numberOfParcels)
+    {
+      this->Stride = NumberOfParcelSums + NumberOfOverlaySums * static_cast<int>(overlays.size());
+    }
+
+    void Initialize()
+    {
+      this->Sums.Local().assign(static_cast<size_t>(this->NumberOfParcels) * this->Stride, 0.0);
+    }
+
+    void operator()(vtkIdType beginVertex, vtkIdType endVertex)
+    {
+      std::vector<double>& sums = this->Sums.Local();
+      const int numberOfOverlays = static_cast<int>(this->Overlays.size());
+      for (vtkIdType vertex = beginVertex; vertex < endVertex; ++vertex)
+        {
+        int parcel = this->ParcelIndices[vertex];
+        if (parcel < 0)
+          {
+          continue;
+          }
+        double area = this->VertexAreas ? this->VertexAreas[vertex] : 1.0;
+        double* parcelSums = &sums[static_cast<size_t>(parcel) * this->Stride];
+        parcelSums[0] += 1.0;
+        parcelSums[1] += area;
+        double* overlaySums = parcelSums + NumberOfParcelSums;
+        for (int overlay = 0; overlay < numberOfOverlays; ++overlay, overlaySums += NumberOfOverlaySums)
+          {
+          double value = this->Overlays[overlay][vertex];
+          if (!std::isfinite(value))
+            {
+            continue;
+            }
+          overlaySums[0] += 1.0;
+          double delta = value - overlaySums[1];
+          overlaySums[1] += delta / overlaySums[0];
+          overlaySums[2] += delta * (value - overlaySums[1]);
+          overlaySums[3] += area;
+          overlaySums[4] += area * value;
+          }
+        }
+    }
+
+    void Reduce()
+    {
+    }
+
+    /// Combine the buffers of all threads, the running means and squared deviations
+    /// of the threads are merged with the pairwise formula of Chan et al.
+    std::vector<double> GetSums()
+    {
+      std::vector<double> sums(static_cast<size_t>(this->NumberOfParcels) * this->Stride, 0.0);
+      const int numberOfOverlays = static_cast<int>(this->Overlays.size());
+      for (const std::vector<double>& threadSums : this->Sums)
+        {
+        for (int parcel = 0; parcel < this->NumberOfParcels; ++parcel)
+          {
+          double* parcelSums = &sums[static_cast<size_t>(parcel) * this->Stride];
+          const double* threadParcelSums = &threadSums[static_cast<size_t>(parcel) * this->Stride];
+          parcelSums[0] += threadParcelSums[0];
+          parcelSums[1] += threadParcelSums[1];
+          double* overlaySums = parcelSums + NumberOfParcelSums;
+          const double* threadOverlaySums = threadParcelSums + NumberOfParcelSums;
+          for (int overlay = 0; overlay < numberOfOverlays;
+            ++overlay, overlaySums += NumberOfOverlaySums, threadOverlaySums += NumberOfOverlaySums)
+            {
+            if (threadOverlaySums[0] == 0.0)
+              {
+              continue;
+              }
+            double count = overlaySums[0] + threadOverlaySums[0];
+            double delta = threadOverlaySums[1] - overlaySums[1];
+            overlaySums[2] += threadOverlaySums[2] + delta * delta * overlaySums[0] * threadOverlaySums[0] / count;
+            overlaySums[1] += delta * threadOverlaySums[0] / count;
+            overlaySums[0] = count;
+            overlaySums[3] += threadOverlaySums[3];
+            overlaySums[4] += threadOverlaySums[4];
+            }
+          }
+        }
+      return sums;
+    }
+
+    vtkSMPThreadLocal<std::vector<double> > Sums;
+    int Stride;
+
+  protected:
+    const int* ParcelIndices;
+    std::vector<const float*> Overlays;
+    const float* VertexAreas;
+    int NumberOfParcels;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Get the array as a contiguous array of the requested type, converting it only if needed
+  template<typename ArrayType>
+  vtkSmartPointer<ArrayType> GetContiguousArray(vtkDataArray* array)
+  {
+    vtkSmartPointer<ArrayType> typedArray = ArrayType::SafeDownCast(array);
+    if (!typedArray || typedArray->GetNumberOfComponents() != 1)
+      {
+      typedArray = vtkSmartPointer<ArrayType>::New();
+      typedArray->SetNumberOfValues(array->GetNumberOfTuples());
+      typedArray->CopyComponent(0, array, 0);
+      }
+    return typedArray;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkDoubleArray> CreateColumn(const std::string& name, vtkIdType numberOfRows)
+  {
+    vtkSmartPointer<vtkDoubleArray> column = vtkSmartPointer<vtkDoubleArray>::New();
+    column->SetName(name.c_str());
+    column->SetNumberOfValues(numberOfRows);
+    return column;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferParcelStatistics);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferParcelStatistics::vtkFreeSurferParcelStatistics()
+  : ParcelIndices(nullptr)
+  , VertexAreas(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferParcelStatistics::~vtkFreeSurferParcelStatistics()
+{
+  this->SetParcelIndices(nullptr);
+  this->SetVertexAreas(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfVertices: " << (this->ParcelIndices ? this->ParcelIndices->GetNumberOfTuples() : 0) << std::endl;
+  os << indent << "NumberOfParcelNames: " << this->ParcelNames.size() << std::endl;
+  os << indent << "NumberOfOverlays: " << this->Overlays.size() << std::endl;
+  os << indent << "VertexAreas: " << (this->VertexAreas ? "set" : "(none)") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::SetParcelIndices(vtkDataArray* parcelIndices)
+{
+  vtkSetObjectBodyMacro(ParcelIndices, vtkDataArray, parcelIndices);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::SetVertexAreas(vtkDataArray* vertexAreas)
+{
+  vtkSetObjectBodyMacro(VertexAreas, vtkDataArray, vertexAreas);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::SetParcelNames(const std::vector<std::string>& parcelNames)
+{
+  this->ParcelNames = parcelNames;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::AddOverlay(vtkDataArray* overlay)
+{
+  if (!overlay)
+    {
+    return;
+    }
+  this->Overlays.push_back(overlay);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferParcelStatistics::RemoveAllOverlays()
+{
+  this->Overlays.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTable* vtkFreeSurferParcelStatistics::GetOutput()
+{
+  return this->Output;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferParcelStatistics::ComputeVertexAreas(vtkPolyData* surface)
+{
+  if (!surface || !surface->GetPoints() || !surface->GetPolys())
+    {
+    return nullptr;
+    }
+
+  vtkSmartPointer<vtkFloatArray> vertexAreas = vtkSmartPointer<vtkFloatArray>::New();
+  vertexAreas->SetName("area");
+  vertexAreas->SetNumberOfValues(surface->GetNumberOfPoints());
+  vertexAreas->FillValue(0.0f);
+  float* vertexArea = vertexAreas->GetPointer(0);
+
+  // Polygons are split into a fan of triangles, each triangle adds a third of its area to its corners
+  vtkPoints* points = surface->GetPoints();
+  vtkCellArray* polys = surface->GetPolys();
+  vtkIdType numberOfPointIds = 0;
+  const vtkIdType* pointIds = nullptr;
+  double p0[3], p1[3], p2[3];
+  for (polys->InitTraversal(); polys->GetNextCell(numberOfPointIds, pointIds);)
+    {
+    points->GetPoint(pointIds[0], p0);
+    for (vtkIdType i = 1; i + 1 < numberOfPointIds; ++i)
+      {
+      points->GetPoint(pointIds[i], p1);
+      points->GetPoint(pointIds[i + 1], p2);
+      float cornerArea = static_cast<float>(vtkTriangle::TriangleArea(p0, p1, p2) / 3.0);
+      vertexArea[pointIds[0]] += cornerArea;
+      vertexArea[pointIds[i]] += cornerArea;
+      vertexArea[pointIds[i + 1]] += cornerArea;
+      }
+    }
+  return vertexAreas;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferParcelStatistics::Compute()
+{
+  this->Output = nullptr;
+  if (!this->ParcelIndices)
+    {
+    vtkErrorMacro("Compute: Parcel indices are not set");
+    return false;
+    }
+  vtkIdType numberOfVertices = this->ParcelIndices->GetNumberOfTuples();
+  if ((this->VertexAreas && this->VertexAreas->GetNumberOfTuples() != numberOfVertices)
+    || std::any_of(this->Overlays.begin(), this->Overlays.end(),
+      [numberOfVertices](vtkDataArray* overlay) { return overlay->GetNumberOfTuples() != numberOfVertices; }))
+    {
+    vtkErrorMacro("Compute: Overlays and vertex areas must have " << numberOfVertices << " values, one per vertex");
+    return false;
+    }
+
+  // The inner loop reads plain contiguous arrays, other array types are converted once
+  vtkSmartPointer<vtkIntArray> parcelIndices = GetContiguousArray<vtkIntArray>(this->ParcelIndices);
+  vtkSmartPointer<vtkFloatArray> vertexAreas;
+  if (this->VertexAreas)
+    {
+    vertexAreas = GetContiguousArray<vtkFloatArray>(this->VertexAreas);
+    }
+  std::vector<vtkSmartPointer<vtkFloatArray> > overlays;
+  std::vector<const float*> overlayValues;
+  for (vtkDataArray* overlay : this->Overlays)
+    {
+    overlays.push_back(GetContiguousArray<vtkFloatArray>(overlay));
+    overlayValues.push_back(overlays.back()->GetPointer(0));
+    }
+
+  const int* parcelIndex = parcelIndices->GetPointer(0);
+  int numberOfParcels = numberOfVertices > 0 ? *std::max_element(parcelIndex, parcelIndex + numberOfVertices) + 1 : 0;
+  numberOfParcels = std::max(numberOfParcels, 0);
+
+  ParcelSumFunctor functor(parcelIndex, overlayValues, vertexAreas ? vertexAreas->GetPointer(0) : nullptr, numberOfParcels);
+  vtkSMPTools::For(0, numberOfVertices, functor);
+  std::vector<double> sums = functor.GetSums();
+
+  std::vector<int> parcels;
+  for (int parcel = 0; parcel < numberOfParcels; ++parcel)
+    {
+    if (sums[static_cast<size_t>(parcel) * functor.Stride] > 0.0)
+      {
+      parcels.push_back(parcel);
+      }
+    }
+  vtkIdType numberOfRows = static_cast<vtkIdType>(parcels.size());
+
+  vtkNew<vtkIntArray> indexColumn;
+  indexColumn->SetName("ParcelIndex");
+  indexColumn->SetNumberOfValues(numberOfRows);
+  vtkNew<vtkStringArray> nameColumn;
+  nameColumn->SetName("ParcelName");
+  nameColumn->SetNumberOfValues(numberOfRows);
+  vtkNew<vtkIntArray> countColumn;
+  countColumn->SetName("NumberOfVertices");
+  countColumn->SetNumberOfValues(numberOfRows);
+  vtkSmartPointer<vtkDoubleArray> areaColumn = CreateColumn("SurfaceArea", numberOfRows);
+  std::vector<vtkSmartPointer<vtkDoubleArray> > overlayColumns;
+  for (size_t overlay = 0; overlay < this->Overlays.size(); ++overlay)
+    {
+    std::ostringstream overlayName;
+    if (this->Overlays[overlay]->GetName())
+      {
+      overlayName << this->Overlays[overlay]->GetName();
+      }
+    else
+      {
+      overlayName << "Overlay" << overlay;
+      }
+    overlayColumns.push_back(CreateColumn(overlayName.str() + ".Mean", numberOfRows));
+    overlayColumns.push_back(CreateColumn(overlayName.str() + ".Std", numberOfRows));
+    overlayColumns.push_back(CreateColumn(overlayName.str() + ".AreaWeightedMean", numberOfRows));
+    }
+
+  for (vtkIdType row = 0; row < numberOfRows; ++row)
+    {
+    int parcel = parcels[row];
+    const double* parcelSums = &sums[static_cast<size_t>(parcel) * functor.Stride];
+    double count = parcelSums[0];
+    double area = parcelSums[1];
+    indexColumn->SetValue(row, parcel);
+    nameColumn->SetValue(row, parcel < static_cast<int>(this->ParcelNames.size()) ? this->ParcelNames[parcel] : std::string());
+    countColumn->SetValue(row, static_cast<int>(count));
+    areaColumn->SetValue(row, area);
+    const double* overlaySums = parcelSums + NumberOfParcelSums;
+    for (size_t overlay = 0; overlay < this->Overlays.size(); ++overlay, overlaySums += NumberOfOverlaySums)
+      {
+      double valueCount = overlaySums[0];
+      double mean = valueCount > 0.0 ? overlaySums[1] : std::numeric_limits<double>::quiet_NaN();
+      // Sample standard deviation, like the StdDev columns of the FreeSurfer stats files
+      double variance = valueCount > 1.0 ? overlaySums[2] / (valueCount - 1.0) : 0.0;
+      double valueArea = overlaySums[3];
+      overlayColumns[3 * overlay]->SetValue(row, mean);
+      overlayColumns[3 * overlay + 1]->SetValue(row, valueCount > 0.0 ? std::sqrt(std::max(0.0, variance)) : mean);
+      overlayColumns[3 * overlay + 2]->SetValue(row, valueArea > 0.0 ? overlaySums[4] / valueArea : mean);
+      }
+    }
+
+  this->Output = vtkSmartPointer<vtkTable>::New();
+  this->Output->AddColumn(indexColumn);
+  this->Output->AddColumn(nameColumn);
+  this->Output->AddColumn(countColumn);
+  this->Output->AddColumn(areaColumn);
+  for (vtkDoubleArray* column : overlayColumns)
+    {
+    this->Output->AddColumn(column);
+    }
+  return true;
+}
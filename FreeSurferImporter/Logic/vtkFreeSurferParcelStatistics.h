@@ -0,0 +1,100 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferParcelStatistics - per-parcel morphometry of surface overlays
+// .SECTION Description
+// Summarizes scalar overlays (thickness, area, curvature, ...) within the parcels
+// of a surface annotation, like the aparc.stats files of FreeSurfer. All parcels
+// and all overlays are accumulated in a single pass over the vertices, split
+// between threads with vtkSMPTools; each thread sums into its own contiguous
+// parcels x statistics buffer and the buffers are added at the end.
+// The output table has one row per parcel with at least one vertex: parcel
+// index and name, number of vertices, surface area, and the mean, sample
+// standard deviation (n - 1 denominator, 0 for parcels of a single vertex) and
+// area-weighted mean of every overlay. Means and deviations are accumulated with
+// Welford's method, so that they do not lose precision for values far from 0.
+// Non-finite overlay values are left out; the statistics of an overlay that has
+// no finite value in a parcel are NaN.
+
+#ifndef __vtkFreeSurferParcelStatistics_h
+#define __vtkFreeSurferParcelStatistics_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkFloatArray;
+class vtkPolyData;
+class vtkTable;
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferParcelStatistics : public vtkObject
+{
+public:
+  static vtkFreeSurferParcelStatistics* New();
+  vtkTypeMacro(vtkFreeSurferParcelStatistics, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Parcel index of each vertex, e.g. read by vtkFreeSurferAnnotationReader.
+  /// Vertices with a negative index are not in any parcel.
+  void SetParcelIndices(vtkDataArray* parcelIndices);
+  vtkGetObjectMacro(ParcelIndices, vtkDataArray);
+
+  /// Name of each parcel index, written to the ParcelName column
+  void SetParcelNames(const std::vector<std::string>& parcelNames);
+
+  /// Overlays to summarize, with one value per vertex. Columns are named after the arrays.
+  void AddOverlay(vtkDataArray* overlay);
+  void RemoveAllOverlays();
+  int GetNumberOfOverlays() const { return static_cast<int>(this->Overlays.size()); }
+
+  /// Area of each vertex, see ComputeVertexAreas. If not set, every vertex has unit area.
+  void SetVertexAreas(vtkDataArray* vertexAreas);
+  vtkGetObjectMacro(VertexAreas, vtkDataArray);
+
+  /// Area of each vertex of a surface: a third of the area of the triangles it belongs to,
+  /// as in the ?h.area files of FreeSurfer when computed on the white surface.
+  static vtkSmartPointer<vtkFloatArray> ComputeVertexAreas(vtkPolyData* surface);
+
+  /// Compute the statistics of all overlays.
+  /// Returns false if the parcel indices are not set or an array does not have one value per vertex.
+  bool Compute();
+
+  /// Table computed by the last call to Compute
+  vtkTable* GetOutput();
+
+protected:
+  vtkFreeSurferParcelStatistics();
+  ~vtkFreeSurferParcelStatistics() override;
+
+  vtkDataArray* ParcelIndices;
+  vtkDataArray* VertexAreas;
+  std::vector<vtkSmartPointer<vtkDataArray> > Overlays;
+  std::vector<std::string> ParcelNames;
+  vtkSmartPointer<vtkTable> Output;
+
+private:
+  vtkFreeSurferParcelStatistics(const vtkFreeSurferParcelStatistics&); // Not implemented
+  void operator=(const vtkFreeSurferParcelStatistics&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferQuantizer.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationDoubleKey.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnsignedShortArray.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void ComputeRange(const T* values, vtkIdType numberOfValues, double range[2])
+  {
+    struct Range
+      {
+      double Minimum = std::numeric_limits<double>::max();
+      double Maximum = -std::numeric_limits<double>::max();
+      };
+    vtkSMPThreadLocal<Range> threadRanges;
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      T minimum = std::numeric_limits<T>::max();
+      T maximum = std::numeric_limits<T>::lowest();
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        // Non-finite values are skipped, they are stored as NaN
+        bool finite = std::isfinite(static_cast<double>(values[i]));
+        minimum = finite && values[i] < minimum ? values[i] : minimum;
+        maximum = finite && values[i] > maximum ? values[i] : maximum;
+        }
+      Range& range = threadRanges.Local();
+      range.Minimum = std::min(range.Minimum, static_cast<double>(minimum));
+      range.Maximum = std::max(range.Maximum, static_cast<double>(maximum));
+      });
+    range[0] = std::numeric_limits<double>::max();
+    range[1] = -std::numeric_limits<double>::max();
+    for (const Range& threadRange : threadRanges)
+      {
+      range[0] = std::min(range[0], threadRange.Minimum);
+      range[1] = std::max(range[1], threadRange.Maximum);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename InputType, typename OutputType>
+  void QuantizeValues(const InputType* input, vtkIdType numberOfValues, double scale, double offset,
+    OutputType maximumValue, OutputType nanValue, OutputType* output)
+  {
+    // Single precision is enough for 16-bit output, except for large integers
+    typedef typename std::conditional<(sizeof(InputType) > 2 && !std::is_same<InputType, float>::value),
+      double, float>::type ComputeType;
+    const ComputeType inverseScale = static_cast<ComputeType>(1.0 / scale);
+    // The offset is subtracted before scaling, so that values far from 0 keep the precision of the input
+    const ComputeType computeOffset = static_cast<ComputeType>(offset);
+    const ComputeType maximum = static_cast<ComputeType>(maximumValue);
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        // Rounded to nearest by the truncation of the conversion, values are not negative.
+        // Non-finite values are selected rather than branched on, so that the loop is still vectorized.
+        bool finite = std::isfinite(static_cast<ComputeType>(input[i]));
+        ComputeType value = (static_cast<ComputeType>(input[i]) - computeOffset) * inverseScale + static_cast<ComputeType>(0.5);
+        value = value > 0 ? value : 0;
+        value = value < maximum ? value : maximum;
+        output[i] = finite ? static_cast<OutputType>(value) : nanValue;
+        }
+      });
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename InputType, typename OutputArrayType>
+  vtkSmartPointer<vtkDataArray> QuantizeArray(const InputType* input, vtkDataArray* values)
+  {
+    typedef typename OutputArrayType::ValueType OutputType;
+    vtkIdType numberOfValues = values->GetNumberOfValues();
+    double range[2] = { 0.0, 0.0 };
+    if (numberOfValues > 0)
+      {
+      ComputeRange(input, numberOfValues, range);
+      }
+    if (range[0] > range[1])
+      {
+      // Only NaN values
+      range[0] = range[1] = 0.0;
+      }
+
+    // The largest stored value of floating-point data is reserved for NaN
+    const bool reserveNaNValue = !std::numeric_limits<InputType>::is_integer;
+    const OutputType nanValue = std::numeric_limits<OutputType>::max();
+    const OutputType maximumValue = reserveNaNValue ? nanValue - 1 : nanValue;
+    const double maximumStoredValue = maximumValue;
+    double offset = range[0];
+    double scale = (range[1] - range[0]) / maximumStoredValue;
+    if (std::numeric_limits<InputType>::is_integer && range[1] - range[0] <= maximumStoredValue)
+      {
+      // Exact
+      scale = 1.0;
+      }
+    if (scale <= 0.0)
+      {
+      scale = 1.0;
+      }
+
+    vtkSmartPointer<OutputArrayType> output = vtkSmartPointer<OutputArrayType>::New();
+    output->SetName(values->GetName());
+    output->SetNumberOfComponents(values->GetNumberOfComponents());
+    output->SetNumberOfTuples(values->GetNumberOfTuples());
+    QuantizeValues(input, numberOfValues, scale, offset, maximumValue, nanValue, output->GetPointer(0));
+    output->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_SCALE(), scale);
+    output->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_OFFSET(), offset);
+    if (reserveNaNValue)
+      {
+      output->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_NAN_VALUE(), nanValue);
+      }
+    return output;
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename InputType>
+  void DequantizeValues(const InputType* input, vtkIdType numberOfValues, double scale, double offset, double nanValue,
+    float* output)
+  {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    vtkSMPTools::For(0, numberOfValues, [&](vtkIdType begin, vtkIdType end)
+      {
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        output[i] = input[i] == nanValue ? nan : static_cast<float>(input[i] * scale + offset);
+        }
+      });
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename InputType>
+  vtkSmartPointer<vtkDataArray> QuantizeArray(const InputType* input, vtkDataArray* values, int storageMode)
+  {
+    if (storageMode == vtkFreeSurferQuantizer::Quantized8Bit && sizeof(InputType) > sizeof(unsigned char))
+      {
+      return QuantizeArray<InputType, vtkUnsignedCharArray>(input, values);
+      }
+    if (storageMode == vtkFreeSurferQuantizer::Quantized16Bit && sizeof(InputType) > sizeof(unsigned short))
+      {
+      return QuantizeArray<InputType, vtkUnsignedShortArray>(input, values);
+      }
+    return nullptr;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferQuantizer);
+vtkInformationKeyMacro(vtkFreeSurferQuantizer, QUANTIZATION_SCALE, Double);
+vtkInformationKeyMacro(vtkFreeSurferQuantizer, QUANTIZATION_OFFSET, Double);
+vtkInformationKeyMacro(vtkFreeSurferQuantizer, QUANTIZATION_NAN_VALUE, Double);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferQuantizer::vtkFreeSurferQuantizer() = default;
+
+//----------------------------------------------------------------------------
+vtkFreeSurferQuantizer::~vtkFreeSurferQuantizer() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferQuantizer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkDataArray> vtkFreeSurferQuantizer::Quantize(vtkDataArray* values, int storageMode)
+{
+  double scale = 1.0;
+  double offset = 0.0;
+  if (!values || storageMode == FullPrecision || vtkFreeSurferQuantizer::GetQuantization(values, scale, offset))
+    {
+    return nullptr;
+    }
+
+  // Values are read directly from the memory of the array, the type is dispatched once
+  vtkSmartPointer<vtkDataArray> quantized;
+  void* input = values->GetVoidPointer(0);
+  switch (values->GetDataType())
+    {
+    vtkTemplateMacro(quantized = QuantizeArray(static_cast<const VTK_TT*>(input), values, storageMode));
+    default:
+      break;
+    }
+  return quantized;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferQuantizer::QuantizeImage(vtkImageData* imageData, int storageMode)
+{
+  vtkDataArray* scalars = imageData ? imageData->GetPointData()->GetScalars() : nullptr;
+  vtkSmartPointer<vtkDataArray> quantized = vtkFreeSurferQuantizer::Quantize(scalars, storageMode);
+  if (!quantized)
+    {
+    return false;
+    }
+  imageData->GetPointData()->SetScalars(quantized);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferQuantizer::Dequantize(vtkDataArray* values)
+{
+  double scale = 1.0;
+  double offset = 0.0;
+  if (!vtkFreeSurferQuantizer::GetQuantization(values, scale, offset))
+    {
+    return nullptr;
+    }
+  vtkSmartPointer<vtkFloatArray> output = vtkSmartPointer<vtkFloatArray>::New();
+  output->SetName(values->GetName());
+  output->SetNumberOfComponents(values->GetNumberOfComponents());
+  output->SetNumberOfTuples(values->GetNumberOfTuples());
+  // Stored values are never negative, -1 matches none of them if no value is reserved for NaN
+  vtkInformation* information = values->GetInformation();
+  double nanValue = information->Has(QUANTIZATION_NAN_VALUE()) ? information->Get(QUANTIZATION_NAN_VALUE()) : -1.0;
+  void* input = values->GetVoidPointer(0);
+  switch (values->GetDataType())
+    {
+    vtkTemplateMacro(DequantizeValues(static_cast<const VTK_TT*>(input), values->GetNumberOfValues(), scale, offset,
+      nanValue, output->GetPointer(0)));
+    default:
+      return nullptr;
+    }
+  return output;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferQuantizer::GetQuantization(vtkDataArray* values, double& scale, double& offset)
+{
+  vtkInformation* information = values && values->HasInformation() ? values->GetInformation() : nullptr;
+  if (!information || !information->Has(QUANTIZATION_SCALE()) || !information->Has(QUANTIZATION_OFFSET()))
+    {
+    return false;
+    }
+  scale = information->Get(QUANTIZATION_SCALE());
+  offset = information->Get(QUANTIZATION_OFFSET());
+  return true;
+}
@@ -0,0 +1,91 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferQuantizer - reduced-precision storage of volumes and overlays
+// .SECTION Description
+// Converts intensity volumes and per-vertex overlays to 8 or 16-bit unsigned
+// integers with a linear scale and offset: value = stored * scale + offset.
+// The range is found with a parallel min/max reduction and the values are
+// converted by a parallel loop without branches that the compiler vectorizes.
+// Integer data whose range fits in the stored type is converted without loss.
+// The largest stored value of floating-point data is reserved for NaN: NaN and
+// infinite values are stored as QUANTIZATION_NAN_VALUE and restored as NaN by
+// Dequantize, they do not take part in the range.
+// The scale and offset are kept in the information of the stored array, see
+// GetQuantization. Linear color mappings of the stored values look the same
+// as those of the original values.
+
+#ifndef __vtkFreeSurferQuantizer_h
+#define __vtkFreeSurferQuantizer_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkFloatArray;
+class vtkImageData;
+class vtkInformationDoubleKey;
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferQuantizer : public vtkObject
+{
+public:
+  static vtkFreeSurferQuantizer* New();
+  vtkTypeMacro(vtkFreeSurferQuantizer, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  enum StorageMode
+    {
+    /// Values are kept in the type of the file
+    FullPrecision,
+    /// Values are stored as unsigned short, 65536 levels
+    Quantized16Bit,
+    /// Values are stored as unsigned char, 256 levels
+    Quantized8Bit
+    };
+
+  /// Returns the values stored in the specified mode, or nullptr if the values are already
+  /// stored in a type no larger than the one of the mode (e.g. UCHAR volumes).
+  static vtkSmartPointer<vtkDataArray> Quantize(vtkDataArray* values, int storageMode);
+
+  /// Replace the scalars of an image by their quantized values.
+  /// Returns false if the scalars were left unchanged.
+  static bool QuantizeImage(vtkImageData* imageData, int storageMode);
+
+  /// Get the scale and offset of quantized values. Returns false if the array is not quantized.
+  static bool GetQuantization(vtkDataArray* values, double& scale, double& offset);
+
+  /// Returns the original values of quantized values, or nullptr if the array is not quantized
+  static vtkSmartPointer<vtkFloatArray> Dequantize(vtkDataArray* values);
+
+  /// Keys of the scale and offset in the information of quantized arrays
+  static vtkInformationDoubleKey* QUANTIZATION_SCALE();
+  static vtkInformationDoubleKey* QUANTIZATION_OFFSET();
+  /// Key of the stored value of NaN, only set for arrays quantized from floating-point values
+  static vtkInformationDoubleKey* QUANTIZATION_NAN_VALUE();
+
+protected:
+  vtkFreeSurferQuantizer();
+  ~vtkFreeSurferQuantizer() override;
+
+private:
+  vtkFreeSurferQuantizer(const vtkFreeSurferQuantizer&); // Not implemented
+  void operator=(const vtkFreeSurferQuantizer&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,341 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSphereResampler.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkStaticPointLocator.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Coordinates of the points of a sphere scaled to unit radius
+  std::vector<double> GetUnitSpherePoints(vtkPoints* points)
+  {
+    vtkIdType numberOfPoints = points->GetNumberOfPoints();
+    std::vector<double> unitPoints(3 * static_cast<size_t>(numberOfPoints));
+    vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end)
+      {
+      for (vtkIdType i = begin; i < end; ++i)
+        {
+        double* point = &unitPoints[3 * i];
+        points->GetPoint(i, point);
+        double norm = vtkMath::Norm(point);
+        if (norm > 0.0)
+          {
+          vtkMath::MultiplyScalar(point, 1.0 / norm);
+          }
+        }
+      });
+    return unitPoints;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Barycentric coordinates of the central projection of a unit vector onto the plane of a triangle.
+  /// Returns false if the vector points away from the triangle.
+  bool GetProjectedBarycentricCoordinates(const double a[3], const double b[3], const double c[3],
+    const double point[3], double weights[3])
+  {
+    double ab[3], ac[3], normal[3];
+    vtkMath::Subtract(b, a, ab);
+    vtkMath::Subtract(c, a, ac);
+    vtkMath::Cross(ab, ac, normal);
+    double normalSquared = vtkMath::Dot(normal, normal);
+    double pointDotNormal = vtkMath::Dot(point, normal);
+    double planeDotNormal = vtkMath::Dot(a, normal);
+    if (normalSquared <= 0.0 || pointDotNormal * planeDotNormal <= 0.0)
+      {
+      return false;
+      }
+    double projection[3] = { point[0], point[1], point[2] };
+    vtkMath::MultiplyScalar(projection, planeDotNormal / pointDotNormal);
+
+    double qa[3], qb[3], qc[3], cross[3];
+    vtkMath::Subtract(a, projection, qa);
+    vtkMath::Subtract(b, projection, qb);
+    vtkMath::Subtract(c, projection, qc);
+    vtkMath::Cross(qb, qc, cross);
+    weights[0] = vtkMath::Dot(cross, normal) / normalSquared;
+    vtkMath::Cross(qc, qa, cross);
+    weights[1] = vtkMath::Dot(cross, normal) / normalSquared;
+    weights[2] = 1.0 - weights[0] - weights[1];
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Best triangle found by a thread for each target vertex: the one with the largest
+  /// smallest barycentric weight, i.e. the one that contains the vertex most clearly
+  struct TriangleMatches
+    {
+    std::vector<float> Scores;
+    std::vector<vtkIdType> Triangles;
+    };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferSphereResampler);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSphereResampler::vtkFreeSurferSphereResampler() = default;
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSphereResampler::~vtkFreeSurferSphereResampler() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSphereResampler::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfTargetVertices: " << this->GetNumberOfTargetVertices() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkFreeSurferSphereResampler::GetNumberOfTargetVertices() const
+{
+  return this->TargetPoints ? this->TargetPoints->GetNumberOfPoints() : 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSphereResampler::SetTargetSphere(vtkPolyData* targetSphere)
+{
+  this->TargetPoints = nullptr;
+  this->TargetLocator = nullptr;
+  if (!targetSphere || !targetSphere->GetPoints() || targetSphere->GetNumberOfPoints() == 0)
+    {
+    vtkErrorMacro("SetTargetSphere: Target sphere has no points");
+    return false;
+    }
+
+  std::vector<double> unitPoints = GetUnitSpherePoints(targetSphere->GetPoints());
+  vtkNew<vtkDoubleArray> coordinates;
+  coordinates->SetNumberOfComponents(3);
+  coordinates->SetNumberOfTuples(targetSphere->GetNumberOfPoints());
+  std::copy(unitPoints.begin(), unitPoints.end(), coordinates->GetPointer(0));
+  vtkNew<vtkPoints> points;
+  points->SetData(coordinates);
+
+  this->TargetPoints = vtkSmartPointer<vtkPolyData>::New();
+  this->TargetPoints->SetPoints(points);
+  this->TargetLocator = vtkSmartPointer<vtkStaticPointLocator>::New();
+  this->TargetLocator->SetDataSet(this->TargetPoints);
+  this->TargetLocator->BuildLocator();
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSphereResampler::ComputeMapping(vtkPolyData* sourceSphere, Mapping& mapping)
+{
+  mapping = Mapping();
+  if (!this->TargetLocator)
+    {
+    vtkErrorMacro("ComputeMapping: Target sphere is not set");
+    return false;
+    }
+  if (!sourceSphere || !sourceSphere->GetPoints() || !sourceSphere->GetPolys())
+    {
+    vtkErrorMacro("ComputeMapping: Source sphere has no triangles");
+    return false;
+    }
+
+  // Triangles are copied to a flat list so that threads can access them at random
+  std::vector<vtkIdType> triangles;
+  triangles.reserve(3 * static_cast<size_t>(sourceSphere->GetNumberOfPolys()));
+  vtkCellArray* polys = sourceSphere->GetPolys();
+  vtkIdType numberOfPointIds = 0;
+  const vtkIdType* pointIds = nullptr;
+  for (polys->InitTraversal(); polys->GetNextCell(numberOfPointIds, pointIds);)
+    {
+    if (numberOfPointIds == 3)
+      {
+      triangles.insert(triangles.end(), pointIds, pointIds + 3);
+      }
+    }
+  vtkIdType numberOfTriangles = static_cast<vtkIdType>(triangles.size() / 3);
+  if (numberOfTriangles == 0)
+    {
+    vtkErrorMacro("ComputeMapping: Source sphere has no triangles");
+    return false;
+    }
+
+  std::vector<double> sourcePoints = GetUnitSpherePoints(sourceSphere->GetPoints());
+  const double* targetPoints = vtkDoubleArray::SafeDownCast(this->TargetPoints->GetPoints()->GetData())->GetPointer(0);
+  vtkIdType numberOfTargetVertices = this->GetNumberOfTargetVertices();
+  vtkStaticPointLocator* locator = this->TargetLocator;
+
+  // Each triangle claims the target vertices around it, the best claim of each thread is kept
+  vtkSMPThreadLocal<TriangleMatches> threadMatches;
+  vtkSMPThreadLocalObject<vtkIdList> threadCandidates;
+  vtkSMPTools::For(0, numberOfTriangles, [&](vtkIdType beginTriangle, vtkIdType endTriangle)
+    {
+    TriangleMatches& matches = threadMatches.Local();
+    if (matches.Scores.empty())
+      {
+      matches.Scores.assign(numberOfTargetVertices, -std::numeric_limits<float>::max());
+      matches.Triangles.assign(numberOfTargetVertices, -1);
+      }
+    vtkIdList* candidates = threadCandidates.Local();
+    for (vtkIdType triangle = beginTriangle; triangle < endTriangle; ++triangle)
+      {
+      const double* a = &sourcePoints[3 * triangles[3 * triangle]];
+      const double* b = &sourcePoints[3 * triangles[3 * triangle + 1]];
+      const double* c = &sourcePoints[3 * triangles[3 * triangle + 2]];
+      double center[3] = { (a[0] + b[0] + c[0]) / 3.0, (a[1] + b[1] + c[1]) / 3.0, (a[2] + b[2] + c[2]) / 3.0 };
+      // The spherical patch bulges slightly out of the plane of the triangle
+      double radius = 1.1 * std::sqrt(std::max(vtkMath::Distance2BetweenPoints(center, a),
+        std::max(vtkMath::Distance2BetweenPoints(center, b), vtkMath::Distance2BetweenPoints(center, c)))) + 1e-6;
+      locator->FindPointsWithinRadius(radius, center, candidates);
+      for (vtkIdType i = 0; i < candidates->GetNumberOfIds(); ++i)
+        {
+        vtkIdType target = candidates->GetId(i);
+        double weights[3] = { 0.0, 0.0, 0.0 };
+        if (!GetProjectedBarycentricCoordinates(a, b, c, &targetPoints[3 * target], weights))
+          {
+          continue;
+          }
+        float score = static_cast<float>(std::min(weights[0], std::min(weights[1], weights[2])));
+        if (score > matches.Scores[target]
+          || (score == matches.Scores[target] && triangle < matches.Triangles[target]))
+          {
+          matches.Scores[target] = score;
+          matches.Triangles[target] = triangle;
+          }
+        }
+      }
+    });
+
+  std::vector<TriangleMatches*> allMatches;
+  for (TriangleMatches& matches : threadMatches)
+    {
+    if (!matches.Scores.empty())
+      {
+      allMatches.push_back(&matches);
+      }
+    }
+
+  mapping.NumberOfSourceVertices = sourceSphere->GetNumberOfPoints();
+  mapping.VertexIds.assign(3 * static_cast<size_t>(numberOfTargetVertices), -1);
+  mapping.Weights.assign(3 * static_cast<size_t>(numberOfTargetVertices), 0.0f);
+  vtkSMPTools::For(0, numberOfTargetVertices, [&](vtkIdType beginTarget, vtkIdType endTarget)
+    {
+    for (vtkIdType target = beginTarget; target < endTarget; ++target)
+      {
+      // Same choice as a single thread would make, whatever the split of the triangles
+      float bestScore = -std::numeric_limits<float>::max();
+      vtkIdType bestTriangle = -1;
+      for (const TriangleMatches* matches : allMatches)
+        {
+        vtkIdType triangle = matches->Triangles[target];
+        float score = matches->Scores[target];
+        if (triangle >= 0 && (bestTriangle < 0 || score > bestScore || (score == bestScore && triangle < bestTriangle)))
+          {
+          bestScore = score;
+          bestTriangle = triangle;
+          }
+        }
+      if (bestTriangle < 0)
+        {
+        continue;
+        }
+
+      // Vertices just outside of the triangle, e.g. in small gaps between triangles, use the closest point
+      const vtkIdType* triangle = &triangles[3 * bestTriangle];
+      double weights[3] = { 1.0 / 3.0, 1.0 / 3.0, 1.0 / 3.0 };
+      GetProjectedBarycentricCoordinates(&sourcePoints[3 * triangle[0]], &sourcePoints[3 * triangle[1]],
+        &sourcePoints[3 * triangle[2]], &targetPoints[3 * target], weights);
+      double weightSum = 0.0;
+      for (int corner = 0; corner < 3; ++corner)
+        {
+        weights[corner] = std::max(0.0, weights[corner]);
+        weightSum += weights[corner];
+        }
+      for (int corner = 0; corner < 3; ++corner)
+        {
+        mapping.VertexIds[3 * target + corner] = triangle[corner];
+        mapping.Weights[3 * target + corner] = static_cast<float>(weightSum > 0.0 ? weights[corner] / weightSum : 1.0 / 3.0);
+        }
+      }
+    });
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkFreeSurferSphereResampler::Resample(const Mapping& mapping, vtkDataArray* overlay,
+  int interpolation/*=Barycentric*/)
+{
+  if (!overlay || overlay->GetNumberOfTuples() != mapping.NumberOfSourceVertices)
+    {
+    return nullptr;
+    }
+
+  // The gather reads a plain contiguous array, other array types are converted once
+  vtkSmartPointer<vtkFloatArray> sourceValues = vtkFloatArray::SafeDownCast(overlay);
+  if (!sourceValues || sourceValues->GetNumberOfComponents() != 1)
+    {
+    sourceValues = vtkSmartPointer<vtkFloatArray>::New();
+    sourceValues->SetNumberOfValues(overlay->GetNumberOfTuples());
+    sourceValues->CopyComponent(0, overlay, 0);
+    }
+  const float* source = sourceValues->GetPointer(0);
+
+  vtkIdType numberOfTargetVertices = static_cast<vtkIdType>(mapping.Weights.size() / 3);
+  vtkSmartPointer<vtkFloatArray> resampled = vtkSmartPointer<vtkFloatArray>::New();
+  resampled->SetName(overlay->GetName());
+  resampled->SetNumberOfValues(numberOfTargetVertices);
+  float* target = resampled->GetPointer(0);
+  const vtkIdType* vertexIds = mapping.VertexIds.data();
+  const float* weights = mapping.Weights.data();
+  bool nearestVertex = (interpolation == NearestVertex);
+  vtkSMPTools::For(0, numberOfTargetVertices, [&](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      const vtkIdType* ids = vertexIds + 3 * i;
+      const float* w = weights + 3 * i;
+      if (ids[0] < 0)
+        {
+        target[i] = std::numeric_limits<float>::quiet_NaN();
+        }
+      else if (nearestVertex)
+        {
+        int corner = (w[0] >= w[1] && w[0] >= w[2]) ? 0 : (w[1] >= w[2] ? 1 : 2);
+        target[i] = source[ids[corner]];
+        }
+      else
+        {
+        target[i] = w[0] * source[ids[0]] + w[1] * source[ids[1]] + w[2] * source[ids[2]];
+        }
+      }
+    });
+  return resampled;
+}
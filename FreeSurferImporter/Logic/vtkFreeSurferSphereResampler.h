@@ -0,0 +1,102 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+// .NAME vtkFreeSurferSphereResampler - resampling of overlays through spherical registration
+// .SECTION Description
+// Maps per-vertex data of a subject onto a target surface such as fsaverage,
+// using the registered sphere of the subject (?h.sphere.reg) and the sphere of
+// the target. A vtkStaticPointLocator is built once over the target sphere.
+// The mapping of a subject is computed by visiting its triangles in parallel
+// and querying the target vertices around each triangle; every target vertex
+// is assigned to the subject triangle that contains its projection, with the
+// barycentric weights of the triangle vertices. Once the mapping of a subject
+// is computed, each of its overlays is resampled by a parallel gather.
+
+#ifndef __vtkFreeSurferSphereResampler_h
+#define __vtkFreeSurferSphereResampler_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkFloatArray;
+class vtkPolyData;
+class vtkStaticPointLocator;
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferSphereResampler : public vtkObject
+{
+public:
+  static vtkFreeSurferSphereResampler* New();
+  vtkTypeMacro(vtkFreeSurferSphereResampler, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  enum Interpolation
+    {
+    /// Value of the closest vertex of the containing triangle
+    NearestVertex,
+    /// Barycentric interpolation within the containing triangle
+    Barycentric
+    };
+
+  /// Correspondence from the vertices of the target to the triangles of a subject sphere
+  struct Mapping
+    {
+    vtkIdType NumberOfSourceVertices = 0;
+    /// Source vertices of the triangle that contains each target vertex, 3 per target vertex.
+    /// -1 if no triangle was found.
+    std::vector<vtkIdType> VertexIds;
+    /// Barycentric weights of the source vertices, 3 per target vertex
+    std::vector<float> Weights;
+    };
+
+  /// Set the sphere of the target surface (e.g. fsaverage/surf/lh.sphere.reg) and build its spatial index.
+  /// Returns false if the sphere has no points.
+  bool SetTargetSphere(vtkPolyData* targetSphere);
+
+  /// Number of vertices of the target sphere, which is the length of resampled overlays
+  vtkIdType GetNumberOfTargetVertices() const;
+
+  /// Compute the mapping of a registered subject sphere (?h.sphere.reg) to the target.
+  /// Can be called from several threads at once once the target sphere is set.
+  /// Returns false if the target is not set or the sphere has no triangles.
+  bool ComputeMapping(vtkPolyData* sourceSphere, Mapping& mapping);
+
+  /// Resample an overlay of the subject, with one value per vertex of the source sphere,
+  /// to the vertices of the target. The output array has the name of the overlay.
+  /// Target vertices without a source triangle are NaN, so that reductions can leave them out.
+  /// Returns nullptr if the overlay does not match the mapping.
+  static vtkSmartPointer<vtkFloatArray> Resample(const Mapping& mapping, vtkDataArray* overlay,
+    int interpolation = Barycentric);
+
+protected:
+  vtkFreeSurferSphereResampler();
+  ~vtkFreeSurferSphereResampler() override;
+
+  vtkSmartPointer<vtkPolyData> TargetPoints;
+  vtkSmartPointer<vtkStaticPointLocator> TargetLocator;
+
+private:
+  vtkFreeSurferSphereResampler(const vtkFreeSurferSphereResampler&); // Not implemented
+  void operator=(const vtkFreeSurferSphereResampler&); // Not implemented
+};
+
+#endif
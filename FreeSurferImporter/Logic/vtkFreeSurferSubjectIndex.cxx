@@ -0,0 +1,213 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSubjectIndex.h"
+#include "vtkSlicerFreeSurferImporterLogic.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool IsSameFile(const vtkFreeSurferSubjectIndex::FileInfo& a, const vtkFreeSurferSubjectIndex::FileInfo& b)
+  {
+    return a.Type == b.Type && a.Size == b.Size && a.ModifiedTime == b.ModifiedTime;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferSubjectIndex);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSubjectIndex::vtkFreeSurferSubjectIndex() = default;
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSubjectIndex::~vtkFreeSurferSubjectIndex() = default;
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSubjectIndex::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "SubjectDirectory: " << this->SubjectDirectory << std::endl;
+  for (const auto& directory : this->Directories)
+    {
+    os << indent << directory.first << ": " << directory.second.size() << " files" << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSubjectIndex::SetSubjectDirectory(const std::string& subjectDirectory)
+{
+  std::string directory = vtksys::SystemTools::CollapseFullPath(subjectDirectory);
+  if (directory == this->SubjectDirectory)
+    {
+    return;
+    }
+  this->SubjectDirectory = directory;
+  this->Directories.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::string> vtkFreeSurferSubjectIndex::GetIndexedDirectories()
+{
+  return { "mri", "surf", "label" };
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSubjectIndex::Update()
+{
+  bool changed = false;
+  for (const std::string& directoryName : GetIndexedDirectories())
+    {
+    changed |= this->UpdateDirectory(directoryName);
+    }
+  if (changed)
+    {
+    this->Modified();
+    }
+  return changed;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSubjectIndex::UpdatePath(const std::string& path)
+{
+  std::string relativePath = path;
+  if (vtksys::SystemTools::FileIsFullPath(path))
+    {
+    relativePath = vtksys::SystemTools::RelativePath(this->SubjectDirectory, vtksys::SystemTools::CollapseFullPath(path));
+    }
+
+  // The first component of the path is the indexed directory
+  std::vector<std::string> components;
+  vtksys::SystemTools::SplitPath(relativePath, components, false);
+  std::string directoryName;
+  for (const std::string& component : components)
+    {
+    if (!component.empty())
+      {
+      directoryName = component;
+      break;
+      }
+    }
+
+  std::vector<std::string> indexedDirectories = GetIndexedDirectories();
+  if (std::find(indexedDirectories.begin(), indexedDirectories.end(), directoryName) == indexedDirectories.end())
+    {
+    return false;
+    }
+  bool changed = this->UpdateDirectory(directoryName);
+  if (changed)
+    {
+    this->Modified();
+    }
+  return changed;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSubjectIndex::UpdateDirectory(const std::string& directoryName)
+{
+  std::map<std::string, FileInfo> files;
+  std::string directoryPath = this->SubjectDirectory + "/" + directoryName;
+  vtksys::Directory directory;
+  if (!this->SubjectDirectory.empty() && directory.Load(directoryPath))
+    {
+    for (unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i)
+      {
+      std::string fileName = directory.GetFile(i);
+      if (fileName == "." || fileName == "..")
+        {
+        continue;
+        }
+
+      // One stat per file gives the kind, size and modification time
+      vtksys::SystemTools::Stat_t status;
+      if (vtksys::SystemTools::Stat(directoryPath + "/" + fileName, &status) != 0 || (status.st_mode & S_IFMT) != S_IFREG)
+        {
+        continue;
+        }
+      FileInfo info;
+      info.Name = directoryName + "/" + fileName;
+      info.Type = vtkSlicerFreeSurferImporterLogic::getFreeSurferFileType(info.Name);
+      info.Size = static_cast<unsigned long long>(status.st_size);
+      info.ModifiedTime = static_cast<long long>(status.st_mtime);
+      files[info.Name] = info;
+      }
+    }
+
+  std::map<std::string, FileInfo>& indexedFiles = this->Directories[directoryName];
+  bool changed = files.size() != indexedFiles.size()
+    || !std::equal(files.begin(), files.end(), indexedFiles.begin(),
+      [](const std::pair<const std::string, FileInfo>& a, const std::pair<const std::string, FileInfo>& b)
+      {
+      return a.first == b.first && IsSameFile(a.second, b.second);
+      });
+  indexedFiles.swap(files);
+  return changed;
+}
+
+//----------------------------------------------------------------------------
+std::vector<vtkFreeSurferSubjectIndex::FileInfo> vtkFreeSurferSubjectIndex::GetFiles() const
+{
+  std::vector<FileInfo> files;
+  for (const auto& directory : this->Directories)
+    {
+    for (const auto& file : directory.second)
+      {
+      files.push_back(file.second);
+      }
+    }
+  return files;
+}
+
+//----------------------------------------------------------------------------
+std::vector<vtkFreeSurferSubjectIndex::FileInfo> vtkFreeSurferSubjectIndex::GetFiles(int type) const
+{
+  std::vector<FileInfo> files;
+  for (const auto& directory : this->Directories)
+    {
+    for (const auto& file : directory.second)
+      {
+      if (file.second.Type == type)
+        {
+        files.push_back(file.second);
+        }
+      }
+    }
+  return files;
+}
+
+//----------------------------------------------------------------------------
+const vtkFreeSurferSubjectIndex::FileInfo* vtkFreeSurferSubjectIndex::GetFileInfo(const std::string& name) const
+{
+  std::string directoryName = name.substr(0, name.find('/'));
+  auto directoryIt = this->Directories.find(directoryName);
+  if (directoryIt == this->Directories.end())
+    {
+    return nullptr;
+    }
+  auto fileIt = directoryIt->second.find(name);
+  return fileIt == directoryIt->second.end() ? nullptr : &fileIt->second;
+}
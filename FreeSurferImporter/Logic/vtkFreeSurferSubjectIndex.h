@@ -0,0 +1,99 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferSubjectIndex - index of the files of a FreeSurfer subject
+// .SECTION Description
+// Lists the mri, surf and label directories of a subject with a single stat
+// per file, and records the type (see vtkSlicerFreeSurferImporterLogic::FreeSurferFileType),
+// size and modification time of every file. After the first scan, single
+// directories can be rescanned when a file system watcher reports a change,
+// so the rest of the subject is not listed again. ModifiedEvent is invoked
+// only when the content of the index changes.
+
+#ifndef __vtkFreeSurferSubjectIndex_h
+#define __vtkFreeSurferSubjectIndex_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferSubjectIndex : public vtkObject
+{
+public:
+  static vtkFreeSurferSubjectIndex* New();
+  vtkTypeMacro(vtkFreeSurferSubjectIndex, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  struct FileInfo
+    {
+    /// Path relative to the subject directory (e.g. "surf/lh.white")
+    std::string Name;
+    /// File type, -1 if the file is not one of the supported types
+    int Type = -1;
+    unsigned long long Size = 0;
+    long long ModifiedTime = 0;
+    };
+
+  /// Subject directory (the directory that contains mri, surf and label)
+  void SetSubjectDirectory(const std::string& subjectDirectory);
+  std::string GetSubjectDirectory() const { return this->SubjectDirectory; }
+
+  /// Subdirectories of the subject that are indexed
+  static std::vector<std::string> GetIndexedDirectories();
+
+  /// Scan all indexed directories.
+  /// Returns true if the content of the index changed.
+  bool Update();
+
+  /// Rescan one indexed directory, specified relative to the subject directory ("surf") or as
+  /// an absolute path. Paths of files in an indexed directory rescan that directory.
+  /// Returns true if the content of the index changed.
+  bool UpdatePath(const std::string& path);
+
+  /// All indexed files, ordered by name
+  std::vector<FileInfo> GetFiles() const;
+
+  /// Indexed files of the specified type, ordered by name
+  std::vector<FileInfo> GetFiles(int type) const;
+
+  /// Get a file by its path relative to the subject directory.
+  /// Returns nullptr if the file is not in the index.
+  const FileInfo* GetFileInfo(const std::string& name) const;
+
+protected:
+  vtkFreeSurferSubjectIndex();
+  ~vtkFreeSurferSubjectIndex() override;
+
+  bool UpdateDirectory(const std::string& directoryName);
+
+  std::string SubjectDirectory;
+  /// Files of each indexed directory, by name
+  std::map<std::string, std::map<std::string, FileInfo> > Directories;
+
+private:
+  vtkFreeSurferSubjectIndex(const vtkFreeSurferSubjectIndex&); // Not implemented
+  void operator=(const vtkFreeSurferSubjectIndex&); // Not implemented
+};
+
+#endif
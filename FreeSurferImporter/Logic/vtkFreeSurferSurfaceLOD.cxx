@@ -0,0 +1,356 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSurfaceLOD.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSMPTools.h>
+#include <vtkStaticPointLocator.h>
+#include <vtkTriangleFilter.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  const char* SourcePointIdsArrayName = "FreeSurferImporter.SourcePointIds";
+  const char* NumberOfSourcePointsArrayName = "FreeSurferImporter.NumberOfSourcePoints";
+  const char* LevelRatioArrayName = "FreeSurferImporter.LevelRatio";
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferSurfaceLOD);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSurfaceLOD::vtkFreeSurferSurfaceLOD()
+  : Input(nullptr)
+  , NumberOfLevels(3)
+  , LevelRatio(0.25)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSurfaceLOD::~vtkFreeSurferSurfaceLOD()
+{
+  this->SetInput(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSurfaceLOD::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfLevels: " << this->NumberOfLevels << std::endl;
+  os << indent << "LevelRatio: " << this->LevelRatio << std::endl;
+  os << indent << "NumberOfAvailableLevels: " << this->GetNumberOfAvailableLevels() << std::endl;
+  for (size_t i = 0; i < this->Levels.size(); ++i)
+    {
+    os << indent << "Level " << i + 1 << ": " << this->Levels[i]->GetNumberOfPoints() << " points, "
+      << this->Levels[i]->GetNumberOfPolys() << " polygons" << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSurfaceLOD::SetInput(vtkPolyData* surface)
+{
+  if (surface == this->Input)
+    {
+    return;
+    }
+  vtkSetObjectBodyMacro(Input, vtkPolyData, surface);
+  this->SetLevels(std::vector<vtkSmartPointer<vtkPolyData> >(), std::vector<vtkSmartPointer<vtkIdList> >());
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFreeSurferSurfaceLOD::GetLevelFileName(const std::string& surfaceFileName, int level)
+{
+  std::ostringstream fileName;
+  fileName << surfaceFileName << ".lod" << level << ".vtp";
+  return fileName.str();
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkFreeSurferSurfaceLOD::GetLevel(int level)
+{
+  if (level == 0)
+    {
+    return this->Input;
+    }
+  if (level < 0 || level > static_cast<int>(this->Levels.size()))
+    {
+    return nullptr;
+    }
+  return this->Levels[level - 1];
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSurfaceLOD::SetLevels(const std::vector<vtkSmartPointer<vtkPolyData> >& levels,
+  const std::vector<vtkSmartPointer<vtkIdList> >& sourcePointIds)
+{
+  this->Levels = levels;
+  this->SourcePointIds = sourcePointIds;
+  this->LevelPointDataTimes.assign(levels.size(), 0);
+  for (int level = 1; level <= static_cast<int>(levels.size()); ++level)
+    {
+    this->UpdateLevelPointData(level);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSurfaceLOD::Build()
+{
+  this->SetLevels(std::vector<vtkSmartPointer<vtkPolyData> >(), std::vector<vtkSmartPointer<vtkIdList> >());
+  if (!this->Input || !this->Input->GetPoints() || this->Input->GetNumberOfPolys() == 0)
+    {
+    vtkErrorMacro("Build: Input surface has no polygons");
+    return false;
+    }
+  int numberOfCoarseLevels = this->NumberOfLevels - 1;
+  if (numberOfCoarseLevels == 0)
+    {
+    return true;
+    }
+
+  // Only the geometry is decimated, point data is gathered from the input afterwards
+  vtkSmartPointer<vtkPolyData> geometry = vtkSmartPointer<vtkPolyData>::New();
+  geometry->SetPoints(this->Input->GetPoints());
+  geometry->SetPolys(this->Input->GetPolys());
+  if (geometry->GetPolys()->IsHomogeneous() != 3)
+    {
+    // Legacy quadrangle surfaces
+    vtkNew<vtkTriangleFilter> triangulator;
+    triangulator->SetInputData(geometry);
+    triangulator->Update();
+    geometry = triangulator->GetOutput();
+    }
+
+  vtkNew<vtkStaticPointLocator> locator;
+  locator->SetDataSet(geometry);
+  locator->BuildLocator();
+
+  std::vector<vtkSmartPointer<vtkPolyData> > levels(numberOfCoarseLevels);
+  std::vector<vtkSmartPointer<vtkIdList> > sourcePointIds(numberOfCoarseLevels);
+  double levelRatio = this->LevelRatio;
+  vtkSMPTools::For(0, numberOfCoarseLevels, [&](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      // Each level decimates its own copy, the traversal state of the input cells is not thread-safe
+      vtkNew<vtkPolyData> levelInput;
+      levelInput->DeepCopy(geometry);
+
+      vtkNew<vtkQuadricDecimation> decimation;
+      decimation->SetInputData(levelInput);
+      decimation->SetTargetReduction(1.0 - std::pow(levelRatio, static_cast<double>(i + 1)));
+      decimation->VolumePreservationOn();
+      decimation->Update();
+
+      vtkSmartPointer<vtkPolyData> level = vtkSmartPointer<vtkPolyData>::New();
+      level->SetPoints(decimation->GetOutput()->GetPoints());
+      level->SetPolys(decimation->GetOutput()->GetPolys());
+
+      vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+      ids->SetNumberOfIds(level->GetNumberOfPoints());
+      double point[3] = { 0.0, 0.0, 0.0 };
+      for (vtkIdType pointId = 0; pointId < level->GetNumberOfPoints(); ++pointId)
+        {
+        level->GetPoints()->GetPoint(pointId, point);
+        ids->SetId(pointId, locator->FindClosestPoint(point));
+        }
+
+      levels[i] = level;
+      sourcePointIds[i] = ids;
+      }
+    });
+
+  this->SetLevels(levels, sourcePointIds);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSurfaceLOD::Load(const std::string& surfaceFileName)
+{
+  if (!this->Input)
+    {
+    return false;
+    }
+
+  vtkIdType numberOfInputPoints = this->Input->GetNumberOfPoints();
+  std::vector<vtkSmartPointer<vtkPolyData> > levels;
+  std::vector<vtkSmartPointer<vtkIdList> > sourcePointIds;
+  for (int level = 1; level < this->NumberOfLevels; ++level)
+    {
+    std::string levelFileName = GetLevelFileName(surfaceFileName, level);
+    int surfaceIsNewer = 0;
+    if (!vtksys::SystemTools::FileExists(levelFileName, true)
+      || !vtksys::SystemTools::FileTimeCompare(surfaceFileName, levelFileName, &surfaceIsNewer)
+      || surfaceIsNewer > 0)
+      {
+      return false;
+      }
+
+    vtkNew<vtkXMLPolyDataReader> reader;
+    reader->SetFileName(levelFileName.c_str());
+    reader->Update();
+    vtkPolyData* levelData = reader->GetOutput();
+    vtkDataArray* idsArray = levelData->GetPointData()->GetArray(SourcePointIdsArrayName);
+    vtkDataArray* numberOfSourcePoints = levelData->GetFieldData()->GetArray(NumberOfSourcePointsArrayName);
+    vtkDataArray* levelRatio = levelData->GetFieldData()->GetArray(LevelRatioArrayName);
+    if (!idsArray || !numberOfSourcePoints || numberOfSourcePoints->GetNumberOfTuples() != 1
+      || static_cast<vtkIdType>(numberOfSourcePoints->GetTuple1(0)) != numberOfInputPoints
+      || !levelRatio || levelRatio->GetNumberOfTuples() != 1 || levelRatio->GetTuple1(0) != this->LevelRatio
+      || idsArray->GetNumberOfTuples() != levelData->GetNumberOfPoints())
+      {
+      return false;
+      }
+
+    vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+    ids->SetNumberOfIds(idsArray->GetNumberOfTuples());
+    for (vtkIdType pointId = 0; pointId < idsArray->GetNumberOfTuples(); ++pointId)
+      {
+      vtkIdType sourcePointId = static_cast<vtkIdType>(idsArray->GetTuple1(pointId));
+      if (sourcePointId < 0 || sourcePointId >= numberOfInputPoints)
+        {
+        return false;
+        }
+      ids->SetId(pointId, sourcePointId);
+      }
+
+    vtkSmartPointer<vtkPolyData> levelSurface = vtkSmartPointer<vtkPolyData>::New();
+    levelSurface->SetPoints(levelData->GetPoints());
+    levelSurface->SetPolys(levelData->GetPolys());
+    levels.push_back(levelSurface);
+    sourcePointIds.push_back(ids);
+    }
+
+  this->SetLevels(levels, sourcePointIds);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSurfaceLOD::Save(const std::string& surfaceFileName)
+{
+  if (!this->Input)
+    {
+    return false;
+    }
+  std::string directory = vtksys::SystemTools::GetFilenamePath(surfaceFileName);
+  if (!vtksys::SystemTools::TestFileAccess(directory.empty() ? "." : directory, vtksys::TEST_FILE_WRITE))
+    {
+    return false;
+    }
+
+  for (int level = 1; level <= static_cast<int>(this->Levels.size()); ++level)
+    {
+    vtkNew<vtkPolyData> levelData;
+    levelData->SetPoints(this->Levels[level - 1]->GetPoints());
+    levelData->SetPolys(this->Levels[level - 1]->GetPolys());
+
+    vtkIdList* ids = this->SourcePointIds[level - 1];
+    vtkNew<vtkIdTypeArray> idsArray;
+    idsArray->SetName(SourcePointIdsArrayName);
+    idsArray->SetNumberOfValues(ids->GetNumberOfIds());
+    std::copy(ids->begin(), ids->end(), idsArray->GetPointer(0));
+    levelData->GetPointData()->AddArray(idsArray);
+
+    vtkNew<vtkIdTypeArray> numberOfSourcePoints;
+    numberOfSourcePoints->SetName(NumberOfSourcePointsArrayName);
+    numberOfSourcePoints->InsertNextValue(this->Input->GetNumberOfPoints());
+    levelData->GetFieldData()->AddArray(numberOfSourcePoints);
+
+    vtkNew<vtkDoubleArray> levelRatio;
+    levelRatio->SetName(LevelRatioArrayName);
+    levelRatio->InsertNextValue(this->LevelRatio);
+    levelData->GetFieldData()->AddArray(levelRatio);
+
+    // Written to a temporary file first, so that a concurrent import never reads a partial level
+    std::string levelFileName = GetLevelFileName(surfaceFileName, level);
+    std::ostringstream temporaryFileName;
+    temporaryFileName << levelFileName << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+    vtkNew<vtkXMLPolyDataWriter> writer;
+    writer->SetFileName(temporaryFileName.str().c_str());
+    writer->SetInputData(levelData);
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    writer->SetCompressorTypeToNone();
+    if (!writer->Write() || !vtksys::SystemTools::RenameFile(temporaryFileName.str(), levelFileName))
+      {
+      vtksys::SystemTools::RemoveFile(temporaryFileName.str());
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSurfaceLOD::UpdateLevelPointData(int level)
+{
+  if (!this->Input || level < 1 || level > static_cast<int>(this->Levels.size()))
+    {
+    return;
+    }
+  vtkPointData* sourcePointData = this->Input->GetPointData();
+  vtkMTimeType sourceTime = sourcePointData->GetMTime();
+  if (this->LevelPointDataTimes[level - 1] == sourceTime)
+    {
+    return;
+    }
+
+  vtkIdList* ids = this->SourcePointIds[level - 1];
+  vtkPointData* targetPointData = this->Levels[level - 1]->GetPointData();
+  targetPointData->Initialize();
+  for (int i = 0; i < sourcePointData->GetNumberOfArrays(); ++i)
+    {
+    vtkAbstractArray* sourceArray = sourcePointData->GetAbstractArray(i);
+    vtkSmartPointer<vtkAbstractArray> targetArray = vtkSmartPointer<vtkAbstractArray>::Take(sourceArray->NewInstance());
+    targetArray->SetName(sourceArray->GetName());
+    targetArray->SetNumberOfComponents(sourceArray->GetNumberOfComponents());
+    targetArray->SetNumberOfTuples(ids->GetNumberOfIds());
+    sourceArray->GetTuples(ids, targetArray);
+    targetPointData->AddArray(targetArray);
+    }
+  for (int attributeType = 0; attributeType < vtkDataSetAttributes::NUM_ATTRIBUTES; ++attributeType)
+    {
+    vtkAbstractArray* activeArray = sourcePointData->GetAbstractAttribute(attributeType);
+    if (activeArray && activeArray->GetName())
+      {
+      targetPointData->SetActiveAttribute(activeArray->GetName(), attributeType);
+      }
+    }
+  this->LevelPointDataTimes[level - 1] = sourceTime;
+}
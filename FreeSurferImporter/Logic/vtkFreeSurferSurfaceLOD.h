@@ -0,0 +1,113 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferSurfaceLOD - decimation hierarchy of a surface for interactive rendering
+// .SECTION Description
+// Builds coarser versions of a surface with vtkQuadricDecimation, all levels
+// in parallel from the full resolution surface. Every vertex of a coarse level
+// records the closest vertex of the full surface, so the per-vertex arrays of
+// the full surface (overlays, annotations, normals) are carried to a level by
+// a simple gather, including arrays that are added after the levels are built.
+// Levels can be saved next to the surface file (lh.pial.lod1.vtp, ...) and are
+// reused as long as they are newer than the surface.
+
+#ifndef __vtkFreeSurferSurfaceLOD_h
+#define __vtkFreeSurferSurfaceLOD_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkIdList;
+class vtkPolyData;
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferSurfaceLOD : public vtkObject
+{
+public:
+  static vtkFreeSurferSurfaceLOD* New();
+  vtkTypeMacro(vtkFreeSurferSurfaceLOD, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Full resolution surface, it is level 0. Setting the input clears the levels.
+  virtual void SetInput(vtkPolyData* surface);
+  vtkGetObjectMacro(Input, vtkPolyData);
+
+  /// Number of levels, including the full resolution surface. Default is 3.
+  vtkSetClampMacro(NumberOfLevels, int, 1, 8);
+  vtkGetMacro(NumberOfLevels, int);
+
+  /// Fraction of the triangles of a level that is kept in the next coarser level. Default is 0.25.
+  vtkSetClampMacro(LevelRatio, double, 0.01, 0.99);
+  vtkGetMacro(LevelRatio, double);
+
+  /// Build the coarse levels of the input in parallel.
+  /// Returns false if the input has no triangles.
+  bool Build();
+
+  /// Read the coarse levels saved for a surface file.
+  /// Returns false if a level is missing, older than the surface file, or does not match the input
+  /// or the LevelRatio.
+  bool Load(const std::string& surfaceFileName);
+
+  /// Save the coarse levels next to the surface file.
+  /// Returns false if the directory is not writable.
+  bool Save(const std::string& surfaceFileName);
+
+  /// Name of the file a level is saved to (e.g. surf/lh.pial.lod1.vtp)
+  static std::string GetLevelFileName(const std::string& surfaceFileName, int level);
+
+  /// Number of levels available, 1 until the levels are built or loaded
+  int GetNumberOfAvailableLevels() const { return static_cast<int>(this->Levels.size()) + 1; }
+
+  /// Get a level, 0 is the input. Returns nullptr if the level is not available.
+  vtkPolyData* GetLevel(int level);
+
+  /// Copy the point data of the input to a coarse level.
+  /// Nothing is copied if the point data of the input did not change since the last update.
+  void UpdateLevelPointData(int level);
+
+protected:
+  vtkFreeSurferSurfaceLOD();
+  ~vtkFreeSurferSurfaceLOD() override;
+
+  /// Set the levels and their source point ids, and initialize their point data
+  void SetLevels(const std::vector<vtkSmartPointer<vtkPolyData> >& levels,
+    const std::vector<vtkSmartPointer<vtkIdList> >& sourcePointIds);
+
+  vtkPolyData* Input;
+  int NumberOfLevels;
+  double LevelRatio;
+
+  /// Coarse levels, starting at level 1
+  std::vector<vtkSmartPointer<vtkPolyData> > Levels;
+  /// Closest input vertex of each vertex of a coarse level
+  std::vector<vtkSmartPointer<vtkIdList> > SourcePointIds;
+  /// Modification time of the input point data when each level was last updated
+  std::vector<vtkMTimeType> LevelPointDataTimes;
+
+private:
+  vtkFreeSurferSurfaceLOD(const vtkFreeSurferSurfaceLOD&); // Not implemented
+  void operator=(const vtkFreeSurferSurfaceLOD&); // Not implemented
+};
+
+#endif
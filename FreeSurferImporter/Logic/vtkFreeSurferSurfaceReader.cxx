@@ -0,0 +1,234 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSurfaceReader.h"
+#include "vtkFreeSurferByteSwap.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkTypeInt32Array.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+  const int TriangleFileMagicNumber = 0xFFFFFE;
+
+  //----------------------------------------------------------------------------
+  class FileCloser
+  {
+  public:
+    FileCloser(FILE* file) : File(file) {}
+    ~FileCloser()
+    {
+      if (this->File)
+        {
+        fclose(this->File);
+        }
+    }
+    FILE* File;
+  };
+
+  //----------------------------------------------------------------------------
+  bool ReadMagicNumber(FILE* file, int& magicNumber)
+  {
+    unsigned char bytes[3] = { 0 };
+    if (fread(bytes, 1, 3, file) != 3)
+      {
+      return false;
+      }
+    magicNumber = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Reads the header of a triangle file and leaves the file positioned at the vertex coordinates
+  bool ReadTriangleFileHeader(FILE* file, int& numberOfVertices, int& numberOfFaces)
+  {
+    int magicNumber = 0;
+    if (!ReadMagicNumber(file, magicNumber) || magicNumber != TriangleFileMagicNumber)
+      {
+      return false;
+      }
+
+    // Skip the "created by" line, it is terminated by two newlines
+    int newlines = 0;
+    int c = 0;
+    while (newlines < 2 && (c = fgetc(file)) != EOF)
+      {
+      if (c == '\n')
+        {
+        ++newlines;
+        }
+      }
+
+    unsigned char counts[8];
+    if (newlines < 2 || fread(counts, 1, 8, file) != 8)
+      {
+      return false;
+      }
+    numberOfVertices = vtkFreeSurferByteSwap::ReadBigEndian<int>(counts);
+    numberOfFaces = vtkFreeSurferByteSwap::ReadBigEndian<int>(counts + 4);
+    return numberOfVertices > 0 && numberOfFaces >= 0;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetSecondsSince(const std::chrono::steady_clock::time_point& start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferSurfaceReader);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSurfaceReader::vtkFreeSurferSurfaceReader()
+  : FileName(nullptr)
+  , ReadSeconds(0.0)
+  , ByteSwapSeconds(0.0)
+{
+  this->SetNumberOfInputPorts(0);
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferSurfaceReader::~vtkFreeSurferSurfaceReader()
+{
+  this->SetFileName(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferSurfaceReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << (this->FileName ? this->FileName : "(none)") << std::endl;
+  os << indent << "ReadSeconds: " << this->ReadSeconds << std::endl;
+  os << indent << "ByteSwapSeconds: " << this->ByteSwapSeconds << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSurfaceReader::IsTriangleFile(const std::string& fileName)
+{
+  FILE* file = vtksys::SystemTools::Fopen(fileName, "rb");
+  FileCloser fileCloser(file);
+  int magicNumber = 0;
+  return file && ReadMagicNumber(file, magicNumber) && magicNumber == TriangleFileMagicNumber;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferSurfaceReader::ReadSurfaceInfo(const std::string& fileName, int& numberOfVertices, int& numberOfFaces)
+{
+  FILE* file = vtksys::SystemTools::Fopen(fileName, "rb");
+  FileCloser fileCloser(file);
+  return file && ReadTriangleFileHeader(file, numberOfVertices, numberOfFaces);
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferSurfaceReader::RequestData(vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** vtkNotUsed(inputVector), vtkInformationVector* outputVector)
+{
+  vtkPolyData* output = vtkPolyData::GetData(outputVector);
+  if (!output || !this->FileName)
+    {
+    vtkErrorMacro("RequestData: FileName is not set");
+    return 0;
+    }
+
+  this->ReadSeconds = 0.0;
+  this->ByteSwapSeconds = 0.0;
+  std::chrono::steady_clock::time_point readStart = std::chrono::steady_clock::now();
+  FILE* file = vtksys::SystemTools::Fopen(this->FileName, "rb");
+  FileCloser fileCloser(file);
+  int numberOfVertices = 0;
+  int numberOfFaces = 0;
+  if (!file || !ReadTriangleFileHeader(file, numberOfVertices, numberOfFaces))
+    {
+    vtkErrorMacro("RequestData: " << this->FileName << " is not a FreeSurfer triangle surface");
+    return 0;
+    }
+
+  // Vertex coordinates are read straight into the point array
+  vtkNew<vtkFloatArray> coordinates;
+  coordinates->SetNumberOfComponents(3);
+  coordinates->SetNumberOfTuples(numberOfVertices);
+  size_t numberOfCoordinates = 3 * static_cast<size_t>(numberOfVertices);
+  if (fread(coordinates->GetPointer(0), sizeof(float), numberOfCoordinates, file) != numberOfCoordinates)
+    {
+    vtkErrorMacro("RequestData: Could not read vertices from " << this->FileName);
+    return 0;
+    }
+  this->ReadSeconds += GetSecondsSince(readStart);
+  std::chrono::steady_clock::time_point swapStart = std::chrono::steady_clock::now();
+  vtkFreeSurferByteSwap::SwapBigEndianRange(coordinates->GetPointer(0), numberOfCoordinates, sizeof(float));
+  this->ByteSwapSeconds += GetSecondsSince(swapStart);
+
+  // Faces are read straight into the connectivity array of the cell array
+  readStart = std::chrono::steady_clock::now();
+  vtkNew<vtkTypeInt32Array> connectivity;
+  size_t numberOfIndices = 3 * static_cast<size_t>(numberOfFaces);
+  connectivity->SetNumberOfValues(numberOfIndices);
+  if (fread(connectivity->GetPointer(0), sizeof(vtkTypeInt32), numberOfIndices, file) != numberOfIndices)
+    {
+    vtkErrorMacro("RequestData: Could not read faces from " << this->FileName);
+    return 0;
+    }
+  this->ReadSeconds += GetSecondsSince(readStart);
+  swapStart = std::chrono::steady_clock::now();
+  vtkFreeSurferByteSwap::SwapBigEndianRange(connectivity->GetPointer(0), numberOfIndices, sizeof(vtkTypeInt32));
+  this->ByteSwapSeconds += GetSecondsSince(swapStart);
+
+  vtkTypeInt32* indices = connectivity->GetPointer(0);
+  bool validIndices = true;
+  for (size_t i = 0; i < numberOfIndices; ++i)
+    {
+    validIndices &= (static_cast<vtkTypeUInt32>(indices[i]) < static_cast<vtkTypeUInt32>(numberOfVertices));
+    }
+  if (!validIndices)
+    {
+    vtkErrorMacro("RequestData: Invalid vertex index in faces of " << this->FileName);
+    return 0;
+    }
+
+  vtkNew<vtkTypeInt32Array> offsets;
+  offsets->SetNumberOfValues(numberOfFaces + 1);
+  vtkTypeInt32* offset = offsets->GetPointer(0);
+  for (int i = 0; i <= numberOfFaces; ++i)
+    {
+    offset[i] = 3 * i;
+    }
+
+  vtkNew<vtkPoints> points;
+  points->SetData(coordinates);
+
+  vtkNew<vtkCellArray> polys;
+  polys->SetData(offsets, connectivity);
+
+  output->SetPoints(points);
+  output->SetPolys(polys);
+  return 1;
+}
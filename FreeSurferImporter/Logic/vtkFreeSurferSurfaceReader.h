@@ -0,0 +1,76 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferSurfaceReader - reader for FreeSurfer triangle surface files
+// .SECTION Description
+// Reads big-endian FreeSurfer triangle surfaces (lh.white, rh.pial, ...).
+// Vertices and faces are read in bulk directly into the arrays of the output,
+// converted to host byte order in place, and the polygons are set from offsets
+// and connectivity arrays without inserting cells one at a time.
+// Legacy quadrangle surfaces are not supported, see IsTriangleFile.
+
+#ifndef __vtkFreeSurferSurfaceReader_h
+#define __vtkFreeSurferSurfaceReader_h
+
+// VTK includes
+#include <vtkPolyDataAlgorithm.h>
+
+// STD includes
+#include <string>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferSurfaceReader : public vtkPolyDataAlgorithm
+{
+public:
+  static vtkFreeSurferSurfaceReader* New();
+  vtkTypeMacro(vtkFreeSurferSurfaceReader, vtkPolyDataAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// File to read
+  vtkSetStringMacro(FileName);
+  vtkGetStringMacro(FileName);
+
+  /// Time spent by the last update reading vertices and faces
+  vtkGetMacro(ReadSeconds, double);
+
+  /// Time spent by the last update converting vertices and faces to host byte order
+  vtkGetMacro(ByteSwapSeconds, double);
+
+  /// Returns true if the file starts with the triangle surface magic number
+  static bool IsTriangleFile(const std::string& fileName);
+
+  /// Read only the vertex and face counts of a triangle surface
+  static bool ReadSurfaceInfo(const std::string& fileName, int& numberOfVertices, int& numberOfFaces);
+
+protected:
+  vtkFreeSurferSurfaceReader();
+  ~vtkFreeSurferSurfaceReader() override;
+
+  int RequestData(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector) override;
+
+  char* FileName;
+  double ReadSeconds;
+  double ByteSwapSeconds;
+
+private:
+  vtkFreeSurferSurfaceReader(const vtkFreeSurferSurfaceReader&); // Not implemented
+  void operator=(const vtkFreeSurferSurfaceReader&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,479 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferVolumePyramid.h"
+#include "vtkFreeSurferHash.h"
+#include "vtkFreeSurferQuantizer.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkIntArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkTypeUInt32Array.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtkXMLImageDataWriter.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+  const char* SourceDimensionsArrayName = "FreeSurferImporter.SourceDimensions";
+  const char* QuantizationArrayName = "FreeSurferImporter.Quantization";
+  const char* SourceFingerprintArrayName = "FreeSurferImporter.SourceFingerprint";
+  /// Bytes hashed at the start and at the end of the volume file, like vtkFreeSurferDecodedDataCache
+  const size_t SourceSampleSize = 64 * 1024;
+
+  //----------------------------------------------------------------------------
+  /// Size of the volume file and hash of its first and last blocks, as 32-bit words
+  /// (low and high size, low and high hash) that are written and read exactly
+  bool GetSourceFingerprint(const std::string& volumeFileName, std::uint32_t fingerprint[4])
+  {
+    vtksys::SystemTools::Stat_t status;
+    if (vtksys::SystemTools::Stat(volumeFileName, &status) != 0)
+      {
+      return false;
+      }
+    std::uint64_t size = static_cast<std::uint64_t>(status.st_size);
+    FILE* file = vtksys::SystemTools::Fopen(volumeFileName, "rb");
+    if (!file)
+      {
+      return false;
+      }
+    std::uint64_t hash = 0;
+    bool hashed = vtkFreeSurferHash::HashFileSamples(file, size, SourceSampleSize, hash);
+    fclose(file);
+    fingerprint[0] = static_cast<std::uint32_t>(size);
+    fingerprint[1] = static_cast<std::uint32_t>(size >> 32);
+    fingerprint[2] = static_cast<std::uint32_t>(hash);
+    fingerprint[3] = static_cast<std::uint32_t>(hash >> 32);
+    return hashed;
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  T ConvertMean(double mean, std::true_type vtkNotUsed(isIntegral))
+  {
+    return static_cast<T>(std::floor(mean + 0.5));
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  T ConvertMean(double mean, std::false_type vtkNotUsed(isIntegral))
+  {
+    return static_cast<T>(mean);
+  }
+
+  //----------------------------------------------------------------------------
+  /// Each output voxel is the mean of the 2x2x2 input voxels it covers, fewer on the last
+  /// row, column or slice of odd dimensions. Output slices are computed in parallel.
+  template<typename T>
+  void Downsample(const T* input, const int inputDimensions[3], int numberOfComponents,
+    T* output, const int outputDimensions[3])
+  {
+    vtkIdType inputRowSize = static_cast<vtkIdType>(inputDimensions[0]) * numberOfComponents;
+    vtkIdType inputSliceSize = inputRowSize * inputDimensions[1];
+    vtkIdType outputRowSize = static_cast<vtkIdType>(outputDimensions[0]) * numberOfComponents;
+    vtkIdType outputSliceSize = outputRowSize * outputDimensions[1];
+    vtkSMPTools::For(0, outputDimensions[2], [&](vtkIdType beginSlice, vtkIdType endSlice)
+      {
+      std::vector<double> sums(numberOfComponents);
+      for (vtkIdType k = beginSlice; k < endSlice; ++k)
+        {
+        vtkIdType k0 = 2 * k;
+        vtkIdType k1 = std::min<vtkIdType>(k0 + 1, inputDimensions[2] - 1);
+        for (vtkIdType j = 0; j < outputDimensions[1]; ++j)
+          {
+          vtkIdType j0 = 2 * j;
+          vtkIdType j1 = std::min<vtkIdType>(j0 + 1, inputDimensions[1] - 1);
+          T* outputVoxel = output + k * outputSliceSize + j * outputRowSize;
+          for (vtkIdType i = 0; i < outputDimensions[0]; ++i)
+            {
+            vtkIdType i0 = 2 * i;
+            vtkIdType i1 = std::min<vtkIdType>(i0 + 1, inputDimensions[0] - 1);
+            std::fill(sums.begin(), sums.end(), 0.0);
+            for (vtkIdType inputK = k0; inputK <= k1; ++inputK)
+              {
+              for (vtkIdType inputJ = j0; inputJ <= j1; ++inputJ)
+                {
+                const T* inputRow = input + inputK * inputSliceSize + inputJ * inputRowSize;
+                for (vtkIdType inputI = i0; inputI <= i1; ++inputI)
+                  {
+                  const T* inputVoxel = inputRow + inputI * numberOfComponents;
+                  for (int component = 0; component < numberOfComponents; ++component)
+                    {
+                    sums[component] += static_cast<double>(inputVoxel[component]);
+                    }
+                  }
+                }
+              }
+            double numberOfVoxels = static_cast<double>((k1 - k0 + 1) * (j1 - j0 + 1) * (i1 - i0 + 1));
+            for (int component = 0; component < numberOfComponents; ++component)
+              {
+              outputVoxel[component] = ConvertMean<T>(sums[component] / numberOfVoxels, std::is_integral<T>());
+              }
+            outputVoxel += numberOfComponents;
+            }
+          }
+        }
+      });
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFreeSurferVolumePyramid);
+
+//----------------------------------------------------------------------------
+vtkFreeSurferVolumePyramid::vtkFreeSurferVolumePyramid()
+  : Input(nullptr)
+  , NumberOfLevels(3)
+{
+  this->LevelsDimensions[0] = 0;
+  this->LevelsDimensions[1] = 0;
+  this->LevelsDimensions[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkFreeSurferVolumePyramid::~vtkFreeSurferVolumePyramid()
+{
+  this->SetInput(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferVolumePyramid::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfLevels: " << this->NumberOfLevels << std::endl;
+  os << indent << "NumberOfAvailableLevels: " << this->GetNumberOfAvailableLevels() << std::endl;
+  for (size_t i = 0; i < this->Levels.size(); ++i)
+    {
+    int dimensions[3] = { 0, 0, 0 };
+    this->Levels[i]->GetDimensions(dimensions);
+    os << indent << "Level " << i + 1 << ": " << dimensions[0] << "x" << dimensions[1] << "x" << dimensions[2]
+      << " voxels" << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferVolumePyramid::SetInput(vtkImageData* imageData)
+{
+  if (imageData == this->Input)
+    {
+    return;
+    }
+  vtkSetObjectBodyMacro(Input, vtkImageData, imageData);
+
+  // Levels loaded before the volume was read are kept if they were saved for it
+  vtkDataArray* scalars = imageData ? imageData->GetPointData()->GetScalars() : nullptr;
+  int dimensions[3] = { 0, 0, 0 };
+  if (scalars)
+    {
+    imageData->GetDimensions(dimensions);
+    }
+  if (!scalars || !this->LevelsMatch(dimensions, scalars->GetDataType()))
+    {
+    this->Levels.clear();
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferVolumePyramid::LevelsMatch(const int dimensions[3], int scalarType) const
+{
+  if (this->Levels.empty()
+    || !std::equal(dimensions, dimensions + 3, this->LevelsDimensions))
+    {
+    return false;
+    }
+  vtkDataArray* levelScalars = this->Levels[0]->GetPointData()->GetScalars();
+  return levelScalars && levelScalars->GetDataType() == scalarType;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkFreeSurferVolumePyramid::GetLevelFileName(const std::string& volumeFileName, int level)
+{
+  std::ostringstream fileName;
+  fileName << volumeFileName << ".pyramid" << level << ".vti";
+  return fileName.str();
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferVolumePyramid::GetLevelDimensions(const int dimensions[3], int level, int levelDimensions[3])
+{
+  // Halving with the dimensions rounded up at each level is the same as dividing once by the level factor
+  int factor = 1 << level;
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    levelDimensions[axis] = std::max(1, (dimensions[axis] + factor - 1) / factor);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkFreeSurferVolumePyramid::GetLevelIJKToRAS(vtkMatrix4x4* ijkToRAS, int level, vtkMatrix4x4* levelIJKToRAS)
+{
+  // Voxel i of a level covers voxels factor * i to factor * i + factor - 1 of the volume
+  double factor = static_cast<double>(1 << level);
+  vtkNew<vtkMatrix4x4> levelToIJK;
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    levelToIJK->SetElement(axis, axis, factor);
+    levelToIJK->SetElement(axis, 3, (factor - 1.0) / 2.0);
+    }
+  vtkMatrix4x4::Multiply4x4(ijkToRAS, levelToIJK, levelIJKToRAS);
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkFreeSurferVolumePyramid::GetLevel(int level)
+{
+  if (level == 0)
+    {
+    return this->Input;
+    }
+  if (level < 0 || level > static_cast<int>(this->Levels.size()))
+    {
+    return nullptr;
+    }
+  return this->Levels[level - 1];
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferVolumePyramid::Build()
+{
+  this->Levels.clear();
+  vtkDataArray* inputScalars = this->Input ? this->Input->GetPointData()->GetScalars() : nullptr;
+  if (!inputScalars || inputScalars->GetNumberOfTuples() == 0)
+    {
+    vtkErrorMacro("Build: Input volume has no scalars");
+    return false;
+    }
+  this->Input->GetDimensions(this->LevelsDimensions);
+  double scale = 1.0;
+  double offset = 0.0;
+  bool quantized = vtkFreeSurferQuantizer::GetQuantization(inputScalars, scale, offset);
+
+  // Each level is computed from the previous one, which is 8 times smaller than the level before it
+  std::vector<vtkSmartPointer<vtkImageData> > levels;
+  vtkImageData* previousLevel = this->Input;
+  for (int level = 1; level < this->NumberOfLevels; ++level)
+    {
+    int previousDimensions[3] = { 0, 0, 0 };
+    previousLevel->GetDimensions(previousDimensions);
+    int levelDimensions[3] = { 0, 0, 0 };
+    GetLevelDimensions(this->LevelsDimensions, level, levelDimensions);
+    vtkDataArray* previousScalars = previousLevel->GetPointData()->GetScalars();
+    int numberOfComponents = previousScalars->GetNumberOfComponents();
+
+    vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(previousScalars->NewInstance());
+    scalars->SetName(inputScalars->GetName() ? inputScalars->GetName() : "ImageScalars");
+    scalars->SetNumberOfComponents(numberOfComponents);
+    scalars->SetNumberOfTuples(static_cast<vtkIdType>(levelDimensions[0]) * levelDimensions[1] * levelDimensions[2]);
+    switch (scalars->GetDataType())
+      {
+      vtkTemplateMacro(Downsample(static_cast<const VTK_TT*>(previousScalars->GetVoidPointer(0)), previousDimensions,
+        numberOfComponents, static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), levelDimensions));
+      default:
+        vtkErrorMacro("Build: Unsupported scalar type " << scalars->GetDataTypeAsString());
+        return false;
+      }
+    if (quantized)
+      {
+      // Means of stored values are stored values of the means
+      scalars->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_SCALE(), scale);
+      scalars->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_OFFSET(), offset);
+      }
+
+    vtkSmartPointer<vtkImageData> levelImage = vtkSmartPointer<vtkImageData>::New();
+    levelImage->SetDimensions(levelDimensions);
+    levelImage->GetPointData()->SetScalars(scalars);
+    levels.push_back(levelImage);
+    previousLevel = levelImage;
+    }
+
+  this->Levels = levels;
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferVolumePyramid::Load(const std::string& volumeFileName, const int dimensions[3])
+{
+  vtkDataArray* inputScalars = this->Input ? this->Input->GetPointData()->GetScalars() : nullptr;
+  std::uint32_t volumeFingerprint[4] = { 0, 0, 0, 0 };
+  if (this->NumberOfLevels > 1 && !GetSourceFingerprint(volumeFileName, volumeFingerprint))
+    {
+    return false;
+    }
+  std::vector<vtkSmartPointer<vtkImageData> > levels;
+  for (int level = 1; level < this->NumberOfLevels; ++level)
+    {
+    std::string levelFileName = GetLevelFileName(volumeFileName, level);
+    int volumeIsNewer = 0;
+    if (!vtksys::SystemTools::FileExists(levelFileName, true)
+      || !vtksys::SystemTools::FileTimeCompare(volumeFileName, levelFileName, &volumeIsNewer)
+      || volumeIsNewer > 0)
+      {
+      return false;
+      }
+
+    vtkNew<vtkXMLImageDataReader> reader;
+    reader->SetFileName(levelFileName.c_str());
+    reader->Update();
+    vtkImageData* levelData = reader->GetOutput();
+    vtkDataArray* scalars = levelData->GetPointData()->GetScalars();
+    vtkDataArray* sourceDimensions = levelData->GetFieldData()->GetArray(SourceDimensionsArrayName);
+    int levelDimensions[3] = { 0, 0, 0 };
+    GetLevelDimensions(dimensions, level, levelDimensions);
+    int readDimensions[3] = { 0, 0, 0 };
+    levelData->GetDimensions(readDimensions);
+    if (!scalars || !sourceDimensions || sourceDimensions->GetNumberOfTuples() != 3
+      || !std::equal(levelDimensions, levelDimensions + 3, readDimensions))
+      {
+      return false;
+      }
+    // A volume file replaced within the timestamp resolution has another size or content
+    vtkDataArray* sourceFingerprint = levelData->GetFieldData()->GetArray(SourceFingerprintArrayName);
+    if (!sourceFingerprint || sourceFingerprint->GetNumberOfTuples() != 4)
+      {
+      return false;
+      }
+    for (int i = 0; i < 4; ++i)
+      {
+      if (static_cast<std::uint32_t>(sourceFingerprint->GetTuple1(i)) != volumeFingerprint[i])
+        {
+        return false;
+        }
+      }
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      if (static_cast<int>(sourceDimensions->GetTuple1(axis)) != dimensions[axis])
+        {
+        return false;
+        }
+      }
+    // Levels saved for another storage mode are not used once the volume is read
+    int scalarType = levels.empty() ? scalars->GetDataType()
+      : levels[0]->GetPointData()->GetScalars()->GetDataType();
+    if (scalars->GetDataType() != scalarType || (inputScalars && inputScalars->GetDataType() != scalarType))
+      {
+      return false;
+      }
+
+    vtkDataArray* quantization = levelData->GetFieldData()->GetArray(QuantizationArrayName);
+    if (quantization && quantization->GetNumberOfTuples() == 2)
+      {
+      scalars->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_SCALE(), quantization->GetTuple1(0));
+      scalars->GetInformation()->Set(vtkFreeSurferQuantizer::QUANTIZATION_OFFSET(), quantization->GetTuple1(1));
+      }
+
+    vtkSmartPointer<vtkImageData> levelImage = vtkSmartPointer<vtkImageData>::New();
+    levelImage->SetDimensions(levelDimensions);
+    levelImage->GetPointData()->SetScalars(scalars);
+    levels.push_back(levelImage);
+    }
+
+  std::copy(dimensions, dimensions + 3, this->LevelsDimensions);
+  this->Levels = levels;
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkFreeSurferVolumePyramid::Save(const std::string& volumeFileName)
+{
+  if (this->Levels.empty())
+    {
+    return false;
+    }
+  std::string directory = vtksys::SystemTools::GetFilenamePath(volumeFileName);
+  std::uint32_t volumeFingerprint[4] = { 0, 0, 0, 0 };
+  if (!vtksys::SystemTools::TestFileAccess(directory.empty() ? "." : directory, vtksys::TEST_FILE_WRITE)
+    || !GetSourceFingerprint(volumeFileName, volumeFingerprint))
+    {
+    return false;
+    }
+
+  for (int level = 1; level <= static_cast<int>(this->Levels.size()); ++level)
+    {
+    vtkImageData* levelImage = this->Levels[level - 1];
+    vtkDataArray* scalars = levelImage->GetPointData()->GetScalars();
+    vtkNew<vtkImageData> levelData;
+    levelData->SetDimensions(levelImage->GetDimensions());
+    levelData->GetPointData()->SetScalars(scalars);
+
+    vtkNew<vtkIntArray> sourceDimensions;
+    sourceDimensions->SetName(SourceDimensionsArrayName);
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      sourceDimensions->InsertNextValue(this->LevelsDimensions[axis]);
+      }
+    levelData->GetFieldData()->AddArray(sourceDimensions);
+
+    vtkNew<vtkTypeUInt32Array> sourceFingerprint;
+    sourceFingerprint->SetName(SourceFingerprintArrayName);
+    for (int i = 0; i < 4; ++i)
+      {
+      sourceFingerprint->InsertNextValue(volumeFingerprint[i]);
+      }
+    levelData->GetFieldData()->AddArray(sourceFingerprint);
+
+    // Array information is not written, the quantization of the values is saved with the level
+    double scale = 1.0;
+    double offset = 0.0;
+    if (vtkFreeSurferQuantizer::GetQuantization(scalars, scale, offset))
+      {
+      vtkNew<vtkDoubleArray> quantization;
+      quantization->SetName(QuantizationArrayName);
+      quantization->InsertNextValue(scale);
+      quantization->InsertNextValue(offset);
+      levelData->GetFieldData()->AddArray(quantization);
+      }
+
+    // Written to a temporary file first, so that a concurrent import never reads a partial level
+    std::string levelFileName = GetLevelFileName(volumeFileName, level);
+    std::ostringstream temporaryFileName;
+    temporaryFileName << levelFileName << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+    vtkNew<vtkXMLImageDataWriter> writer;
+    writer->SetFileName(temporaryFileName.str().c_str());
+    writer->SetInputData(levelData);
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    writer->SetCompressorTypeToNone();
+    if (!writer->Write() || !vtksys::SystemTools::RenameFile(temporaryFileName.str(), levelFileName))
+      {
+      vtksys::SystemTools::RemoveFile(temporaryFileName.str());
+      return false;
+      }
+    }
+  return true;
+}
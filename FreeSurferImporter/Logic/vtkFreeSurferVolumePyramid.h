@@ -0,0 +1,112 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkFreeSurferVolumePyramid - downsampled levels of a volume for previews
+// .SECTION Description
+// Builds a resolution pyramid of a volume: each level halves the dimensions of
+// the previous one, every voxel being the mean of the 2x2x2 voxels it covers.
+// The voxels of a level are computed in parallel, in the scalar type of the
+// volume, so that quantized volumes keep their scale and offset. High
+// resolution volumes (0.7 mm or submillimeter) can be shown at a coarse level
+// while the full resolution volume is decoded.
+// Levels can be saved next to the volume file (mri/T1.mgz.pyramid1.vti, ...)
+// and are reused as long as they are newer than the volume, they can be
+// loaded from the dimensions in the header of the volume, before it is read.
+
+#ifndef __vtkFreeSurferVolumePyramid_h
+#define __vtkFreeSurferVolumePyramid_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+class vtkImageData;
+class vtkMatrix4x4;
+
+// STD includes
+#include <string>
+#include <vector>
+
+#include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_LOGIC_EXPORT vtkFreeSurferVolumePyramid : public vtkObject
+{
+public:
+  static vtkFreeSurferVolumePyramid* New();
+  vtkTypeMacro(vtkFreeSurferVolumePyramid, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Full resolution volume, it is level 0.
+  /// Levels that were not built or loaded for the dimensions and scalar type of the volume are cleared.
+  virtual void SetInput(vtkImageData* imageData);
+  vtkGetObjectMacro(Input, vtkImageData);
+
+  /// Number of levels, including the full resolution volume. Default is 3.
+  vtkSetClampMacro(NumberOfLevels, int, 1, 6);
+  vtkGetMacro(NumberOfLevels, int);
+
+  /// Build the coarse levels of the input, the voxels of each level are computed in parallel.
+  /// Returns false if the input has no scalars.
+  bool Build();
+
+  /// Read the coarse levels saved for a volume file of the specified dimensions.
+  /// The input is not needed, so the levels can be shown before the volume is read.
+  /// Returns false if a level is missing, older than the volume file, or does not match the dimensions
+  /// or the size and the hash of the first and last blocks of the volume file saved with it.
+  bool Load(const std::string& volumeFileName, const int dimensions[3]);
+
+  /// Save the coarse levels next to the volume file.
+  /// Returns false if the directory is not writable.
+  bool Save(const std::string& volumeFileName);
+
+  /// Name of the file a level is saved to (e.g. mri/T1.mgz.pyramid1.vti)
+  static std::string GetLevelFileName(const std::string& volumeFileName, int level);
+
+  /// Dimensions of a level of a volume
+  static void GetLevelDimensions(const int dimensions[3], int level, int levelDimensions[3]);
+
+  /// Voxel to RAS transform of a level of a volume. The voxels of a level are centered on the
+  /// voxels of the volume they cover, so that the levels are aligned with the volume.
+  static void GetLevelIJKToRAS(vtkMatrix4x4* ijkToRAS, int level, vtkMatrix4x4* levelIJKToRAS);
+
+  /// Number of levels available, 1 until the levels are built or loaded
+  int GetNumberOfAvailableLevels() const { return static_cast<int>(this->Levels.size()) + 1; }
+
+  /// Get a level, 0 is the input. Returns nullptr if the level is not available.
+  vtkImageData* GetLevel(int level);
+
+protected:
+  vtkFreeSurferVolumePyramid();
+  ~vtkFreeSurferVolumePyramid() override;
+
+  /// Returns true if the levels are for a volume of these dimensions and scalar type
+  bool LevelsMatch(const int dimensions[3], int scalarType) const;
+
+  vtkImageData* Input;
+  int NumberOfLevels;
+
+  /// Coarse levels, starting at level 1
+  std::vector<vtkSmartPointer<vtkImageData> > Levels;
+  /// Dimensions of the full resolution volume of the levels
+  int LevelsDimensions[3];
+
+private:
+  vtkFreeSurferVolumePyramid(const vtkFreeSurferVolumePyramid&); // Not implemented
+  void operator=(const vtkFreeSurferVolumePyramid&); // Not implemented
+};
+
+#endif
@@ -17,314 +17,3559 @@
 
 // FreeSurferImporter Logic includes
 #include "vtkSlicerFreeSurferImporterLogic.h"
+#include "vtkFreeSurferAnnotationReader.h"
+#include "vtkFreeSurferColorLUT.h"
+#include "vtkFreeSurferDecodedDataCache.h"
+#include "vtkFreeSurferGroupOverlay.h"
+#include "vtkFreeSurferHash.h"
+#include "vtkFreeSurferImageHistogram.h"
+#include "vtkFreeSurferLabelStatistics.h"
+#include "vtkFreeSurferLabelSurfaces.h"
+#include "vtkFreeSurferMGHReader.h"
+#include "vtkFreeSurferOverlayReader.h"
+#include "vtkFreeSurferParcelStatistics.h"
+#include "vtkFreeSurferQuantizer.h"
+#include "vtkFreeSurferSphereResampler.h"
+#include "vtkFreeSurferSubjectIndex.h"
+#include "vtkFreeSurferSurfaceLOD.h"
+#include "vtkFreeSurferSurfaceReader.h"
+#include "vtkFreeSurferVolumePyramid.h"
 
 // MRML includes
-#include <vtkMRMLFreeSurferModelStorageNode.h>
+#include <vtkMRMLColorTableNode.h>
+#include <vtkMRMLDisplayNode.h>
 #include <vtkMRMLFreeSurferModelOverlayStorageNode.h>
+#include <vtkMRMLFreeSurferModelStorageNode.h>
+#include <vtkMRMLModelDisplayNode.h>
 #include <vtkMRMLModelNode.h>
 #include <vtkMRMLModelStorageNode.h>
+#include <vtkMRMLScalarVolumeDisplayNode.h>
 #include <vtkMRMLScalarVolumeNode.h>
 #include <vtkMRMLScene.h>
 #include <vtkMRMLSegmentationNode.h>
 #include <vtkMRMLSegmentationStorageNode.h>
+#include <vtkMRMLSliceCompositeNode.h>
+#include <vtkMRMLSliceNode.h>
+#include <vtkMRMLStorableNode.h>
+#include <vtkMRMLStorageNode.h>
+#include <vtkMRMLTableNode.h>
 #include <vtkMRMLVolumeArchetypeStorageNode.h>
 
+// Segmentations includes
+#include <vtkOrientedImageData.h>
+#include <vtkSegment.h>
+#include <vtkSegmentation.h>
+#include <vtkSegmentationConverter.h>
+
+// FreeSurfer includes
+#include <vtkFSSurfaceReader.h>
+
 // VTK includes
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkImageClip.h>
 #include <vtkImageData.h>
 #include <vtkIntArray.h>
+#include <vtkLookupTable.h>
 #include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkObserverManager.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkPolyDataNormals.h>
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
+#include <vtkWeakPointer.h>
 #include <vtksys/SystemTools.hxx>
 
 // STD includes
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <regex>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Polygons shared between surfaces with identical faces (lh.inflated, lh.sphere, lh.orig, ...).
+  /// Shared polygons are read-only, see vtkSlicerFreeSurferImporterLogic::detachSharedSurfaceTopology.
+  class SharedTopologyCache
+  {
+  public:
+    /// Returns a cell array with the same content as polys that is already used by another
+    /// surface, or polys itself if no loaded surface has the same topology.
+    /// This method is thread-safe.
+    vtkSmartPointer<vtkCellArray> GetSharedPolys(vtkIdType numberOfPoints, vtkCellArray* polys)
+    {
+      if (!polys->GetConnectivityArray())
+        {
+        return polys;
+        }
+      TopologyKey key(numberOfPoints, polys->GetNumberOfCells(), HashConnectivity(polys));
+
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      // Release polygons that are only referenced by the cache
+      for (auto it = this->Polys.begin(); it != this->Polys.end();)
+        {
+        if (it->second->GetReferenceCount() == 1)
+          {
+          it = this->Polys.erase(it);
+          }
+        else
+          {
+          ++it;
+          }
+        }
+
+      auto sharedIt = this->Polys.find(key);
+      if (sharedIt != this->Polys.end() && HaveSameConnectivity(sharedIt->second, polys))
+        {
+        return sharedIt->second;
+        }
+      this->Polys[key] = polys;
+      return polys;
+    }
+
+  protected:
+    static std::uint64_t HashConnectivity(vtkCellArray* polys)
+    {
+      vtkDataArray* connectivity = polys->GetConnectivityArray();
+      size_t size = static_cast<size_t>(connectivity->GetNumberOfValues()) * connectivity->GetDataTypeSize();
+      return vtkFreeSurferHash::HashBytes(connectivity->GetVoidPointer(0), size);
+    }
+
+    static bool HaveSameConnectivity(vtkCellArray* polys1, vtkCellArray* polys2)
+    {
+      vtkDataArray* connectivity1 = polys1->GetConnectivityArray();
+      vtkDataArray* connectivity2 = polys2->GetConnectivityArray();
+      if (connectivity1->GetDataType() != connectivity2->GetDataType()
+        || connectivity1->GetNumberOfValues() != connectivity2->GetNumberOfValues())
+        {
+        return false;
+        }
+      size_t size = static_cast<size_t>(connectivity1->GetNumberOfValues()) * connectivity1->GetDataTypeSize();
+      return memcmp(connectivity1->GetVoidPointer(0), connectivity2->GetVoidPointer(0), size) == 0;
+    }
+
+    /// Number of vertices, number of faces and connectivity hash
+    typedef std::tuple<vtkIdType, vtkIdType, std::uint64_t> TopologyKey;
+
+    std::mutex Mutex;
+    std::map<TopologyKey, vtkSmartPointer<vtkCellArray> > Polys;
+  };
+}
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Spatial indices of target spheres and mappings of subject spheres onto them
+  class SphereResamplerCache
+  {
+  public:
+    typedef vtkFreeSurferSphereResampler::Mapping Mapping;
+
+    /// Returns the mapping of a registered subject sphere onto a target sphere.
+    /// The target sphere is indexed on first use. The mapping is reused if it was computed recently
+    /// and neither sphere file was modified since. Threads that ask for a mapping that is being
+    /// computed wait for it instead of computing it again.
+    /// This method is thread-safe.
+    std::shared_ptr<const Mapping> GetMapping(const std::string& sourceSphereFile, const std::string& targetSphereFile,
+      vtkFreeSurferDecodedDataCache* cache,
+      std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportStageMeasurement>* measurements);
+
+    /// Release all target indices and mappings
+    void Clear();
+
+  protected:
+    /// Spatial index of a target sphere. It has its own mutex, so that the cache is not locked
+    /// while a target is indexed and threads resampling onto other targets are not blocked.
+    struct Target
+      {
+      std::mutex Mutex;
+      long int ModifiedTime = 0;
+      vtkSmartPointer<vtkFreeSurferSphereResampler> Resampler;
+      };
+
+    struct MappingEntry
+      {
+      std::string SourceSphereFile;
+      long int SourceModifiedTime = 0;
+      std::string TargetSphereFile;
+      long int TargetModifiedTime = 0;
+      std::shared_ptr<const Mapping> SharedMapping;
+      double Megabytes = 0.0;
+      };
+
+    /// A mapping onto fsaverage takes about 6 MB, this keeps both hemispheres of a few subjects,
+    /// enough to resample several overlays of the subjects without computing their mappings again.
+    static constexpr double MaximumMappingsMegabytes = 64.0;
+
+    std::shared_ptr<const Mapping> ComputeMapping(const std::string& sourceSphereFile, const std::string& targetSphereFile,
+      long int targetModifiedTime, std::shared_ptr<Target> target, vtkFreeSurferDecodedDataCache* cache,
+      std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportStageMeasurement>* measurements);
+
+    typedef std::pair<std::string, std::string> SphereFiles;
+
+    std::mutex Mutex;
+    /// Targets, by target sphere file
+    std::map<std::string, std::shared_ptr<Target> > Targets;
+    /// Most recently used first
+    std::list<MappingEntry> Mappings;
+    double MappingsMegabytes = 0.0;
+    /// Mappings being computed, by source and target sphere file
+    std::map<SphereFiles, std::shared_future<std::shared_ptr<const Mapping> > > PendingMappings;
+  };
+}
+
+//----------------------------------------------------------------------------
+class vtkSlicerFreeSurferImporterLogic::vtkInternal
+{
+public:
+  SharedTopologyCache Topologies;
+
+  /// Topology cache to read a surface with, nullptr if the surface keeps its own polygons.
+  /// White and pial surfaces are the ones edited in place (e.g. by surface correction tools),
+  /// so they never share their polygons with the other surfaces of the hemisphere.
+  SharedTopologyCache* GetSharedTopologies(bool shareSurfaceTopology, const std::string& fileName)
+    {
+    std::string extension = vtksys::SystemTools::GetFilenameLastExtension(fileName);
+    if (!shareSurfaceTopology || extension == ".white" || extension == ".pial")
+      {
+      return nullptr;
+      }
+    return &this->Topologies;
+    }
+
+  SphereResamplerCache SphereResamplers;
+
+  /// Indices of the recently used subject directories and their full path, most recently used first
+  std::list<std::pair<std::string, vtkSmartPointer<vtkFreeSurferSubjectIndex> > > SubjectIndices;
+  /// Enough to switch between the subjects of a study without scanning them again
+  static const size_t MaximumNumberOfSubjectIndices = 8;
+
+  /// A node whose data is decoded on demand
+  struct Placeholder
+    {
+    FreeSurferImportItem Item;
+    int NumberOfVertices = 0;
+    /// Overlays to apply when the surface is decoded
+    std::vector<FreeSurferImportItem> Overlays;
+    };
+  /// Placeholder nodes, by node ID
+  std::map<std::string, Placeholder> Placeholders;
+  /// Overlays decoded for placeholders, so that both surfaces of a hemisphere share them
+  std::map<std::string, vtkWeakPointer<vtkDataArray> > PlaceholderOverlays;
+  /// Color table nodes of the annotations decoded for placeholders, by file
+  std::map<std::string, std::string> PlaceholderColorTableNodeIDs;
+
+  /// Levels of detail of the models, by node ID
+  std::map<std::string, vtkSmartPointer<vtkFreeSurferSurfaceLOD> > SurfaceLevelsOfDetail;
+
+  /// Pyramid of a volume and the voxel to RAS transform of its full resolution level
+  struct VolumeLevels
+    {
+    vtkSmartPointer<vtkFreeSurferVolumePyramid> Pyramid;
+    vtkSmartPointer<vtkMatrix4x4> IJKToRAS;
+    };
+  /// Pyramids of the volumes, by node ID
+  std::map<std::string, VolumeLevels> VolumePyramids;
+
+  /// Quantized array replaced by its original values while the scene is saved
+  struct SavedQuantizedArray
+    {
+    vtkSmartPointer<vtkDataSetAttributes> Attributes;
+    vtkSmartPointer<vtkDataArray> StoredValues;
+    vtkSmartPointer<vtkDataArray> OriginalValues;
+    };
+  std::vector<SavedQuantizedArray> SavedQuantizedArrays;
+
+  /// Measurements since the last clearFreeSurferImportReport, only accessed from the main thread
+  std::deque<FreeSurferImportStageMeasurement> Report;
+  /// The oldest measurements are dropped beyond this, so that long headless sessions that never
+  /// clear the report do not grow it without bound
+  static const size_t MaximumNumberOfImportMeasurements = 10000;
+
+  /// State of the background import
+  std::vector<FreeSurferImportItem> Items;
+  std::vector<unsigned long> FileSizes;
+  std::thread ReadThread;
+  std::atomic<bool> CancelRequested{ false };
+  std::atomic<bool> ReadFinished{ true };
+  std::atomic<int> NumberOfFilesRead{ 0 };
+  std::atomic<unsigned long long> BytesRead{ 0 };
+  std::chrono::steady_clock::time_point StartTime;
+
+  /// Items that have been read but not added to the scene yet
+  std::mutex ReadItemsMutex;
+  std::deque<int> ReadItems;
+  /// Items taken by a worker, protected by ReadItemsMutex
+  std::vector<bool> ItemsClaimed;
+  /// Volumes whose full resolution was requested by setFreeSurferVolumeLevel, read before the other items.
+  /// Protected by ReadItemsMutex.
+  std::deque<int> PriorityItems;
+  /// Preview levels built by a worker after the volume was read
+  struct BuiltVolumeLevels
+    {
+    int Index = -1;
+    vtkSmartPointer<vtkFreeSurferVolumePyramid> Pyramid;
+    std::vector<FreeSurferImportStageMeasurement> Measurements;
+    };
+  /// Levels that have been built but not used by the volume nodes yet, protected by ReadItemsMutex
+  std::deque<BuiltVolumeLevels> BuiltLevels;
+
+  /// Only accessed from the main thread
+  bool Running = false;
+  std::vector<int> PendingOverlays;
+  std::vector<vtkWeakPointer<vtkMRMLModelNode> > ModelNodes;
+  /// A volume shown at a coarse level until its full resolution is added
+  struct PreviewVolume
+    {
+    vtkWeakPointer<vtkMRMLScalarVolumeNode> Node;
+    /// Set if the full resolution was moved to the front of the worker queue by setFreeSurferVolumeLevel
+    bool FullResolutionRequested = false;
+    };
+  /// Preview volumes of the import, by item index
+  std::map<int, PreviewVolume> PreviewVolumes;
+  int NumberOfFilesCompleted = 0;
+  int NumberOfFilesFailed = 0;
+  /// Overlays and annotations that were read but not added because the import was canceled
+  int NumberOfOverlaysDropped = 0;
+  std::string LastCompletedFileName;
+  /// Volume nodes of the import, by item index, that the levels built by the workers are given to
+  std::map<int, vtkWeakPointer<vtkMRMLScalarVolumeNode> > VolumeNodes;
+
+  /// Take an item for a worker. Returns false if another worker already took it.
+  bool ClaimItem(int index)
+  {
+    std::lock_guard<std::mutex> lock(this->ReadItemsMutex);
+    if (this->ItemsClaimed[index])
+      {
+      return false;
+      }
+    this->ItemsClaimed[index] = true;
+    return true;
+  }
+
+  /// Take the first requested item that no worker took yet. Returns -1 if there is none.
+  int ClaimPriorityItem()
+  {
+    std::lock_guard<std::mutex> lock(this->ReadItemsMutex);
+    while (!this->PriorityItems.empty())
+      {
+      int index = this->PriorityItems.front();
+      this->PriorityItems.pop_front();
+      if (!this->ItemsClaimed[index])
+        {
+        this->ItemsClaimed[index] = true;
+        return index;
+        }
+      }
+    return -1;
+  }
+
+  void JoinReadThread()
+  {
+    if (this->ReadThread.joinable())
+      {
+      this->ReadThread.join();
+      }
+  }
+};
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerFreeSurferImporterLogic);
 
+//----------------------------------------------------------------------------
+const char* vtkSlicerFreeSurferImporterLogic::DefaultColorLUTName = "FreeSurferColorLUT";
+const char* vtkSlicerFreeSurferImporterLogic::PlaceholderAttributeName = "FreeSurferImporter.Placeholder";
+
+namespace
+{
+  typedef std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportStageMeasurement> MeasurementList;
+
+  //----------------------------------------------------------------------------
+  /// Measures the stages of the import of a file.
+  /// Nothing is recorded if no measurement list is specified.
+  class StageTimer
+  {
+  public:
+    StageTimer(MeasurementList* measurements, const std::string& fileName)
+      : Measurements(measurements)
+      , FileName(fileName)
+      , Start(std::chrono::steady_clock::now())
+    {
+    }
+
+    /// Time since construction or the last call to Restart
+    double GetElapsedSeconds() const
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->Start).count();
+    }
+
+    void Restart()
+    {
+      this->Start = std::chrono::steady_clock::now();
+    }
+
+    void Add(int stage, double seconds, double megabytesRead = 0.0, double megabytesAllocated = 0.0)
+    {
+      if (!this->Measurements)
+        {
+        return;
+        }
+      vtkSlicerFreeSurferImporterLogic::FreeSurferImportStageMeasurement measurement;
+      measurement.Stage = stage;
+      measurement.FileName = this->FileName;
+      measurement.Seconds = std::max(0.0, seconds);
+      measurement.MegabytesRead = megabytesRead;
+      measurement.MegabytesAllocated = megabytesAllocated;
+      this->Measurements->push_back(measurement);
+    }
+
+    /// Add the time since the last restart as a measurement and restart
+    void Stop(int stage, double megabytesRead = 0.0, double megabytesAllocated = 0.0)
+    {
+      this->Add(stage, this->GetElapsedSeconds(), megabytesRead, megabytesAllocated);
+      this->Restart();
+    }
+
+  protected:
+    MeasurementList* Measurements;
+    std::string FileName;
+    std::chrono::steady_clock::time_point Start;
+  };
+
+  //----------------------------------------------------------------------------
+  double GetFileMegabytes(const std::string& fileName)
+  {
+    return vtksys::SystemTools::FileLength(fileName) / (1024.0 * 1024.0);
+  }
+
+  //----------------------------------------------------------------------------
+  /// File of a node for the import report, or its name if it is not stored in a file
+  std::string GetNodeFileName(vtkMRMLNode* node)
+  {
+    vtkMRMLStorableNode* storableNode = vtkMRMLStorableNode::SafeDownCast(node);
+    vtkMRMLStorageNode* storageNode = storableNode ? storableNode->GetStorageNode() : nullptr;
+    if (storageNode && storageNode->GetFileName())
+      {
+      return storageNode->GetFileName();
+      }
+    return node && node->GetName() ? node->GetName() : "";
+  }
+
+  //----------------------------------------------------------------------------
+  /// Memory used by a data object or array (GetActualMemorySize is in kibibytes)
+  template<typename T>
+  double GetMegabytes(T* data)
+  {
+    return data ? data->GetActualMemorySize() / 1024.0 : 0.0;
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadMGHImage(const std::string& fileName, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS,
+    vtkFreeSurferDecodedDataCache* cache, MeasurementList* measurements = nullptr)
+  {
+    StageTimer timer(measurements, fileName);
+    bool compressed = vtkFreeSurferMGHReader::IsCompressedFile(fileName);
+    // Uncompressed volumes are mapped by the reader, a cache entry would only duplicate them
+    if (!compressed)
+      {
+      cache = nullptr;
+      }
+    if (cache && cache->LoadImage(fileName, imageData, ijkToRAS))
+      {
+      timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetMegabytes(imageData), GetMegabytes(imageData));
+      return true;
+      }
+
+    vtkNew<vtkFreeSurferMGHReader> reader;
+    reader->SetFileName(fileName.c_str());
+    reader->Update();
+    if (!reader->GetOutput()->GetPointData()->GetScalars())
+      {
+      return false;
+      }
+
+    // Detach the image from the reader pipeline, the voxel buffer itself is not copied
+    imageData->ShallowCopy(reader->GetOutput());
+    ijkToRAS->DeepCopy(reader->GetIJKToRASMatrix());
+    if (cache)
+      {
+      cache->StoreImage(fileName, imageData, ijkToRAS);
+      }
+
+    // Storing the cache entry is accounted to reading, it is only done when the file is decompressed
+    double byteSwapSeconds = reader->GetByteSwapSeconds();
+    timer.Add(compressed ? vtkSlicerFreeSurferImporterLogic::DecompressionStage : vtkSlicerFreeSurferImporterLogic::ReadStage,
+      timer.GetElapsedSeconds() - byteSwapSeconds, GetFileMegabytes(fileName), GetMegabytes(imageData));
+    timer.Add(vtkSlicerFreeSurferImporterLogic::ByteSwapStage, byteSwapSeconds);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void TransformPolyData(vtkPolyData* polyData, vtkMatrix4x4* matrix)
+  {
+    vtkNew<vtkTransform> transform;
+    transform->SetMatrix(matrix);
+
+    vtkNew<vtkTransformPolyDataFilter> transformer;
+    transformer->SetTransform(transform);
+    transformer->SetInputData(polyData);
+    transformer->Update();
+    polyData->ShallowCopy(transformer->GetOutput());
+    polyData->Modified();
+  }
+
+  //----------------------------------------------------------------------------
+  /// Read the points and faces of a surface file, timed as reading and byte swapping
+  vtkSmartPointer<vtkPolyData> ReadSurfaceFile(const std::string& fileName, StageTimer& timer)
+  {
+    vtkSmartPointer<vtkPolyDataAlgorithm> reader;
+    if (vtkFreeSurferSurfaceReader::IsTriangleFile(fileName))
+      {
+      vtkNew<vtkFreeSurferSurfaceReader> surfaceReader;
+      surfaceReader->SetFileName(fileName.c_str());
+      reader = surfaceReader.GetPointer();
+      }
+    else
+      {
+      // Legacy quadrangle surfaces
+      vtkNew<vtkFSSurfaceReader> surfaceReader;
+      surfaceReader->SetFileName(fileName.c_str());
+      reader = surfaceReader.GetPointer();
+      }
+    reader->Update();
+    vtkFreeSurferSurfaceReader* triangleReader = vtkFreeSurferSurfaceReader::SafeDownCast(reader);
+    double byteSwapSeconds = triangleReader ? triangleReader->GetByteSwapSeconds() : 0.0;
+    timer.Add(vtkSlicerFreeSurferImporterLogic::ReadStage, timer.GetElapsedSeconds() - byteSwapSeconds,
+      GetFileMegabytes(fileName), GetMegabytes(reader->GetOutput()));
+    timer.Add(vtkSlicerFreeSurferImporterLogic::ByteSwapStage, byteSwapSeconds);
+    timer.Restart();
+    return reader->GetOutput();
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadSurface(const std::string& fileName, vtkMatrix4x4* surfaceToRAS, vtkPolyData* surface,
+    SharedTopologyCache* topologies, vtkFreeSurferDecodedDataCache* cache, vtkFreeSurferSurfaceLOD* levelsOfDetail = nullptr,
+    MeasurementList* measurements = nullptr)
+  {
+    StageTimer timer(measurements, fileName);
+    double processingMegabytes = 0.0;
+    if (cache && cache->LoadSurface(fileName, surface))
+      {
+      timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetMegabytes(surface), GetMegabytes(surface));
+      }
+    else
+      {
+      vtkSmartPointer<vtkPolyData> surfaceData = ReadSurfaceFile(fileName, timer);
+      vtkNew<vtkPolyDataNormals> normals;
+      normals->SetInputData(surfaceData);
+      normals->SplittingOff();
+      // FreeSurfer surfaces are closed and consistently oriented
+      normals->ConsistencyOff();
+      normals->Update();
+      if (normals->GetOutput()->GetNumberOfPoints() == 0)
+        {
+        return false;
+        }
+
+      surface->ShallowCopy(normals->GetOutput());
+      processingMegabytes += GetMegabytes(surface->GetPointData()->GetNormals());
+      if (cache)
+        {
+        cache->StoreSurface(fileName, surface);
+        }
+      }
+
+    if (levelsOfDetail)
+      {
+      // Levels are kept in surface coordinates next to the surface and transformed with it
+      levelsOfDetail->SetInput(surface);
+      if (!levelsOfDetail->Load(fileName) && levelsOfDetail->Build())
+        {
+        levelsOfDetail->Save(fileName);
+        }
+      for (int level = 1; level < levelsOfDetail->GetNumberOfAvailableLevels(); ++level)
+        {
+        processingMegabytes += GetMegabytes(levelsOfDetail->GetLevel(level));
+        }
+      }
+    if (topologies)
+      {
+      // Neither the normals nor the RAS transform change the faces, so the polygons
+      // can be replaced by the ones of a surface with the same topology
+      surface->SetPolys(topologies->GetSharedPolys(surface->GetNumberOfPoints(), surface->GetPolys()));
+      }
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::SurfaceProcessingStage, 0.0, processingMegabytes);
+    if (surfaceToRAS)
+      {
+      TransformPolyData(surface, surfaceToRAS);
+      for (int level = 1; levelsOfDetail && level < levelsOfDetail->GetNumberOfAvailableLevels(); ++level)
+        {
+        TransformPolyData(levelsOfDetail->GetLevel(level), surfaceToRAS);
+        }
+      timer.Stop(vtkSlicerFreeSurferImporterLogic::TransformStage, 0.0, GetMegabytes(surface->GetPoints()->GetData()));
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Read a sphere for resampling. The resampler only uses the points and faces: spheres that
+  /// are not already decoded are read without normals and are not added to the decoded data cache.
+  bool ReadSphere(const std::string& fileName, vtkPolyData* sphere, vtkFreeSurferDecodedDataCache* cache,
+    MeasurementList* measurements)
+  {
+    StageTimer timer(measurements, fileName);
+    if (cache && cache->LoadSurface(fileName, sphere))
+      {
+      timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetMegabytes(sphere), GetMegabytes(sphere));
+      return true;
+      }
+    vtkSmartPointer<vtkPolyData> sphereData = ReadSurfaceFile(fileName, timer);
+    if (sphereData->GetNumberOfPoints() == 0)
+      {
+      return false;
+      }
+    sphere->ShallowCopy(sphereData);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Overlays and annotations have one value per vertex and are added after the surfaces
+  bool IsPerVertexFileType(int type)
+  {
+    return type == vtkSlicerFreeSurferImporterLogic::ScalarOverlayFile
+      || type == vtkSlicerFreeSurferImporterLogic::AnnotationFile;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<unsigned long> GetFileSizes(const std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem>& items)
+  {
+    std::vector<unsigned long> fileSizes;
+    for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : items)
+      {
+      fileSizes.push_back(vtksys::SystemTools::FileLength(item.Directory + item.Name));
+      }
+    return fileSizes;
+  }
+
+  //----------------------------------------------------------------------------
+  // Start with the largest files so that the workers finish at about the same time
+  std::vector<int> GetLargestFirstOrder(const std::vector<unsigned long>& fileSizes)
+  {
+    std::vector<int> itemOrder;
+    for (size_t i = 0; i < fileSizes.size(); ++i)
+      {
+      itemOrder.push_back(static_cast<int>(i));
+      }
+    std::stable_sort(itemOrder.begin(), itemOrder.end(),
+      [&fileSizes](int a, int b) { return fileSizes[a] > fileSizes[b]; });
+    return itemOrder;
+  }
+
+  //----------------------------------------------------------------------------
+  int GetNumberOfWorkerThreads(int requestedNumberOfThreads)
+  {
+    if (requestedNumberOfThreads > 0)
+      {
+      return requestedNumberOfThreads;
+      }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  //----------------------------------------------------------------------------
+  /// Run the function for each item index on a pool of worker threads.
+  /// Items are handed out one at a time, in the order given by itemOrder.
+  void RunInParallel(const std::vector<int>& itemOrder, int numberOfThreads, const std::function<void(int)>& function)
+  {
+    std::atomic<size_t> nextItem(0);
+    auto worker = [&]()
+      {
+      for (size_t i = nextItem++; i < itemOrder.size(); i = nextItem++)
+        {
+        function(itemOrder[i]);
+        }
+      };
+
+    int numberOfWorkers = std::min(numberOfThreads, static_cast<int>(itemOrder.size()));
+    std::vector<std::thread> workers;
+    for (int i = 1; i < numberOfWorkers; ++i)
+      {
+      workers.emplace_back(worker);
+      }
+    worker();
+    for (std::thread& thread : workers)
+      {
+      thread.join();
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Point the model to the surface file it was read from, as if the FreeSurfer model storage node had read it
+  void AddFreeSurferModelStorageNode(vtkMRMLScene* scene, vtkMRMLModelNode* modelNode, const std::string& surfaceFile)
+  {
+    vtkMRMLFreeSurferModelStorageNode* storageNode = vtkMRMLFreeSurferModelStorageNode::SafeDownCast(
+      scene->AddNewNodeByClass("vtkMRMLFreeSurferModelStorageNode"));
+    if (storageNode)
+      {
+      storageNode->SetFileName(surfaceFile.c_str());
+      modelNode->SetAndObserveStorageNodeID(storageNode->GetID());
+      }
+  }
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Values of a volume or overlay in the storage mode of the logic.
+  /// Returns the values unchanged if they are stored in full precision, or if their type is not larger than the
+  /// quantized type (e.g. UCHAR volumes).
+  vtkSmartPointer<vtkDataArray> GetStoredValues(const std::string& fileName, vtkDataArray* values, int storageMode,
+    MeasurementList* measurements)
+  {
+    if (storageMode == vtkFreeSurferQuantizer::FullPrecision)
+      {
+      return values;
+      }
+    StageTimer timer(measurements, fileName);
+    vtkSmartPointer<vtkDataArray> quantized = vtkFreeSurferQuantizer::Quantize(values, storageMode);
+    if (!quantized)
+      {
+      return values;
+      }
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::QuantizationStage, 0.0, GetMegabytes(quantized.GetPointer()));
+    return quantized;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Only floating-point volumes are quantized: integer volumes are label volumes (aseg, aparc+aseg, wmparc, ...)
+  /// whose labels would be merged, or conformed UCHAR volumes that are already small
+  void SetStoredScalars(const std::string& fileName, vtkImageData* imageData, int storageMode, MeasurementList* measurements)
+  {
+    vtkDataArray* scalars = imageData->GetPointData()->GetScalars();
+    if (!scalars || (scalars->GetDataType() != VTK_FLOAT && scalars->GetDataType() != VTK_DOUBLE))
+      {
+      return;
+      }
+    vtkSmartPointer<vtkDataArray> storedScalars = GetStoredValues(fileName, scalars, storageMode, measurements);
+    if (storedScalars != scalars)
+      {
+      imageData->GetPointData()->SetScalars(storedScalars);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Preview levels of a volume, loaded if they were saved next to the volume file,
+  /// built and saved otherwise. Returns nullptr if numberOfLevels is less than 2.
+  vtkSmartPointer<vtkFreeSurferVolumePyramid> GetVolumePyramid(const std::string& fileName, vtkImageData* imageData,
+    int numberOfLevels, MeasurementList* measurements)
+  {
+    if (numberOfLevels < 2)
+      {
+      return nullptr;
+      }
+    StageTimer timer(measurements, fileName);
+    vtkSmartPointer<vtkFreeSurferVolumePyramid> pyramid = vtkSmartPointer<vtkFreeSurferVolumePyramid>::New();
+    pyramid->SetNumberOfLevels(numberOfLevels);
+    pyramid->SetInput(imageData);
+    int dimensions[3] = { 0, 0, 0 };
+    imageData->GetDimensions(dimensions);
+    bool loaded = pyramid->Load(fileName, dimensions);
+    if (!loaded && !pyramid->Build())
+      {
+      return nullptr;
+      }
+    double levelsMegabytes = 0.0;
+    for (int level = 1; level < pyramid->GetNumberOfAvailableLevels(); ++level)
+      {
+      levelsMegabytes += GetMegabytes(pyramid->GetLevel(level));
+      }
+    if (!loaded)
+      {
+      // Built once, the next imports of the volume show the saved levels before it is decoded
+      pyramid->Save(fileName);
+      }
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::PreviewStage, loaded ? levelsMegabytes : 0.0, levelsMegabytes);
+    return pyramid;
+  }
+
+  //----------------------------------------------------------------------------
+  void SetQuantizationAttributes(vtkMRMLScalarVolumeNode* volumeNode, vtkImageData* imageData)
+  {
+    double scale = 1.0;
+    double offset = 0.0;
+    if (!vtkFreeSurferQuantizer::GetQuantization(imageData->GetPointData()->GetScalars(), scale, offset))
+      {
+      volumeNode->RemoveAttribute("FreeSurferImporter.ValueScale");
+      volumeNode->RemoveAttribute("FreeSurferImporter.ValueOffset");
+      return;
+      }
+    // Voxel values are stored values, the original values are stored * scale + offset
+    std::ostringstream scaleStream;
+    scaleStream << std::setprecision(17) << scale;
+    std::ostringstream offsetStream;
+    offsetStream << std::setprecision(17) << offset;
+    volumeNode->SetAttribute("FreeSurferImporter.ValueScale", scaleStream.str().c_str());
+    volumeNode->SetAttribute("FreeSurferImporter.ValueOffset", offsetStream.str().c_str());
+  }
+
+  //----------------------------------------------------------------------------
+  /// Returns true if the volume is a layer of the slice view of the slice node
+  bool IsShownInSliceView(vtkMRMLScene* scene, vtkMRMLSliceNode* sliceNode, vtkMRMLNode* volumeNode)
+  {
+    const char* layoutName = sliceNode->GetLayoutName();
+    const char* volumeNodeID = volumeNode->GetID();
+    if (!layoutName || !volumeNodeID)
+      {
+      return false;
+      }
+    std::vector<vtkMRMLNode*> compositeNodes;
+    scene->GetNodesByClass("vtkMRMLSliceCompositeNode", compositeNodes);
+    for (vtkMRMLNode* node : compositeNodes)
+      {
+      vtkMRMLSliceCompositeNode* compositeNode = vtkMRMLSliceCompositeNode::SafeDownCast(node);
+      if (!compositeNode->GetLayoutName() || strcmp(compositeNode->GetLayoutName(), layoutName) != 0)
+        {
+        continue;
+        }
+      const char* layerVolumeNodeIDs[3] =
+        {
+        compositeNode->GetBackgroundVolumeID(),
+        compositeNode->GetForegroundVolumeID(),
+        compositeNode->GetLabelVolumeID()
+        };
+      for (const char* layerVolumeNodeID : layerVolumeNodeIDs)
+        {
+        if (layerVolumeNodeID && strcmp(layerVolumeNodeID, volumeNodeID) == 0)
+          {
+          return true;
+          }
+        }
+      }
+    return false;
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkSlicerFreeSurferImporterLogic::vtkSlicerFreeSurferImporterLogic()
+  : NumberOfThreads(0)
+  , ShareSurfaceTopology(true)
+  , LazyLoading(false)
+  , NumberOfSurfaceLevelsOfDetail(1)
+  , NumberOfVolumePreviewLevels(1)
+  , LabelModelSmoothingFactor(0.5)
+  , StorageMode(vtkFreeSurferQuantizer::FullPrecision)
+  , DecodedDataCache(vtkFreeSurferDecodedDataCache::New())
+  , Internal(new vtkInternal())
+{
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerFreeSurferImporterLogic::~vtkSlicerFreeSurferImporterLogic()
+{
+  this->Internal->CancelRequested = true;
+  this->Internal->JoinReadThread();
+  delete this->Internal;
+  this->DecodedDataCache->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "ShareSurfaceTopology: " << (this->ShareSurfaceTopology ? "true" : "false") << std::endl;
+  os << indent << "LazyLoading: " << (this->LazyLoading ? "true" : "false") << std::endl;
+  os << indent << "NumberOfPlaceholderNodes: " << this->Internal->Placeholders.size() << std::endl;
+  os << indent << "NumberOfSurfaceLevelsOfDetail: " << this->NumberOfSurfaceLevelsOfDetail << std::endl;
+  os << indent << "NumberOfVolumePreviewLevels: " << this->NumberOfVolumePreviewLevels << std::endl;
+  os << indent << "LabelModelSmoothingFactor: " << this->LabelModelSmoothingFactor << std::endl;
+  os << indent << "StorageMode: " << this->StorageMode << std::endl;
+  os << indent << "NumberOfImportMeasurements: " << this->Internal->Report.size() << std::endl;
+  os << indent << "DecodedDataCache:" << std::endl;
+  this->DecodedDataCache->PrintSelf(os, indent.GetNextIndent());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  events->InsertNextValue(vtkMRMLScene::StartSaveEvent);
+  events->InsertNextValue(vtkMRMLScene::EndSaveEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+
+  // Placeholder volumes are decoded when they are shown in a slice view,
+  // preview volumes when a slice view showing them is zoomed in
+  this->Internal->Placeholders.clear();
+  std::vector<vtkMRMLNode*> sliceViewNodes;
+  if (newScene)
+    {
+    newScene->GetNodesByClass("vtkMRMLSliceCompositeNode", sliceViewNodes);
+    std::vector<vtkMRMLNode*> sliceNodes;
+    newScene->GetNodesByClass("vtkMRMLSliceNode", sliceNodes);
+    sliceViewNodes.insert(sliceViewNodes.end(), sliceNodes.begin(), sliceNodes.end());
+    }
+  for (vtkMRMLNode* sliceViewNode : sliceViewNodes)
+    {
+    this->OnMRMLSceneNodeAdded(sliceViewNode);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::RegisterNodes()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::UpdateFromMRMLScene()
+{
+  assert(this->GetMRMLScene() != 0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::ProcessMRMLSceneEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+  if (event == vtkMRMLScene::StartSaveEvent)
+    {
+    this->dequantizeFreeSurferNodesForSave();
+    }
+  else if (event == vtkMRMLScene::EndSaveEvent)
+    {
+    this->restoreFreeSurferQuantizedNodes();
+    }
+  this->Superclass::ProcessMRMLSceneEvents(caller, event, callData);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::dequantizeFreeSurferNodesForSave()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+    {
+    return;
+    }
+  std::vector<vtkMRMLNode*> nodes;
+  scene->GetNodesByClass("vtkMRMLScalarVolumeNode", nodes);
+  std::vector<vtkMRMLNode*> modelNodes;
+  scene->GetNodesByClass("vtkMRMLModelNode", modelNodes);
+  nodes.insert(nodes.end(), modelNodes.begin(), modelNodes.end());
+  for (vtkMRMLNode* node : nodes)
+    {
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+    vtkDataSet* data = volumeNode ? vtkDataSet::SafeDownCast(volumeNode->GetImageData())
+      : vtkDataSet::SafeDownCast(modelNode ? modelNode->GetPolyData() : nullptr);
+    vtkPointData* pointData = data ? data->GetPointData() : nullptr;
+    for (int i = 0; pointData && i < pointData->GetNumberOfArrays(); ++i)
+      {
+      vtkDataArray* storedValues = pointData->GetArray(i);
+      vtkSmartPointer<vtkFloatArray> originalValues = vtkFreeSurferQuantizer::Dequantize(storedValues);
+      if (!originalValues)
+        {
+        continue;
+        }
+      vtkInternal::SavedQuantizedArray savedArray;
+      savedArray.Attributes = pointData;
+      savedArray.StoredValues = storedValues;
+      savedArray.OriginalValues = originalValues;
+      this->Internal->SavedQuantizedArrays.push_back(savedArray);
+      // Arrays with the same name are replaced in place, so the active scalars stay active
+      if (storedValues == pointData->GetScalars() && !storedValues->GetName())
+        {
+        pointData->SetScalars(originalValues);
+        }
+      else
+        {
+        pointData->AddArray(originalValues);
+        }
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::restoreFreeSurferQuantizedNodes()
 {
+  for (const vtkInternal::SavedQuantizedArray& savedArray : this->Internal->SavedQuantizedArrays)
+    {
+    vtkDataSetAttributes* attributes = savedArray.Attributes;
+    vtkDataArray* originalValues = savedArray.OriginalValues;
+    if (attributes->GetScalars() == originalValues)
+      {
+      attributes->SetScalars(savedArray.StoredValues);
+      }
+    else if (originalValues->GetName() && attributes->GetArray(originalValues->GetName()) == originalValues)
+      {
+      attributes->AddArray(savedArray.StoredValues);
+      }
+    }
+  this->Internal->SavedQuantizedArrays.clear();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic
+::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  if (vtkMRMLSliceCompositeNode::SafeDownCast(node) || vtkMRMLSliceNode::SafeDownCast(node))
+    {
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue(vtkCommand::ModifiedEvent);
+    this->GetMRMLNodesObserverManager()->AddObjectEvents(node, events);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic
+::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  if (node && node->GetID())
+    {
+    this->Internal->Placeholders.erase(node->GetID());
+    this->Internal->SurfaceLevelsOfDetail.erase(node->GetID());
+    this->Internal->VolumePyramids.erase(node->GetID());
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+  if (event == vtkMRMLDisplayableNode::DisplayModifiedEvent)
+    {
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(caller);
+    if (volumeNode)
+      {
+      this->GetMRMLNodesObserverManager()->RemoveObjectEvents(volumeNode);
+      this->loadFreeSurferPlaceholderNode(volumeNode);
+      }
+    return;
+    }
+
+  if (event != vtkCommand::ModifiedEvent || !this->GetMRMLScene()
+    || (this->Internal->Placeholders.empty() && this->Internal->PreviewVolumes.empty()))
+    {
+    this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
+    return;
+    }
+
+  vtkMRMLSliceCompositeNode* compositeNode = vtkMRMLSliceCompositeNode::SafeDownCast(caller);
+  if (compositeNode)
+    {
+    const char* volumeNodeIDs[3] =
+      {
+      compositeNode->GetBackgroundVolumeID(),
+      compositeNode->GetForegroundVolumeID(),
+      compositeNode->GetLabelVolumeID()
+      };
+    for (const char* volumeNodeID : volumeNodeIDs)
+      {
+      vtkMRMLNode* volumeNode = volumeNodeID ? this->GetMRMLScene()->GetNodeByID(volumeNodeID) : nullptr;
+      if (this->isFreeSurferPlaceholderNode(volumeNode))
+        {
+        this->loadFreeSurferPlaceholderNode(volumeNode);
+        }
+      }
+    return;
+    }
+
+  vtkMRMLSliceNode* sliceNode = vtkMRMLSliceNode::SafeDownCast(caller);
+  if (sliceNode)
+    {
+    // A preview is replaced by the full resolution volume once its voxels are larger than the pixels of the view
+    double pixelSize = sliceNode->GetFieldOfView()[0] / std::max(1, sliceNode->GetDimensions()[0]);
+    std::vector<vtkMRMLScalarVolumeNode*> zoomedVolumeNodes;
+    for (const auto& preview : this->Internal->PreviewVolumes)
+      {
+      vtkMRMLScalarVolumeNode* volumeNode = preview.second.Node;
+      if (!volumeNode || preview.second.FullResolutionRequested)
+        {
+        continue;
+        }
+      double* spacing = volumeNode->GetSpacing();
+      if (pixelSize < std::min(spacing[0], std::min(spacing[1], spacing[2]))
+        && IsShownInSliceView(this->GetMRMLScene(), sliceNode, volumeNode))
+        {
+        zoomedVolumeNodes.push_back(volumeNode);
+        }
+      }
+    for (vtkMRMLScalarVolumeNode* volumeNode : zoomedVolumeNodes)
+      {
+      this->setFreeSurferVolumeLevel(volumeNode, 0);
+      }
+    return;
+    }
+
+  vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(caller);
+  if (displayNode && displayNode->GetVisibility())
+    {
+    vtkMRMLNode* displayableNode = displayNode->GetDisplayableNode();
+    if (this->isFreeSurferPlaceholderNode(displayableNode))
+      {
+      this->GetMRMLNodesObserverManager()->RemoveObjectEvents(displayNode);
+      this->loadFreeSurferPlaceholderNode(displayableNode);
+      }
+    return;
+    }
+
+  this->Superclass::ProcessMRMLNodesEvents(caller, event, callData);
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferVolume(std::string fsDirectory, std::string name)
+{
+  std::string volumeFile = fsDirectory + name;
+  if (vtkFreeSurferMGHReader::CanReadFile(volumeFile))
+    {
+    return this->loadFreeSurferMGHVolume(volumeFile, name);
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, volumeFile);
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLScalarVolumeNode"));
+  volumeNode->SetName(name.c_str());
+  volumeNode->AddDefaultStorageNode(volumeFile.c_str());
+
+  vtkMRMLVolumeArchetypeStorageNode* volumeStorageNode = vtkMRMLVolumeArchetypeStorageNode::SafeDownCast(volumeNode->GetStorageNode());
+  if (volumeStorageNode->ReadData(volumeNode))
+    {
+    // Other formats are read by the storage node, all stages up to the display are reported as reading
+    timer.Stop(ReadStage, GetFileMegabytes(volumeFile), GetMegabytes(volumeNode->GetImageData()));
+    volumeNode->CreateDefaultDisplayNodes();
+    timer.Stop(SceneStage);
+    this->addFreeSurferImportMeasurements(measurements);
+    return volumeNode;
+    }
+
+  this->GetMRMLScene()->RemoveNode(volumeStorageNode);
+  this->GetMRMLScene()->RemoveNode(volumeNode);
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferMGHVolume(std::string volumeFile, std::string name)
+{
+  vtkNew<vtkImageData> imageData;
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  MeasurementList measurements;
+  bool success = ReadMGHImage(volumeFile, imageData, ijkToRAS, this->DecodedDataCache, &measurements);
+  if (success)
+    {
+    SetStoredScalars(volumeFile, imageData, this->StorageMode, &measurements);
+    }
+  this->addFreeSurferImportMeasurements(measurements);
+  if (!success)
+    {
+    vtkErrorMacro("loadFreeSurferMGHVolume: Could not read " << volumeFile);
+    return nullptr;
+    }
+  return this->addFreeSurferVolumeNode(volumeFile, name, imageData, ijkToRAS);
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferVolumeNode(std::string volumeFile, std::string name,
+  vtkImageData* imageData, vtkMatrix4x4* ijkToRAS, vtkFreeSurferVolumePyramid* pyramid/*=nullptr*/)
+{
+  if (!imageData || !ijkToRAS)
+    {
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, volumeFile);
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLScalarVolumeNode"));
+  if (!volumeNode)
+    {
+    return nullptr;
+    }
+  volumeNode->SetName(name.c_str());
+  volumeNode->SetIJKToRASMatrix(ijkToRAS);
+  volumeNode->SetAndObserveImageData(imageData);
+  SetQuantizationAttributes(volumeNode, imageData);
+  if (pyramid && pyramid->GetInput() == imageData && pyramid->GetNumberOfAvailableLevels() > 1)
+    {
+    vtkInternal::VolumeLevels& volumeLevels = this->Internal->VolumePyramids[volumeNode->GetID()];
+    volumeLevels.Pyramid = pyramid;
+    volumeLevels.IJKToRAS = vtkSmartPointer<vtkMatrix4x4>::New();
+    volumeLevels.IJKToRAS->DeepCopy(ijkToRAS);
+    }
+  volumeNode->AddDefaultStorageNode(volumeFile.c_str());
+  timer.Stop(SceneStage);
+
+  // The initial window/level is taken from a histogram computed by a kernel specialized for the scalar type
+  // of the volume, with the percentiles of the automatic window/level, so that the display node does not scan
+  // the voxels again through the generic image pipeline
+  vtkNew<vtkFreeSurferImageHistogram> histogram;
+  if (histogram->Compute(imageData))
+    {
+    vtkMRMLScalarVolumeDisplayNode* displayNode = vtkMRMLScalarVolumeDisplayNode::SafeDownCast(
+      this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLScalarVolumeDisplayNode"));
+    if (displayNode)
+      {
+      displayNode->SetAutoWindowLevel(0);
+      displayNode->SetWindowLevelMinMax(histogram->GetPercentile(0.1), histogram->GetPercentile(99.9));
+      displayNode->SetAndObserveColorNodeID("vtkMRMLColorTableNodeGrey");
+      volumeNode->SetAndObserveDisplayNodeID(displayNode->GetID());
+      }
+    }
+  timer.Stop(LUTStage, 0.0, histogram->GetBins().size() * sizeof(vtkIdType) / (1024.0 * 1024.0));
+  volumeNode->CreateDefaultDisplayNodes();
+  timer.Stop(SceneStage);
+  this->addFreeSurferImportMeasurements(measurements);
+  return volumeNode;
+}
+
+//-----------------------------------------------------------------------------
+vtkFreeSurferVolumePyramid* vtkSlicerFreeSurferImporterLogic::getFreeSurferVolumePyramid(vtkMRMLScalarVolumeNode* volumeNode)
+{
+  if (!volumeNode || !volumeNode->GetID())
+    {
+    return nullptr;
+    }
+  std::map<std::string, vtkInternal::VolumeLevels>::iterator levelsIt =
+    this->Internal->VolumePyramids.find(volumeNode->GetID());
+  return levelsIt != this->Internal->VolumePyramids.end() ? levelsIt->second.Pyramid.GetPointer() : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::setFreeSurferVolumeLevel(vtkMRMLScalarVolumeNode* volumeNode, int level)
+{
+  if (!volumeNode || !volumeNode->GetID())
+    {
+    return false;
+    }
+  vtkInternal* internal = this->Internal;
+  if (this->isFreeSurferPlaceholderNode(volumeNode))
+    {
+    // Showing any level needs the voxels, the pyramid of a placeholder is built when it is decoded
+    return this->loadFreeSurferPlaceholderNode(volumeNode) && (level == 0 || this->setFreeSurferVolumeLevel(volumeNode, level));
+    }
+  if (level == 0)
+    {
+    for (auto& preview : internal->PreviewVolumes)
+      {
+      if (preview.second.Node != volumeNode)
+        {
+        continue;
+        }
+      // The next free worker reads the volume, processFreeSurferFilesImport replaces the preview when it is read
+      if (!preview.second.FullResolutionRequested)
+        {
+        std::lock_guard<std::mutex> lock(internal->ReadItemsMutex);
+        internal->PriorityItems.push_back(preview.first);
+        preview.second.FullResolutionRequested = true;
+        }
+      return true;
+      }
+    }
+
+  std::map<std::string, vtkInternal::VolumeLevels>::iterator levelsIt = internal->VolumePyramids.find(volumeNode->GetID());
+  vtkImageData* levelImage = levelsIt != internal->VolumePyramids.end() ? levelsIt->second.Pyramid->GetLevel(level) : nullptr;
+  if (!levelImage)
+    {
+    return false;
+    }
+  if (volumeNode->GetImageData() != levelImage)
+    {
+    vtkNew<vtkMatrix4x4> levelIJKToRAS;
+    vtkFreeSurferVolumePyramid::GetLevelIJKToRAS(levelsIt->second.IJKToRAS, level, levelIJKToRAS);
+    volumeNode->SetIJKToRASMatrix(levelIJKToRAS);
+    volumeNode->SetAndObserveImageData(levelImage);
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::addFreeSurferVolumePreviews()
+{
+  vtkInternal* internal = this->Internal;
+  for (int index = 0; index < static_cast<int>(internal->Items.size()); ++index)
+    {
+    const FreeSurferImportItem& item = internal->Items[index];
+    std::string volumeFile = item.Directory + item.Name;
+    vtkFreeSurferMGHReader::Header header;
+    if (item.Type != VolumeFile || !vtkFreeSurferMGHReader::CanReadFile(volumeFile)
+      || !vtkFreeSurferMGHReader::ReadHeader(volumeFile, header))
+      {
+      continue;
+      }
+
+    // Only the header and the saved levels are read, the volume is decoded by the import
+    MeasurementList measurements;
+    StageTimer timer(&measurements, volumeFile);
+    vtkNew<vtkFreeSurferVolumePyramid> pyramid;
+    pyramid->SetNumberOfLevels(this->NumberOfVolumePreviewLevels);
+    if (!pyramid->Load(volumeFile, header.Dimensions))
+      {
+      continue;
+      }
+    int level = pyramid->GetNumberOfAvailableLevels() - 1;
+    vtkImageData* levelImage = pyramid->GetLevel(level);
+    timer.Stop(ReadStage, GetMegabytes(levelImage), GetMegabytes(levelImage));
+    this->addFreeSurferImportMeasurements(measurements);
+
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    vtkFreeSurferMGHReader::ComputeIJKToRASMatrix(header, ijkToRAS);
+    vtkNew<vtkMatrix4x4> levelIJKToRAS;
+    vtkFreeSurferVolumePyramid::GetLevelIJKToRAS(ijkToRAS, level, levelIJKToRAS);
+    vtkMRMLScalarVolumeNode* volumeNode = this->addFreeSurferVolumeNode(volumeFile, item.Name, levelImage, levelIJKToRAS);
+    if (volumeNode)
+      {
+      internal->PreviewVolumes[index].Node = volumeNode;
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::showFreeSurferVolumeFullResolution(vtkMRMLScalarVolumeNode* volumeNode,
+  FreeSurferImportItem& item)
+{
+  this->addFreeSurferImportMeasurements(item.Measurements);
+  item.Measurements.clear();
+  item.Node = nullptr;
+  item.Success = false;
+  vtkImageData* imageData = vtkImageData::SafeDownCast(item.Data);
+  if (!imageData || !item.IJKToRAS)
+    {
+    vtkErrorMacro("showFreeSurferVolumeFullResolution: Could not read " << item.Directory + item.Name);
+    this->GetMRMLScene()->RemoveNode(volumeNode);
+    return false;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, item.Directory + item.Name);
+  vtkDataArray* previewScalars = volumeNode->GetImageData() ? volumeNode->GetImageData()->GetPointData()->GetScalars() : nullptr;
+  int previewScalarType = previewScalars ? previewScalars->GetDataType() : VTK_VOID;
+  volumeNode->SetIJKToRASMatrix(item.IJKToRAS);
+  volumeNode->SetAndObserveImageData(imageData);
+  SetQuantizationAttributes(volumeNode, imageData);
+  timer.Stop(SceneStage);
+
+  // The window/level of the preview is kept, unless the levels were saved in another storage mode
+  vtkMRMLScalarVolumeDisplayNode* displayNode = vtkMRMLScalarVolumeDisplayNode::SafeDownCast(volumeNode->GetDisplayNode());
+  if (displayNode && previewScalarType != imageData->GetPointData()->GetScalars()->GetDataType())
+    {
+    vtkNew<vtkFreeSurferImageHistogram> histogram;
+    if (histogram->Compute(imageData))
+      {
+      displayNode->SetWindowLevelMinMax(histogram->GetPercentile(0.1), histogram->GetPercentile(99.9));
+      }
+    timer.Stop(LUTStage, 0.0, histogram->GetBins().size() * sizeof(vtkIdType) / (1024.0 * 1024.0));
+    }
+  this->addFreeSurferImportMeasurements(measurements);
+
+  // The scene holds the data from now on
+  item.Data = nullptr;
+  item.IJKToRAS = nullptr;
+  item.Node = volumeNode;
+  item.Success = true;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLSegmentationNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferSegmentation(std::string fsDirectory, std::string name)
+{
+  std::string segmentationFile = fsDirectory + name;
+  if (vtkFreeSurferMGHReader::CanReadFile(segmentationFile))
+    {
+    vtkNew<vtkImageData> labelImage;
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    MeasurementList measurements;
+    bool success = ReadMGHImage(segmentationFile, labelImage, ijkToRAS, this->DecodedDataCache, &measurements);
+    this->addFreeSurferImportMeasurements(measurements);
+    if (!success)
+      {
+      vtkErrorMacro("loadFreeSurferSegmentation: Could not read " << segmentationFile);
+      return nullptr;
+      }
+    return this->addFreeSurferSegmentationNode(segmentationFile, name, labelImage, ijkToRAS);
+    }
+
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLSegmentationNode"));
+  if (!segmentationNode)
+    {
+    return nullptr;
+    }
+  segmentationNode->SetName(name.c_str());
+  segmentationNode->AddDefaultStorageNode(segmentationFile.c_str());
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, segmentationFile);
+  vtkMRMLSegmentationStorageNode* segmentationStorageNode = vtkMRMLSegmentationStorageNode::SafeDownCast(segmentationNode->GetStorageNode());
+  if (segmentationStorageNode && segmentationStorageNode->ReadData(segmentationNode))
+    {
+    timer.Stop(ReadStage, GetFileMegabytes(segmentationFile));
+    this->addFreeSurferImportMeasurements(measurements);
+    this->applyFreeSurferSegmentationLUT(segmentationNode);
+    return segmentationNode;
+    }
+
+  this->GetMRMLScene()->RemoveNode(segmentationStorageNode);
+  this->GetMRMLScene()->RemoveNode(segmentationNode);
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLSegmentationNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferSegmentationNode(std::string segmentationFile, std::string name,
+  vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS, vtkFreeSurferColorLUT* lut/*=nullptr*/)
+{
+  if (!labelImage || !ijkToRAS)
+    {
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, segmentationFile);
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLSegmentationNode"));
+  if (!segmentationNode)
+    {
+    return nullptr;
+    }
+  segmentationNode->SetName(name.c_str());
+  // The storage node is added first so that the segments are reported under the file name
+  segmentationNode->AddDefaultStorageNode(segmentationFile.c_str());
+  double sceneSeconds = timer.GetElapsedSeconds();
+  if (!this->updateFreeSurferSegmentationNode(segmentationNode, labelImage, ijkToRAS, lut))
+    {
+    this->GetMRMLScene()->RemoveNode(segmentationNode->GetStorageNode());
+    this->GetMRMLScene()->RemoveNode(segmentationNode);
+    return nullptr;
+    }
+
+  timer.Restart();
+  segmentationNode->CreateDefaultDisplayNodes();
+  timer.Add(SceneStage, sceneSeconds + timer.GetElapsedSeconds());
+  this->addFreeSurferImportMeasurements(measurements);
+  return segmentationNode;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::updateFreeSurferSegmentationNode(vtkMRMLSegmentationNode* segmentationNode,
+  vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS, vtkFreeSurferColorLUT* lut/*=nullptr*/)
+{
+  if (!segmentationNode || !labelImage || !ijkToRAS)
+    {
+    return false;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, GetNodeFileName(segmentationNode));
+  vtkNew<vtkFreeSurferLabelStatistics> labelStatistics;
+  if (!labelStatistics->Compute(labelImage))
+    {
+    return false;
+    }
+
+  // All segments share one labelmap, each segment is identified by its label value
+  vtkNew<vtkOrientedImageData> labelmap;
+  int labelsExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  int* imageExtent = labelImage->GetExtent();
+  double labelmapMegabytes = 0.0;
+  if (labelStatistics->GetLabelsExtent(labelsExtent)
+    && !std::equal(labelsExtent, labelsExtent + 6, imageExtent))
+    {
+    // Crop to the labeled region, this is typically a fraction of the conformed 256^3 volume
+    vtkNew<vtkImageClip> clipper;
+    clipper->SetInputData(labelImage);
+    clipper->SetOutputWholeExtent(labelsExtent);
+    clipper->ClipDataOn();
+    clipper->Update();
+    labelmap->ShallowCopy(clipper->GetOutput());
+    labelmapMegabytes = GetMegabytes(labelmap.GetPointer());
+    }
+  else
+    {
+    labelmap->ShallowCopy(labelImage);
+    }
+  labelmap->SetImageToWorldMatrix(ijkToRAS);
+
+  vtkSmartPointer<vtkFreeSurferColorLUT> colorLUT = lut;
+  if (!colorLUT)
+    {
+    colorLUT = this->getFreeSurferColorLUT();
+    }
+
+    {
+    MRMLNodeModifyBlocker blocker(segmentationNode);
+    vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+    segmentation->RemoveAllSegments();
+    std::string labelmapName = vtkSegmentationConverter::GetBinaryLabelmapRepresentationName();
+    vtkFreeSurferColorLUT::LabelInfo unknownInfo;
+    for (int i = 0; i < labelStatistics->GetNumberOfLabels(); ++i)
+      {
+      int labelValue = labelStatistics->GetNthLabelInfo(i).Value;
+      const vtkFreeSurferColorLUT::LabelInfo* info = colorLUT ? colorLUT->GetLabelInfo(labelValue) : nullptr;
+      if (!info)
+        {
+        info = &unknownInfo;
+        }
+
+      vtkNew<vtkSegment> segment;
+      segment->SetName(info->Name.c_str());
+      segment->SetColor(info->Color[0], info->Color[1], info->Color[2]);
+      segment->SetLabelValue(labelValue);
+      segment->AddRepresentation(labelmapName, labelmap);
+      segmentation->AddSegment(segment);
+      }
+    }
+  timer.Stop(LUTStage, 0.0, labelmapMegabytes);
+  this->addFreeSurferImportMeasurements(measurements);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<vtkMRMLModelNode*> vtkSlicerFreeSurferImporterLogic::addFreeSurferLabelModels(vtkMRMLScalarVolumeNode* labelVolumeNode,
+  const std::vector<int>& labelValues/*=std::vector<int>()*/, vtkFreeSurferColorLUT* lut/*=nullptr*/)
+{
+  std::vector<vtkMRMLModelNode*> modelNodes;
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !labelVolumeNode)
+    {
+    return modelNodes;
+    }
+  if (this->isFreeSurferPlaceholderNode(labelVolumeNode) && !this->loadFreeSurferPlaceholderNode(labelVolumeNode))
+    {
+    return modelNodes;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, GetNodeFileName(labelVolumeNode));
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  labelVolumeNode->GetIJKToRASMatrix(ijkToRAS);
+  vtkNew<vtkFreeSurferLabelSurfaces> labelSurfaces;
+  labelSurfaces->SetLabelValues(labelValues);
+  labelSurfaces->SetSmoothingFactor(this->LabelModelSmoothingFactor);
+  if (!labelSurfaces->Compute(labelVolumeNode->GetImageData(), ijkToRAS))
+    {
+    vtkErrorMacro("addFreeSurferLabelModels: " << labelVolumeNode->GetName() << " has no voxels");
+    return modelNodes;
+    }
+  double surfaceMegabytes = 0.0;
+  for (int i = 0; i < labelSurfaces->GetNumberOfOutputs(); ++i)
+    {
+    surfaceMegabytes += GetMegabytes(labelSurfaces->GetOutput(i));
+    }
+  timer.Stop(SurfaceProcessingStage, 0.0, surfaceMegabytes);
+
+  vtkSmartPointer<vtkFreeSurferColorLUT> colorLUT = lut;
+  if (!colorLUT)
+    {
+    colorLUT = this->getFreeSurferColorLUT();
+    }
+  vtkFreeSurferColorLUT::LabelInfo unknownInfo;
+  double sceneSeconds = 0.0;
+  for (int i = 0; i < labelSurfaces->GetNumberOfOutputs(); ++i)
+    {
+    int labelValue = labelSurfaces->GetOutputLabelValue(i);
+    const vtkFreeSurferColorLUT::LabelInfo* info = colorLUT ? colorLUT->GetLabelInfo(labelValue) : nullptr;
+    if (!info)
+      {
+      info = &unknownInfo;
+      }
+    // Labels that are not in the color table are named after their value
+    std::string modelName = info != &unknownInfo && !info->Name.empty() ? info->Name : "Label_" + std::to_string(labelValue);
+    vtkMRMLModelNode* modelNode = this->addFreeSurferModelNode(modelName, labelSurfaces->GetOutput(i));
+    if (!modelNode)
+      {
+      continue;
+      }
+    timer.Restart();
+    modelNode->SetAttribute("FreeSurferImporter.LabelValue", std::to_string(labelValue).c_str());
+    modelNode->CreateDefaultDisplayNodes();
+    if (modelNode->GetDisplayNode())
+      {
+      modelNode->GetDisplayNode()->SetColor(info->Color[0], info->Color[1], info->Color[2]);
+      }
+    sceneSeconds += timer.GetElapsedSeconds();
+    modelNodes.push_back(modelNode);
+    }
+  timer.Add(SceneStage, sceneSeconds);
+  this->addFreeSurferImportMeasurements(measurements);
+  return modelNodes;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLModelNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferModel(std::string fsDirectory, std::string name)
+{
+  std::string surfFile = fsDirectory + name;
+  vtkNew<vtkPolyData> surface;
+  vtkSmartPointer<vtkFreeSurferSurfaceLOD> levelsOfDetail;
+  if (this->NumberOfSurfaceLevelsOfDetail > 1)
+    {
+    levelsOfDetail = vtkSmartPointer<vtkFreeSurferSurfaceLOD>::New();
+    levelsOfDetail->SetNumberOfLevels(this->NumberOfSurfaceLevelsOfDetail);
+    }
+  MeasurementList measurements;
+  bool success = ReadSurface(surfFile, nullptr, surface, this->Internal->GetSharedTopologies(this->ShareSurfaceTopology, surfFile),
+    this->DecodedDataCache, levelsOfDetail, &measurements);
+  this->addFreeSurferImportMeasurements(measurements);
+  if (!success)
+    {
+    vtkErrorMacro("loadFreeSurferModel: Could not read " << surfFile);
+    return nullptr;
+    }
+  return this->addFreeSurferModelNode(name, surface, levelsOfDetail, surfFile);
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLModelNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferModelNode(std::string name, vtkPolyData* surface,
+  vtkFreeSurferSurfaceLOD* levelsOfDetail/*=nullptr*/, std::string surfaceFile/*=std::string()*/)
+{
+  if (!surface)
+    {
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, name);
+  vtkMRMLModelNode* surfNode = vtkMRMLModelNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLModelNode"));
+  if (!surfNode)
+    {
+    return nullptr;
+    }
+  surfNode->SetName(name.c_str());
+  surfNode->SetAndObservePolyData(surface);
+  if (!surfaceFile.empty())
+    {
+    AddFreeSurferModelStorageNode(this->GetMRMLScene(), surfNode, surfaceFile);
+    }
+  if (levelsOfDetail && levelsOfDetail->GetInput() == surface && levelsOfDetail->GetNumberOfAvailableLevels() > 1)
+    {
+    this->Internal->SurfaceLevelsOfDetail[surfNode->GetID()] = levelsOfDetail;
+    }
+  timer.Stop(SceneStage);
+  this->addFreeSurferImportMeasurements(measurements);
+  return surfNode;
+}
+
+//-----------------------------------------------------------------------------
+vtkFreeSurferSurfaceLOD* vtkSlicerFreeSurferImporterLogic::getFreeSurferModelLevelsOfDetail(vtkMRMLModelNode* modelNode)
+{
+  if (!modelNode || !modelNode->GetID())
+    {
+    return nullptr;
+    }
+  std::map<std::string, vtkSmartPointer<vtkFreeSurferSurfaceLOD> >::iterator levelsIt =
+    this->Internal->SurfaceLevelsOfDetail.find(modelNode->GetID());
+  return levelsIt != this->Internal->SurfaceLevelsOfDetail.end() ? levelsIt->second.GetPointer() : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::setFreeSurferModelLevelOfDetail(vtkMRMLModelNode* modelNode, int level)
+{
+  vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+  vtkPolyData* levelSurface = levelsOfDetail ? levelsOfDetail->GetLevel(level) : nullptr;
+  if (!levelSurface)
+    {
+    return false;
+    }
+  levelsOfDetail->UpdateLevelPointData(level);
+  if (modelNode->GetPolyData() != levelSurface)
+    {
+    modelNode->SetAndObservePolyData(levelSurface);
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::setFreeSurferModelsInteracting(bool interacting)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+    {
+    return;
+    }
+  for (const auto& levelsOfDetail : this->Internal->SurfaceLevelsOfDetail)
+    {
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(scene->GetNodeByID(levelsOfDetail.first));
+    int level = interacting ? levelsOfDetail.second->GetNumberOfAvailableLevels() - 1 : 0;
+    this->setFreeSurferModelLevelOfDetail(modelNode, level);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::detachSharedSurfaceTopology(vtkMRMLModelNode* modelNode)
+{
+  // Only the full resolution surface shares its polygons
+  vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+  vtkPolyData* polyData = levelsOfDetail ? levelsOfDetail->GetInput() : (modelNode ? modelNode->GetPolyData() : nullptr);
+  if (!polyData || !polyData->GetPolys())
+    {
+    return;
+    }
+  if (polyData->GetPolys()->GetReferenceCount() > 1)
+    {
+    vtkNew<vtkCellArray> polys;
+    polys->DeepCopy(polyData->GetPolys());
+    polyData->SetPolys(polys);
+    }
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool IsModelOfHemisphere(vtkMRMLModelNode* modelNode, const std::string& overlayName)
+  {
+    if (!modelNode || !modelNode->GetName())
+      {
+      return false;
+      }
+    std::string hemisphereName = vtksys::SystemTools::GetFilenameWithoutExtension(overlayName);
+    return vtksys::SystemTools::GetFilenameWithoutExtension(modelNode->GetName()) == hemisphereName;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Paint files do not store the number of vertices, it is read from the white (or orig)
+  /// surface of the hemisphere in the same directory. Returns 0 if no surface was found.
+  int GetPaintFileNumberOfVertices(const std::string& fileName)
+  {
+    std::string directory = vtksys::SystemTools::GetFilenamePath(fileName);
+    std::string hemisphereName = vtksys::SystemTools::GetFilenameName(fileName).substr(0, 3);
+    for (const char* surfaceName : { "white", "orig" })
+      {
+      std::string surfaceFile = (directory.empty() ? std::string() : directory + "/") + hemisphereName + surfaceName;
+      int numberOfVertices = 0;
+      int numberOfFaces = 0;
+      if (vtkFreeSurferSurfaceReader::ReadSurfaceInfo(surfaceFile, numberOfVertices, numberOfFaces))
+        {
+        return numberOfVertices;
+        }
+      }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkFloatArray> ReadOverlay(const std::string& fileName, vtkFreeSurferDecodedDataCache* cache,
+    MeasurementList* measurements = nullptr)
+  {
+    StageTimer timer(measurements, fileName);
+    if (cache)
+      {
+      vtkSmartPointer<vtkFloatArray> cachedOverlay = vtkFloatArray::SafeDownCast(cache->LoadArray(fileName));
+      if (cachedOverlay)
+        {
+        timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetMegabytes(cachedOverlay.GetPointer()),
+          GetMegabytes(cachedOverlay.GetPointer()));
+        return cachedOverlay;
+        }
+      }
+
+    vtkNew<vtkFreeSurferOverlayReader> reader;
+    reader->SetFileName(fileName.c_str());
+    if (vtkFreeSurferOverlayReader::IsPaintFile(fileName))
+      {
+      reader->SetNumberOfVertices(GetPaintFileNumberOfVertices(fileName));
+      }
+    if (!reader->Read())
+      {
+      return nullptr;
+      }
+    if (cache)
+      {
+      cache->StoreArray(fileName, reader->GetOutput());
+      }
+    // Overlays are small, the byte swap is reported as part of reading
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetFileMegabytes(fileName), GetMegabytes(reader->GetOutput()));
+    return reader->GetOutput();
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkIntArray> ReadAnnotation(const std::string& fileName, vtkSmartPointer<vtkFreeSurferColorLUT>& colorTable,
+    MeasurementList* measurements = nullptr)
+  {
+    StageTimer timer(measurements, fileName);
+    vtkNew<vtkFreeSurferAnnotationReader> reader;
+    reader->SetFileName(fileName.c_str());
+    if (!reader->Read())
+      {
+      return nullptr;
+      }
+    colorTable = reader->GetColorTable();
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::ReadStage, GetFileMegabytes(fileName), GetMegabytes(reader->GetOutput()));
+    return reader->GetOutput();
+  }
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  std::shared_ptr<const SphereResamplerCache::Mapping> SphereResamplerCache::GetMapping(const std::string& sourceSphereFile,
+    const std::string& targetSphereFile, vtkFreeSurferDecodedDataCache* cache, MeasurementList* measurements)
+  {
+    long int sourceModifiedTime = vtksys::SystemTools::ModifiedTime(sourceSphereFile);
+    long int targetModifiedTime = vtksys::SystemTools::ModifiedTime(targetSphereFile);
+    SphereFiles sphereFiles(sourceSphereFile, targetSphereFile);
+    std::shared_ptr<Target> target;
+    std::promise<std::shared_ptr<const Mapping> > mappingPromise;
+    {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    for (auto it = this->Mappings.begin(); it != this->Mappings.end(); ++it)
+      {
+      if (it->SourceSphereFile == sourceSphereFile && it->TargetSphereFile == targetSphereFile)
+        {
+        if (it->SourceModifiedTime != sourceModifiedTime || it->TargetModifiedTime != targetModifiedTime)
+          {
+          this->MappingsMegabytes -= it->Megabytes;
+          this->Mappings.erase(it);
+          break;
+          }
+        this->Mappings.splice(this->Mappings.begin(), this->Mappings, it);
+        return this->Mappings.front().SharedMapping;
+        }
+      }
+    auto pendingIt = this->PendingMappings.find(sphereFiles);
+    if (pendingIt != this->PendingMappings.end())
+      {
+      std::shared_future<std::shared_ptr<const Mapping> > pendingMapping = pendingIt->second;
+      lock.unlock();
+      return pendingMapping.get();
+      }
+    this->PendingMappings[sphereFiles] = mappingPromise.get_future().share();
+    std::shared_ptr<Target>& cachedTarget = this->Targets[targetSphereFile];
+    if (!cachedTarget)
+      {
+      cachedTarget = std::make_shared<Target>();
+      }
+    target = cachedTarget;
+    }
+
+    std::shared_ptr<const Mapping> mapping = this->ComputeMapping(sourceSphereFile, targetSphereFile, targetModifiedTime,
+      target, cache, measurements);
+    if (mapping)
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      MappingEntry entry;
+      entry.SourceSphereFile = sourceSphereFile;
+      entry.SourceModifiedTime = sourceModifiedTime;
+      entry.TargetSphereFile = targetSphereFile;
+      entry.TargetModifiedTime = targetModifiedTime;
+      entry.SharedMapping = mapping;
+      entry.Megabytes = (mapping->VertexIds.size() * sizeof(vtkIdType) + mapping->Weights.size() * sizeof(float)) / (1024.0 * 1024.0);
+      this->Mappings.push_front(entry);
+      this->MappingsMegabytes += entry.Megabytes;
+      // The mapping just computed is kept even if it is larger than the maximum on its own
+      while (this->Mappings.size() > 1 && this->MappingsMegabytes > MaximumMappingsMegabytes)
+        {
+        this->MappingsMegabytes -= this->Mappings.back().Megabytes;
+        this->Mappings.pop_back();
+        }
+      }
+    {
+    // Waiting threads get the mapping, or nullptr if it could not be computed
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->PendingMappings.erase(sphereFiles);
+    }
+    mappingPromise.set_value(mapping);
+    return mapping;
+  }
+
+  //----------------------------------------------------------------------------
+  std::shared_ptr<const SphereResamplerCache::Mapping> SphereResamplerCache::ComputeMapping(const std::string& sourceSphereFile,
+    const std::string& targetSphereFile, long int targetModifiedTime, std::shared_ptr<Target> target,
+    vtkFreeSurferDecodedDataCache* cache, MeasurementList* measurements)
+  {
+    // Threads that need the same target wait for it to be indexed once
+    vtkSmartPointer<vtkFreeSurferSphereResampler> resampler;
+    {
+    std::lock_guard<std::mutex> targetLock(target->Mutex);
+    if (!target->Resampler || target->ModifiedTime != targetModifiedTime)
+      {
+      target->Resampler = nullptr;
+      vtkNew<vtkPolyData> targetSphere;
+      if (!ReadSphere(targetSphereFile, targetSphere, cache, measurements))
+        {
+        return nullptr;
+        }
+      StageTimer timer(measurements, targetSphereFile);
+      vtkSmartPointer<vtkFreeSurferSphereResampler> targetResampler = vtkSmartPointer<vtkFreeSurferSphereResampler>::New();
+      if (!targetResampler->SetTargetSphere(targetSphere))
+        {
+        return nullptr;
+        }
+      timer.Stop(vtkSlicerFreeSurferImporterLogic::SurfaceProcessingStage);
+      target->Resampler = targetResampler;
+      target->ModifiedTime = targetModifiedTime;
+      }
+    resampler = target->Resampler;
+    }
+
+    vtkNew<vtkPolyData> sourceSphere;
+    if (!ReadSphere(sourceSphereFile, sourceSphere, cache, measurements))
+      {
+      return nullptr;
+      }
+    StageTimer timer(measurements, sourceSphereFile);
+    std::shared_ptr<Mapping> mapping = std::make_shared<Mapping>();
+    if (!resampler->ComputeMapping(sourceSphere, *mapping))
+      {
+      return nullptr;
+      }
+    double megabytes = (mapping->VertexIds.size() * sizeof(vtkIdType) + mapping->Weights.size() * sizeof(float)) / (1024.0 * 1024.0);
+    timer.Stop(vtkSlicerFreeSurferImporterLogic::SurfaceProcessingStage, 0.0, megabytes);
+    return mapping;
+  }
+
+  //----------------------------------------------------------------------------
+  void SphereResamplerCache::Clear()
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    // Threads that are indexing a target keep their own reference to it
+    this->Targets.clear();
+    this->Mappings.clear();
+    this->MappingsMegabytes = 0.0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkFloatArray> vtkSlicerFreeSurferImporterLogic::resampleFreeSurferOverlay(std::string overlayFile,
+  std::string sourceSphereFile, std::string targetSphereFile, int interpolation/*=vtkFreeSurferSphereResampler::Barycentric*/)
+{
+  MeasurementList measurements;
+  vtkSmartPointer<vtkFloatArray> overlay = ReadOverlay(overlayFile, this->DecodedDataCache, &measurements);
+  std::shared_ptr<const vtkFreeSurferSphereResampler::Mapping> mapping = this->Internal->SphereResamplers.GetMapping(
+    sourceSphereFile, targetSphereFile, this->DecodedDataCache, &measurements);
+  vtkSmartPointer<vtkFloatArray> resampled;
+  if (overlay && mapping)
+    {
+    StageTimer timer(&measurements, overlayFile);
+    resampled = vtkFreeSurferSphereResampler::Resample(*mapping, overlay, interpolation);
+    timer.Stop(SurfaceProcessingStage, 0.0, GetMegabytes(resampled.GetPointer()));
+    if (!resampled)
+      {
+      vtkErrorMacro("resampleFreeSurferOverlay: " << overlayFile << " does not have one value per vertex of " << sourceSphereFile);
+      }
+    }
+  this->addFreeSurferImportMeasurements(measurements);
+  return resampled;
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Values of a curvature format overlay or of an MGH file with one value per vertex
+  vtkSmartPointer<vtkDataArray> ReadPerVertexValues(const std::string& fileName, vtkFreeSurferDecodedDataCache* cache,
+    MeasurementList* measurements)
+  {
+    if (vtkFreeSurferOverlayReader::CanReadFile(fileName))
+      {
+      return ReadOverlay(fileName, cache, measurements);
+      }
+    vtkNew<vtkImageData> imageData;
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    if (!vtkFreeSurferMGHReader::CanReadFile(fileName)
+      || !ReadMGHImage(fileName, imageData, ijkToRAS, cache, measurements))
+      {
+      return nullptr;
+      }
+    return imageData->GetPointData()->GetScalars();
+  }
+
+  //----------------------------------------------------------------------------
+  /// Fill the rows of a group overlay in parallel, largest files first.
+  /// readSubject returns the values of a subject, or nullptr if they could not be read.
+  void FillGroupOverlay(vtkFreeSurferGroupOverlay* groupOverlay, const std::vector<std::string>& fileNames, int numberOfThreads,
+    const std::function<vtkSmartPointer<vtkDataArray>(int subject, MeasurementList* measurements)>& readSubject,
+    MeasurementList& measurements)
+  {
+    std::vector<unsigned long> fileSizes;
+    for (const std::string& fileName : fileNames)
+      {
+      fileSizes.push_back(vtksys::SystemTools::FileLength(fileName));
+      }
+    std::vector<MeasurementList> subjectMeasurements(fileNames.size());
+    RunInParallel(GetLargestFirstOrder(fileSizes), numberOfThreads, [&](int subject)
+      {
+      groupOverlay->SetSubjectName(subject, fileNames[subject]);
+      vtkSmartPointer<vtkDataArray> values = readSubject(subject, &subjectMeasurements[subject]);
+      if (!groupOverlay->SetSubjectValues(subject, values))
+        {
+        groupOverlay->SetSubjectValid(subject, false);
+        }
+      });
+    for (const MeasurementList& subjectMeasurement : subjectMeasurements)
+      {
+      measurements.insert(measurements.end(), subjectMeasurement.begin(), subjectMeasurement.end());
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void WarnInvalidSubjects(vtkFreeSurferGroupOverlay* groupOverlay)
+  {
+    for (int subject = 0; subject < groupOverlay->GetNumberOfSubjects(); ++subject)
+      {
+      if (!groupOverlay->GetSubjectValid(subject))
+        {
+        vtkWarningWithObjectMacro(groupOverlay, "Could not read " << groupOverlay->GetSubjectName(subject)
+          << " with " << groupOverlay->GetNumberOfVertices() << " values, the subject is left out");
+        }
+      }
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkFreeSurferGroupOverlay> vtkSlicerFreeSurferImporterLogic::loadFreeSurferGroupOverlay(std::string name,
+  const std::vector<std::string>& overlayFiles)
+{
+  // The common number of vertices is taken from the first file with a readable header
+  vtkIdType numberOfVertices = 0;
+  for (const std::string& overlayFile : overlayFiles)
+    {
+    int numberOfOverlayVertices = 0;
+    vtkFreeSurferMGHReader::Header header;
+    if (vtkFreeSurferOverlayReader::ReadOverlayInfo(overlayFile, numberOfOverlayVertices))
+      {
+      numberOfVertices = numberOfOverlayVertices;
+      }
+    else if (vtkFreeSurferMGHReader::ReadHeader(overlayFile, header))
+      {
+      numberOfVertices = static_cast<vtkIdType>(header.Dimensions[0]) * header.Dimensions[1] * header.Dimensions[2];
+      }
+    if (numberOfVertices > 0)
+      {
+      break;
+      }
+    }
+
+  vtkSmartPointer<vtkFreeSurferGroupOverlay> groupOverlay = vtkSmartPointer<vtkFreeSurferGroupOverlay>::New();
+  groupOverlay->SetName(name.c_str());
+  if (numberOfVertices == 0 || !groupOverlay->Allocate(static_cast<int>(overlayFiles.size()), numberOfVertices))
+    {
+    vtkErrorMacro("loadFreeSurferGroupOverlay: Could not read any of the " << overlayFiles.size() << " overlays of " << name);
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  FillGroupOverlay(groupOverlay, overlayFiles, GetNumberOfWorkerThreads(this->NumberOfThreads),
+    [this, &overlayFiles](int subject, MeasurementList* subjectMeasurements)
+      {
+      return ReadPerVertexValues(overlayFiles[subject], this->DecodedDataCache, subjectMeasurements);
+      }, measurements);
+  this->addFreeSurferImportMeasurements(measurements);
+  WarnInvalidSubjects(groupOverlay);
+  if (groupOverlay->GetNumberOfValidSubjects() == 0)
+    {
+    vtkErrorMacro("loadFreeSurferGroupOverlay: Could not read any of the " << overlayFiles.size() << " overlays of " << name);
+    return nullptr;
+    }
+  return groupOverlay;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkFreeSurferGroupOverlay> vtkSlicerFreeSurferImporterLogic::loadFreeSurferResampledGroupOverlay(
+  std::string name, const std::vector<std::string>& overlayFiles, const std::vector<std::string>& sourceSphereFiles,
+  std::string targetSphereFile, int interpolation/*=vtkFreeSurferSphereResampler::Barycentric*/)
+{
+  if (overlayFiles.size() != sourceSphereFiles.size())
+    {
+    vtkErrorMacro("loadFreeSurferResampledGroupOverlay: " << overlayFiles.size() << " overlays but "
+      << sourceSphereFiles.size() << " spheres");
+    return nullptr;
+    }
+  int numberOfVertices = 0;
+  int numberOfFaces = 0;
+  vtkSmartPointer<vtkFreeSurferGroupOverlay> groupOverlay = vtkSmartPointer<vtkFreeSurferGroupOverlay>::New();
+  groupOverlay->SetName(name.c_str());
+  if (!vtkFreeSurferSurfaceReader::ReadSurfaceInfo(targetSphereFile, numberOfVertices, numberOfFaces)
+    || !groupOverlay->Allocate(static_cast<int>(overlayFiles.size()), numberOfVertices))
+    {
+    vtkErrorMacro("loadFreeSurferResampledGroupOverlay: Could not read target sphere " << targetSphereFile);
+    return nullptr;
+    }
+
+  // The subjects are resampled in parallel, each one computes the mapping of its sphere once
+  MeasurementList measurements;
+  FillGroupOverlay(groupOverlay, overlayFiles, GetNumberOfWorkerThreads(this->NumberOfThreads),
+    [&](int subject, MeasurementList* subjectMeasurements) -> vtkSmartPointer<vtkDataArray>
+      {
+      vtkSmartPointer<vtkFloatArray> overlay = ReadOverlay(overlayFiles[subject], this->DecodedDataCache, subjectMeasurements);
+      std::shared_ptr<const vtkFreeSurferSphereResampler::Mapping> mapping = this->Internal->SphereResamplers.GetMapping(
+        sourceSphereFiles[subject], targetSphereFile, this->DecodedDataCache, subjectMeasurements);
+      if (!overlay || !mapping)
+        {
+        return nullptr;
+        }
+      StageTimer timer(subjectMeasurements, overlayFiles[subject]);
+      vtkSmartPointer<vtkFloatArray> resampled = vtkFreeSurferSphereResampler::Resample(*mapping, overlay, interpolation);
+      timer.Stop(SurfaceProcessingStage);
+      return resampled;
+      }, measurements);
+  this->addFreeSurferImportMeasurements(measurements);
+  WarnInvalidSubjects(groupOverlay);
+  if (groupOverlay->GetNumberOfValidSubjects() == 0)
+    {
+    vtkErrorMacro("loadFreeSurferResampledGroupOverlay: Could not resample any of the " << overlayFiles.size()
+      << " overlays of " << name);
+    return nullptr;
+    }
+  return groupOverlay;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::clearFreeSurferResamplingCache()
+{
+  this->Internal->SphereResamplers.Clear();
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::loadFreeSurferScalarOverlay(std::string fsDirectory, std::string name, std::vector<vtkMRMLModelNode*> modelNodes)
+{
+  std::string overlayFile = fsDirectory + name;
+  MeasurementList measurements;
+  if (vtkFreeSurferOverlayReader::CanReadFile(overlayFile))
+    {
+    vtkSmartPointer<vtkDataArray> overlay = ReadOverlay(overlayFile, this->DecodedDataCache, &measurements);
+    if (overlay)
+      {
+      overlay = GetStoredValues(overlayFile, overlay, this->StorageMode, &measurements);
+      }
+    this->addFreeSurferImportMeasurements(measurements);
+    return overlay && this->addFreeSurferScalarOverlay(name, overlay, modelNodes);
+    }
+
+  // Other formats (e.g. paint files) are read for each model by the storage node
+  vtkMRMLFreeSurferModelOverlayStorageNode* overlayStorageNode = vtkMRMLFreeSurferModelOverlayStorageNode::SafeDownCast(
+    this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLFreeSurferModelOverlayStorageNode"));
+  if (!overlayStorageNode)
+    {
+    return false;
+    }
+  overlayStorageNode->SetFileName(overlayFile.c_str());
+
+  // Each model reads the file again
+  StageTimer timer(&measurements, overlayFile);
+  bool success = true;
+  int numberOfOverlayLoaded = 0;
+  for (vtkMRMLModelNode* modelNode : modelNodes)
+    {
+    if (!IsModelOfHemisphere(modelNode, name))
+      {
+      continue;
+      }
+
+    // Scalar overlay is already loaded for this model
+    if (modelNode->HasPointScalarName(name.c_str()))
+      {
+      continue;
+      }
+
+    if (!overlayStorageNode->ReadData(modelNode))
+      {
+      success = false;
+      continue;
+      }
+    numberOfOverlayLoaded += 1;
+    }
+
+  this->GetMRMLScene()->RemoveNode(overlayStorageNode);
+  timer.Stop(ReadStage, numberOfOverlayLoaded * GetFileMegabytes(overlayFile));
+  this->addFreeSurferImportMeasurements(measurements);
+  if (numberOfOverlayLoaded == 0)
+    {
+    success = false;
+    }
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::addFreeSurferScalarOverlay(std::string name, vtkDataArray* overlay, const std::vector<vtkMRMLModelNode*>& modelNodes)
+{
+  if (!overlay)
+    {
+    return false;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, name);
+  // Same colors as the overlay storage node: curvatures are shown green/red, other measures with the heat map
+  const char* colorNodeID = (name.find("curv") != std::string::npos || name.find("sulc") != std::string::npos)
+    ? "vtkMRMLFreeSurferProceduralColorNodeGreenRed" : "vtkMRMLFreeSurferProceduralColorNodeHeat";
+  double range[2] = { 0.0, 0.0 };
+  overlay->GetRange(range);
+  int numberOfOverlayLoaded = 0;
+  for (vtkMRMLModelNode* modelNode : modelNodes)
+    {
+    // Overlays are added to the full resolution surface and carried to the other levels when they are shown
+    vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+    vtkPolyData* polyData = levelsOfDetail ? levelsOfDetail->GetInput() : (modelNode ? modelNode->GetPolyData() : nullptr);
+    if (!IsModelOfHemisphere(modelNode, name) || !polyData)
+      {
+      continue;
+      }
+    if (polyData->GetNumberOfPoints() != overlay->GetNumberOfTuples())
+      {
+      vtkWarningMacro("addFreeSurferScalarOverlay: " << name << " has " << overlay->GetNumberOfTuples()
+        << " values but " << modelNode->GetName() << " has " << polyData->GetNumberOfPoints() << " vertices");
+      continue;
+      }
+
+    // Scalar overlay is already loaded for this model
+    if (!polyData->GetPointData()->GetAbstractArray(name.c_str()))
+      {
+      // The array is shared by reference between all models of the hemisphere
+      polyData->GetPointData()->AddArray(overlay);
+      polyData->GetPointData()->SetActiveScalars(name.c_str());
+      polyData->Modified();
+      if (polyData != modelNode->GetPolyData())
+        {
+        this->setFreeSurferModelLevelOfDetail(modelNode, 0);
+        }
+      }
+
+    // The last overlay added is shown
+    vtkMRMLModelDisplayNode* displayNode = modelNode->GetModelDisplayNode();
+    if (displayNode)
+      {
+      displayNode->SetActiveScalarName(name.c_str());
+      displayNode->SetAndObserveColorNodeID(colorNodeID);
+      displayNode->SetScalarRangeFlag(vtkMRMLDisplayNode::UseManualScalarRange);
+      displayNode->SetScalarRange(range);
+      displayNode->ScalarVisibilityOn();
+      }
+    numberOfOverlayLoaded += 1;
+    }
+
+  timer.Stop(SceneStage);
+  this->addFreeSurferImportMeasurements(measurements);
+  return numberOfOverlayLoaded > 0;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::loadFreeSurferAnnotation(std::string fsDirectory, std::string name, std::vector<vtkMRMLModelNode*> modelNodes)
+{
+  std::string annotationFile = fsDirectory + name;
+  MeasurementList measurements;
+  vtkSmartPointer<vtkFreeSurferColorLUT> colorTable;
+  vtkSmartPointer<vtkIntArray> parcelIndices = ReadAnnotation(annotationFile, colorTable, &measurements);
+  this->addFreeSurferImportMeasurements(measurements);
+  if (!parcelIndices)
+    {
+    vtkErrorMacro("loadFreeSurferAnnotation: Could not read " << annotationFile);
+    return false;
+    }
+
+  vtkMRMLColorTableNode* colorTableNode = this->addFreeSurferAnnotationColorTableNode(name, colorTable);
+  if (!this->addFreeSurferAnnotation(name, parcelIndices, colorTableNode, modelNodes))
+    {
+    if (colorTableNode)
+      {
+      this->GetMRMLScene()->RemoveNode(colorTableNode);
+      }
+    return false;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLColorTableNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferAnnotationColorTableNode(std::string name, vtkFreeSurferColorLUT* colorTable)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !colorTable || colorTable->GetNumberOfLabels() == 0)
+    {
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, name);
+  int maximumValue = colorTable->GetMaximumLabelValue();
+  vtkMRMLColorTableNode* colorTableNode = vtkMRMLColorTableNode::SafeDownCast(
+    scene->AddNewNodeByClass("vtkMRMLColorTableNode", name));
+  if (!colorTableNode)
+    {
+    return nullptr;
+    }
+  colorTableNode->SetTypeToUser();
+  colorTableNode->SetNumberOfColors(maximumValue + 1);
+  colorTableNode->GetLookupTable()->SetRange(0, maximumValue);
+  // Unlabeled vertices (-1) are below the range, they are shown in the gray of unknown labels
+  // instead of being clamped to the color of the first parcel
+  colorTableNode->GetLookupTable()->SetBelowRangeColor(0.5, 0.5, 0.5, 1.0);
+  colorTableNode->GetLookupTable()->UseBelowRangeColorOn();
+  // Indices that are not in the color table are transparent
+  for (int value = 0; value <= maximumValue; ++value)
+    {
+    colorTableNode->SetColor(value, "", 0.0, 0.0, 0.0, 0.0);
+    }
+  for (int n = 0; n < colorTable->GetNumberOfLabels(); ++n)
+    {
+    const vtkFreeSurferColorLUT::LabelInfo& label = colorTable->GetNthLabelInfo(n);
+    colorTableNode->SetColor(label.Value, label.Name.c_str(),
+      label.Color[0], label.Color[1], label.Color[2], 1.0);
+    }
+  timer.Stop(LUTStage);
+  this->addFreeSurferImportMeasurements(measurements);
+  return colorTableNode;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::addFreeSurferAnnotation(std::string name, vtkDataArray* parcelIndices,
+  vtkMRMLColorTableNode* colorTableNode, const std::vector<vtkMRMLModelNode*>& modelNodes)
+{
+  if (!colorTableNode || !this->addFreeSurferScalarOverlay(name, parcelIndices, modelNodes))
+    {
+    return false;
+    }
+
+  for (vtkMRMLModelNode* modelNode : modelNodes)
+    {
+    vtkMRMLModelDisplayNode* displayNode = modelNode ? modelNode->GetModelDisplayNode() : nullptr;
+    vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+    vtkPolyData* polyData = levelsOfDetail ? levelsOfDetail->GetInput() : (modelNode ? modelNode->GetPolyData() : nullptr);
+    if (!displayNode || !polyData || polyData->GetPointData()->GetArray(name.c_str()) != parcelIndices)
+      {
+      continue;
+      }
+    // Parcels are shown with the colors of the annotation, unlabeled vertices (-1) with the below range color
+    displayNode->SetActiveScalarName(name.c_str());
+    displayNode->SetAndObserveColorNodeID(colorTableNode->GetID());
+    displayNode->SetScalarRangeFlag(vtkMRMLDisplayNode::UseColorNodeScalarRange);
+    displayNode->ScalarVisibilityOn();
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLTableNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferParcelStatisticsTable(vtkMRMLModelNode* modelNode,
+  std::string annotationName, const std::vector<std::string>& overlayNames)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+  vtkPolyData* polyData = levelsOfDetail ? levelsOfDetail->GetInput() : (modelNode ? modelNode->GetPolyData() : nullptr);
+  if (!scene || !polyData)
+    {
+    return nullptr;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, annotationName);
+  vtkNew<vtkFreeSurferParcelStatistics> statistics;
+  statistics->SetParcelIndices(polyData->GetPointData()->GetArray(annotationName.c_str()));
+  if (!statistics->GetParcelIndices())
+    {
+    vtkErrorMacro("addFreeSurferParcelStatisticsTable: " << modelNode->GetName() << " has no annotation " << annotationName);
+    return nullptr;
+    }
+  for (const std::string& overlayName : overlayNames)
+    {
+    vtkDataArray* overlay = polyData->GetPointData()->GetArray(overlayName.c_str());
+    if (!overlay)
+      {
+      vtkErrorMacro("addFreeSurferParcelStatisticsTable: " << modelNode->GetName() << " has no overlay " << overlayName);
+      return nullptr;
+      }
+    // Statistics of overlays stored with reduced precision are computed from their original values
+    vtkSmartPointer<vtkFloatArray> originalValues = vtkFreeSurferQuantizer::Dequantize(overlay);
+    statistics->AddOverlay(originalValues ? originalValues.GetPointer() : overlay);
+    }
+  statistics->SetVertexAreas(vtkFreeSurferParcelStatistics::ComputeVertexAreas(polyData));
+
+  // The annotation is usually shown with its color table, otherwise the table is found by name
+  vtkMRMLColorTableNode* colorTableNode = nullptr;
+  vtkMRMLDisplayNode* displayNode = modelNode->GetDisplayNode();
+  if (displayNode && displayNode->GetActiveScalarName() && annotationName == displayNode->GetActiveScalarName())
+    {
+    colorTableNode = vtkMRMLColorTableNode::SafeDownCast(displayNode->GetColorNode());
+    }
+  if (!colorTableNode)
+    {
+    colorTableNode = vtkMRMLColorTableNode::SafeDownCast(scene->GetFirstNode(annotationName.c_str(), "vtkMRMLColorTableNode"));
+    }
+  if (colorTableNode)
+    {
+    std::vector<std::string> parcelNames(colorTableNode->GetNumberOfColors());
+    for (int i = 0; i < colorTableNode->GetNumberOfColors(); ++i)
+      {
+      const char* colorName = colorTableNode->GetColorName(i);
+      parcelNames[i] = colorName ? colorName : "";
+      }
+    statistics->SetParcelNames(parcelNames);
+    }
+
+  if (!statistics->Compute())
+    {
+    return nullptr;
+    }
+  timer.Stop(SurfaceProcessingStage);
+
+  std::string tableName = std::string(modelNode->GetName() ? modelNode->GetName() : "") + " " + annotationName + " statistics";
+  vtkMRMLTableNode* tableNode = vtkMRMLTableNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLTableNode", tableName));
+  if (tableNode)
+    {
+    tableNode->SetAndObserveTable(statistics->GetOutput());
+    }
+  timer.Stop(SceneStage);
+  this->addFreeSurferImportMeasurements(measurements);
+  return tableNode;
+}
+
+//-----------------------------------------------------------------------------
+namespace
+{
+  // Surfaces are centered on the middle voxel of the reference volume
+  void ComputeSurfaceToRASTransform(const int extent[6], const int dimensions[3], vtkMatrix4x4* ijkToRAS, vtkMatrix4x4* surfaceToRAS)
+  {
+    double center[4] = { 0, 0, 0, 1 };
+    for (int i = 0; i < 3; ++i)
+      {
+      center[i] = extent[2 * i] + std::ceil((dimensions[i] / 2.0));
+      }
+    ijkToRAS->MultiplyPoint(center, center);
+
+    surfaceToRAS->Identity();
+    for (int i = 0; i < 3; ++i)
+      {
+      surfaceToRAS->SetElement(i, 3, center[i]);
+      }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::transformFreeSurferModelToRAS(vtkMRMLModelNode* modelNode, vtkMRMLScalarVolumeNode* origVolumeNode)
+{
+  if (!modelNode || !origVolumeNode || !origVolumeNode->GetImageData())
+    {
+    return;
+    }
+
+  // Placeholder volumes have the extent of the volume, they are not decoded
+  int extent[6] = { 0 };
+  origVolumeNode->GetImageData()->GetExtent(extent);
+
+  int dimensions[3] = { 0 };
+  origVolumeNode->GetImageData()->GetDimensions(dimensions);
+
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  origVolumeNode->GetIJKToRASMatrix(ijkToRAS);
+
+  vtkNew<vtkMatrix4x4> surfaceToRAS;
+  ComputeSurfaceToRASTransform(extent, dimensions, ijkToRAS, surfaceToRAS);
+  this->transformFreeSurferModelToRAS(modelNode, surfaceToRAS);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::transformFreeSurferModelToRAS(vtkMRMLModelNode* modelNode, vtkMatrix4x4* surfaceToRAS)
+{
+  if (!modelNode || !surfaceToRAS || !modelNode->GetPolyData())
+    {
+    return;
+    }
+  MeasurementList measurements;
+  StageTimer timer(&measurements, GetNodeFileName(modelNode));
+  vtkFreeSurferSurfaceLOD* levelsOfDetail = this->getFreeSurferModelLevelsOfDetail(modelNode);
+  if (!levelsOfDetail)
+    {
+    TransformPolyData(modelNode->GetPolyData(), surfaceToRAS);
+    }
+  for (int level = 0; levelsOfDetail && level < levelsOfDetail->GetNumberOfAvailableLevels(); ++level)
+    {
+    TransformPolyData(levelsOfDetail->GetLevel(level), surfaceToRAS);
+    }
+  timer.Stop(TransformStage, 0.0, GetMegabytes(modelNode->GetPolyData()->GetPoints()->GetData()));
+  this->addFreeSurferImportMeasurements(measurements);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::getFreeSurferSurfaceToRASTransform(std::string origFile, vtkMatrix4x4* surfaceToRAS)
+{
+  if (!surfaceToRAS)
+    {
+    return false;
+    }
+
+  vtkFreeSurferMGHReader::Header header;
+  if (!vtkFreeSurferMGHReader::ReadHeader(origFile, header))
+    {
+    vtkErrorMacro("getFreeSurferSurfaceToRASTransform: Could not read MGH header of " << origFile);
+    return false;
+    }
+
+  int extent[6] = { 0, header.Dimensions[0] - 1, 0, header.Dimensions[1] - 1, 0, header.Dimensions[2] - 1 };
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  vtkFreeSurferMGHReader::ComputeIJKToRASMatrix(header, ijkToRAS);
+  ComputeSurfaceToRASTransform(extent, header.Dimensions, ijkToRAS, surfaceToRAS);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::registerFreeSurferColorLUT(std::string name, std::string fileName)
+{
+  this->ColorLUTFileNames[name] = fileName;
+}
+
+//-----------------------------------------------------------------------------
+vtkSmartPointer<vtkFreeSurferColorLUT> vtkSlicerFreeSurferImporterLogic::getFreeSurferColorLUT(std::string name/*=DefaultColorLUTName*/)
+{
+  std::string lutFileName;
+  std::map<std::string, std::string>::iterator lutIt = this->ColorLUTFileNames.find(name);
+  if (lutIt != this->ColorLUTFileNames.end())
+    {
+    lutFileName = lutIt->second;
+    }
+  else if (name == DefaultColorLUTName)
+    {
+    lutFileName = this->GetModuleShareDirectory() + "/FreeSurferColorLUT.txt";
+    }
+  else
+    {
+    vtkErrorMacro("getFreeSurferColorLUT: Color table " << name << " is not registered");
+    return nullptr;
+    }
+
+  return vtkFreeSurferColorLUT::GetCachedLUT(lutFileName);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::applyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentationNode, vtkFreeSurferColorLUT* lut/*=nullptr*/)
+{
+  if (!segmentationNode)
+    {
+    return;
+    }
+
+  vtkSmartPointer<vtkFreeSurferColorLUT> colorLUT = lut;
+  if (!colorLUT)
+    {
+    colorLUT = this->getFreeSurferColorLUT();
+    }
+  if (!colorLUT)
+    {
+    return;
+    }
+
+  MeasurementList measurements;
+  StageTimer timer(&measurements, GetNodeFileName(segmentationNode));
+  MRMLNodeModifyBlocker blocker(segmentationNode);
+
+  vtkFreeSurferColorLUT::LabelInfo unknownInfo;
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  for (int i = 0; i < segmentation->GetNumberOfSegments(); ++i)
+    {
+    vtkSegment* segment = segmentation->GetNthSegment(i);
+    const vtkFreeSurferColorLUT::LabelInfo* info = colorLUT->GetLabelInfo(segment->GetLabelValue());
+    if (!info)
+      {
+      info = &unknownInfo;
+      }
+    segment->SetName(info->Name.c_str());
+    segment->SetColor(info->Color[0], info->Color[1], info->Color[2]);
+    }
+  timer.Stop(LUTStage);
+  this->addFreeSurferImportMeasurements(measurements);
+}
+
+//-----------------------------------------------------------------------------
+vtkFreeSurferSubjectIndex* vtkSlicerFreeSurferImporterLogic::getFreeSurferSubjectIndex(std::string subjectDirectory, bool update/*=false*/)
+{
+  std::string directory = vtksys::SystemTools::CollapseFullPath(subjectDirectory);
+  std::list<std::pair<std::string, vtkSmartPointer<vtkFreeSurferSubjectIndex> > >& subjectIndices = this->Internal->SubjectIndices;
+  for (auto indexIt = subjectIndices.begin(); indexIt != subjectIndices.end(); ++indexIt)
+    {
+    if (indexIt->first != directory)
+      {
+      continue;
+      }
+    subjectIndices.splice(subjectIndices.begin(), subjectIndices, indexIt);
+    vtkFreeSurferSubjectIndex* subjectIndex = subjectIndices.front().second;
+    if (update)
+      {
+      subjectIndex->Update();
+      }
+    return subjectIndex;
+    }
+
+  vtkSmartPointer<vtkFreeSurferSubjectIndex> subjectIndex = vtkSmartPointer<vtkFreeSurferSubjectIndex>::New();
+  subjectIndex->SetSubjectDirectory(directory);
+  subjectIndex->Update();
+  subjectIndices.emplace_front(directory, subjectIndex);
+  if (subjectIndices.size() > vtkInternal::MaximumNumberOfSubjectIndices)
+    {
+    subjectIndices.pop_back();
+    }
+  return subjectIndex;
+}
+
+//-----------------------------------------------------------------------------
+int vtkSlicerFreeSurferImporterLogic::getFreeSurferFileType(std::string fileName)
+{
+  std::string name = vtksys::SystemTools::GetFilenameName(fileName);
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(name));
+  if (extension == ".mgz" || extension == ".mgh")
+    {
+    // Label volumes: segmentations (aseg, aparc+aseg, *.seg.mgz) and white matter parcellations (wmparc)
+    bool labelVolume = name.find("seg") != std::string::npos || name.find("parc") != std::string::npos;
+    return labelVolume ? SegmentationFile : VolumeFile;
+    }
+  if (extension == ".cor" || extension == ".bshort")
+    {
+    return VolumeFile;
+    }
+  if (extension == ".annot")
+    {
+    return AnnotationFile;
+    }
+  if (extension == ".label")
+    {
+    return LabelFile;
+    }
+
+  // Surfaces and overlays are named after the hemisphere (lh.white, rh.thickness, ...)
+  if (name.size() < 4 || (name.compare(0, 3, "lh.") != 0 && name.compare(0, 3, "rh.") != 0))
+    {
+    return -1;
+    }
+  std::string surfaceName = name.substr(3);
+  if (surfaceName == "white" || surfaceName == "pial" || surfaceName == "inflated"
+    || surfaceName == "sphere" || surfaceName == "sphere.reg" || surfaceName == "orig")
+    {
+    return ModelFile;
+    }
+  if (surfaceName.compare(0, 4, "area") == 0 || surfaceName.compare(0, 4, "curv") == 0
+    || surfaceName == "sulc" || surfaceName == "thickness" || extension == ".w")
+    {
+    return ScalarOverlayFile;
+    }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::readFreeSurferFile(FreeSurferImportItem& item)
+{
+  std::string fileName = item.Directory + item.Name;
+  switch (item.Type)
+    {
+    case VolumeFile:
+      {
+      if (!vtkFreeSurferMGHReader::CanReadFile(fileName))
+        {
+        return false;
+        }
+      vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+      vtkSmartPointer<vtkMatrix4x4> ijkToRAS = vtkSmartPointer<vtkMatrix4x4>::New();
+      if (!ReadMGHImage(fileName, imageData, ijkToRAS, this->DecodedDataCache, &item.Measurements))
+        {
+        return false;
+        }
+      SetStoredScalars(fileName, imageData, this->StorageMode, &item.Measurements);
+      item.Data = imageData;
+      item.IJKToRAS = ijkToRAS;
+      return true;
+      }
+    case SegmentationFile:
+      {
+      if (!vtkFreeSurferMGHReader::CanReadFile(fileName))
+        {
+        return false;
+        }
+      vtkSmartPointer<vtkImageData> labelImage = vtkSmartPointer<vtkImageData>::New();
+      vtkSmartPointer<vtkMatrix4x4> ijkToRAS = vtkSmartPointer<vtkMatrix4x4>::New();
+      if (!ReadMGHImage(fileName, labelImage, ijkToRAS, this->DecodedDataCache, &item.Measurements))
+        {
+        return false;
+        }
+      item.Data = labelImage;
+      item.IJKToRAS = ijkToRAS;
+      return true;
+      }
+    case ModelFile:
+      {
+      vtkSmartPointer<vtkPolyData> surface = vtkSmartPointer<vtkPolyData>::New();
+      vtkSmartPointer<vtkFreeSurferSurfaceLOD> levelsOfDetail;
+      if (this->NumberOfSurfaceLevelsOfDetail > 1)
+        {
+        levelsOfDetail = vtkSmartPointer<vtkFreeSurferSurfaceLOD>::New();
+        levelsOfDetail->SetNumberOfLevels(this->NumberOfSurfaceLevelsOfDetail);
+        }
+      if (!ReadSurface(fileName, item.SurfaceToRAS, surface, this->Internal->GetSharedTopologies(this->ShareSurfaceTopology, fileName),
+        this->DecodedDataCache, levelsOfDetail, &item.Measurements))
+        {
+        return false;
+        }
+      item.Data = surface;
+      item.LevelsOfDetail = levelsOfDetail;
+      return true;
+      }
+    case ScalarOverlayFile:
+      {
+      // Overlays are decoded once here and shared by all models of the hemisphere
+      if (!vtkFreeSurferOverlayReader::CanReadFile(fileName) && !vtkFreeSurferOverlayReader::IsPaintFile(fileName))
+        {
+        return false;
+        }
+      vtkSmartPointer<vtkFloatArray> overlay = ReadOverlay(fileName, this->DecodedDataCache, &item.Measurements);
+      if (!overlay)
+        {
+        return false;
+        }
+      item.Data = GetStoredValues(fileName, overlay, this->StorageMode, &item.Measurements);
+      return true;
+      }
+    case AnnotationFile:
+      {
+      // Annotations are decoded once here and shared by all models of the hemisphere
+      vtkSmartPointer<vtkFreeSurferColorLUT> colorTable;
+      vtkSmartPointer<vtkIntArray> parcelIndices = ReadAnnotation(fileName, colorTable, &item.Measurements);
+      if (!parcelIndices)
+        {
+        return false;
+        }
+      item.Data = parcelIndices;
+      item.ColorTable = colorTable;
+      return true;
+      }
+    default:
+      // Other formats are loaded through storage nodes on the main thread
+      return false;
+    }
 }
 
-//----------------------------------------------------------------------------
-vtkSlicerFreeSurferImporterLogic::~vtkSlicerFreeSurferImporterLogic()
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::readFreeSurferFiles(std::vector<FreeSurferImportItem>& items)
 {
+  std::vector<unsigned long> fileSizes = GetFileSizes(items);
+  RunInParallel(GetLargestFirstOrder(fileSizes), GetNumberOfWorkerThreads(this->NumberOfThreads), [this, &items](int index)
+    {
+    this->readFreeSurferFile(items[index]);
+    });
 }
 
-//----------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::PrintSelf(ostream& os, vtkIndent indent)
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::addFreeSurferFileToScene(FreeSurferImportItem& item, const std::vector<vtkMRMLModelNode*>& modelNodes)
 {
-  this->Superclass::PrintSelf(os, indent);
-}
+  item.Node = nullptr;
+  item.Success = false;
 
-//---------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
-{
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  // Stages measured on the worker threads are reported from here, on the main thread
+  this->addFreeSurferImportMeasurements(item.Measurements);
+  item.Measurements.clear();
+
+  switch (item.Type)
+    {
+    case VolumeFile:
+      if (vtkImageData::SafeDownCast(item.Data))
+        {
+        item.Node = this->addFreeSurferVolumeNode(item.Directory + item.Name, item.Name,
+          vtkImageData::SafeDownCast(item.Data), item.IJKToRAS);
+        }
+      else
+        {
+        item.Node = this->loadFreeSurferVolume(item.Directory, item.Name);
+        }
+      item.Success = item.Node != nullptr;
+      break;
+    case SegmentationFile:
+      // Segmentations are always decoded by readFreeSurferFile, a missing label image means that the read failed
+      if (vtkImageData::SafeDownCast(item.Data))
+        {
+        item.Node = this->addFreeSurferSegmentationNode(item.Directory + item.Name, item.Name,
+          vtkImageData::SafeDownCast(item.Data), item.IJKToRAS);
+        }
+      item.Success = item.Node != nullptr;
+      break;
+    case ModelFile:
+      {
+      vtkMRMLModelNode* modelNode = nullptr;
+      if (vtkPolyData::SafeDownCast(item.Data))
+        {
+        modelNode = this->addFreeSurferModelNode(item.Name, vtkPolyData::SafeDownCast(item.Data), item.LevelsOfDetail,
+          item.Directory + item.Name);
+        }
+      else
+        {
+        modelNode = this->loadFreeSurferModel(item.Directory, item.Name);
+        if (modelNode && item.SurfaceToRAS)
+          {
+          this->transformFreeSurferModelToRAS(modelNode, item.SurfaceToRAS);
+          }
+        }
+      if (modelNode)
+        {
+        MeasurementList measurements;
+        StageTimer timer(&measurements, item.Directory + item.Name);
+        modelNode->CreateDefaultDisplayNodes();
+        timer.Stop(SceneStage);
+        this->addFreeSurferImportMeasurements(measurements);
+        }
+      item.Node = modelNode;
+      item.Success = item.Node != nullptr;
+      break;
+      }
+    case ScalarOverlayFile:
+      // Curvature and paint files are always decoded by readFreeSurferFile
+      if (vtkDataArray::SafeDownCast(item.Data))
+        {
+        item.Success = this->addFreeSurferScalarOverlay(item.Name, vtkDataArray::SafeDownCast(item.Data), modelNodes);
+        }
+      break;
+    case AnnotationFile:
+      {
+      if (vtkDataArray::SafeDownCast(item.Data))
+        {
+        vtkMRMLColorTableNode* colorTableNode = this->addFreeSurferAnnotationColorTableNode(item.Name, item.ColorTable);
+        item.Success = this->addFreeSurferAnnotation(item.Name, vtkDataArray::SafeDownCast(item.Data), colorTableNode, modelNodes);
+        if (item.Success)
+          {
+          item.Node = colorTableNode;
+          }
+        else if (colorTableNode)
+          {
+          this->GetMRMLScene()->RemoveNode(colorTableNode);
+          }
+        }
+      break;
+      }
+    default:
+      break;
+    }
+
+  // The scene holds the data from now on
+  item.Data = nullptr;
+  item.IJKToRAS = nullptr;
+  item.LevelsOfDetail = nullptr;
+  item.ColorTable = nullptr;
+  return item.Success;
 }
 
 //-----------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::RegisterNodes()
+bool vtkSlicerFreeSurferImporterLogic::loadFreeSurferFiles(std::vector<FreeSurferImportItem>& items)
 {
-  assert(this->GetMRMLScene() != 0);
-}
+  if (this->LazyLoading)
+    {
+    return this->addFreeSurferPlaceholderNodes(items);
+    }
 
-//---------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::UpdateFromMRMLScene()
-{
-  assert(this->GetMRMLScene() != 0);
+  this->readFreeSurferFiles(items);
+  return this->addFreeSurferFilesToScene(items);
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::addFreeSurferFilesToScene(std::vector<FreeSurferImportItem>& items)
 {
+  bool success = true;
+  std::vector<vtkMRMLModelNode*> modelNodes;
+
+  // Overlays and annotations are added last, once the surfaces they apply to are in the scene
+  for (FreeSurferImportItem& item : items)
+    {
+    if (IsPerVertexFileType(item.Type))
+      {
+      continue;
+      }
+    if (!this->addFreeSurferFileToScene(item, modelNodes))
+      {
+      success = false;
+      continue;
+      }
+    if (vtkMRMLModelNode::SafeDownCast(item.Node))
+      {
+      modelNodes.push_back(vtkMRMLModelNode::SafeDownCast(item.Node));
+      }
+    }
+
+  for (FreeSurferImportItem& item : items)
+    {
+    if (!IsPerVertexFileType(item.Type))
+      {
+      continue;
+      }
+    if (!this->addFreeSurferFileToScene(item, modelNodes))
+      {
+      success = false;
+      }
+    }
+
+  return success;
 }
 
-//---------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+//-----------------------------------------------------------------------------
+namespace
 {
+  //----------------------------------------------------------------------------
+  template<typename T>
+  std::string JoinValues(const T* values, int numberOfValues)
+  {
+    std::ostringstream stream;
+    for (int i = 0; i < numberOfValues; ++i)
+      {
+      stream << (i > 0 ? " " : "") << values[i];
+      }
+    return stream.str();
+  }
+
+  //----------------------------------------------------------------------------
+  void SetImageHeaderAttributes(vtkMRMLNode* node, const vtkFreeSurferMGHReader::Header& header, vtkMatrix4x4* ijkToRAS)
+  {
+    int vtkScalarType = VTK_VOID;
+    int valueSize = 0;
+    vtkFreeSurferMGHReader::GetScalarTypeInfo(header.Type, vtkScalarType, valueSize);
+
+    // RAS bounds of the voxel centers
+    double bounds[6] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+    for (int corner = 0; corner < 8; ++corner)
+      {
+      double ijk[4] = { 0.0, 0.0, 0.0, 1.0 };
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        ijk[axis] = (corner & (1 << axis)) ? header.Dimensions[axis] - 1 : 0;
+        }
+      double ras[4] = { 0.0, 0.0, 0.0, 1.0 };
+      ijkToRAS->MultiplyPoint(ijk, ras);
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        bounds[2 * axis] = std::min(bounds[2 * axis], ras[axis]);
+        bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], ras[axis]);
+        }
+      }
+
+    node->SetAttribute("FreeSurferImporter.Dimensions", JoinValues(header.Dimensions, 3).c_str());
+    node->SetAttribute("FreeSurferImporter.Spacing", JoinValues(header.Spacing, 3).c_str());
+    node->SetAttribute("FreeSurferImporter.NumberOfFrames", std::to_string(header.NumberOfFrames).c_str());
+    node->SetAttribute("FreeSurferImporter.ScalarType", vtkImageScalarTypeNameMacro(vtkScalarType));
+    node->SetAttribute("FreeSurferImporter.Bounds", JoinValues(bounds, 6).c_str());
+  }
 }
 
 //-----------------------------------------------------------------------------
-vtkMRMLScalarVolumeNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferVolume(std::string fsDirectory, std::string name)
+bool vtkSlicerFreeSurferImporterLogic::addFreeSurferPlaceholderNodes(std::vector<FreeSurferImportItem>& items)
 {
-  std::string volumeFile = fsDirectory + name;
-  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLScalarVolumeNode"));
-  volumeNode->SetName(name.c_str());
-  volumeNode->AddDefaultStorageNode(volumeFile.c_str());
+  bool success = true;
+  std::vector<vtkMRMLModelNode*> modelNodes;
+  std::vector<vtkMRMLModelNode*> loadedModelNodes;
 
-  vtkMRMLVolumeArchetypeStorageNode* volumeStorageNode = vtkMRMLVolumeArchetypeStorageNode::SafeDownCast(volumeNode->GetStorageNode());
-  if (volumeStorageNode->ReadData(volumeNode))
+  for (FreeSurferImportItem& item : items)
     {
-    volumeNode->CreateDefaultDisplayNodes();
-    return volumeNode;
+    if (IsPerVertexFileType(item.Type))
+      {
+      continue;
+      }
+    item.Node = this->addFreeSurferPlaceholderNode(item);
+    item.Success = item.Node != nullptr;
+    if (!item.Node)
+      {
+      // No header to read, the file is loaded now
+      this->readFreeSurferFile(item);
+      if (this->addFreeSurferFileToScene(item, loadedModelNodes) && vtkMRMLModelNode::SafeDownCast(item.Node))
+        {
+        loadedModelNodes.push_back(vtkMRMLModelNode::SafeDownCast(item.Node));
+        }
+      }
+    if (vtkMRMLModelNode::SafeDownCast(item.Node))
+      {
+      modelNodes.push_back(vtkMRMLModelNode::SafeDownCast(item.Node));
+      }
+    success &= item.Success;
     }
 
-  this->GetMRMLScene()->RemoveNode(volumeStorageNode);
-  this->GetMRMLScene()->RemoveNode(volumeNode);
-  return nullptr;
+  // Overlays and annotations are attached to the placeholders of their hemisphere and decoded with them
+  for (FreeSurferImportItem& item : items)
+    {
+    if (!IsPerVertexFileType(item.Type))
+      {
+      continue;
+      }
+    item.Node = nullptr;
+    item.Success = false;
+    int numberOfValues = 0;
+    bool hasOverlayInfo = item.Type == AnnotationFile
+      ? vtkFreeSurferAnnotationReader::ReadAnnotationInfo(item.Directory + item.Name, numberOfValues)
+      : vtkFreeSurferOverlayReader::ReadOverlayInfo(item.Directory + item.Name, numberOfValues);
+    for (vtkMRMLModelNode* modelNode : modelNodes)
+      {
+      std::map<std::string, vtkInternal::Placeholder>::iterator placeholderIt = this->Internal->Placeholders.find(modelNode->GetID());
+      if (placeholderIt != this->Internal->Placeholders.end() && IsModelOfHemisphere(modelNode, item.Name)
+        && (!hasOverlayInfo || placeholderIt->second.NumberOfVertices == numberOfValues))
+        {
+        placeholderIt->second.Overlays.push_back(item);
+        item.Success = true;
+        }
+      }
+    if (!loadedModelNodes.empty())
+      {
+      FreeSurferImportItem loadedItem = item;
+      this->readFreeSurferFile(loadedItem);
+      item.Success |= this->addFreeSurferFileToScene(loadedItem, loadedModelNodes);
+      }
+    success &= item.Success;
+    }
+
+  return success;
 }
 
 //-----------------------------------------------------------------------------
-vtkMRMLSegmentationNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferSegmentation(std::string fsDirectory, std::string name)
+vtkMRMLNode* vtkSlicerFreeSurferImporterLogic::addFreeSurferPlaceholderNode(FreeSurferImportItem& item)
 {
-  std::string segmentationFile = fsDirectory + name;
-  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLSegmentationNode"));
-  if (!segmentationNode)
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
     {
     return nullptr;
     }
-  segmentationNode->SetName(name.c_str());
-  segmentationNode->AddDefaultStorageNode(segmentationFile.c_str());
 
-  vtkMRMLSegmentationStorageNode* segmentationStorageNode = vtkMRMLSegmentationStorageNode::SafeDownCast(segmentationNode->GetStorageNode());
-  if (segmentationStorageNode && segmentationStorageNode->ReadData(segmentationNode))
+  std::string fileName = item.Directory + item.Name;
+  vtkInternal::Placeholder placeholder;
+  placeholder.Item = item;
+  vtkMRMLNode* node = nullptr;
+  vtkMRMLDisplayNode* displayNode = nullptr;
+  switch (item.Type)
     {
-    this->applyFreeSurferSegmentationLUT(segmentationNode);
-    return segmentationNode;
+    case VolumeFile:
+    case SegmentationFile:
+      {
+      vtkFreeSurferMGHReader::Header header;
+      if (!vtkFreeSurferMGHReader::CanReadFile(fileName) || !vtkFreeSurferMGHReader::ReadHeader(fileName, header))
+        {
+        return nullptr;
+        }
+      vtkNew<vtkMatrix4x4> ijkToRAS;
+      vtkFreeSurferMGHReader::ComputeIJKToRASMatrix(header, ijkToRAS);
+
+      if (item.Type == VolumeFile)
+        {
+        vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLScalarVolumeNode"));
+        if (!volumeNode)
+          {
+          return nullptr;
+          }
+        // The image has the geometry of the volume but no scalars until the volume is decoded,
+        // with unit spacing and zero origin like the images read by vtkFreeSurferMGHReader
+        vtkNew<vtkImageData> imageData;
+        imageData->SetExtent(0, header.Dimensions[0] - 1, 0, header.Dimensions[1] - 1, 0, header.Dimensions[2] - 1);
+        imageData->SetSpacing(1.0, 1.0, 1.0);
+        imageData->SetOrigin(0.0, 0.0, 0.0);
+        volumeNode->SetIJKToRASMatrix(ijkToRAS);
+        volumeNode->SetAndObserveImageData(imageData);
+        volumeNode->AddDefaultStorageNode(fileName.c_str());
+        volumeNode->CreateDefaultDisplayNodes();
+
+        // Volumes are decoded when one of their display nodes is modified, e.g. when volume rendering is enabled
+        vtkNew<vtkIntArray> events;
+        events->InsertNextValue(vtkMRMLDisplayableNode::DisplayModifiedEvent);
+        this->GetMRMLNodesObserverManager()->AddObjectEvents(volumeNode, events);
+        node = volumeNode;
+        }
+      else
+        {
+        vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLSegmentationNode"));
+        if (!segmentationNode)
+          {
+          return nullptr;
+          }
+        segmentationNode->AddDefaultStorageNode(fileName.c_str());
+        segmentationNode->CreateDefaultDisplayNodes();
+        displayNode = segmentationNode->GetDisplayNode();
+        node = segmentationNode;
+        }
+      SetImageHeaderAttributes(node, header, ijkToRAS);
+      break;
+      }
+    case ModelFile:
+      {
+      int numberOfFaces = 0;
+      if (!vtkFreeSurferSurfaceReader::ReadSurfaceInfo(fileName, placeholder.NumberOfVertices, numberOfFaces))
+        {
+        return nullptr;
+        }
+      vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLModelNode"));
+      if (!modelNode)
+        {
+        return nullptr;
+        }
+      modelNode->SetAttribute("FreeSurferImporter.NumberOfVertices", std::to_string(placeholder.NumberOfVertices).c_str());
+      modelNode->SetAttribute("FreeSurferImporter.NumberOfFaces", std::to_string(numberOfFaces).c_str());
+      AddFreeSurferModelStorageNode(scene, modelNode, fileName);
+      modelNode->CreateDefaultDisplayNodes();
+      displayNode = modelNode->GetDisplayNode();
+      node = modelNode;
+      break;
+      }
+    default:
+      return nullptr;
     }
 
-  this->GetMRMLScene()->RemoveNode(segmentationStorageNode);
-  this->GetMRMLScene()->RemoveNode(segmentationNode);
-  return nullptr;
+  node->SetName(item.Name.c_str());
+  node->SetAttribute(PlaceholderAttributeName, "1");
+  node->SetAttribute("FreeSurferImporter.FileName", fileName.c_str());
+  this->Internal->Placeholders[node->GetID()] = placeholder;
+
+  // Models and segmentations are added hidden and decoded when they are shown
+  if (displayNode)
+    {
+    displayNode->SetVisibility(false);
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue(vtkCommand::ModifiedEvent);
+    this->GetMRMLNodesObserverManager()->AddObjectEvents(displayNode, events);
+    }
+  return node;
 }
 
 //-----------------------------------------------------------------------------
-vtkMRMLModelNode* vtkSlicerFreeSurferImporterLogic::loadFreeSurferModel(std::string fsDirectory, std::string name)
+bool vtkSlicerFreeSurferImporterLogic::isFreeSurferPlaceholderNode(vtkMRMLNode* node)
 {
-  std::string surfFile = fsDirectory + name;
-  vtkMRMLModelNode* surfNode = vtkMRMLModelNode::SafeDownCast(this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLModelNode"));
-  if (!surfNode)
+  return node && node->GetID() && this->Internal->Placeholders.count(node->GetID()) > 0;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::loadFreeSurferPlaceholderNode(vtkMRMLNode* node)
+{
+  if (!this->isFreeSurferPlaceholderNode(node))
     {
-    return nullptr;
+    return false;
+    }
+
+  // The placeholder is removed first, the node is modified while it is decoded
+  vtkInternal::Placeholder placeholder = this->Internal->Placeholders[node->GetID()];
+  this->Internal->Placeholders.erase(node->GetID());
+  node->RemoveAttribute(PlaceholderAttributeName);
+  if (vtkMRMLScalarVolumeNode::SafeDownCast(node))
+    {
+    this->GetMRMLNodesObserverManager()->RemoveObjectEvents(node);
     }
-  surfNode->SetName(name.c_str());
 
-  vtkMRMLFreeSurferModelStorageNode* surfStorageNode = vtkMRMLFreeSurferModelStorageNode::SafeDownCast(
-    this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLFreeSurferModelStorageNode"));
-  if (surfStorageNode)
+  FreeSurferImportItem& item = placeholder.Item;
+  bool success = this->readFreeSurferFile(item);
+  this->addFreeSurferImportMeasurements(item.Measurements);
+  item.Measurements.clear();
+  MeasurementList measurements;
+  StageTimer timer(&measurements, item.Directory + item.Name);
+  if (success)
     {
-    surfNode->SetAndObserveStorageNodeID(surfStorageNode->GetID());
-    surfStorageNode->SetFileName(surfFile.c_str());
-    if (surfStorageNode->ReadData(surfNode))
+    switch (item.Type)
       {
-      return surfNode;
+      case VolumeFile:
+        {
+        vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+        volumeNode->SetIJKToRASMatrix(item.IJKToRAS);
+        volumeNode->SetAndObserveImageData(vtkImageData::SafeDownCast(item.Data));
+        timer.Stop(SceneStage);
+        break;
+        }
+      case SegmentationFile:
+        success = this->updateFreeSurferSegmentationNode(vtkMRMLSegmentationNode::SafeDownCast(node),
+          vtkImageData::SafeDownCast(item.Data), item.IJKToRAS);
+        break;
+      case ModelFile:
+        {
+        vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+        modelNode->SetAndObservePolyData(vtkPolyData::SafeDownCast(item.Data));
+        if (item.LevelsOfDetail && item.LevelsOfDetail->GetNumberOfAvailableLevels() > 1)
+          {
+          this->Internal->SurfaceLevelsOfDetail[modelNode->GetID()] = item.LevelsOfDetail;
+          }
+        timer.Stop(SceneStage);
+        std::vector<vtkMRMLModelNode*> modelNodes(1, modelNode);
+        for (FreeSurferImportItem& overlayItem : placeholder.Overlays)
+          {
+          // Overlays still used by another surface of the hemisphere are not decoded again
+          std::string overlayFile = overlayItem.Directory + overlayItem.Name;
+          vtkSmartPointer<vtkDataArray> overlay = this->Internal->PlaceholderOverlays[overlayFile].GetPointer();
+          vtkMRMLColorTableNode* colorTableNode = nullptr;
+          if (overlayItem.Type == AnnotationFile)
+            {
+            colorTableNode = vtkMRMLColorTableNode::SafeDownCast(
+              this->GetMRMLScene()->GetNodeByID(this->Internal->PlaceholderColorTableNodeIDs[overlayFile]));
+            }
+          bool decodeColorTable = overlayItem.Type == AnnotationFile && !colorTableNode;
+          if ((!overlay || decodeColorTable) && this->readFreeSurferFile(overlayItem))
+            {
+            overlay = vtkDataArray::SafeDownCast(overlayItem.Data);
+            this->Internal->PlaceholderOverlays[overlayFile] = overlay;
+            }
+          this->addFreeSurferImportMeasurements(overlayItem.Measurements);
+          overlayItem.Measurements.clear();
+          bool applied = false;
+          if (overlayItem.Type == AnnotationFile)
+            {
+            // The color table node is shared by the surfaces of the hemisphere, like the parcel indices
+            if (decodeColorTable && overlayItem.ColorTable)
+              {
+              colorTableNode = this->addFreeSurferAnnotationColorTableNode(overlayItem.Name, overlayItem.ColorTable);
+              this->Internal->PlaceholderColorTableNodeIDs[overlayFile] = colorTableNode ? colorTableNode->GetID() : "";
+              }
+            applied = this->addFreeSurferAnnotation(overlayItem.Name, overlay, colorTableNode, modelNodes);
+            }
+          else
+            {
+            // Formats that are not decoded natively are loaded through their storage node
+            applied = overlay ? this->addFreeSurferScalarOverlay(overlayItem.Name, overlay, modelNodes)
+              : this->loadFreeSurferScalarOverlay(overlayItem.Directory, overlayItem.Name, modelNodes);
+            }
+          overlayItem.Data = nullptr;
+          overlayItem.ColorTable = nullptr;
+          if (!applied)
+            {
+            vtkWarningMacro("loadFreeSurferPlaceholderNode: Could not apply overlay " << overlayFile);
+            }
+          }
+        break;
+        }
+      default:
+        success = false;
+        break;
       }
     }
+  item.Data = nullptr;
+  item.IJKToRAS = nullptr;
+  item.LevelsOfDetail = nullptr;
+  this->addFreeSurferImportMeasurements(measurements);
 
-  this->GetMRMLScene()->RemoveNode(surfStorageNode);
-  this->GetMRMLScene()->RemoveNode(surfNode);
-  return nullptr;
+  if (!success)
+    {
+    vtkErrorMacro("loadFreeSurferPlaceholderNode: Could not read " << item.Directory + item.Name);
+    }
+  return success;
 }
 
 //-----------------------------------------------------------------------------
-bool vtkSlicerFreeSurferImporterLogic::loadFreeSurferScalarOverlay(std::string fsDirectory, std::string name, std::vector<vtkMRMLModelNode*> modelNodes)
+bool vtkSlicerFreeSurferImporterLogic::startFreeSurferFilesImport(const std::vector<FreeSurferImportItem>& items)
 {
-  std::string hemisphereName = vtksys::SystemTools::GetFilenameWithoutExtension(name);
-
-  vtkMRMLFreeSurferModelOverlayStorageNode* overlayStorageNode = vtkMRMLFreeSurferModelOverlayStorageNode::SafeDownCast(
-    this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLFreeSurferModelOverlayStorageNode"));
-  if (!overlayStorageNode)
+  vtkInternal* internal = this->Internal;
+  if (internal->Running)
     {
+    vtkErrorMacro("startFreeSurferFilesImport: An import is already running");
     return false;
     }
-  std::string overlayFile = fsDirectory + name;
-  overlayStorageNode->SetFileName(overlayFile.c_str());
+  internal->JoinReadThread();
 
-  bool success = true;
-  int numberOfOverlayLoaded = 0;
-  for (vtkMRMLModelNode* modelNode : modelNodes)
+  internal->Items = items;
+  internal->FileSizes = GetFileSizes(items);
+  internal->ReadItems.clear();
+  internal->ItemsClaimed.assign(items.size(), false);
+  internal->PriorityItems.clear();
+  internal->BuiltLevels.clear();
+  internal->PendingOverlays.clear();
+  internal->ModelNodes.clear();
+  internal->PreviewVolumes.clear();
+  internal->VolumeNodes.clear();
+  internal->NumberOfFilesCompleted = 0;
+  internal->NumberOfFilesFailed = 0;
+  internal->NumberOfOverlaysDropped = 0;
+  internal->LastCompletedFileName.clear();
+  internal->NumberOfFilesRead = 0;
+  internal->BytesRead = 0;
+  internal->CancelRequested = false;
+  internal->ReadFinished = false;
+  internal->Running = true;
+  internal->StartTime = std::chrono::steady_clock::now();
+
+  // Volumes with saved preview levels are shown before any file is read
+  if (this->NumberOfVolumePreviewLevels > 1)
     {
-    if (!modelNode->GetName())
+    this->addFreeSurferVolumePreviews();
+    }
+
+  std::vector<int> itemOrder = GetLargestFirstOrder(internal->FileSizes);
+  int numberOfThreads = GetNumberOfWorkerThreads(this->NumberOfThreads);
+  int numberOfVolumeLevels = this->NumberOfVolumePreviewLevels;
+  internal->ReadThread = std::thread([this, internal, itemOrder, numberOfThreads, numberOfVolumeLevels]()
+    {
+    auto readItem = [this, internal, numberOfVolumeLevels](int index)
       {
-      continue;
-      }
+      FreeSurferImportItem& item = internal->Items[index];
+      this->readFreeSurferFile(item);
+      // Taken before the item is handed to the main thread, which releases the data once it is in the scene
+      std::string fileName = item.Directory + item.Name;
+      vtkSmartPointer<vtkImageData> volumeImage = (item.Type == VolumeFile && numberOfVolumeLevels > 1)
+        ? vtkImageData::SafeDownCast(item.Data) : nullptr;
+      internal->BytesRead += internal->FileSizes[index];
+      ++internal->NumberOfFilesRead;
+        {
+        std::lock_guard<std::mutex> lock(internal->ReadItemsMutex);
+        internal->ReadItems.push_back(index);
+        }
 
-    std::string modelNodeHemisphere = vtksys::SystemTools::GetFilenameWithoutExtension(modelNode->GetName());
-    if (modelNodeHemisphere != hemisphereName)
+      // The levels are built or loaded once the full resolution volume can be shown
+      if (!volumeImage || internal->CancelRequested)
+        {
+        return;
+        }
+      vtkInternal::BuiltVolumeLevels levels;
+      levels.Index = index;
+      levels.Pyramid = GetVolumePyramid(fileName, volumeImage, numberOfVolumeLevels, &levels.Measurements);
+      std::lock_guard<std::mutex> lock(internal->ReadItemsMutex);
+      internal->BuiltLevels.push_back(levels);
+      };
+    RunInParallel(itemOrder, numberOfThreads, [internal, readItem](int index)
       {
-      continue;
+      // Volumes requested by setFreeSurferVolumeLevel are read first, by the next free worker
+      for (int priorityIndex = internal->ClaimPriorityItem(); priorityIndex >= 0 && !internal->CancelRequested;
+        priorityIndex = internal->ClaimPriorityItem())
+        {
+        readItem(priorityIndex);
+        }
+      if (!internal->CancelRequested && internal->ClaimItem(index))
+        {
+        readItem(index);
+        }
+      });
+    internal->ReadFinished = true;
+    });
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> vtkSlicerFreeSurferImporterLogic::processFreeSurferFilesImport()
+{
+  vtkInternal* internal = this->Internal;
+  std::vector<FreeSurferImportItem> completedItems;
+  if (!internal->Running)
+    {
+    return completedItems;
+    }
+
+  // Check before taking the items so that no item read before the flag was set is missed
+  bool readFinished = internal->ReadFinished;
+  std::deque<int> readItems;
+  std::deque<vtkInternal::BuiltVolumeLevels> builtLevels;
+    {
+    // Taken together so that the volume of each level is added to the scene first
+    std::lock_guard<std::mutex> lock(internal->ReadItemsMutex);
+    readItems.swap(internal->ReadItems);
+    builtLevels.swap(internal->BuiltLevels);
+    }
+
+  auto completeItem = [this, internal, &completedItems](int index)
+    {
+    FreeSurferImportItem& item = internal->Items[index];
+    bool success = false;
+    std::map<int, vtkInternal::PreviewVolume>::iterator previewIt = internal->PreviewVolumes.find(index);
+    vtkMRMLScalarVolumeNode* previewNode = previewIt != internal->PreviewVolumes.end() ? previewIt->second.Node.GetPointer() : nullptr;
+    if (previewNode)
+      {
+      success = this->showFreeSurferVolumeFullResolution(previewNode, item);
+      }
+    else
+      {
+      std::vector<vtkMRMLModelNode*> modelNodes;
+      for (vtkMRMLModelNode* modelNode : internal->ModelNodes)
+        {
+        if (modelNode)
+          {
+          modelNodes.push_back(modelNode);
+          }
+        }
+      success = this->addFreeSurferFileToScene(item, modelNodes);
       }
+    if (previewIt != internal->PreviewVolumes.end())
+      {
+      internal->PreviewVolumes.erase(previewIt);
+      }
+    if (success)
+      {
+      ++internal->NumberOfFilesCompleted;
+      }
+    else
+      {
+      ++internal->NumberOfFilesFailed;
+      }
+    if (vtkMRMLModelNode::SafeDownCast(item.Node))
+      {
+      internal->ModelNodes.push_back(vtkMRMLModelNode::SafeDownCast(item.Node));
+      }
+    if (vtkMRMLScalarVolumeNode::SafeDownCast(item.Node))
+      {
+      internal->VolumeNodes[index] = vtkMRMLScalarVolumeNode::SafeDownCast(item.Node);
+      }
+    internal->LastCompletedFileName = item.Name;
+    completedItems.push_back(item);
+    };
 
-    // Scalar overlay is already loaded for this model
-    if (modelNode->HasCellScalarName(name.c_str()))
+  for (int index : readItems)
+    {
+    if (IsPerVertexFileType(internal->Items[index].Type))
       {
+      // Overlays and annotations are added once all surfaces are in the scene
+      internal->PendingOverlays.push_back(index);
       continue;
       }
+    completeItem(index);
+    }
 
-    if (!overlayStorageNode->ReadData(modelNode))
+  // The levels are used by setFreeSurferVolumeLevel if the volume node still shows the volume they were built from
+  for (const vtkInternal::BuiltVolumeLevels& levels : builtLevels)
+    {
+    this->addFreeSurferImportMeasurements(levels.Measurements);
+    std::map<int, vtkWeakPointer<vtkMRMLScalarVolumeNode> >::iterator volumeIt = internal->VolumeNodes.find(levels.Index);
+    vtkMRMLScalarVolumeNode* volumeNode = volumeIt != internal->VolumeNodes.end() ? volumeIt->second.GetPointer() : nullptr;
+    if (!volumeNode || !levels.Pyramid || levels.Pyramid->GetInput() != volumeNode->GetImageData()
+      || levels.Pyramid->GetNumberOfAvailableLevels() < 2)
       {
-      success = false;
       continue;
       }
-    numberOfOverlayLoaded += 1;
+    vtkInternal::VolumeLevels& volumeLevels = internal->VolumePyramids[volumeNode->GetID()];
+    volumeLevels.Pyramid = levels.Pyramid;
+    volumeLevels.IJKToRAS = vtkSmartPointer<vtkMatrix4x4>::New();
+    volumeNode->GetIJKToRASMatrix(volumeLevels.IJKToRAS);
     }
 
-  this->GetMRMLScene()->RemoveNode(overlayStorageNode);
-  if (numberOfOverlayLoaded == 0)
+  if (readFinished)
     {
-    success = false;
+    if (!internal->CancelRequested)
+      {
+      for (int index : internal->PendingOverlays)
+        {
+        completeItem(index);
+        }
+      }
+    else
+      {
+      internal->NumberOfOverlaysDropped += static_cast<int>(internal->PendingOverlays.size());
+      }
+    internal->PendingOverlays.clear();
+
+    // Previews of volumes that were not read because the import was canceled
+    for (const auto& preview : internal->PreviewVolumes)
+      {
+      if (preview.second.Node)
+        {
+        this->GetMRMLScene()->RemoveNode(preview.second.Node);
+        }
+      }
+    internal->PreviewVolumes.clear();
+    internal->VolumeNodes.clear();
+    internal->JoinReadThread();
+    internal->Running = false;
     }
-  return success;
+
+  return completedItems;
 }
 
 //-----------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::transformFreeSurferModelToRAS(vtkMRMLModelNode* modelNode, vtkMRMLScalarVolumeNode* origVolumeNode)
+void vtkSlicerFreeSurferImporterLogic::cancelFreeSurferFilesImport()
 {
-  if (!modelNode || !origVolumeNode)
-    {
-    return;
-    }
-
-  int extent[6] = { 0 };
-  origVolumeNode->GetImageData()->GetExtent(extent);
-
-  int dimensions[3] = { 0 };
-  origVolumeNode->GetImageData()->GetDimensions(dimensions);
+  this->Internal->CancelRequested = true;
+}
 
-  double center[4] = { 0, 0, 0, 1 };
-  for (int i = 0; i < 3; ++i)
+//-----------------------------------------------------------------------------
+std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> vtkSlicerFreeSurferImporterLogic::stopFreeSurferFilesImport()
+{
+  vtkInternal* internal = this->Internal;
+  if (!internal->Running)
     {
-    center[i] = extent[2 * i] + std::ceil((dimensions[i] / 2.0));
+    return std::vector<FreeSurferImportItem>();
     }
-
-  vtkNew<vtkMatrix4x4> ijkToRAS;
-  origVolumeNode->GetIJKToRASMatrix(ijkToRAS);
-  ijkToRAS->MultiplyPoint(center, center);
-
-  vtkNew<vtkTransform> transform;
-  transform->Translate(center);
-
-  vtkNew<vtkTransformPolyDataFilter> transformer;
-  transformer->SetTransform(transform);
-  transformer->SetInputData(modelNode->GetPolyData());
-  transformer->Update();
-  modelNode->GetPolyData()->ShallowCopy(transformer->GetOutput());
-  modelNode->GetPolyData()->Modified();
+  internal->CancelRequested = true;
+  // Workers finish the file they are reading, then the items read so far are added in one pass
+  internal->JoinReadThread();
+  return this->processFreeSurferFilesImport();
 }
 
 //-----------------------------------------------------------------------------
-struct SegmentInfo
+vtkSlicerFreeSurferImporterLogic::FreeSurferImportProgress vtkSlicerFreeSurferImporterLogic::getFreeSurferFilesImportProgress()
 {
-  std::string name = "Unknown";
-  double color[3] = { 0.5 };
-};
+  vtkInternal* internal = this->Internal;
+  FreeSurferImportProgress progress;
+  progress.NumberOfFiles = static_cast<int>(internal->Items.size());
+  progress.NumberOfFilesRead = internal->NumberOfFilesRead;
+  progress.NumberOfFilesCompleted = internal->NumberOfFilesCompleted;
+  progress.NumberOfFilesFailed = internal->NumberOfFilesFailed;
+  progress.NumberOfOverlaysDropped = internal->NumberOfOverlaysDropped;
+  progress.MegabytesRead = internal->BytesRead / (1024.0 * 1024.0);
+  progress.ElapsedTimeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - internal->StartTime).count();
+  progress.LastCompletedFileName = internal->LastCompletedFileName;
+  progress.Running = internal->Running;
+  progress.Canceled = internal->CancelRequested;
+  return progress;
+}
 
 //-----------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::applyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentationNode)
+const char* vtkSlicerFreeSurferImporterLogic::getFreeSurferImportStageName(int stage)
 {
-  if (!segmentationNode)
+  switch (stage)
     {
-    return;
+    case ReadStage: return "read";
+    case DecompressionStage: return "decompression";
+    case ByteSwapStage: return "byte swap";
+    case SurfaceProcessingStage: return "surface processing";
+    case TransformStage: return "transform";
+    case LUTStage: return "LUT";
+    case QuantizationStage: return "quantization";
+    case PreviewStage: return "preview";
+    case SceneStage: return "scene";
+    default: return "unknown";
     }
-  MRMLNodeModifyBlocker blocker(segmentationNode);
-
-  std::string sharedDirectory = this->GetModuleShareDirectory();
-  std::string lutFilename = "FreeSurferColorLUT.txt";
-
-  std::string lutDirectory = sharedDirectory + "/" + lutFilename;
+}
 
-  std::ifstream lutFile;
-  lutFile.open(lutDirectory);
-  if (!lutFile.is_open())
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::addFreeSurferImportMeasurements(const std::vector<FreeSurferImportStageMeasurement>& measurements)
+{
+  for (const FreeSurferImportStageMeasurement& measurement : measurements)
     {
-    return;
+    this->Internal->Report.push_back(measurement);
+    this->InvokeEvent(ImportStageMeasuredEvent, &this->Internal->Report.back());
+    if (this->Internal->Report.size() > vtkInternal::MaximumNumberOfImportMeasurements)
+      {
+      this->Internal->Report.pop_front();
+      }
     }
+}
 
-  std::map<int, SegmentInfo> segmentInfoMap;
+//-----------------------------------------------------------------------------
+std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportStageMeasurement> vtkSlicerFreeSurferImporterLogic::getFreeSurferImportReport()
+{
+  return std::vector<FreeSurferImportStageMeasurement>(this->Internal->Report.begin(), this->Internal->Report.end());
+}
 
-  std::string line;
-  while (std::getline(lutFile, line))
+//-----------------------------------------------------------------------------
+std::string vtkSlicerFreeSurferImporterLogic::getFreeSurferImportReportSummary()
+{
+  std::vector<FreeSurferImportStageMeasurement> totals(NumberOfImportStages);
+  std::vector<bool> measured(NumberOfImportStages, false);
+  for (const FreeSurferImportStageMeasurement& measurement : this->Internal->Report)
     {
-    line = std::regex_replace(line, std::regex("^ +| +$|( ) +"), "$1");
-    if (line.empty())
+    if (measurement.Stage < 0 || measurement.Stage >= NumberOfImportStages)
       {
       continue;
       }
-    if (line[0] == '#')
+    FreeSurferImportStageMeasurement& total = totals[measurement.Stage];
+    total.Seconds += measurement.Seconds;
+    total.MegabytesRead += measurement.MegabytesRead;
+    total.MegabytesAllocated += measurement.MegabytesAllocated;
+    measured[measurement.Stage] = true;
+    }
+
+  std::ostringstream summary;
+  summary << std::fixed;
+  for (int stage = 0; stage < NumberOfImportStages; ++stage)
+    {
+    if (!measured[stage])
       {
       continue;
       }
-
-    std::vector<std::string> tokens;
-    std::stringstream ss(line);;
-    std::string token;
-    while (std::getline(ss, token, ' '))
+    const FreeSurferImportStageMeasurement& total = totals[stage];
+    if (summary.tellp() > 0)
       {
-      tokens.push_back(token);
+      summary << ", ";
       }
-    if (tokens.size() != 6)
+    summary << getFreeSurferImportStageName(stage) << " " << std::setprecision(2) << total.Seconds << " s";
+    if (total.MegabytesRead > 0.0 || total.MegabytesAllocated > 0.0)
       {
-      continue;
+      summary << std::setprecision(1) << " (" << total.MegabytesRead << " MB read, "
+        << total.MegabytesAllocated << " MB allocated)";
       }
-
-    int value = vtkVariant(tokens[0]).ToInt();
-    SegmentInfo info;
-    info.name = tokens[1];
-    info.color[0] = vtkVariant(tokens[2]).ToInt() / 255.0;
-    info.color[1] = vtkVariant(tokens[3]).ToInt() / 255.0;
-    info.color[2] = vtkVariant(tokens[4]).ToInt() / 255.0;
-    segmentInfoMap[value] = info;
     }
-  lutFile.close();
+  return summary.str();
+}
 
-  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
-  for (int i = 0; i < segmentation->GetNumberOfSegments(); ++i)
-    {
-    vtkSegment* segment = segmentation->GetNthSegment(i);
-    SegmentInfo info = segmentInfoMap[segment->GetLabelValue()];
-    segment->SetName(info.name.c_str());
-    segment->SetColor(info.color);
-    }
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::clearFreeSurferImportReport()
+{
+  this->Internal->Report.clear();
 }
@@ -28,12 +28,37 @@
 #include "vtkSlicerModuleLogic.h"
 
 // MRML includes
+class vtkMRMLColorTableNode;
 class vtkMRMLScalarVolumeNode;
+class vtkMRMLTableNode;
 class vtkMRMLSegmentationNode;
 class vtkMRMLModelNode;
+class vtkMRMLNode;
+
+// FreeSurferImporter includes
+#include "vtkFreeSurferQuantizer.h"
+#include "vtkFreeSurferSphereResampler.h"
+class vtkFreeSurferColorLUT;
+class vtkFreeSurferDecodedDataCache;
+class vtkFreeSurferGroupOverlay;
+class vtkFreeSurferSubjectIndex;
+class vtkFreeSurferSurfaceLOD;
+class vtkFreeSurferVolumePyramid;
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkSmartPointer.h>
+class vtkDataArray;
+class vtkFloatArray;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
 
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
 
@@ -49,12 +74,401 @@ public:
   void PrintSelf(ostream& os, vtkIndent indent);
 
   vtkMRMLScalarVolumeNode* loadFreeSurferVolume(std::string fsDirectory, std::string name);
+  /// Load an .mgh/.mgz volume using the native MGH reader
+  vtkMRMLScalarVolumeNode* loadFreeSurferMGHVolume(std::string volumeFile, std::string name);
+  /// Add a volume node for voxel data that has already been read.
+  /// If a pyramid of the volume is specified, its levels are used by setFreeSurferVolumeLevel.
+  vtkMRMLScalarVolumeNode* addFreeSurferVolumeNode(std::string volumeFile, std::string name, vtkImageData* imageData, vtkMatrix4x4* ijkToRAS,
+    vtkFreeSurferVolumePyramid* pyramid = nullptr);
   vtkMRMLSegmentationNode* loadFreeSurferSegmentation(std::string fsDirectory, std::string name);
+  /// Storage of the intensity volumes and scalar overlays added to the scene, see vtkFreeSurferQuantizer.
+  /// In the quantized modes the values are converted to 8 or 16-bit integers when they are decoded,
+  /// which divides the memory of float volumes and overlays by 4 or 2. The scale and offset are kept
+  /// in the information of the arrays, and in the FreeSurferImporter.ValueScale and
+  /// FreeSurferImporter.ValueOffset attributes of volume nodes. Parcel statistics are computed from the
+  /// original values. Segmentations, group overlays and resampled overlays keep full precision.
+  /// The mapping from original to stored values is linear, so the window/level of volumes and the scalar range
+  /// of overlays, which are computed from the stored values, show the same colors as in full precision.
+  /// However the values shown by Slicer (data probe, window/level and scalar range widgets, color legends)
+  /// are stored values: the original value is stored * ValueScale + ValueOffset. When the scene is saved,
+  /// the quantized arrays are replaced by their original values until the save ends, so that files are
+  /// written in original units; nodes saved on their own, outside of a scene save, are written quantized.
+  /// Only floating-point volumes are quantized, integer volumes (e.g. aparc+aseg.mgz) keep their labels.
+  /// NaN values of overlays are kept, see vtkFreeSurferQuantizer.
+  /// Default is FullPrecision.
+  vtkSetClampMacro(StorageMode, int, vtkFreeSurferQuantizer::FullPrecision, vtkFreeSurferQuantizer::Quantized8Bit);
+  vtkGetMacro(StorageMode, int);
+
+  /// Number of levels of the preview pyramid of volumes imported by startFreeSurferFilesImport, including the
+  /// full resolution volume. If greater than 1, the worker threads build the downsampled volumes once the full
+  /// resolution volume has been handed to the main thread, and save them next to the volume
+  /// (mri/T1.mgz.pyramid1.vti, ...), so they are only built once, see vtkFreeSurferVolumePyramid.
+  /// Volumes whose levels are saved are shown at their coarsest level as soon as startFreeSurferFilesImport
+  /// is called, and the full resolution volume replaces the preview when it is decoded. The volume is read
+  /// before the other files if a slice view showing the preview is zoomed in below the voxel size of the preview.
+  /// Synchronous loads (loadFreeSurferVolume, loadFreeSurferFiles) ignore this option.
+  /// Default is 1, no levels are built.
+  vtkSetClampMacro(NumberOfVolumePreviewLevels, int, 1, 6);
+  vtkGetMacro(NumberOfVolumePreviewLevels, int);
+
+  /// Show a level of the pyramid of a volume, 0 is the full resolution volume.
+  /// The full resolution of a volume that is shown as a preview is read by the next free worker of the import,
+  /// and replaces the preview in processFreeSurferFilesImport.
+  /// Returns false if the volume has no such level.
+  bool setFreeSurferVolumeLevel(vtkMRMLScalarVolumeNode* volumeNode, int level);
+
+  /// Get the pyramid of a volume, nullptr if none was built
+  vtkFreeSurferVolumePyramid* getFreeSurferVolumePyramid(vtkMRMLScalarVolumeNode* volumeNode);
+
+  /// Add a segmentation node for a label volume that has already been read.
+  /// The label volume is scanned once to find the labels and their extent, and all segments
+  /// share one labelmap that references the voxels of labelImage without copying them
+  /// (the labelmap is only copied if it is cropped to the labeled region).
+  /// Segment names and colors are set from the lookup table (default FreeSurferColorLUT.txt).
+  vtkMRMLSegmentationNode* addFreeSurferSegmentationNode(std::string segmentationFile, std::string name,
+    vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS, vtkFreeSurferColorLUT* lut = nullptr);
+  /// Replace the segments of a segmentation node by the labels of a label volume,
+  /// as described in addFreeSurferSegmentationNode.
+  bool updateFreeSurferSegmentationNode(vtkMRMLSegmentationNode* segmentationNode,
+    vtkImageData* labelImage, vtkMatrix4x4* ijkToRAS, vtkFreeSurferColorLUT* lut = nullptr);
+  /// Add a smoothed surface model for each of the specified labels of a label volume (e.g. aseg.mgz).
+  /// All labels of the volume are used if labelValues is empty. The structures are extracted in
+  /// parallel with discrete flying edges, see vtkFreeSurferLabelSurfaces, and the models are named
+  /// and colored from the lookup table (default FreeSurferColorLUT.txt). Labels that are not in the
+  /// lookup table are named Label_<value>.
+  /// Returns the models in increasing label value order.
+  std::vector<vtkMRMLModelNode*> addFreeSurferLabelModels(vtkMRMLScalarVolumeNode* labelVolumeNode,
+    const std::vector<int>& labelValues = std::vector<int>(), vtkFreeSurferColorLUT* lut = nullptr);
+  /// Amount of smoothing of the models built by addFreeSurferLabelModels, between 0 (none) and 1.
+  /// Default is 0.5.
+  vtkSetClampMacro(LabelModelSmoothingFactor, double, 0.0, 1.0);
+  vtkGetMacro(LabelModelSmoothingFactor, double);
   vtkMRMLModelNode* loadFreeSurferModel(std::string fsDirectory, std::string name);
+  /// Add a model node for a surface that has already been read.
+  /// If levels of detail of the surface are specified, they are used by setFreeSurferModelLevelOfDetail.
+  /// If the surface file is specified, a FreeSurfer model storage node pointing at it is added.
+  vtkMRMLModelNode* addFreeSurferModelNode(std::string name, vtkPolyData* surface, vtkFreeSurferSurfaceLOD* levelsOfDetail = nullptr,
+    std::string surfaceFile = std::string());
+
+  /// Give the model its own copy of its polygons if they are shared with other surfaces.
+  /// Surfaces of a hemisphere share their polygons when ShareSurfaceTopology is enabled.
+  /// Shared polygons are read-only: this must be called before editing them in place,
+  /// otherwise the edit changes all the surfaces that share them.
+  void detachSharedSurfaceTopology(vtkMRMLModelNode* modelNode);
+
+  /// If enabled (default), surfaces with identical faces (e.g. lh.inflated, lh.sphere and lh.orig)
+  /// are detected by their vertex and face counts and a content hash, and share one cell array.
+  /// White and pial surfaces, that are edited in place, always keep their own polygons.
+  vtkSetMacro(ShareSurfaceTopology, bool);
+  vtkGetMacro(ShareSurfaceTopology, bool);
+  vtkBooleanMacro(ShareSurfaceTopology, bool);
+
+  /// Number of levels of detail of imported surfaces, including the full resolution surface.
+  /// If greater than 1, coarser surfaces are built in parallel when the surfaces are read and
+  /// saved next to them (surf/lh.pial.lod1.vtp, ...), so they are only built once.
+  /// Default is 1, no coarse levels are built.
+  vtkSetClampMacro(NumberOfSurfaceLevelsOfDetail, int, 1, 8);
+  vtkGetMacro(NumberOfSurfaceLevelsOfDetail, int);
+
+  /// Show a level of detail of a model, 0 is the full resolution surface.
+  /// Overlays and other per-vertex arrays of the full resolution surface are carried to the level.
+  /// Returns false if the model has no such level.
+  bool setFreeSurferModelLevelOfDetail(vtkMRMLModelNode* modelNode, int level);
+
+  /// Show the coarsest level of detail of all models while the views are being interacted with,
+  /// and the full resolution surfaces otherwise.
+  void setFreeSurferModelsInteracting(bool interacting);
+
+  /// Get the levels of detail of a model, nullptr if none were built
+  vtkFreeSurferSurfaceLOD* getFreeSurferModelLevelsOfDetail(vtkMRMLModelNode* modelNode);
+
+  /// Load a scalar overlay onto the models of the matching hemisphere.
+  /// Curvature files are decoded once and the same array is shared by all models.
   bool loadFreeSurferScalarOverlay(std::string fsDirectory, std::string name, std::vector<vtkMRMLModelNode*> modelNodes);
 
+  /// Attach a decoded overlay by reference to every model of the matching hemisphere
+  /// that has one vertex per overlay value, and show it with a FreeSurfer color map over
+  /// the range of its values. Returns false if no model was compatible.
+  bool addFreeSurferScalarOverlay(std::string name, vtkDataArray* overlay, const std::vector<vtkMRMLModelNode*>& modelNodes);
+
+  /// Load a surface annotation (e.g. label/lh.aparc.annot) onto the models of the matching hemisphere.
+  /// The parcel index of each vertex is decoded once, the same array is shared by all models and
+  /// shown with a color table node made from the color table embedded in the file.
+  bool loadFreeSurferAnnotation(std::string fsDirectory, std::string name, std::vector<vtkMRMLModelNode*> modelNodes);
+
+  /// Add a color table node with the name and color of each parcel index of an annotation.
+  /// Unlabeled vertices (-1) are shown with the below range color of its lookup table.
+  vtkMRMLColorTableNode* addFreeSurferAnnotationColorTableNode(std::string name, vtkFreeSurferColorLUT* colorTable);
+
+  /// Attach decoded parcel indices by reference to every model of the matching hemisphere that has
+  /// one vertex per value, and show them with the specified color table node.
+  /// Returns false if no model was compatible.
+  bool addFreeSurferAnnotation(std::string name, vtkDataArray* parcelIndices, vtkMRMLColorTableNode* colorTableNode,
+    const std::vector<vtkMRMLModelNode*>& modelNodes);
+
+  /// Add a table node with the statistics of overlays of a model within the parcels of one of its annotations
+  /// (e.g. "lh.aparc.annot"): number of vertices, surface area, and the mean, standard deviation and area-weighted
+  /// mean of each overlay, computed in a single parallel pass over the vertices, see vtkFreeSurferParcelStatistics.
+  /// Vertex areas are computed from the triangles of the model, so the white surface gives the areas of aparc.stats.
+  /// Parcel names are taken from the color table node of the annotation.
+  /// Returns nullptr if the model does not have the annotation or one of the overlays.
+  vtkMRMLTableNode* addFreeSurferParcelStatisticsTable(vtkMRMLModelNode* modelNode, std::string annotationName,
+    const std::vector<std::string>& overlayNames);
+
+  /// Resample an overlay of a subject (e.g. surf/lh.thickness) onto the vertices of a target surface
+  /// (e.g. fsaverage) through the registered sphere of the subject (surf/lh.sphere.reg) and the sphere of the target.
+  /// The spatial index of each target sphere is built once, and the mappings of the most recently used subjects
+  /// are kept (up to 64 MB, about 10 mappings onto fsaverage), so resampling more overlays of a subject only costs
+  /// a parallel gather, see vtkFreeSurferSphereResampler. Indices and mappings are rebuilt when a sphere file is modified.
+  /// Returns nullptr if a file could not be read or the overlay does not match the subject sphere.
+  vtkSmartPointer<vtkFloatArray> resampleFreeSurferOverlay(std::string overlayFile, std::string sourceSphereFile,
+    std::string targetSphereFile, int interpolation = vtkFreeSurferSphereResampler::Barycentric);
+
+  /// Load the overlays of a group of subjects on a common surface into one subjects x vertices matrix,
+  /// one file per subject, read in parallel on NumberOfThreads worker threads.
+  /// Files are curvature format overlays or MGH files with one value per vertex (e.g. lh.thickness.fwhm10.fsaverage.mgh).
+  /// The name (e.g. "lh.thickness") prefixes the arrays computed by the group overlay, so that they can be shown on
+  /// the models of the hemisphere with addFreeSurferScalarOverlay. Subjects that could not be read are marked invalid.
+  /// Returns nullptr if none of the files could be read.
+  vtkSmartPointer<vtkFreeSurferGroupOverlay> loadFreeSurferGroupOverlay(std::string name,
+    const std::vector<std::string>& overlayFiles);
+
+  /// Load the overlays of a group of subjects resampled onto a target surface, see resampleFreeSurferOverlay.
+  /// sourceSphereFiles has the registered sphere of the subject of each overlay (e.g. surf/lh.sphere.reg).
+  /// Returns nullptr if the target sphere or none of the overlays could be read.
+  vtkSmartPointer<vtkFreeSurferGroupOverlay> loadFreeSurferResampledGroupOverlay(std::string name,
+    const std::vector<std::string>& overlayFiles, const std::vector<std::string>& sourceSphereFiles,
+    std::string targetSphereFile, int interpolation = vtkFreeSurferSphereResampler::Barycentric);
+
+  /// Release the target sphere indices and subject mappings kept by resampleFreeSurferOverlay
+  /// and loadFreeSurferResampledGroupOverlay
+  void clearFreeSurferResamplingCache();
+
   void transformFreeSurferModelToRAS(vtkMRMLModelNode* surf, vtkMRMLScalarVolumeNode* orig);
-  void applyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentation);
+  void transformFreeSurferModelToRAS(vtkMRMLModelNode* surf, vtkMatrix4x4* surfaceToRAS);
+
+  /// Compute the transform from FreeSurfer surface coordinates to RAS using only the header
+  /// of the reference volume (usually mri/orig.mgz). No voxel data is decompressed.
+  bool getFreeSurferSurfaceToRASTransform(std::string origFile, vtkMatrix4x4* surfaceToRAS);
+
+  /// Apply names and colors to the segments from the specified lookup table.
+  /// If no table is specified, the default FreeSurferColorLUT.txt is used.
+  void applyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentation, vtkFreeSurferColorLUT* lut = nullptr);
+
+  /// Register a color lookup table file under the specified name.
+  /// Registering a file under the default name replaces the FreeSurferColorLUT.txt shipped with the module.
+  void registerFreeSurferColorLUT(std::string name, std::string fileName);
+
+  /// Get a registered color lookup table.
+  /// Tables are parsed once per process and re-parsed only if the file has been modified.
+  /// Returns nullptr if the table is not registered or could not be read.
+  vtkSmartPointer<vtkFreeSurferColorLUT> getFreeSurferColorLUT(std::string name = DefaultColorLUTName);
+
+  /// Name of the lookup table shipped with the module
+  static const char* DefaultColorLUTName;
+
+  /// Types of files of a subject. Labels are indexed but not imported yet.
+  enum FreeSurferFileType
+    {
+    VolumeFile,
+    SegmentationFile,
+    ModelFile,
+    ScalarOverlayFile,
+    AnnotationFile,
+    LabelFile
+    };
+
+  /// Get the index of the files of a subject directory.
+  /// The directory is scanned on the first call. After that the index is kept by the logic and
+  /// only updated through its Update methods, e.g. when a file system watcher reports a change,
+  /// or here if update is true. Only the indices of the most recently used subjects are kept.
+  vtkFreeSurferSubjectIndex* getFreeSurferSubjectIndex(std::string subjectDirectory, bool update = false);
+
+  /// Get the type of a file of a subject from its name and directory
+  /// (e.g. "mri/aparc+aseg.mgz" or "surf/lh.thickness").
+  /// Returns -1 if the file is not one of the supported types.
+  static int getFreeSurferFileType(std::string fileName);
+
+  /// Stages of the import of a file, measured by all load methods
+  enum FreeSurferImportStage
+    {
+    /// Reading uncompressed files, and decoded data cache hits
+    ReadStage,
+    /// Reading and inflating compressed files (.mgz)
+    DecompressionStage,
+    /// Conversion of big-endian data to host byte order
+    ByteSwapStage,
+    /// Surface normals, levels of detail and topology sharing
+    SurfaceProcessingStage,
+    /// Transform of surfaces to RAS
+    TransformStage,
+    /// Label scan, intensity histogram and color lookup table application
+    LUTStage,
+    /// Conversion of volumes and overlays to reduced precision, see StorageMode
+    QuantizationStage,
+    /// Downsampling of volumes into preview levels, see NumberOfVolumePreviewLevels
+    PreviewStage,
+    /// Creation of MRML data, storage and display nodes
+    SceneStage,
+    NumberOfImportStages
+    };
+
+  /// Get the name of a stage, e.g. "decompression"
+  static const char* getFreeSurferImportStageName(int stage);
+
+  /// Time and memory spent in one stage of the import of a file
+  struct FreeSurferImportStageMeasurement
+    {
+    int Stage = ReadStage;
+    std::string FileName;
+    double Seconds = 0.0;
+    /// Size of the data read from disk or from the decoded data cache
+    double MegabytesRead = 0.0;
+    /// Size of the data created by the stage
+    double MegabytesAllocated = 0.0;
+    };
+
+  enum
+    {
+    /// Invoked on the main thread when a stage of an import is measured.
+    /// The call data is a pointer to the FreeSurferImportStageMeasurement.
+    ImportStageMeasuredEvent = vtkCommand::UserEvent + 1
+    };
+
+  /// Get the measurements of all stages of the imports since the last call to clearFreeSurferImportReport.
+  /// Stages of files decoded on worker threads are reported once the files are added to the scene.
+  /// Only the most recent 10000 measurements are kept, callers that import repeatedly, like the
+  /// batch import, should clear the report after each import.
+  std::vector<FreeSurferImportStageMeasurement> getFreeSurferImportReport();
+
+  /// Get the total time, data read and data allocated of each stage as one line of text,
+  /// e.g. "decompression 1.20 s (95.3 MB read, 256.0 MB allocated), byte swap 0.04 s, scene 0.31 s"
+  std::string getFreeSurferImportReportSummary();
+
+  /// Remove all measurements from the report
+  void clearFreeSurferImportReport();
+
+  /// A file to import. The members after Name are filled in by the import.
+  struct FreeSurferImportItem
+    {
+    int Type = VolumeFile;
+    std::string Directory;
+    std::string Name;
+    /// If set, the transform is applied to the surface after it is read
+    vtkSmartPointer<vtkMatrix4x4> SurfaceToRAS;
+
+    /// Decoded data that is not part of the scene yet (image, surface or per-vertex array)
+    vtkSmartPointer<vtkObject> Data;
+    vtkSmartPointer<vtkMatrix4x4> IJKToRAS;
+    /// Coarser levels of a surface, if NumberOfSurfaceLevelsOfDetail is greater than 1
+    vtkSmartPointer<vtkFreeSurferSurfaceLOD> LevelsOfDetail;
+    /// Parcel names and colors of an annotation
+    vtkSmartPointer<vtkFreeSurferColorLUT> ColorTable;
+    /// Node created for the file, the color table node for annotations (nullptr if the import failed)
+    vtkMRMLNode* Node = nullptr;
+    bool Success = false;
+    /// Identifier set by the caller to match items returned by processFreeSurferFilesImport
+    int Id = -1;
+    /// Stages measured while the file is decoded, moved to the import report when it is added to the scene
+    std::vector<FreeSurferImportStageMeasurement> Measurements;
+    };
+
+  /// Progress of the background import started by startFreeSurferFilesImport
+  struct FreeSurferImportProgress
+    {
+    int NumberOfFiles = 0;
+    int NumberOfFilesRead = 0;
+    int NumberOfFilesCompleted = 0;
+    int NumberOfFilesFailed = 0;
+    /// Overlays and annotations that were read but not added to the scene because the import was canceled
+    int NumberOfOverlaysDropped = 0;
+    double MegabytesRead = 0.0;
+    double ElapsedTimeSeconds = 0.0;
+    std::string LastCompletedFileName;
+    bool Running = false;
+    bool Canceled = false;
+
+    /// Read throughput in MB/s
+    double GetThroughput() const { return this->ElapsedTimeSeconds > 0.0 ? this->MegabytesRead / this->ElapsedTimeSeconds : 0.0; }
+    };
+
+  /// Decode a file into detached VTK data objects, without touching the scene.
+  /// Returns false if the file type is not decoded off the main thread or could not be read.
+  /// This method is thread-safe.
+  bool readFreeSurferFile(FreeSurferImportItem& item);
+
+  /// Decode all files in parallel on a pool of NumberOfThreads worker threads.
+  void readFreeSurferFiles(std::vector<FreeSurferImportItem>& items);
+
+  /// Create the nodes for a file decoded by readFreeSurferFile. Only volumes and surfaces in formats
+  /// that are not decoded natively are read here, through their storage node. Other files that were
+  /// not decoded are reported as failed. Overlays are added to the specified model nodes.
+  /// Must be called on the main thread.
+  bool addFreeSurferFileToScene(FreeSurferImportItem& item, const std::vector<vtkMRMLModelNode*>& modelNodes);
+
+  /// Add the files decoded by readFreeSurferFiles to the scene, overlays last so that they are
+  /// applied to the models loaded with them. Returns true if all files were loaded.
+  /// Must be called on the main thread.
+  bool addFreeSurferFilesToScene(std::vector<FreeSurferImportItem>& items);
+
+  /// Decode all files in parallel, then add them to the scene. Overlays are applied to the models
+  /// loaded with them. Returns true if all files were loaded.
+  bool loadFreeSurferFiles(std::vector<FreeSurferImportItem>& items);
+
+  /// If enabled, loadFreeSurferFiles adds placeholder nodes instead of decoding the files,
+  /// see addFreeSurferPlaceholderNodes. Disabled by default.
+  vtkSetMacro(LazyLoading, bool);
+  vtkGetMacro(LazyLoading, bool);
+  vtkBooleanMacro(LazyLoading, bool);
+
+  /// Add a node for each file without decoding its data. Only the headers are read, and the
+  /// header metadata is stored in node attributes (e.g. FreeSurferImporter.Dimensions,
+  /// FreeSurferImporter.Bounds or FreeSurferImporter.NumberOfVertices).
+  /// The data of a placeholder is decoded the first time it is displayed: when a volume is shown
+  /// in a slice view or one of its display nodes is modified, or when the display node of a model
+  /// or segmentation is made visible (they are added hidden). Overlays and annotations are applied
+  /// when the models they belong to are decoded. Placeholder volumes have an image with the extent
+  /// of the volume but no scalars: code that accesses their voxels must call loadFreeSurferPlaceholderNode
+  /// first, as the methods of this logic do.
+  /// Files that have no readable header are loaded immediately.
+  bool addFreeSurferPlaceholderNodes(std::vector<FreeSurferImportItem>& items);
+
+  /// Returns true if the node was added by addFreeSurferPlaceholderNodes and its data is not decoded yet
+  bool isFreeSurferPlaceholderNode(vtkMRMLNode* node);
+
+  /// Decode the data of a placeholder node now. Returns false if the node is not a placeholder
+  /// or its file could not be read.
+  bool loadFreeSurferPlaceholderNode(vtkMRMLNode* node);
+
+  /// Attribute set on placeholder nodes until their data is decoded
+  static const char* PlaceholderAttributeName;
+
+  /// Start reading the files on background threads and return immediately.
+  /// The scene is only modified by processFreeSurferFilesImport.
+  /// Returns false if an import is already running.
+  bool startFreeSurferFilesImport(const std::vector<FreeSurferImportItem>& items);
+
+  /// Add the files that have been read since the last call to the scene and return them.
+  /// Must be called periodically from the main thread until the import is no longer running.
+  std::vector<FreeSurferImportItem> processFreeSurferFilesImport();
+
+  /// Stop reading files that have not been started yet. Files that are already read are still
+  /// returned by processFreeSurferFilesImport.
+  void cancelFreeSurferFilesImport();
+
+  /// Cancel the import and wait for the worker threads, then add the files already read to the scene
+  /// and return them, like the last call to processFreeSurferFilesImport. Must be called on the main thread.
+  std::vector<FreeSurferImportItem> stopFreeSurferFilesImport();
+
+  FreeSurferImportProgress getFreeSurferFilesImportProgress();
+
+  /// Number of worker threads used for reading files. If 0, the number of cores is used.
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /// On-disk cache of decoded volumes, surfaces and overlays used by all read methods.
+  /// The cache is disabled until a cache directory is set.
+  vtkGetObjectMacro(DecodedDataCache, vtkFreeSurferDecodedDataCache);
 
 protected:
   vtkSlicerFreeSurferImporterLogic();
@@ -66,6 +480,44 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+  /// Write the original values of quantized volumes and overlays when the scene is saved
+  virtual void ProcessMRMLSceneEvents(vtkObject* caller, unsigned long event, void* callData);
+  /// Decode placeholder nodes when they are displayed, and preview volumes when a slice view is zoomed in
+  virtual void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData);
+
+  /// Add a placeholder node for a file from its header.
+  /// Returns nullptr if the header of the file cannot be read.
+  vtkMRMLNode* addFreeSurferPlaceholderNode(FreeSurferImportItem& item);
+
+  /// Replace the quantized arrays of volumes and models by their original values, until restoreFreeSurferQuantizedNodes
+  void dequantizeFreeSurferNodesForSave();
+  void restoreFreeSurferQuantizedNodes();
+
+  /// Add a volume node showing the coarsest saved level of each volume of the background import.
+  /// Volumes whose levels are not saved are added when they are decoded.
+  void addFreeSurferVolumePreviews();
+
+  /// Replace the preview of a volume by the full resolution volume decoded for the item.
+  /// The preview node is removed if the volume could not be decoded.
+  bool showFreeSurferVolumeFullResolution(vtkMRMLScalarVolumeNode* volumeNode, FreeSurferImportItem& item);
+
+  /// Add measurements to the import report and invoke ImportStageMeasuredEvent for each.
+  /// Must be called on the main thread.
+  void addFreeSurferImportMeasurements(const std::vector<FreeSurferImportStageMeasurement>& measurements);
+
+  std::map<std::string, std::string> ColorLUTFileNames;
+  int NumberOfThreads;
+  bool ShareSurfaceTopology;
+  bool LazyLoading;
+  int NumberOfSurfaceLevelsOfDetail;
+  int NumberOfVolumePreviewLevels;
+  double LabelModelSmoothingFactor;
+  int StorageMode;
+  vtkFreeSurferDecodedDataCache* DecodedDataCache;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
 private:
 
   vtkSlicerFreeSurferImporterLogic(const vtkSlicerFreeSurferImporterLogic&); // Not implemented
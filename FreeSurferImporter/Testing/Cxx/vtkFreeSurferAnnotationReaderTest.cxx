@@ -0,0 +1,253 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the parsing of annotation files by vtkFreeSurferAnnotationReader.
+//
+// The same parcellation is written with the old color table format (entries
+// indexed by their order) and with the version 2 format (entries with an
+// explicit index, here one above the dense label index of the color table),
+// and both files must give the expected parcel index of each vertex.
+//
+// Usage: vtkFreeSurferAnnotationReaderTest [--temp dir]
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferAnnotationReader.h"
+#include "vtkFreeSurferColorLUT.h"
+
+// VTK includes
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+  struct Parcel
+    {
+    const char* Name;
+    int Color[3];
+    };
+
+  const Parcel Parcels[] = {
+    { "unknown", { 25, 5, 25 } },
+    { "bankssts", { 25, 100, 40 } },
+    { "caudalanteriorcingulate", { 125, 100, 160 } },
+    };
+  const int NumberOfParcels = 3;
+
+  /// Parcel of each vertex in the file, -1 for a color that is not in the color table
+  const int VertexParcels[] = { 0, 1, 1, 2, -1, 2 };
+  const int NumberOfVertices = 6;
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void AppendBigEndian(std::string& buffer, T value)
+  {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    const std::uint16_t one = 1;
+    if (*reinterpret_cast<const unsigned char*>(&one) == 1)
+      {
+      std::reverse(bytes, bytes + sizeof(T));
+      }
+    buffer.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+  }
+
+  //----------------------------------------------------------------------------
+  /// Length and characters of a string, with its null character as in FreeSurfer files
+  void AppendString(std::string& buffer, const std::string& value)
+  {
+    AppendBigEndian<std::int32_t>(buffer, static_cast<std::int32_t>(value.size() + 1));
+    buffer.append(value.c_str(), value.size() + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  std::int32_t GetPackedColor(const int color[3])
+  {
+    return color[0] + (color[1] << 8) + (color[2] << 16);
+  }
+
+  //----------------------------------------------------------------------------
+  /// Write the vertex labels and a color table in the old format (version 1),
+  /// or in the format with explicit parcel indices (version 2)
+  bool WriteAnnotation(const std::string& fileName, int version, const int parcelIndices[])
+  {
+    std::string buffer;
+    AppendBigEndian<std::int32_t>(buffer, NumberOfVertices);
+    // Vertices are not required to be in order
+    for (int vertex = NumberOfVertices - 1; vertex >= 0; --vertex)
+      {
+      const int unlistedColor[3] = { 1, 2, 3 };
+      AppendBigEndian<std::int32_t>(buffer, vertex);
+      AppendBigEndian<std::int32_t>(buffer,
+        GetPackedColor(VertexParcels[vertex] < 0 ? unlistedColor : Parcels[VertexParcels[vertex]].Color));
+      }
+
+    AppendBigEndian<std::int32_t>(buffer, 1);
+    if (version == 1)
+      {
+      AppendBigEndian<std::int32_t>(buffer, NumberOfParcels);
+      AppendString(buffer, "aparc.annot.ctab");
+      }
+    else
+      {
+      AppendBigEndian<std::int32_t>(buffer, -version);
+      AppendBigEndian<std::int32_t>(buffer, *std::max_element(parcelIndices, parcelIndices + NumberOfParcels) + 1);
+      AppendString(buffer, "aparc.annot.ctab");
+      AppendBigEndian<std::int32_t>(buffer, NumberOfParcels);
+      }
+    for (int parcel = 0; parcel < NumberOfParcels; ++parcel)
+      {
+      if (version != 1)
+        {
+        AppendBigEndian<std::int32_t>(buffer, parcelIndices[parcel]);
+        }
+      AppendString(buffer, Parcels[parcel].Name);
+      for (int component = 0; component < 3; ++component)
+        {
+        AppendBigEndian<std::int32_t>(buffer, Parcels[parcel].Color[component]);
+        }
+      AppendBigEndian<std::int32_t>(buffer, 0);
+      }
+
+    FILE* file = vtksys::SystemTools::Fopen(fileName, "wb");
+    if (!file)
+      {
+      return false;
+      }
+    bool success = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    return (fclose(file) == 0) && success;
+  }
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferAnnotationReaderTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Write and read an annotation, and check the parcel index of each vertex and the color table
+  bool CheckAnnotation(const std::string& fileName, int version, const int parcelIndices[])
+  {
+    std::string description = "version " + std::to_string(version) + " annotation";
+    if (!Check(WriteAnnotation(fileName, version, parcelIndices), "Could not write " + fileName))
+      {
+      return false;
+      }
+
+    int numberOfVertices = 0;
+    bool success = Check(vtkFreeSurferAnnotationReader::ReadAnnotationInfo(fileName, numberOfVertices)
+      && numberOfVertices == NumberOfVertices, "Wrong number of vertices in the " + description + " info");
+
+    vtkNew<vtkFreeSurferAnnotationReader> reader;
+    reader->SetFileName(fileName.c_str());
+    if (!Check(reader->Read(), "Could not read the " + description))
+      {
+      return false;
+      }
+    vtkIntArray* output = reader->GetOutput();
+    vtkFreeSurferColorLUT* colorTable = reader->GetColorTable();
+    if (!Check(output && colorTable, "No output for the " + description)
+      || !Check(output->GetNumberOfTuples() == NumberOfVertices, "Wrong number of vertices in the " + description))
+      {
+      return false;
+      }
+    success &= Check(vtksys::SystemTools::GetFilenameName(fileName) == output->GetName(), "Output of the " + description + " is not named after the file");
+
+    for (int vertex = 0; vertex < NumberOfVertices; ++vertex)
+      {
+      int expectedIndex = VertexParcels[vertex] < 0 ? -1 : parcelIndices[VertexParcels[vertex]];
+      success &= Check(output->GetValue(vertex) == expectedIndex,
+        "Wrong parcel index of vertex " + std::to_string(vertex) + " in the " + description);
+      }
+
+    success &= Check(colorTable->GetNumberOfLabels() == NumberOfParcels, "Wrong number of parcels in the " + description);
+    success &= Check(colorTable->GetMaximumLabelValue() == *std::max_element(parcelIndices, parcelIndices + NumberOfParcels),
+      "Wrong maximum parcel index in the " + description);
+    for (int parcel = 0; parcel < NumberOfParcels; ++parcel)
+      {
+      const vtkFreeSurferColorLUT::LabelInfo* info = colorTable->GetLabelInfo(parcelIndices[parcel]);
+      if (!Check(info != nullptr, std::string("Parcel ") + Parcels[parcel].Name + " is missing in the " + description))
+        {
+        success = false;
+        continue;
+        }
+      success &= Check(info->Name == Parcels[parcel].Name, "Wrong name of parcel " + std::to_string(parcelIndices[parcel]) + " in the " + description);
+      for (int component = 0; component < 3; ++component)
+        {
+        success &= Check(info->Color[component] == Parcels[parcel].Color[component] / 255.0,
+          std::string("Wrong color of parcel ") + Parcels[parcel].Name + " in the " + description);
+        }
+      }
+    return success;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferAnnotationReaderTest(int argc, char* argv[])
+{
+  std::string temporaryDirectory = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  for (int i = 1; i + 1 < argc; i += 2)
+    {
+    std::string option = argv[i];
+    if (option == "--temp")
+      {
+      temporaryDirectory = argv[i + 1];
+      }
+    else
+      {
+      std::cerr << "vtkFreeSurferAnnotationReaderTest: Unknown option " << option << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::string testDirectory = temporaryDirectory + "/vtkFreeSurferAnnotationReaderTest";
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  if (!vtksys::SystemTools::MakeDirectory(testDirectory))
+    {
+    std::cerr << "vtkFreeSurferAnnotationReaderTest: Could not create " << testDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  bool success = true;
+  success &= Check(vtkFreeSurferAnnotationReader::CanReadFile("lh.aparc.annot")
+    && vtkFreeSurferAnnotationReader::CanReadFile("lh.aparc.ANNOT")
+    && !vtkFreeSurferAnnotationReader::CanReadFile("lh.thickness"), "Wrong annotation extension check");
+
+  // Old format: the parcel index is the order of the entry in the color table
+  const int orderedIndices[] = { 0, 1, 2 };
+  success &= CheckAnnotation(testDirectory + "/lh.v1.annot", 1, orderedIndices);
+
+  // Version 2: explicit indices, not contiguous and beyond the dense label index
+  const int explicitIndices[] = { 0, 1001, vtkFreeSurferColorLUT::MaximumDenseLabelValue + 5 };
+  success &= CheckAnnotation(testDirectory + "/lh.v2.annot", 2, explicitIndices);
+
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
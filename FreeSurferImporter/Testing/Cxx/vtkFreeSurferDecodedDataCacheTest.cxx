@@ -0,0 +1,207 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the invalidation and eviction of vtkFreeSurferDecodedDataCache entries.
+//
+// An array is stored for a synthetic source file, then the source is modified in
+// ways the fingerprint must detect (size, modification time, first and last
+// blocks) and the entry must no longer be returned.
+//
+// Usage: vtkFreeSurferDecodedDataCacheTest [--temp dir]
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferDecodedDataCache.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
+namespace
+{
+  /// Larger than the blocks hashed at the start and the end of the source
+  const size_t SourceSize = 256 * 1024;
+  const std::time_t SourceModifiedTime = 1000000000;
+
+  //----------------------------------------------------------------------------
+  bool WriteSource(const std::string& fileName, const std::vector<unsigned char>& content, std::time_t modifiedTime)
+  {
+    FILE* file = vtksys::SystemTools::Fopen(fileName, "wb");
+    if (!file)
+      {
+      return false;
+      }
+    bool success = fwrite(content.data(), 1, content.size(), file) == content.size();
+    success = (fclose(file) == 0) && success;
+
+    // Modifications within the same second are only detected by the hashes
+#ifdef _WIN32
+    struct _utimbuf times;
+    times.actime = modifiedTime;
+    times.modtime = modifiedTime;
+    return success && _utime(fileName.c_str(), &times) == 0;
+#else
+    struct utimbuf times;
+    times.actime = modifiedTime;
+    times.modtime = modifiedTime;
+    return success && utime(fileName.c_str(), &times) == 0;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkFloatArray> CreateValues(vtkIdType numberOfValues)
+  {
+    vtkSmartPointer<vtkFloatArray> values = vtkSmartPointer<vtkFloatArray>::New();
+    values->SetName("values");
+    values->SetNumberOfValues(numberOfValues);
+    for (vtkIdType i = 0; i < numberOfValues; ++i)
+      {
+      values->SetValue(i, static_cast<float>(i) * 0.5f);
+      }
+    return values;
+  }
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferDecodedDataCacheTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Store the values for the source, modify the source and check whether the entry is still returned
+  bool CheckModification(vtkFreeSurferDecodedDataCache* cache, const std::string& sourceFileName,
+    const std::vector<unsigned char>& content, vtkFloatArray* values,
+    const std::vector<unsigned char>& modifiedContent, std::time_t modifiedTime, bool expectValid, const std::string& modification)
+  {
+    if (!Check(WriteSource(sourceFileName, content, SourceModifiedTime), "Could not write " + sourceFileName)
+      || !Check(cache->StoreArray(sourceFileName, values), "Could not store the values of " + sourceFileName)
+      || !Check(cache->LoadArray(sourceFileName) != nullptr, "Stored values are not returned")
+      || !Check(WriteSource(sourceFileName, modifiedContent, modifiedTime), "Could not write " + sourceFileName))
+      {
+      return false;
+      }
+    vtkSmartPointer<vtkDataArray> cachedValues = cache->LoadArray(sourceFileName);
+    if (!expectValid)
+      {
+      return Check(cachedValues == nullptr, "Values are returned after a modification of the " + modification);
+      }
+    return Check(cachedValues != nullptr && cachedValues->GetNumberOfTuples() == values->GetNumberOfTuples()
+      && cachedValues->GetComponent(10, 0) == values->GetValue(10), "Values are not returned after " + modification);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferDecodedDataCacheTest(int argc, char* argv[])
+{
+  std::string temporaryDirectory = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  for (int i = 1; i + 1 < argc; i += 2)
+    {
+    std::string option = argv[i];
+    if (option == "--temp")
+      {
+      temporaryDirectory = argv[i + 1];
+      }
+    else
+      {
+      std::cerr << "vtkFreeSurferDecodedDataCacheTest: Unknown option " << option << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::string testDirectory = temporaryDirectory + "/vtkFreeSurferDecodedDataCacheTest";
+  std::string cacheDirectory = testDirectory + "/cache";
+  std::string sourceFileName = testDirectory + "/lh.thickness";
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  if (!vtksys::SystemTools::MakeDirectory(testDirectory))
+    {
+    std::cerr << "vtkFreeSurferDecodedDataCacheTest: Could not create " << testDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkFreeSurferDecodedDataCache> cache;
+  cache->SetCacheDirectory(cacheDirectory);
+  cache->SetMaximumSize(0);
+
+  std::vector<unsigned char> content(SourceSize);
+  for (size_t i = 0; i < content.size(); ++i)
+    {
+    content[i] = static_cast<unsigned char>(i * 7);
+    }
+  vtkSmartPointer<vtkFloatArray> values = CreateValues(1000);
+
+  std::vector<unsigned char> longerContent = content;
+  longerContent.push_back(0);
+  std::vector<unsigned char> firstBlockModified = content;
+  firstBlockModified[10] ^= 0xFF;
+  std::vector<unsigned char> lastBlockModified = content;
+  lastBlockModified[content.size() - 10] ^= 0xFF;
+  std::vector<unsigned char> middleModified = content;
+  middleModified[content.size() / 2] ^= 0xFF;
+
+  bool success = true;
+  success &= CheckModification(cache, sourceFileName, content, values, content, SourceModifiedTime, true, "no modification");
+  success &= CheckModification(cache, sourceFileName, content, values, longerContent, SourceModifiedTime, false, "size");
+  success &= CheckModification(cache, sourceFileName, content, values, content, SourceModifiedTime + 1, false, "modification time");
+  success &= CheckModification(cache, sourceFileName, content, values, firstBlockModified, SourceModifiedTime, false, "first block");
+  success &= CheckModification(cache, sourceFileName, content, values, lastBlockModified, SourceModifiedTime, false, "last block");
+  // Only the first and last blocks are hashed, the size and modification time usually change with the middle
+  success &= CheckModification(cache, sourceFileName, content, values, middleModified, SourceModifiedTime, true,
+    "a modification that keeps the size, modification time, first and last blocks");
+
+  // Least recently used entries are removed when the cache exceeds its maximum size
+  std::string otherSourceFileName = testDirectory + "/rh.thickness";
+  vtkSmartPointer<vtkFloatArray> largeValues = CreateValues(160 * 1024);
+  success &= Check(WriteSource(sourceFileName, content, SourceModifiedTime)
+    && WriteSource(otherSourceFileName, content, SourceModifiedTime), "Could not write the sources");
+  cache->Clear();
+  success &= Check(cache->GetSizeInMegabytes() == 0.0, "Cache is not empty after Clear");
+  cache->SetMaximumSize(1);
+  success &= Check(cache->StoreArray(sourceFileName, largeValues), "Could not store the values of " + sourceFileName);
+  success &= Check(cache->StoreArray(otherSourceFileName, largeValues), "Could not store the values of " + otherSourceFileName);
+  success &= Check(cache->GetSizeInMegabytes() <= 1.0, "Cache is larger than its maximum size");
+  success &= Check(cache->LoadArray(sourceFileName) == nullptr, "Least recently used entry was not removed");
+  success &= Check(cache->LoadArray(otherSourceFileName) != nullptr, "Most recently used entry was removed");
+
+  // A new cache object lists the entries left in the directory
+  vtkNew<vtkFreeSurferDecodedDataCache> otherCache;
+  otherCache->SetCacheDirectory(cacheDirectory);
+  success &= Check(otherCache->GetSizeInMegabytes() == cache->GetSizeInMegabytes(), "Entries of the directory are not listed");
+  success &= Check(otherCache->LoadArray(otherSourceFileName) != nullptr, "Entry is not shared between cache objects");
+
+  cache->Clear();
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
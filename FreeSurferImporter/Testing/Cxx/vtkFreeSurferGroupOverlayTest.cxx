@@ -0,0 +1,170 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the per-vertex statistics of vtkFreeSurferGroupOverlay.
+//
+// Two groups of three subjects and an invalid subject with outlying values are
+// stored. The mean, standard deviation and Welch t value of each vertex are
+// compared with values computed by hand, with non-finite values left out and
+// NaN where a vertex has too few finite values.
+//
+// Usage: vtkFreeSurferGroupOverlayTest
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferGroupOverlay.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const int NumberOfSubjects = 7;
+  const int NumberOfVertices = 5;
+  const float NaN = std::numeric_limits<float>::quiet_NaN();
+  const float Infinity = std::numeric_limits<float>::infinity();
+
+  /// Values of each subject (rows) at each vertex (columns).
+  /// Vertex 0: all values are finite.
+  /// Vertex 1: one non-finite value in each group.
+  /// Vertex 2: a single finite value in group 0.
+  /// Vertex 3: same value for all subjects.
+  /// Vertex 4: no finite value.
+  const float SubjectValues[NumberOfSubjects][NumberOfVertices] = {
+    { 1.0f, 1.0f, 1.0f, 5.0f, NaN },
+    { 2.0f, 2.0f, NaN, 5.0f, NaN },
+    { 3.0f, NaN, NaN, 5.0f, NaN },
+    { 4.0f, 4.0f, 4.0f, 5.0f, NaN },
+    { 6.0f, 6.0f, 6.0f, 5.0f, NaN },
+    { 8.0f, Infinity, 8.0f, 5.0f, -Infinity },
+    // Invalid subject, must not change any statistic
+    { 1000.0f, 1000.0f, 1000.0f, 1000.0f, 1000.0f },
+    };
+  const int Groups[NumberOfSubjects] = { 0, 0, 0, 1, 1, 1, 1 };
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferGroupOverlayTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsClose(float value, double expected)
+  {
+    if (std::isnan(expected))
+      {
+      return std::isnan(value);
+      }
+    return std::abs(value - expected) <= 1e-5 * std::max(1.0, std::abs(expected));
+  }
+
+  //----------------------------------------------------------------------------
+  bool CheckValues(vtkFloatArray* output, const std::string& name, const double expected[NumberOfVertices])
+  {
+    if (!Check(output != nullptr, "No " + name + " output")
+      || !Check(output->GetNumberOfValues() == NumberOfVertices, "Wrong number of " + name + " values")
+      || !Check(std::string(output->GetName()) == "lh.thickness." + name, "Wrong name of the " + name + " output"))
+      {
+      return false;
+      }
+    bool success = true;
+    for (int vertex = 0; vertex < NumberOfVertices; ++vertex)
+      {
+      success &= Check(IsClose(output->GetValue(vertex), expected[vertex]), "Wrong " + name + " at vertex "
+        + std::to_string(vertex) + ": " + std::to_string(output->GetValue(vertex)) + " instead of " + std::to_string(expected[vertex]));
+      }
+    return success;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferGroupOverlayTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkFreeSurferGroupOverlay> groupOverlay;
+  groupOverlay->SetName("lh.thickness");
+  if (!Check(groupOverlay->Allocate(NumberOfSubjects, NumberOfVertices), "Could not allocate the matrix"))
+    {
+    return EXIT_FAILURE;
+    }
+
+  bool success = true;
+  success &= Check(groupOverlay->GetNumberOfValidSubjects() == 0, "Subjects are valid after Allocate");
+  success &= Check(groupOverlay->GetRowStride() >= NumberOfVertices, "Rows overlap");
+  for (int subject = 0; subject + 1 < NumberOfSubjects; ++subject)
+    {
+    vtkNew<vtkFloatArray> values;
+    values->SetNumberOfValues(NumberOfVertices);
+    for (int vertex = 0; vertex < NumberOfVertices; ++vertex)
+      {
+      values->SetValue(vertex, SubjectValues[subject][vertex]);
+      }
+    success &= Check(groupOverlay->SetSubjectValues(subject, values), "Could not set the values of subject " + std::to_string(subject));
+    }
+  // The last subject has values but is not valid, e.g. its file was truncated
+  float* invalidValues = groupOverlay->GetSubjectValues(NumberOfSubjects - 1);
+  std::copy(SubjectValues[NumberOfSubjects - 1], SubjectValues[NumberOfSubjects - 1] + NumberOfVertices, invalidValues);
+  success &= Check(groupOverlay->GetNumberOfValidSubjects() == NumberOfSubjects - 1, "Wrong number of valid subjects");
+  success &= Check(!groupOverlay->GetSubjectValid(NumberOfSubjects - 1), "Subject is valid without SetSubjectValues");
+  vtkNew<vtkFloatArray> wrongSize;
+  wrongSize->SetNumberOfValues(NumberOfVertices + 1);
+  success &= Check(!groupOverlay->SetSubjectValues(NumberOfSubjects - 1, wrongSize), "Values of another surface are accepted");
+
+  // Vertex 0: 1, 2, 3, 4, 6, 8. Vertex 1: 1, 2, 4, 6. Vertex 2: 1, 4, 6, 8.
+  const double expectedMeans[NumberOfVertices] = { 4.0, 3.25, 4.75, 5.0, NaN };
+  const double expectedStandardDeviations[NumberOfVertices] = {
+    std::sqrt(34.0 / 5.0), std::sqrt(14.75 / 3.0), std::sqrt(26.75 / 3.0), 0.0, NaN };
+  success &= CheckValues(groupOverlay->ComputeMean(), "mean", expectedMeans);
+  success &= CheckValues(groupOverlay->ComputeStandardDeviation(), "std", expectedStandardDeviations);
+
+  // Vertex 0: group 0 has mean 2 and variance 1, group 1 has mean 6 and variance 4.
+  // Vertex 1: group 0 has mean 1.5 and variance 0.5, group 1 has mean 5 and variance 2.
+  const double expectedT[NumberOfVertices] = {
+    (6.0 - 2.0) / std::sqrt(4.0 / 3.0 + 1.0 / 3.0), (5.0 - 1.5) / std::sqrt(2.0 / 2.0 + 0.5 / 2.0), NaN, 0.0, NaN };
+  std::vector<int> groups(Groups, Groups + NumberOfSubjects);
+  success &= CheckValues(groupOverlay->ComputeTStatistic(groups), "t", expectedT);
+
+  // Subjects of other groups are left out, swapping the groups changes the sign
+  groups[0] = 2;
+  std::vector<int> swappedGroups(NumberOfSubjects);
+  for (int subject = 0; subject < NumberOfSubjects; ++subject)
+    {
+    swappedGroups[subject] = 1 - Groups[subject];
+    }
+  vtkSmartPointer<vtkFloatArray> swappedT = groupOverlay->ComputeTStatistic(swappedGroups);
+  success &= Check(swappedT && IsClose(swappedT->GetValue(0), -expectedT[0]) && IsClose(swappedT->GetValue(1), -expectedT[1]),
+    "Swapping the groups does not change the sign of t");
+  vtkSmartPointer<vtkFloatArray> partialT = groupOverlay->ComputeTStatistic(groups);
+  // Vertex 0 without subject 0: group 0 has mean 2.5 and variance 0.5
+  success &= Check(partialT && IsClose(partialT->GetValue(0), (6.0 - 2.5) / std::sqrt(4.0 / 3.0 + 0.5 / 2.0))
+    && std::isnan(partialT->GetValue(1)), "Subjects outside of the groups are not left out");
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
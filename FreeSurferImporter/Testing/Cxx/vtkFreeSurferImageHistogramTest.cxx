@@ -0,0 +1,165 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the ranges and percentiles of vtkFreeSurferImageHistogram.
+//
+// Images with known value distributions are counted: 8-bit images (one bin
+// per value), a small range of integers (one bin per value) and float values
+// with NaN voxels (fixed number of bins). Percentiles must be the exact value
+// for discrete bins and within one bin for the others.
+//
+// Usage: vtkFreeSurferImageHistogramTest
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferImageHistogram.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferImageHistogramTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Image of 10 x 10 x 10 voxels of the specified type, voxel i set to value(i)
+  template<typename ValueFunction>
+  vtkSmartPointer<vtkImageData> CreateImage(int scalarType, ValueFunction value)
+  {
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(10, 10, 10);
+    image->AllocateScalars(scalarType, 1);
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i)
+      {
+      scalars->SetComponent(i, 0, value(i));
+      }
+    return image;
+  }
+
+  //----------------------------------------------------------------------------
+  bool CheckPercentile(vtkFreeSurferImageHistogram* histogram, double percent, double expected, double tolerance,
+    const std::string& description)
+  {
+    double percentile = histogram->GetPercentile(percent);
+    return Check(std::abs(percentile - expected) <= tolerance, "Percentile " + std::to_string(percent) + " of the "
+      + description + " is " + std::to_string(percentile) + " instead of " + std::to_string(expected));
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferImageHistogramTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool success = true;
+  vtkNew<vtkFreeSurferImageHistogram> histogram;
+
+  // Unsigned char: values 0 to 99, 10 voxels each, one bin per value
+  vtkSmartPointer<vtkImageData> ucharImage = CreateImage(VTK_UNSIGNED_CHAR, [](vtkIdType i) { return static_cast<double>(i % 100); });
+  if (Check(histogram->Compute(ucharImage), "Could not compute the histogram of the unsigned char image"))
+    {
+    success &= Check(histogram->GetRange()[0] == 0.0 && histogram->GetRange()[1] == 99.0, "Wrong range of the unsigned char image");
+    success &= Check(histogram->GetBins().size() == 256 && histogram->GetBinOrigin() == 0.0 && histogram->GetBinSpacing() == 1.0,
+      "Unsigned char image does not have one bin per value");
+    success &= Check(histogram->GetBins()[42] == 10 && histogram->GetBins()[200] == 0, "Wrong counts of the unsigned char image");
+    success &= CheckPercentile(histogram, 0.0, 0.0, 0.0, "unsigned char image");
+    success &= CheckPercentile(histogram, 50.0, 49.0, 0.0, "unsigned char image");
+    success &= CheckPercentile(histogram, 99.0, 98.0, 0.0, "unsigned char image");
+    success &= CheckPercentile(histogram, 100.0, 99.0, 0.0, "unsigned char image");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Signed char: bins are ordered by value, from the lowest value of the type
+  vtkSmartPointer<vtkImageData> charImage = CreateImage(VTK_SIGNED_CHAR, [](vtkIdType i) { return static_cast<double>(i % 100 - 50); });
+  if (Check(histogram->Compute(charImage), "Could not compute the histogram of the signed char image"))
+    {
+    success &= Check(histogram->GetRange()[0] == -50.0 && histogram->GetRange()[1] == 49.0, "Wrong range of the signed char image");
+    success &= CheckPercentile(histogram, 50.0, -1.0, 0.0, "signed char image");
+    success &= CheckPercentile(histogram, 100.0, 49.0, 0.0, "signed char image");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Short values with a range smaller than the number of bins: one bin per value
+  vtkSmartPointer<vtkImageData> shortImage = CreateImage(VTK_SHORT, [](vtkIdType i) { return static_cast<double>(i % 11 - 5); });
+  if (Check(histogram->Compute(shortImage), "Could not compute the histogram of the short image"))
+    {
+    success &= Check(histogram->GetBins().size() == 11 && histogram->GetBinSpacing() == 1.0, "Short image does not have one bin per value");
+    success &= CheckPercentile(histogram, 50.0, 0.0, 0.0, "short image");
+    success &= CheckPercentile(histogram, 100.0, 5.0, 0.0, "short image");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Float values 0 to 99.9 in steps of 0.1, with NaN voxels that are not counted
+  vtkSmartPointer<vtkImageData> floatImage = CreateImage(VTK_FLOAT, [](vtkIdType i)
+    {
+    return i % 10 == 3 ? std::numeric_limits<double>::quiet_NaN() : 0.1 * i;
+    });
+  histogram->SetNumberOfBins(100);
+  if (Check(histogram->Compute(floatImage), "Could not compute the histogram of the float image"))
+    {
+    success &= Check(histogram->GetRange()[0] == 0.0 && std::abs(histogram->GetRange()[1] - 99.9) < 1e-4, "Wrong range of the float image");
+    vtkIdType numberOfValues = 0;
+    for (vtkIdType count : histogram->GetBins())
+      {
+      numberOfValues += count;
+      }
+    success &= Check(histogram->GetBins().size() == 100 && numberOfValues == 900, "NaN voxels of the float image are counted");
+    double binSpacing = histogram->GetBinSpacing();
+    success &= CheckPercentile(histogram, 0.0, 0.0, binSpacing, "float image");
+    success &= CheckPercentile(histogram, 25.0, 25.0, binSpacing, "float image");
+    success &= CheckPercentile(histogram, 50.0, 50.0, binSpacing, "float image");
+    success &= CheckPercentile(histogram, 99.0, 99.0, binSpacing, "float image");
+    success &= CheckPercentile(histogram, 100.0, 99.9, 1e-4, "float image");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Only NaN values
+  vtkSmartPointer<vtkImageData> nanImage = CreateImage(VTK_DOUBLE, [](vtkIdType) { return std::numeric_limits<double>::quiet_NaN(); });
+  success &= Check(!histogram->Compute(nanImage) && histogram->GetBins().empty(), "Histogram of an image without valid values is computed");
+  success &= Check(histogram->GetPercentile(50.0) == 0.0, "Percentile of an empty histogram is not 0");
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the extraction of label surfaces by vtkFreeSurferLabelSurfaces.
+//
+// Boxes of different labels are drawn in a label volume, one of them touching
+// the border of the volume. Each requested label must give one closed surface,
+// with the extent of its box mapped to RAS by the IJK to RAS matrix and with
+// normals pointing outwards.
+//
+// Usage: vtkFreeSurferLabelSurfacesTest
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferLabelSurfaces.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkFeatureEdges.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  struct LabelBox
+    {
+    int Value;
+    int Extent[6];
+    };
+
+  /// The last box touches the border of the volume, its surface must still be closed
+  const LabelBox Boxes[] = {
+    { 3, { 2, 6, 2, 6, 2, 6 } },
+    { 7, { 10, 15, 4, 8, 12, 16 } },
+    { 1024, { 0, 3, 12, 19, 14, 19 } },
+    };
+  const int NumberOfBoxes = 3;
+  const int VolumeSize = 20;
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferLabelSurfacesTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// RAS bounds of the boundary of a box of voxels, halfway between the voxels of the box and the next ones
+  void GetExpectedBounds(const LabelBox& box, vtkMatrix4x4* ijkToRAS, double bounds[6])
+  {
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      bounds[2 * axis] = VTK_DOUBLE_MAX;
+      bounds[2 * axis + 1] = VTK_DOUBLE_MIN;
+      }
+    for (int corner = 0; corner < 8; ++corner)
+      {
+      double ijk[4] = { 0.0, 0.0, 0.0, 1.0 };
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        ijk[axis] = (corner & (1 << axis)) ? box.Extent[2 * axis + 1] + 0.5 : box.Extent[2 * axis] - 0.5;
+        }
+      double ras[4] = { 0.0 };
+      ijkToRAS->MultiplyPoint(ijk, ras);
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        bounds[2 * axis] = std::min(bounds[2 * axis], ras[axis]);
+        bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], ras[axis]);
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsClosed(vtkPolyData* surface)
+  {
+    vtkNew<vtkFeatureEdges> boundaryEdges;
+    boundaryEdges->SetInputData(surface);
+    boundaryEdges->BoundaryEdgesOn();
+    boundaryEdges->FeatureEdgesOff();
+    boundaryEdges->ManifoldEdgesOff();
+    boundaryEdges->NonManifoldEdgesOff();
+    boundaryEdges->Update();
+    return boundaryEdges->GetOutput()->GetNumberOfCells() == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Normals point away from the center of the surface on average
+  bool HasOutwardNormals(vtkPolyData* surface)
+  {
+    vtkDataArray* normals = surface->GetPointData()->GetNormals();
+    if (!normals)
+      {
+      return false;
+      }
+    double bounds[6] = { 0.0 };
+    surface->GetBounds(bounds);
+    double sum = 0.0;
+    for (vtkIdType pointId = 0; pointId < surface->GetNumberOfPoints(); ++pointId)
+      {
+      double point[3] = { 0.0 };
+      surface->GetPoint(pointId, point);
+      const double* normal = normals->GetTuple3(pointId);
+      for (int axis = 0; axis < 3; ++axis)
+        {
+        sum += normal[axis] * (point[axis] - (bounds[2 * axis] + bounds[2 * axis + 1]) / 2.0);
+        }
+      }
+    return sum > 0.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferLabelSurfacesTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkImageData> labelImage;
+  labelImage->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  // Origin and spacing of the image are ignored, voxels are placed by the IJK to RAS matrix
+  labelImage->SetOrigin(100.0, 100.0, 100.0);
+  labelImage->SetSpacing(3.0, 3.0, 3.0);
+  labelImage->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(labelImage->GetScalarPointer());
+  std::fill(voxels, voxels + VolumeSize * VolumeSize * VolumeSize, static_cast<short>(0));
+  for (const LabelBox& box : Boxes)
+    {
+    for (int k = box.Extent[4]; k <= box.Extent[5]; ++k)
+      {
+      for (int j = box.Extent[2]; j <= box.Extent[3]; ++j)
+        {
+        for (int i = box.Extent[0]; i <= box.Extent[1]; ++i)
+          {
+          voxels[(k * VolumeSize + j) * VolumeSize + i] = static_cast<short>(box.Value);
+          }
+        }
+      }
+    }
+
+  // Conformed orientation (LIA) with 2 mm voxels along the first axis
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  const double elements[16] = {
+    -2.0, 0.0, 0.0, 10.0,
+    0.0, 0.0, 1.0, -5.0,
+    0.0, -1.0, 0.0, 3.0,
+    0.0, 0.0, 0.0, 1.0 };
+  ijkToRAS->DeepCopy(elements);
+
+  bool success = true;
+
+  // All labels except the background, without smoothing so that the surfaces are on the voxel boundaries
+  vtkNew<vtkFreeSurferLabelSurfaces> labelSurfaces;
+  labelSurfaces->SetSmoothingFactor(0.0);
+  success &= Check(labelSurfaces->Compute(labelImage, ijkToRAS), "Could not compute the label surfaces");
+  success &= Check(labelSurfaces->GetNumberOfOutputs() == NumberOfBoxes, "Wrong number of label surfaces");
+  for (int n = 0; n < labelSurfaces->GetNumberOfOutputs() && n < NumberOfBoxes; ++n)
+    {
+    const LabelBox& box = Boxes[n];
+    std::string label = std::to_string(box.Value);
+    vtkPolyData* surface = labelSurfaces->GetOutput(n);
+    success &= Check(labelSurfaces->GetOutputLabelValue(n) == box.Value, "Labels are not in increasing label value order");
+    if (!Check(surface && surface->GetNumberOfPolys() > 0, "Surface of label " + label + " is empty"))
+      {
+      success = false;
+      continue;
+      }
+
+    double expectedBounds[6] = { 0.0 };
+    GetExpectedBounds(box, ijkToRAS, expectedBounds);
+    double bounds[6] = { 0.0 };
+    surface->GetBounds(bounds);
+    for (int i = 0; i < 6; ++i)
+      {
+      success &= Check(std::abs(bounds[i] - expectedBounds[i]) < 1e-4, "Wrong RAS bounds of the surface of label " + label);
+      }
+    success &= Check(IsClosed(surface), "Surface of label " + label + " is not closed");
+    success &= Check(HasOutwardNormals(surface), "Normals of label " + label + " do not point outwards");
+    }
+
+  // Requested labels only, labels that are not in the volume are skipped. Smoothing keeps the surface
+  // within the voxels next to the structure.
+  std::vector<int> labelValues = { 7, 99 };
+  labelSurfaces->SetLabelValues(labelValues);
+  labelSurfaces->SetSmoothingFactor(0.5);
+  labelSurfaces->ComputeNormalsOff();
+  success &= Check(labelSurfaces->Compute(labelImage, ijkToRAS), "Could not compute the requested label surfaces");
+  if (Check(labelSurfaces->GetNumberOfOutputs() == 1 && labelSurfaces->GetOutputLabelValue(0) == 7,
+    "Wrong requested label surfaces"))
+    {
+    vtkPolyData* surface = labelSurfaces->GetOutput(0);
+    double expectedBounds[6] = { 0.0 };
+    GetExpectedBounds(Boxes[1], ijkToRAS, expectedBounds);
+    double bounds[6] = { 0.0 };
+    surface->GetBounds(bounds);
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      double voxelSize = std::abs(ijkToRAS->GetElement(axis, 0)) + std::abs(ijkToRAS->GetElement(axis, 1))
+        + std::abs(ijkToRAS->GetElement(axis, 2));
+      success &= Check(bounds[2 * axis] > expectedBounds[2 * axis] - voxelSize
+        && bounds[2 * axis + 1] < expectedBounds[2 * axis + 1] + voxelSize, "Smoothed surface is not around its voxels");
+      }
+    success &= Check(IsClosed(surface), "Smoothed surface is not closed");
+    success &= Check(surface->GetPointData()->GetNormals() == nullptr, "Normals are computed when disabled");
+    }
+  else
+    {
+    success = false;
+    }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the round trip of values through vtkFreeSurferQuantizer.
+//
+// Floating-point and integer values are quantized to 16 and 8 bits and
+// dequantized. Every finite value must come back within half a quantization
+// step, NaN and infinite values must come back as NaN, and integer values
+// whose range fits in the stored type must come back exactly.
+//
+// Usage: vtkFreeSurferQuantizerTest
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferQuantizer.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkShortArray.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferQuantizerTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Values spread over [minimum, maximum], in an order that differs from their magnitude
+  vtkSmartPointer<vtkFloatArray> CreateFloatValues(vtkIdType numberOfValues, double minimum, double maximum)
+  {
+    vtkSmartPointer<vtkFloatArray> values = vtkSmartPointer<vtkFloatArray>::New();
+    values->SetName("values");
+    values->SetNumberOfValues(numberOfValues);
+    for (vtkIdType i = 0; i < numberOfValues; ++i)
+      {
+      double fraction = static_cast<double>((i * 7919) % numberOfValues) / (numberOfValues - 1);
+      values->SetValue(i, static_cast<float>(minimum + fraction * (maximum - minimum)));
+      }
+    return values;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Quantize and dequantize the values, and check that finite values are restored within half a step
+  /// (up to the rounding of single-precision computations) and non-finite values as NaN
+  bool CheckRoundTrip(vtkDataArray* values, int storageMode, int expectedType, const std::string& description)
+  {
+    vtkSmartPointer<vtkDataArray> quantized = vtkFreeSurferQuantizer::Quantize(values, storageMode);
+    if (!Check(quantized != nullptr, "Could not quantize the " + description)
+      || !Check(quantized->GetDataType() == expectedType, "Wrong stored type of the " + description)
+      || !Check(quantized->GetNumberOfValues() == values->GetNumberOfValues(), "Wrong number of quantized " + description))
+      {
+      return false;
+      }
+    double scale = 0.0;
+    double offset = 0.0;
+    bool success = Check(vtkFreeSurferQuantizer::GetQuantization(quantized, scale, offset) && scale > 0.0,
+      "No quantization of the " + description);
+    success &= Check(std::string(quantized->GetName()) == values->GetName(), "Quantized " + description + " are renamed");
+    success &= Check(vtkFreeSurferQuantizer::Quantize(quantized, storageMode) == nullptr, "Quantized " + description + " are quantized again");
+
+    vtkSmartPointer<vtkFloatArray> dequantized = vtkFreeSurferQuantizer::Dequantize(quantized);
+    if (!Check(dequantized != nullptr && dequantized->GetNumberOfValues() == values->GetNumberOfValues(),
+      "Could not dequantize the " + description))
+      {
+      return false;
+      }
+    double maximumError = 0.0;
+    bool nanRestored = true;
+    for (vtkIdType i = 0; i < values->GetNumberOfValues(); ++i)
+      {
+      double value = values->GetComponent(i, 0);
+      double restored = dequantized->GetValue(i);
+      if (!std::isfinite(value))
+        {
+        nanRestored &= std::isnan(restored);
+        continue;
+        }
+      double tolerance = 1e-6 * std::max(1.0, std::abs(value));
+      maximumError = std::max(maximumError, std::abs(restored - value) - tolerance);
+      }
+    success &= Check(nanRestored, "Non-finite " + description + " are not restored as NaN");
+    success &= Check(maximumError <= 0.51 * scale, "Dequantized " + description + " differ by " + std::to_string(maximumError)
+      + ", more than half the scale " + std::to_string(scale));
+    return success;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferQuantizerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool success = true;
+
+  // Floating-point values, with non-finite values that must not take part in the range
+  vtkSmartPointer<vtkFloatArray> floatValues = CreateFloatValues(10000, -5.0, 1000.0);
+  floatValues->SetValue(17, std::numeric_limits<float>::quiet_NaN());
+  floatValues->SetValue(4242, std::numeric_limits<float>::infinity());
+  floatValues->SetValue(9999, -std::numeric_limits<float>::infinity());
+  success &= CheckRoundTrip(floatValues, vtkFreeSurferQuantizer::Quantized16Bit, VTK_UNSIGNED_SHORT, "float values (16 bit)");
+  success &= CheckRoundTrip(floatValues, vtkFreeSurferQuantizer::Quantized8Bit, VTK_UNSIGNED_CHAR, "float values (8 bit)");
+  vtkSmartPointer<vtkDataArray> quantized = vtkFreeSurferQuantizer::Quantize(floatValues, vtkFreeSurferQuantizer::Quantized16Bit);
+  double scale = 0.0;
+  double offset = 0.0;
+  if (Check(quantized && vtkFreeSurferQuantizer::GetQuantization(quantized, scale, offset), "Could not quantize the float values"))
+    {
+    double minimum = VTK_DOUBLE_MAX;
+    double maximum = VTK_DOUBLE_MIN;
+    for (vtkIdType i = 0; i < floatValues->GetNumberOfValues(); ++i)
+      {
+      if (std::isfinite(floatValues->GetValue(i)))
+        {
+        minimum = std::min(minimum, static_cast<double>(floatValues->GetValue(i)));
+        maximum = std::max(maximum, static_cast<double>(floatValues->GetValue(i)));
+        }
+      }
+    // The largest stored value is reserved for NaN
+    success &= Check(offset == minimum && std::abs(scale * 65534.0 - (maximum - minimum)) < 1e-9 * maximum,
+      "Range of the float values is not mapped to the stored values");
+    success &= Check(quantized->GetInformation()->Has(vtkFreeSurferQuantizer::QUANTIZATION_NAN_VALUE())
+      && quantized->GetInformation()->Get(vtkFreeSurferQuantizer::QUANTIZATION_NAN_VALUE()) == 65535.0
+      && quantized->GetComponent(17, 0) == 65535.0, "NaN is not stored as the largest stored value");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Small range far from 0: the offset is subtracted before scaling, so the stored levels are those
+  // computed in double precision even though float values are converted in single precision
+  vtkSmartPointer<vtkFloatArray> farValues = CreateFloatValues(1000, 100000.0, 100010.0);
+  quantized = vtkFreeSurferQuantizer::Quantize(farValues, vtkFreeSurferQuantizer::Quantized16Bit);
+  if (Check(quantized && vtkFreeSurferQuantizer::GetQuantization(quantized, scale, offset), "Could not quantize the values far from 0"))
+    {
+    double maximumLevelError = 0.0;
+    for (vtkIdType i = 0; i < farValues->GetNumberOfValues(); ++i)
+      {
+      double level = std::floor((farValues->GetValue(i) - offset) / scale + 0.5);
+      maximumLevelError = std::max(maximumLevelError, std::abs(quantized->GetComponent(i, 0) - level));
+      }
+    success &= Check(maximumLevelError <= 1.0, "Stored levels of values far from 0 are off by " + std::to_string(maximumLevelError));
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Only non-finite values
+  vtkNew<vtkFloatArray> nanValues;
+  nanValues->SetName("values");
+  nanValues->SetNumberOfValues(10);
+  nanValues->Fill(std::numeric_limits<float>::quiet_NaN());
+  success &= CheckRoundTrip(nanValues, vtkFreeSurferQuantizer::Quantized8Bit, VTK_UNSIGNED_CHAR, "NaN values");
+
+  // Integers whose range fits in the stored type are stored exactly, without a value reserved for NaN
+  vtkNew<vtkShortArray> labelValues;
+  labelValues->SetName("values");
+  labelValues->SetNumberOfValues(1000);
+  for (vtkIdType i = 0; i < labelValues->GetNumberOfValues(); ++i)
+    {
+    labelValues->SetValue(i, static_cast<short>(-300 + (i * 37) % 1000));
+    }
+  vtkNew<vtkIntArray> intValues;
+  intValues->DeepCopy(labelValues);
+  success &= CheckRoundTrip(intValues, vtkFreeSurferQuantizer::Quantized16Bit, VTK_UNSIGNED_SHORT, "int values (16 bit)");
+  quantized = vtkFreeSurferQuantizer::Quantize(intValues, vtkFreeSurferQuantizer::Quantized16Bit);
+  vtkSmartPointer<vtkFloatArray> dequantized = vtkFreeSurferQuantizer::Dequantize(quantized);
+  bool exact = quantized && dequantized && !quantized->GetInformation()->Has(vtkFreeSurferQuantizer::QUANTIZATION_NAN_VALUE());
+  for (vtkIdType i = 0; exact && i < intValues->GetNumberOfValues(); ++i)
+    {
+    exact = dequantized->GetValue(i) == intValues->GetValue(i);
+    }
+  success &= Check(exact, "Integer values are not restored exactly");
+  success &= CheckRoundTrip(intValues, vtkFreeSurferQuantizer::Quantized8Bit, VTK_UNSIGNED_CHAR, "int values (8 bit)");
+
+  // Values that are not larger than the stored type, or full precision, are left unchanged
+  success &= Check(vtkFreeSurferQuantizer::Quantize(labelValues, vtkFreeSurferQuantizer::Quantized16Bit) == nullptr,
+    "Short values are quantized to 16 bit");
+  vtkNew<vtkUnsignedCharArray> ucharValues;
+  ucharValues->SetNumberOfValues(10);
+  success &= Check(vtkFreeSurferQuantizer::Quantize(ucharValues, vtkFreeSurferQuantizer::Quantized8Bit) == nullptr,
+    "Unsigned char values are quantized to 8 bit");
+  success &= Check(vtkFreeSurferQuantizer::Quantize(floatValues, vtkFreeSurferQuantizer::FullPrecision) == nullptr,
+    "Values are quantized in full precision mode");
+  success &= Check(vtkFreeSurferQuantizer::Dequantize(floatValues) == nullptr, "Values that are not quantized are dequantized");
+
+  // Images keep their geometry, only the scalars are replaced
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(10, 10, 10);
+  image->SetSpacing(2.0, 2.0, 2.0);
+  image->AllocateScalars(VTK_DOUBLE, 1);
+  for (vtkIdType i = 0; i < 1000; ++i)
+    {
+    image->GetPointData()->GetScalars()->SetComponent(i, 0, 0.25 * i);
+    }
+  success &= Check(vtkFreeSurferQuantizer::QuantizeImage(image, vtkFreeSurferQuantizer::Quantized16Bit)
+    && image->GetScalarType() == VTK_UNSIGNED_SHORT && image->GetPointData()->GetScalars()->GetNumberOfTuples() == 1000
+    && image->GetSpacing()[0] == 2.0, "Image scalars are not quantized");
+  success &= Check(!vtkFreeSurferQuantizer::QuantizeImage(image, vtkFreeSurferQuantizer::Quantized16Bit),
+    "Quantized image scalars are quantized again");
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
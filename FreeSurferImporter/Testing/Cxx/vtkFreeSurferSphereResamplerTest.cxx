@@ -0,0 +1,164 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the resampling of overlays by vtkFreeSurferSphereResampler.
+//
+// An overlay resampled onto the sphere it was defined on must be unchanged,
+// with both interpolations. A linear function of the coordinates resampled
+// onto a finer sphere of another radius must be close to the same function
+// at the target vertices.
+//
+// Usage: vtkFreeSurferSphereResamplerTest
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSphereResampler.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferSphereResamplerTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPolyData> CreateSphere(double radius, int resolution)
+  {
+    vtkNew<vtkSphereSource> sphereSource;
+    sphereSource->SetRadius(radius);
+    sphereSource->SetThetaResolution(2 * resolution);
+    sphereSource->SetPhiResolution(resolution);
+    sphereSource->Update();
+    return sphereSource->GetOutput();
+  }
+
+  //----------------------------------------------------------------------------
+  /// Linear function of the direction of the vertex from the center of the sphere
+  double GetValue(const double point[3], double radius)
+  {
+    return (point[0] + 2.0 * point[1] + 3.0 * point[2]) / radius;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkFloatArray> CreateOverlay(vtkPolyData* sphere, double radius)
+  {
+    vtkSmartPointer<vtkFloatArray> overlay = vtkSmartPointer<vtkFloatArray>::New();
+    overlay->SetName("thickness");
+    overlay->SetNumberOfValues(sphere->GetNumberOfPoints());
+    for (vtkIdType i = 0; i < sphere->GetNumberOfPoints(); ++i)
+      {
+      double point[3] = { 0.0 };
+      sphere->GetPoint(i, point);
+      overlay->SetValue(i, static_cast<float>(GetValue(point, radius)));
+      }
+    return overlay;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Largest difference between the values and the reference, NaN values are not accepted
+  double GetMaximumError(vtkFloatArray* values, vtkFloatArray* reference)
+  {
+    double maximumError = 0.0;
+    for (vtkIdType i = 0; i < reference->GetNumberOfValues(); ++i)
+      {
+      double error = std::abs(static_cast<double>(values->GetValue(i)) - reference->GetValue(i));
+      if (!(error <= maximumError))
+        {
+        maximumError = std::isnan(error) ? VTK_DOUBLE_MAX : error;
+        }
+      }
+    return maximumError;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferSphereResamplerTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool success = true;
+  vtkSmartPointer<vtkPolyData> sphere = CreateSphere(100.0, 24);
+  vtkSmartPointer<vtkFloatArray> overlay = CreateOverlay(sphere, 100.0);
+
+  vtkNew<vtkFreeSurferSphereResampler> resampler;
+  vtkFreeSurferSphereResampler::Mapping mapping;
+  success &= Check(resampler->SetTargetSphere(sphere), "Could not set the target sphere");
+  success &= Check(resampler->GetNumberOfTargetVertices() == sphere->GetNumberOfPoints(), "Wrong number of target vertices");
+  if (!Check(resampler->ComputeMapping(sphere, mapping), "Could not compute the mapping of the same sphere"))
+    {
+    return EXIT_FAILURE;
+    }
+  success &= Check(mapping.NumberOfSourceVertices == sphere->GetNumberOfPoints(), "Wrong number of source vertices of the mapping");
+  success &= Check(mapping.VertexIds.size() == 3 * static_cast<size_t>(sphere->GetNumberOfPoints())
+    && mapping.Weights.size() == mapping.VertexIds.size(), "Wrong size of the mapping");
+
+  // Same sphere: each vertex is a corner of its triangle, with a weight of 1
+  vtkSmartPointer<vtkFloatArray> barycentric = vtkFreeSurferSphereResampler::Resample(mapping, overlay);
+  vtkSmartPointer<vtkFloatArray> nearest = vtkFreeSurferSphereResampler::Resample(mapping, overlay,
+    vtkFreeSurferSphereResampler::NearestVertex);
+  if (Check(barycentric && nearest, "Could not resample onto the same sphere"))
+    {
+    success &= Check(barycentric->GetNumberOfValues() == overlay->GetNumberOfValues(), "Wrong number of resampled values");
+    success &= Check(std::string(barycentric->GetName()) == overlay->GetName(), "Resampled overlay is not named after the overlay");
+    success &= Check(GetMaximumError(barycentric, overlay) < 1e-4, "Barycentric resampling onto the same sphere changes the values");
+    success &= Check(GetMaximumError(nearest, overlay) == 0.0, "Nearest vertex resampling onto the same sphere changes the values");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Finer target sphere of another radius: only the directions of the vertices matter
+  vtkSmartPointer<vtkPolyData> targetSphere = CreateSphere(50.0, 40);
+  vtkSmartPointer<vtkFloatArray> targetValues = CreateOverlay(targetSphere, 50.0);
+  success &= Check(resampler->SetTargetSphere(targetSphere), "Could not set the finer target sphere");
+  success &= Check(resampler->ComputeMapping(sphere, mapping), "Could not compute the mapping to the finer sphere");
+  vtkSmartPointer<vtkFloatArray> resampled = vtkFreeSurferSphereResampler::Resample(mapping, overlay);
+  if (Check(resampled && resampled->GetNumberOfValues() == targetSphere->GetNumberOfPoints(),
+    "Could not resample onto the finer sphere"))
+    {
+    // Values range from -3.7 to 3.7, flat source triangles lower the values by about 1 percent
+    success &= Check(GetMaximumError(resampled, targetValues) < 0.1, "Resampled values differ from the function on the finer sphere");
+    }
+  else
+    {
+    success = false;
+    }
+
+  // Overlays of another surface are rejected
+  vtkNew<vtkFloatArray> otherOverlay;
+  otherOverlay->SetNumberOfValues(sphere->GetNumberOfPoints() + 1);
+  success &= Check(vtkFreeSurferSphereResampler::Resample(mapping, otherOverlay) == nullptr,
+    "Overlay with another number of vertices is resampled");
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
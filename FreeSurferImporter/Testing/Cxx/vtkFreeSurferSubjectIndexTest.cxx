@@ -0,0 +1,169 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the scan and the rescan of subject directories by vtkFreeSurferSubjectIndex.
+//
+// A synthetic subject directory is indexed, then files are added, modified and
+// removed, and only the changes of the rescanned directories must be reported.
+//
+// Usage: vtkFreeSurferSubjectIndexTest [--temp dir]
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferSubjectIndex.h"
+#include "vtkSlicerFreeSurferImporterLogic.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool WriteFile(const std::string& fileName, size_t size)
+  {
+    FILE* file = vtksys::SystemTools::Fopen(fileName, "wb");
+    if (!file)
+      {
+      return false;
+      }
+    std::vector<char> content(size, 'x');
+    bool success = fwrite(content.data(), 1, content.size(), file) == content.size();
+    return (fclose(file) == 0) && success;
+  }
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferSubjectIndexTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check that the file is indexed with the expected type and size
+  bool CheckFile(vtkFreeSurferSubjectIndex* index, const std::string& name, int type, unsigned long long size)
+  {
+    const vtkFreeSurferSubjectIndex::FileInfo* info = index->GetFileInfo(name);
+    return Check(info != nullptr, name + " is not indexed")
+      && Check(info->Type == type, "Wrong type of " + name)
+      && Check(info->Size == size, "Wrong size of " + name);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferSubjectIndexTest(int argc, char* argv[])
+{
+  std::string temporaryDirectory = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  for (int i = 1; i + 1 < argc; i += 2)
+    {
+    std::string option = argv[i];
+    if (option == "--temp")
+      {
+      temporaryDirectory = argv[i + 1];
+      }
+    else
+      {
+      std::cerr << "vtkFreeSurferSubjectIndexTest: Unknown option " << option << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::string subjectDirectory = temporaryDirectory + "/vtkFreeSurferSubjectIndexTest/bert";
+  vtksys::SystemTools::RemoveADirectory(subjectDirectory);
+  if (!vtksys::SystemTools::MakeDirectory(subjectDirectory + "/mri")
+    || !vtksys::SystemTools::MakeDirectory(subjectDirectory + "/surf")
+    || !vtksys::SystemTools::MakeDirectory(subjectDirectory + "/label")
+    || !vtksys::SystemTools::MakeDirectory(subjectDirectory + "/scripts")
+    || !vtksys::SystemTools::MakeDirectory(subjectDirectory + "/surf/subdirectory"))
+    {
+    std::cerr << "vtkFreeSurferSubjectIndexTest: Could not create " << subjectDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  bool success = true;
+  success &= Check(WriteFile(subjectDirectory + "/mri/orig.mgz", 10)
+    && WriteFile(subjectDirectory + "/mri/aparc+aseg.mgz", 20)
+    && WriteFile(subjectDirectory + "/surf/lh.white", 30)
+    && WriteFile(subjectDirectory + "/surf/lh.thickness", 40)
+    && WriteFile(subjectDirectory + "/surf/lh.unknown", 50)
+    && WriteFile(subjectDirectory + "/label/lh.aparc.annot", 60)
+    && WriteFile(subjectDirectory + "/scripts/recon-all.log", 70), "Could not write the subject files");
+
+  vtkNew<vtkFreeSurferSubjectIndex> index;
+  index->SetSubjectDirectory(subjectDirectory);
+  success &= Check(index->GetFiles().empty(), "Files are indexed before the first scan");
+  success &= Check(index->Update(), "First scan does not report a change");
+  success &= Check(!index->Update(), "Scan of an unchanged subject reports a change");
+
+  // Regular files of the indexed directories only, ordered by name
+  std::vector<vtkFreeSurferSubjectIndex::FileInfo> files = index->GetFiles();
+  const char* expectedNames[] = { "label/lh.aparc.annot", "mri/aparc+aseg.mgz", "mri/orig.mgz",
+    "surf/lh.thickness", "surf/lh.unknown", "surf/lh.white" };
+  success &= Check(files.size() == 6, "Wrong number of indexed files");
+  for (size_t i = 0; i < files.size() && i < 6; ++i)
+    {
+    success &= Check(files[i].Name == expectedNames[i], "Unexpected indexed file " + files[i].Name);
+    }
+  success &= CheckFile(index, "mri/orig.mgz", vtkSlicerFreeSurferImporterLogic::VolumeFile, 10);
+  success &= CheckFile(index, "mri/aparc+aseg.mgz", vtkSlicerFreeSurferImporterLogic::SegmentationFile, 20);
+  success &= CheckFile(index, "surf/lh.white", vtkSlicerFreeSurferImporterLogic::ModelFile, 30);
+  success &= CheckFile(index, "surf/lh.thickness", vtkSlicerFreeSurferImporterLogic::ScalarOverlayFile, 40);
+  success &= CheckFile(index, "surf/lh.unknown", -1, 50);
+  success &= CheckFile(index, "label/lh.aparc.annot", vtkSlicerFreeSurferImporterLogic::AnnotationFile, 60);
+  success &= Check(index->GetFileInfo("scripts/recon-all.log") == nullptr, "Files outside of the indexed directories are indexed");
+  success &= Check(index->GetFileInfo("surf/subdirectory") == nullptr, "Directories are indexed");
+  success &= Check(index->GetFiles(vtkSlicerFreeSurferImporterLogic::ModelFile).size() == 1, "Wrong number of model files");
+  success &= Check(index->GetFiles(vtkSlicerFreeSurferImporterLogic::LabelFile).empty(), "Wrong number of label files");
+
+  // Changes are only seen in the rescanned directory
+  success &= Check(WriteFile(subjectDirectory + "/surf/rh.white", 35)
+    && WriteFile(subjectDirectory + "/mri/orig.mgz", 15), "Could not modify the subject files");
+  success &= Check(!index->UpdatePath("label"), "Rescan of an unchanged directory reports a change");
+  success &= Check(index->GetFileInfo("surf/rh.white") == nullptr, "Directory is rescanned without a request");
+  success &= Check(index->UpdatePath(subjectDirectory + "/surf/rh.white"), "Rescan from an absolute file path does not report a change");
+  success &= CheckFile(index, "surf/rh.white", vtkSlicerFreeSurferImporterLogic::ModelFile, 35);
+  success &= CheckFile(index, "mri/orig.mgz", vtkSlicerFreeSurferImporterLogic::VolumeFile, 10);
+  success &= Check(index->UpdatePath("mri"), "Modified file size is not reported");
+  success &= CheckFile(index, "mri/orig.mgz", vtkSlicerFreeSurferImporterLogic::VolumeFile, 15);
+  success &= Check(!index->UpdatePath("scripts"), "Rescan of a directory that is not indexed reports a change");
+
+  // Removed files, and modification of the index only when its content changes
+  vtkMTimeType modifiedTime = index->GetMTime();
+  success &= Check(vtksys::SystemTools::RemoveFile(subjectDirectory + "/surf/lh.thickness"), "Could not remove a subject file");
+  success &= Check(index->Update(), "Removed file is not reported");
+  success &= Check(index->GetFileInfo("surf/lh.thickness") == nullptr, "Removed file is still indexed");
+  success &= Check(index->GetMTime() > modifiedTime, "Index is not modified by a change");
+  modifiedTime = index->GetMTime();
+  index->Update();
+  success &= Check(index->GetMTime() == modifiedTime, "Index is modified by a scan without changes");
+
+  // A missing subject directory gives an empty index
+  index->SetSubjectDirectory(subjectDirectory + "/missing");
+  success &= Check(!index->Update() && index->GetFiles().empty(), "Missing subject directory has indexed files");
+
+  vtksys::SystemTools::RemoveADirectory(temporaryDirectory + "/vtkFreeSurferSubjectIndexTest");
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
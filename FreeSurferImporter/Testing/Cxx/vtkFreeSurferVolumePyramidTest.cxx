@@ -0,0 +1,288 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Test of the levels of vtkFreeSurferVolumePyramid.
+//
+// The levels of a volume with odd dimensions are built and compared with the
+// means of the voxels they cover, and their IJK to RAS matrices must place
+// them on the volume. The levels are then saved for a synthetic volume file and
+// loaded again, and must be rejected once the volume file is modified, even
+// when its size and modification time do not tell.
+//
+// Usage: vtkFreeSurferVolumePyramidTest [--temp dir]
+
+// FreeSurferImporter Logic includes
+#include "vtkFreeSurferVolumePyramid.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
+
+namespace
+{
+  const int Dimensions[3] = { 9, 8, 5 };
+  /// Larger than the blocks hashed at the start and the end of the volume file
+  const size_t VolumeFileSize = 256 * 1024;
+
+  //----------------------------------------------------------------------------
+  bool WriteVolumeFile(const std::string& fileName, const std::vector<unsigned char>& content, std::time_t modifiedTime)
+  {
+    FILE* file = vtksys::SystemTools::Fopen(fileName, "wb");
+    if (!file)
+      {
+      return false;
+      }
+    bool success = fwrite(content.data(), 1, content.size(), file) == content.size();
+    success = (fclose(file) == 0) && success;
+#ifdef _WIN32
+    struct _utimbuf times;
+    times.actime = modifiedTime;
+    times.modtime = modifiedTime;
+    return success && _utime(fileName.c_str(), &times) == 0;
+#else
+    struct utimbuf times;
+    times.actime = modifiedTime;
+    times.modtime = modifiedTime;
+    return success && utime(fileName.c_str(), &times) == 0;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  bool Check(bool condition, const std::string& description)
+  {
+    if (!condition)
+      {
+      std::cerr << "vtkFreeSurferVolumePyramidTest: " << description << std::endl;
+      }
+    return condition;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetVoxelValue(int i, int j, int k)
+  {
+    return i + 10 * j + 100 * k;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Mean of the volume voxels covered by a voxel of a level, rounded as the short values of the levels
+  double GetExpectedLevelValue(int level, int i, int j, int k)
+  {
+    int factor = 1 << level;
+    double sum = 0.0;
+    int count = 0;
+    for (int volumeK = factor * k; volumeK < std::min(factor * (k + 1), Dimensions[2]); ++volumeK)
+      {
+      for (int volumeJ = factor * j; volumeJ < std::min(factor * (j + 1), Dimensions[1]); ++volumeJ)
+        {
+        for (int volumeI = factor * i; volumeI < std::min(factor * (i + 1), Dimensions[0]); ++volumeI)
+          {
+          sum += GetVoxelValue(volumeI, volumeJ, volumeK);
+          ++count;
+          }
+        }
+      }
+    return std::floor(sum / count + 0.5);
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check the dimensions and voxels of the levels of the pyramid
+  bool CheckLevels(vtkFreeSurferVolumePyramid* pyramid, const std::string& description)
+  {
+    bool success = Check(pyramid->GetNumberOfAvailableLevels() == 3, "Wrong number of " + description + " levels");
+    const int expectedDimensions[3][3] = { { 9, 8, 5 }, { 5, 4, 3 }, { 3, 2, 2 } };
+    for (int level = 1; level < pyramid->GetNumberOfAvailableLevels() && level < 3; ++level)
+      {
+      std::string levelName = description + " level " + std::to_string(level);
+      vtkImageData* levelImage = pyramid->GetLevel(level);
+      int levelDimensions[3] = { 0, 0, 0 };
+      vtkFreeSurferVolumePyramid::GetLevelDimensions(Dimensions, level, levelDimensions);
+      if (!Check(levelImage && levelImage->GetPointData()->GetScalars(), "No " + levelName)
+        || !Check(std::equal(levelDimensions, levelDimensions + 3, expectedDimensions[level])
+          && std::equal(levelDimensions, levelDimensions + 3, levelImage->GetDimensions()), "Wrong dimensions of " + levelName)
+        || !Check(levelImage->GetScalarType() == VTK_SHORT, "Wrong scalar type of " + levelName))
+        {
+        success = false;
+        continue;
+        }
+      // Odd dimensions: the last voxels of a level cover fewer voxels of the volume
+      double maximumError = 0.0;
+      for (int k = 0; k < levelDimensions[2]; ++k)
+        {
+        for (int j = 0; j < levelDimensions[1]; ++j)
+          {
+          for (int i = 0; i < levelDimensions[0]; ++i)
+            {
+            double value = levelImage->GetScalarComponentAsDouble(i, j, k, 0);
+            maximumError = std::max(maximumError, std::abs(value - GetExpectedLevelValue(level, i, j, k)));
+            }
+          }
+        }
+      success &= Check(maximumError <= 1.0, "Voxels of " + levelName + " are not the means of the volume voxels they cover");
+      }
+    return success;
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsSamePoint(const double a[4], const double b[4])
+  {
+    return std::abs(a[0] - b[0]) < 1e-9 && std::abs(a[1] - b[1]) < 1e-9 && std::abs(a[2] - b[2]) < 1e-9;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkFreeSurferVolumePyramidTest(int argc, char* argv[])
+{
+  std::string temporaryDirectory = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  for (int i = 1; i + 1 < argc; i += 2)
+    {
+    std::string option = argv[i];
+    if (option == "--temp")
+      {
+      temporaryDirectory = argv[i + 1];
+      }
+    else
+      {
+      std::cerr << "vtkFreeSurferVolumePyramidTest: Unknown option " << option << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::string testDirectory = temporaryDirectory + "/vtkFreeSurferVolumePyramidTest";
+  std::string volumeFileName = testDirectory + "/T1.mgz";
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  if (!vtksys::SystemTools::MakeDirectory(testDirectory))
+    {
+    std::cerr << "vtkFreeSurferVolumePyramidTest: Could not create " << testDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkImageData> volume;
+  volume->SetDimensions(Dimensions[0], Dimensions[1], Dimensions[2]);
+  volume->AllocateScalars(VTK_SHORT, 1);
+  for (int k = 0; k < Dimensions[2]; ++k)
+    {
+    for (int j = 0; j < Dimensions[1]; ++j)
+      {
+      for (int i = 0; i < Dimensions[0]; ++i)
+        {
+        volume->SetScalarComponentFromDouble(i, j, k, 0, GetVoxelValue(i, j, k));
+        }
+      }
+    }
+
+  bool success = true;
+  vtkNew<vtkFreeSurferVolumePyramid> pyramid;
+  pyramid->SetNumberOfLevels(3);
+  pyramid->SetInput(volume);
+  success &= Check(pyramid->GetNumberOfAvailableLevels() == 1 && pyramid->GetLevel(0) == volume.GetPointer()
+    && pyramid->GetLevel(1) == nullptr, "Levels are available before they are built");
+  success &= Check(pyramid->Build(), "Could not build the levels");
+  success &= CheckLevels(pyramid, "built");
+
+  // The voxels of a level are centered on the volume voxels they cover, and the corners of the volume are kept
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  const double elements[16] = {
+    -0.7, 0.0, 0.0, 90.0,
+    0.0, 0.0, 0.7, -120.0,
+    0.0, -0.7, 0.0, 100.0,
+    0.0, 0.0, 0.0, 1.0 };
+  ijkToRAS->DeepCopy(elements);
+  for (int level = 1; level < 3; ++level)
+    {
+    int factor = 1 << level;
+    vtkNew<vtkMatrix4x4> levelIJKToRAS;
+    vtkFreeSurferVolumePyramid::GetLevelIJKToRAS(ijkToRAS, level, levelIJKToRAS);
+
+    const double levelVoxel[4] = { 1.0, 0.0, 2.0, 1.0 };
+    const double coveredCenter[4] = { factor + (factor - 1) / 2.0, (factor - 1) / 2.0, 2 * factor + (factor - 1) / 2.0, 1.0 };
+    double levelRAS[4] = { 0.0 };
+    double volumeRAS[4] = { 0.0 };
+    levelIJKToRAS->MultiplyPoint(levelVoxel, levelRAS);
+    ijkToRAS->MultiplyPoint(coveredCenter, volumeRAS);
+    success &= Check(IsSamePoint(levelRAS, volumeRAS), "Voxel of level " + std::to_string(level) + " is not centered on the voxels it covers");
+
+    const double corner[4] = { -0.5, -0.5, -0.5, 1.0 };
+    levelIJKToRAS->MultiplyPoint(corner, levelRAS);
+    ijkToRAS->MultiplyPoint(corner, volumeRAS);
+    success &= Check(IsSamePoint(levelRAS, volumeRAS), "Corner of level " + std::to_string(level) + " is not the corner of the volume");
+    }
+
+  // Levels saved for the volume file are loaded from its dimensions, before the volume is read
+  std::vector<unsigned char> content(VolumeFileSize);
+  for (size_t i = 0; i < content.size(); ++i)
+    {
+    content[i] = static_cast<unsigned char>(i * 13);
+    }
+  const std::time_t volumeModifiedTime = std::time(nullptr) - 3600;
+  success &= Check(WriteVolumeFile(volumeFileName, content, volumeModifiedTime), "Could not write " + volumeFileName);
+  success &= Check(pyramid->Save(volumeFileName), "Could not save the levels");
+  success &= Check(vtksys::SystemTools::FileExists(vtkFreeSurferVolumePyramid::GetLevelFileName(volumeFileName, 2), true),
+    "Level 2 is not saved next to the volume");
+
+  vtkNew<vtkFreeSurferVolumePyramid> loadedPyramid;
+  loadedPyramid->SetNumberOfLevels(3);
+  success &= Check(loadedPyramid->Load(volumeFileName, Dimensions), "Could not load the saved levels");
+  success &= CheckLevels(loadedPyramid, "loaded");
+  // The volume read later keeps the levels
+  loadedPyramid->SetInput(volume);
+  success &= Check(loadedPyramid->GetNumberOfAvailableLevels() == 3, "Loaded levels are cleared when the volume is read");
+
+  // Levels of a volume of other dimensions
+  const int otherDimensions[3] = { 9, 8, 6 };
+  vtkNew<vtkFreeSurferVolumePyramid> otherPyramid;
+  otherPyramid->SetNumberOfLevels(3);
+  success &= Check(!otherPyramid->Load(volumeFileName, otherDimensions) && otherPyramid->GetNumberOfAvailableLevels() == 1,
+    "Levels are loaded for other dimensions");
+
+  // Volume file modified after the levels were saved
+  success &= Check(WriteVolumeFile(volumeFileName, content, std::time(nullptr) + 3600), "Could not write " + volumeFileName);
+  success &= Check(!otherPyramid->Load(volumeFileName, Dimensions), "Levels are loaded for a newer volume file");
+
+  // Volume file replaced by another one of the same size and an older modification time
+  std::vector<unsigned char> lastBlockModified = content;
+  lastBlockModified[content.size() - 10] ^= 0xFF;
+  success &= Check(WriteVolumeFile(volumeFileName, lastBlockModified, volumeModifiedTime), "Could not write " + volumeFileName);
+  success &= Check(!otherPyramid->Load(volumeFileName, Dimensions), "Levels are loaded for another volume file of the same size");
+  std::vector<unsigned char> longerContent = content;
+  longerContent.push_back(0);
+  success &= Check(WriteVolumeFile(volumeFileName, longerContent, volumeModifiedTime), "Could not write " + volumeFileName);
+  success &= Check(!otherPyramid->Load(volumeFileName, Dimensions), "Levels are loaded for a volume file of another size");
+  success &= Check(WriteVolumeFile(volumeFileName, content, volumeModifiedTime), "Could not write " + volumeFileName);
+  success &= Check(otherPyramid->Load(volumeFileName, Dimensions), "Levels are not loaded for the original volume file");
+
+  vtksys::SystemTools::RemoveADirectory(testDirectory);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
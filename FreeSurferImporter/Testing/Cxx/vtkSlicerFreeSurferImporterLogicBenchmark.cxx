@@ -0,0 +1,537 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Benchmark of the FreeSurferImporter logic on a synthetic subject.
+//
+// A subject of configurable size is generated in a temporary directory:
+//   mri/orig.mgz      conformed UCHAR volume (compressed)
+//   mri/rawavg.mgh    FLOAT volume (uncompressed)
+//   mri/aseg.mgz      INT label volume with subcortical and cortical parcel labels
+//   surf/lh.white, surf/lh.pial        closed triangle surfaces
+//   surf/lh.thickness, surf/lh.curv    per-vertex overlays
+// Each logic entry point is then timed and one tab-separated line is written per
+// operation, with throughput, so that results can be compared between builds.
+// The process_max_rss_megabytes column is the maximum resident set size of the
+// process after the operation (getrusage), not the memory used by the operation.
+//
+// Usage: vtkSlicerFreeSurferImporterLogicBenchmark [--temp dir] [--lut FreeSurferColorLUT.txt]
+//   [--volume-size 256] [--vertices 150000] [--repeat 3] [--output results.tsv]
+
+// FreeSurferImporter Logic includes
+#include "vtkSlicerFreeSurferImporterLogic.h"
+
+// MRML includes
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSegmentationNode.h>
+
+// Segmentations includes
+#include <vtkSegmentation.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtk_zlib.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+
+namespace
+{
+  const double Pi = 3.14159265358979323846;
+
+  //----------------------------------------------------------------------------
+  double GetProcessMaxRSSMegabytes()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      {
+      return 0.0;
+      }
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      {
+      return 0.0;
+      }
+# ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+# else
+    return usage.ru_maxrss / 1024.0;
+# endif
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  template<typename T>
+  void AppendBigEndian(std::string& buffer, T value)
+  {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    const std::uint16_t one = 1;
+    if (*reinterpret_cast<const unsigned char*>(&one) == 1)
+      {
+      std::reverse(bytes, bytes + sizeof(T));
+      }
+    buffer.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+  }
+
+  //----------------------------------------------------------------------------
+  /// Small deterministic generator, so that all runs decode the same data
+  class RandomGenerator
+  {
+  public:
+    unsigned int Next()
+    {
+      this->State = this->State * 1664525u + 1013904223u;
+      return this->State >> 16;
+    }
+    std::uint32_t State = 12345u;
+  };
+
+  //----------------------------------------------------------------------------
+  class OutputFile
+  {
+  public:
+    OutputFile(const std::string& fileName, bool compressed)
+    {
+      if (compressed)
+        {
+        // Fast compression, the benchmark measures decoding
+        this->GzFile = gzopen(fileName.c_str(), "wb1");
+        }
+      else
+        {
+        this->File = vtksys::SystemTools::Fopen(fileName, "wb");
+        }
+    }
+    ~OutputFile()
+    {
+      if (this->GzFile)
+        {
+        gzclose(this->GzFile);
+        }
+      if (this->File)
+        {
+        fclose(this->File);
+        }
+    }
+    bool IsOpen() const { return this->GzFile || this->File; }
+    bool Write(const std::string& buffer)
+    {
+      if (this->GzFile)
+        {
+        return gzwrite(this->GzFile, buffer.data(), static_cast<unsigned int>(buffer.size())) == static_cast<int>(buffer.size());
+        }
+      return fwrite(buffer.data(), 1, buffer.size(), this->File) == buffer.size();
+    }
+    gzFile GzFile = nullptr;
+    FILE* File = nullptr;
+  };
+
+  //----------------------------------------------------------------------------
+  /// Conformed MGH header: 1 mm voxels, coronal slices, centered at the origin
+  std::string GetMGHHeader(int size, int mghType)
+  {
+    std::string header;
+    AppendBigEndian<std::int32_t>(header, 1);
+    for (int i = 0; i < 3; ++i)
+      {
+      AppendBigEndian<std::int32_t>(header, size);
+      }
+    AppendBigEndian<std::int32_t>(header, 1);
+    AppendBigEndian<std::int32_t>(header, mghType);
+    AppendBigEndian<std::int32_t>(header, 0);
+    AppendBigEndian<std::int16_t>(header, 1);
+    for (int i = 0; i < 3; ++i)
+      {
+      AppendBigEndian<float>(header, 1.0f);
+      }
+    const float directions[9] = { -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f };
+    for (float direction : directions)
+      {
+      AppendBigEndian<float>(header, direction);
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      AppendBigEndian<float>(header, 0.0f);
+      }
+    header.resize(284, '\0');
+    return header;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Label of a voxel of the synthetic aseg: nested shells of subcortical structures
+  /// inside a white matter shell, inside a cortex split into parcels by angle.
+  int GetSyntheticLabel(double x, double y, double z)
+  {
+    double radius = std::sqrt(x * x + y * y + z * z);
+    if (radius > 1.0)
+      {
+      return 0;
+      }
+    bool left = x < 0.0;
+    if (radius > 0.85)
+      {
+      double angle = std::atan2(z, y) + Pi;
+      int parcel = 1 + std::min(34, static_cast<int>(angle / (2.0 * Pi) * 35.0));
+      return (left ? 1000 : 2000) + parcel;
+      }
+    static const int leftLabels[5] = { 4, 10, 11, 12, 2 };
+    static const int rightLabels[5] = { 43, 49, 50, 51, 41 };
+    int band = std::min(4, static_cast<int>(radius / 0.85 * 5.0));
+    return left ? leftLabels[band] : rightLabels[band];
+  }
+
+  //----------------------------------------------------------------------------
+  bool WriteVolume(const std::string& fileName, int size, int mghType, bool compressed)
+  {
+    OutputFile file(fileName, compressed);
+    if (!file.IsOpen() || !file.Write(GetMGHHeader(size, mghType)))
+      {
+      return false;
+      }
+
+    // Written one slice at a time, so that 512^3 volumes can be generated with little memory
+    RandomGenerator random;
+    std::string slice;
+    double halfSize = size / 2.0;
+    for (int k = 0; k < size; ++k)
+      {
+      slice.clear();
+      for (int j = 0; j < size; ++j)
+        {
+        for (int i = 0; i < size; ++i)
+          {
+          double x = (i - halfSize) / (0.40 * size);
+          double y = (j - halfSize) / (0.45 * size);
+          double z = (k - halfSize) / (0.35 * size);
+          int label = GetSyntheticLabel(x, y, z);
+          switch (mghType)
+            {
+            case 0: // MRI_UCHAR
+              slice.push_back(static_cast<char>(label == 0 ? 0 : 80 + (label % 40) + random.Next() % 16));
+              break;
+            case 1: // MRI_INT
+              AppendBigEndian<std::int32_t>(slice, label);
+              break;
+            default: // MRI_FLOAT
+              AppendBigEndian<float>(slice, label == 0 ? 0.0f : 80.0f + (label % 40) + (random.Next() % 1000) / 100.0f);
+              break;
+            }
+          }
+        }
+      if (!file.Write(slice))
+        {
+        return false;
+        }
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Closed torus with about numberOfVertices vertices, in surface coordinates
+  bool WriteSurface(const std::string& fileName, int numberOfVertices, double minorRadius)
+  {
+    int rows = std::max(3, static_cast<int>(std::sqrt(numberOfVertices / 2.0)));
+    int columns = 2 * rows;
+    std::string buffer;
+    AppendBigEndian<unsigned char>(buffer, 0xFF);
+    AppendBigEndian<unsigned char>(buffer, 0xFF);
+    AppendBigEndian<unsigned char>(buffer, 0xFE);
+    buffer += "created by vtkSlicerFreeSurferImporterLogicBenchmark\n\n";
+    AppendBigEndian<std::int32_t>(buffer, rows * columns);
+    AppendBigEndian<std::int32_t>(buffer, 2 * rows * columns);
+    for (int row = 0; row < rows; ++row)
+      {
+      double v = 2.0 * Pi * row / rows;
+      for (int column = 0; column < columns; ++column)
+        {
+        double u = 2.0 * Pi * column / columns;
+        double radius = 60.0 + minorRadius * std::cos(v);
+        AppendBigEndian<float>(buffer, static_cast<float>(radius * std::cos(u)));
+        AppendBigEndian<float>(buffer, static_cast<float>(radius * std::sin(u)));
+        AppendBigEndian<float>(buffer, static_cast<float>(minorRadius * std::sin(v)));
+        }
+      }
+    for (int row = 0; row < rows; ++row)
+      {
+      for (int column = 0; column < columns; ++column)
+        {
+        std::int32_t p0 = row * columns + column;
+        std::int32_t p1 = row * columns + (column + 1) % columns;
+        std::int32_t p2 = ((row + 1) % rows) * columns + column;
+        std::int32_t p3 = ((row + 1) % rows) * columns + (column + 1) % columns;
+        const std::int32_t faces[6] = { p0, p1, p3, p0, p3, p2 };
+        for (std::int32_t index : faces)
+          {
+          AppendBigEndian<std::int32_t>(buffer, index);
+          }
+        }
+      }
+    OutputFile file(fileName, false);
+    return file.IsOpen() && file.Write(buffer);
+  }
+
+  //----------------------------------------------------------------------------
+  /// Overlay in the new curv format, with the vertex count of the surfaces written by WriteSurface
+  bool WriteOverlay(const std::string& fileName, int numberOfVertices, double offset)
+  {
+    int rows = std::max(3, static_cast<int>(std::sqrt(numberOfVertices / 2.0)));
+    int columns = 2 * rows;
+    std::string buffer;
+    AppendBigEndian<unsigned char>(buffer, 0xFF);
+    AppendBigEndian<unsigned char>(buffer, 0xFF);
+    AppendBigEndian<unsigned char>(buffer, 0xFF);
+    AppendBigEndian<std::int32_t>(buffer, rows * columns);
+    AppendBigEndian<std::int32_t>(buffer, 2 * rows * columns);
+    AppendBigEndian<std::int32_t>(buffer, 1);
+    for (int row = 0; row < rows; ++row)
+      {
+      for (int column = 0; column < columns; ++column)
+        {
+        double value = offset + std::sin(4.0 * Pi * row / rows) * std::cos(6.0 * Pi * column / columns);
+        AppendBigEndian<float>(buffer, static_cast<float>(value));
+        }
+      }
+    OutputFile file(fileName, false);
+    return file.IsOpen() && file.Write(buffer);
+  }
+
+  //----------------------------------------------------------------------------
+  struct BenchmarkResult
+    {
+    std::string Operation;
+    std::string FileName;
+    double Megabytes = 0.0;
+    double Items = 0.0;
+    double Seconds = -1.0;
+    };
+
+  //----------------------------------------------------------------------------
+  /// Run an operation and keep the fastest time. Returns false if the operation failed.
+  bool Measure(BenchmarkResult& result, const std::function<bool()>& operation)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool success = operation();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!success)
+      {
+      std::cerr << "Benchmark: " << result.Operation << " failed on " << result.FileName << std::endl;
+      return false;
+      }
+    if (result.Seconds < 0.0 || seconds < result.Seconds)
+      {
+      result.Seconds = seconds;
+      }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetFileMegabytes(const std::string& fileName)
+  {
+    return vtksys::SystemTools::FileLength(fileName) / (1024.0 * 1024.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerFreeSurferImporterLogicBenchmark(int argc, char* argv[])
+{
+  std::string temporaryDirectory = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  std::string lutFileName;
+  std::string outputFileName;
+  int volumeSize = 256;
+  int numberOfVertices = 150000;
+  int numberOfRepeats = 3;
+  for (int i = 1; i + 1 < argc; i += 2)
+    {
+    std::string option = argv[i];
+    std::string value = argv[i + 1];
+    if (option == "--temp")
+      {
+      temporaryDirectory = value;
+      }
+    else if (option == "--lut")
+      {
+      lutFileName = value;
+      }
+    else if (option == "--output")
+      {
+      outputFileName = value;
+      }
+    else if (option == "--volume-size")
+      {
+      volumeSize = std::max(8, std::min(512, atoi(value.c_str())));
+      }
+    else if (option == "--vertices")
+      {
+      numberOfVertices = std::max(18, std::min(1000000, atoi(value.c_str())));
+      }
+    else if (option == "--repeat")
+      {
+      numberOfRepeats = std::max(1, atoi(value.c_str()));
+      }
+    else
+      {
+      std::cerr << "Benchmark: Unknown option " << option << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Generate the subject
+  std::string subjectDirectory = temporaryDirectory + "/FreeSurferImporterBenchmarkSubject";
+  std::string mriDirectory = subjectDirectory + "/mri/";
+  std::string surfDirectory = subjectDirectory + "/surf/";
+  vtksys::SystemTools::MakeDirectory(mriDirectory);
+  vtksys::SystemTools::MakeDirectory(surfDirectory);
+  if (!WriteVolume(mriDirectory + "orig.mgz", volumeSize, 0, true)
+    || !WriteVolume(mriDirectory + "rawavg.mgh", volumeSize, 3, false)
+    || !WriteVolume(mriDirectory + "aseg.mgz", volumeSize, 1, true)
+    || !WriteSurface(surfDirectory + "lh.white", numberOfVertices, 25.0)
+    || !WriteSurface(surfDirectory + "lh.pial", numberOfVertices, 27.5)
+    || !WriteOverlay(surfDirectory + "lh.thickness", numberOfVertices, 2.5)
+    || !WriteOverlay(surfDirectory + "lh.curv", numberOfVertices, 0.0))
+    {
+    std::cerr << "Benchmark: Could not write the synthetic subject to " << subjectDirectory << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerFreeSurferImporterLogic> logic;
+  logic->SetMRMLScene(scene);
+  if (!lutFileName.empty())
+    {
+    logic->registerFreeSurferColorLUT(vtkSlicerFreeSurferImporterLogic::DefaultColorLUTName, lutFileName);
+    }
+
+  double numberOfVoxels = static_cast<double>(volumeSize) * volumeSize * volumeSize;
+  BenchmarkResult origVolume = { "loadFreeSurferVolume", "mri/orig.mgz", GetFileMegabytes(mriDirectory + "orig.mgz"), numberOfVoxels };
+  BenchmarkResult rawVolume = { "loadFreeSurferVolume", "mri/rawavg.mgh", GetFileMegabytes(mriDirectory + "rawavg.mgh"), numberOfVoxels };
+  BenchmarkResult segmentation = { "loadFreeSurferSegmentation", "mri/aseg.mgz", GetFileMegabytes(mriDirectory + "aseg.mgz"), numberOfVoxels };
+  BenchmarkResult whiteModel = { "loadFreeSurferModel", "surf/lh.white", GetFileMegabytes(surfDirectory + "lh.white") };
+  BenchmarkResult pialModel = { "loadFreeSurferModel", "surf/lh.pial", GetFileMegabytes(surfDirectory + "lh.pial") };
+  BenchmarkResult thicknessOverlay = { "loadFreeSurferScalarOverlay", "surf/lh.thickness", GetFileMegabytes(surfDirectory + "lh.thickness") };
+  BenchmarkResult curvOverlay = { "loadFreeSurferScalarOverlay", "surf/lh.curv", GetFileMegabytes(surfDirectory + "lh.curv") };
+  BenchmarkResult transform = { "transformFreeSurferModelToRAS", "surf/lh.white" };
+  BenchmarkResult lut = { "applyFreeSurferSegmentationLUT", "mri/aseg.mgz" };
+  BenchmarkResult labelModels = { "addFreeSurferLabelModels", "mri/aseg.mgz" };
+  std::vector<BenchmarkResult*> results = { &origVolume, &rawVolume, &segmentation, &whiteModel, &pialModel,
+    &thicknessOverlay, &curvOverlay, &transform, &lut, &labelModels };
+  std::vector<double> maxRSSMegabytes(results.size(), 0.0);
+
+  bool success = true;
+  for (int repeat = 0; repeat < numberOfRepeats && success; ++repeat)
+    {
+    vtkMRMLScalarVolumeNode* origNode = nullptr;
+    vtkMRMLSegmentationNode* segmentationNode = nullptr;
+    std::vector<vtkMRMLModelNode*> modelNodes(2, nullptr);
+
+    success &= Measure(origVolume, [&]() { return (origNode = logic->loadFreeSurferVolume(mriDirectory, "orig.mgz")) != nullptr; });
+    maxRSSMegabytes[0] = GetProcessMaxRSSMegabytes();
+    success &= Measure(rawVolume, [&]() { return logic->loadFreeSurferVolume(mriDirectory, "rawavg.mgh") != nullptr; });
+    maxRSSMegabytes[1] = GetProcessMaxRSSMegabytes();
+    success &= Measure(segmentation, [&]() { return (segmentationNode = logic->loadFreeSurferSegmentation(mriDirectory, "aseg.mgz")) != nullptr; });
+    maxRSSMegabytes[2] = GetProcessMaxRSSMegabytes();
+    success &= Measure(whiteModel, [&]() { return (modelNodes[0] = logic->loadFreeSurferModel(surfDirectory, "lh.white")) != nullptr; });
+    maxRSSMegabytes[3] = GetProcessMaxRSSMegabytes();
+    success &= Measure(pialModel, [&]() { return (modelNodes[1] = logic->loadFreeSurferModel(surfDirectory, "lh.pial")) != nullptr; });
+    maxRSSMegabytes[4] = GetProcessMaxRSSMegabytes();
+    success &= Measure(thicknessOverlay, [&]() { return logic->loadFreeSurferScalarOverlay(surfDirectory, "lh.thickness", modelNodes); });
+    maxRSSMegabytes[5] = GetProcessMaxRSSMegabytes();
+    success &= Measure(curvOverlay, [&]() { return logic->loadFreeSurferScalarOverlay(surfDirectory, "lh.curv", modelNodes); });
+    maxRSSMegabytes[6] = GetProcessMaxRSSMegabytes();
+    if (!success)
+      {
+      break;
+      }
+
+    success &= Measure(transform, [&]() { logic->transformFreeSurferModelToRAS(modelNodes[0], origNode); return true; });
+    maxRSSMegabytes[7] = GetProcessMaxRSSMegabytes();
+    success &= Measure(lut, [&]() { logic->applyFreeSurferSegmentationLUT(segmentationNode); return true; });
+    maxRSSMegabytes[8] = GetProcessMaxRSSMegabytes();
+
+    // Items are the models built from the label volume
+    vtkMRMLScalarVolumeNode* labelVolumeNode = logic->loadFreeSurferVolume(mriDirectory, "aseg.mgz");
+    std::vector<vtkMRMLModelNode*> labelModelNodes;
+    success &= Measure(labelModels, [&]() { labelModelNodes = logic->addFreeSurferLabelModels(labelVolumeNode); return !labelModelNodes.empty(); });
+    maxRSSMegabytes[9] = GetProcessMaxRSSMegabytes();
+    if (!success)
+      {
+      break;
+      }
+
+    whiteModel.Items = pialModel.Items = transform.Items = modelNodes[0]->GetPolyData()->GetNumberOfPoints();
+    thicknessOverlay.Items = curvOverlay.Items = modelNodes[0]->GetPolyData()->GetNumberOfPoints();
+    transform.Megabytes = 12.0 * transform.Items / (1024.0 * 1024.0);
+    lut.Items = segmentationNode->GetSegmentation()->GetNumberOfSegments();
+    labelModels.Items = labelModelNodes.size();
+
+    scene->Clear(true);
+    }
+
+  if (!success)
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::ostringstream report;
+  report << "operation\tfile\tmegabytes\titems\tseconds\tmegabytes_per_second\titems_per_second\tprocess_max_rss_megabytes\n";
+  for (size_t i = 0; i < results.size(); ++i)
+    {
+    const BenchmarkResult& result = *results[i];
+    double seconds = std::max(result.Seconds, 1e-9);
+    report << result.Operation << "\t" << result.FileName << "\t" << result.Megabytes << "\t" << result.Items << "\t"
+      << result.Seconds << "\t" << result.Megabytes / seconds << "\t" << result.Items / seconds << "\t"
+      << maxRSSMegabytes[i] << "\n";
+    }
+  std::cout << report.str();
+  if (!outputFileName.empty())
+    {
+    std::ofstream output(outputFileName.c_str());
+    output << report.str();
+    if (!output)
+      {
+      std::cerr << "Benchmark: Could not write " << outputFileName << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  vtksys::SystemTools::RemoveADirectory(subjectDirectory);
+  return EXIT_SUCCESS;
+}
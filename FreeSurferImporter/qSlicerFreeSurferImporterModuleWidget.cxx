@@ -17,8 +17,22 @@
 
 // Qt includes
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QPair>
+#include <QPersistentModelIndex>
+#include <QSet>
+#include <QTimer>
+
+// Slicer includes
+#include <qMRMLThreeDView.h>
+#include <qMRMLThreeDWidget.h>
+#include <qSlicerApplication.h>
+#include <qSlicerLayoutManager.h>
 
 #include "qSlicerFreeSurferImporterModule.h"
+#include "vtkFreeSurferSubjectIndex.h"
 #include "vtkSlicerFreeSurferImporterLogic.h"
 
 // SlicerQt includes
@@ -38,8 +52,13 @@
 
 // VTK include
 #include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkInteractorObserver.h>
+#include <vtkNew.h>
+#include <vtkRenderWindowInteractor.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkTransform.h>
+#include <vtkWeakPointer.h>
 #include <vtksys/SystemTools.hxx>
 
 //-----------------------------------------------------------------------------
@@ -51,8 +70,31 @@ public:
   qSlicerFreeSurferImporterModuleWidgetPrivate(qSlicerFreeSurferImporterModuleWidget& object);
 
   void updateStatus(bool success, QString statusMessage = "");
+  void updateCompletedItem(const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item);
+  /// Files that could not be loaded by the last import, e.g. "2 failed: lh.pial, aseg.mgz"
+  QString failedFilesStatus() const;
+  /// Fill the selector boxes from the subject index
+  void updateSelectorBoxes(bool keepCheckedItems);
+  void updateSelectorBox(ctkCheckableComboBox* selectorBox, const QStringList& fileNames, bool keepCheckedItems);
+  /// Watch the indexed directories of the current subject
+  void updateWatchedDirectories();
+  vtkSlicerFreeSurferImporterLogic* logic();
 
   qSlicerFreeSurferImporterModuleWidget* q_ptr;
+
+  /// Polls the background import
+  QTimer ImportTimer;
+  /// Selector box entry of each file being imported, indexed by item Id
+  QList<QPair<ctkCheckableComboBox*, QPersistentModelIndex> > ImportItemSources;
+  /// Files of the last import that could not be loaded
+  QStringList FailedFileNames;
+
+  /// Files of the current subject
+  vtkWeakPointer<vtkFreeSurferSubjectIndex> SubjectIndex;
+  QFileSystemWatcher FileSystemWatcher;
+  /// Changes are collected for a short time, files are often written in bursts
+  QTimer SubjectIndexTimer;
+  QSet<QString> ChangedDirectories;
 };
 
 //-----------------------------------------------------------------------------
@@ -75,6 +117,153 @@ void qSlicerFreeSurferImporterModuleWidgetPrivate::updateStatus(bool success, QS
     }
 }
 
+//-----------------------------------------------------------------------------
+QString qSlicerFreeSurferImporterModuleWidgetPrivate::failedFilesStatus() const
+{
+  if (this->FailedFileNames.isEmpty())
+    {
+    return QString();
+    }
+  return QString("%1 failed: %2").arg(this->FailedFileNames.size()).arg(this->FailedFileNames.join(", "));
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidgetPrivate::updateCompletedItem(const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item)
+{
+  if (!item.Success)
+    {
+    this->FailedFileNames << QString::fromStdString(item.Name);
+    this->updateStatus(true, "Could not load " + QString::fromStdString(item.Name) + "!");
+    return;
+    }
+  if (item.Id >= 0 && item.Id < this->ImportItemSources.size())
+    {
+    const QPair<ctkCheckableComboBox*, QPersistentModelIndex>& source = this->ImportItemSources[item.Id];
+    // The entry is gone if the file list was updated during the import
+    if (source.second.isValid())
+      {
+      source.first->setCheckState(source.second, Qt::CheckState::Unchecked);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidgetPrivate::updateSelectorBoxes(bool keepCheckedItems)
+{
+  QStringList volumeFiles;
+  QStringList segmentationFiles;
+  QStringList modelFiles;
+  QStringList scalarOverlayFiles;
+  QStringList annotationFiles;
+  if (this->SubjectIndex)
+    {
+    for (const vtkFreeSurferSubjectIndex::FileInfo& file : this->SubjectIndex->GetFiles())
+      {
+      QString directoryName = QString::fromStdString(vtksys::SystemTools::GetFilenamePath(file.Name));
+      QString fileName = QString::fromStdString(vtksys::SystemTools::GetFilenameName(file.Name));
+      if (directoryName == "mri")
+        {
+        if (file.Type == vtkSlicerFreeSurferImporterLogic::SegmentationFile)
+          {
+          segmentationFiles << fileName;
+          }
+        if ((file.Type == vtkSlicerFreeSurferImporterLogic::VolumeFile || file.Type == vtkSlicerFreeSurferImporterLogic::SegmentationFile)
+          && vtksys::SystemTools::GetFilenameExtension(file.Name) != ".seg.mgz")
+          {
+          volumeFiles << fileName;
+          }
+        }
+      else if (directoryName == "surf")
+        {
+        if (file.Type == vtkSlicerFreeSurferImporterLogic::ModelFile)
+          {
+          modelFiles << fileName;
+          }
+        else if (file.Type == vtkSlicerFreeSurferImporterLogic::ScalarOverlayFile)
+          {
+          scalarOverlayFiles << fileName;
+          }
+        }
+      else if (directoryName == "label")
+        {
+        if (file.Type == vtkSlicerFreeSurferImporterLogic::AnnotationFile)
+          {
+          annotationFiles << fileName;
+          }
+        }
+      }
+    }
+
+  this->updateSelectorBox(this->volumeSelectorBox, volumeFiles, keepCheckedItems);
+  this->updateSelectorBox(this->segmentationSelectorBox, segmentationFiles, keepCheckedItems);
+  this->updateSelectorBox(this->modelSelectorBox, modelFiles, keepCheckedItems);
+  this->updateSelectorBox(this->scalarOverlaySelectorBox, scalarOverlayFiles, keepCheckedItems);
+  this->updateSelectorBox(this->annotationSelectorBox, annotationFiles, keepCheckedItems);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidgetPrivate::updateSelectorBox(ctkCheckableComboBox* selectorBox, const QStringList& fileNames, bool keepCheckedItems)
+{
+  QStringList checkedFileNames;
+  if (keepCheckedItems)
+    {
+    for (QModelIndex checkedIndex : selectorBox->checkedIndexes())
+      {
+      checkedFileNames << selectorBox->itemText(checkedIndex.row());
+      }
+    }
+
+  selectorBox->clear();
+  for (const QString& fileName : fileNames)
+    {
+    selectorBox->addItem(fileName);
+    if (checkedFileNames.contains(fileName))
+      {
+      selectorBox->setCheckState(selectorBox->model()->index(selectorBox->count() - 1, 0), Qt::CheckState::Checked);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidgetPrivate::updateWatchedDirectories()
+{
+  QStringList watchedPaths = this->FileSystemWatcher.directories();
+  if (!watchedPaths.isEmpty())
+    {
+    this->FileSystemWatcher.removePaths(watchedPaths);
+    }
+  if (!this->SubjectIndex)
+    {
+    return;
+    }
+
+  // The subject directory itself is watched to notice indexed directories that are created later
+  QString subjectDirectory = QString::fromStdString(this->SubjectIndex->GetSubjectDirectory());
+  QStringList paths;
+  paths << subjectDirectory;
+  for (const std::string& directoryName : vtkFreeSurferSubjectIndex::GetIndexedDirectories())
+    {
+    QString path = subjectDirectory + "/" + QString::fromStdString(directoryName);
+    if (QFileInfo(path).isDir())
+      {
+      paths << path;
+      }
+    }
+  this->FileSystemWatcher.addPaths(paths);
+}
+
+//-----------------------------------------------------------------------------
+vtkSlicerFreeSurferImporterLogic* qSlicerFreeSurferImporterModuleWidgetPrivate::logic()
+{
+  Q_Q(qSlicerFreeSurferImporterModuleWidget);
+  qSlicerFreeSurferImporterModule* module = qobject_cast<qSlicerFreeSurferImporterModule*>(q->module());
+  if (!module)
+    {
+    return nullptr;
+    }
+  return vtkSlicerFreeSurferImporterLogic::SafeDownCast(module->logic());
+}
+
 //-----------------------------------------------------------------------------
 // qSlicerFreeSurferImporterModuleWidget methods
 
@@ -88,6 +277,14 @@ qSlicerFreeSurferImporterModuleWidget::qSlicerFreeSurferImporterModuleWidget(QWi
 //-----------------------------------------------------------------------------
 qSlicerFreeSurferImporterModuleWidget::~qSlicerFreeSurferImporterModuleWidget()
 {
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+  vtkSlicerFreeSurferImporterLogic* logic = d->logic();
+  if (logic && d->ImportTimer.isActive())
+    {
+    // Finish the background import so that the logic can start a new one later
+    d->ImportTimer.stop();
+    logic->stopFreeSurferFilesImport();
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -102,6 +299,23 @@ void qSlicerFreeSurferImporterModuleWidget::setup()
 
   QObject::connect(d->fsDirectoryButton, &ctkDirectoryButton::directoryChanged, this, &qSlicerFreeSurferImporterModuleWidget::updateFileList);
   QObject::connect(d->loadButton, &QPushButton::clicked, this, &qSlicerFreeSurferImporterModuleWidget::loadSelectedFiles);
+
+  // Volume previews are only shown while files are read in the background
+  auto updateVolumePreviewEnabled = [d]()
+    {
+    d->volumePreviewCheckBox->setEnabled(d->asynchronousCheckBox->isChecked() && !d->lazyLoadingCheckBox->isChecked());
+    };
+  QObject::connect(d->asynchronousCheckBox, &QCheckBox::toggled, this, updateVolumePreviewEnabled);
+  QObject::connect(d->lazyLoadingCheckBox, &QCheckBox::toggled, this, updateVolumePreviewEnabled);
+  updateVolumePreviewEnabled();
+
+  d->ImportTimer.setInterval(100);
+  QObject::connect(&d->ImportTimer, &QTimer::timeout, this, &qSlicerFreeSurferImporterModuleWidget::updateImportProgress);
+
+  d->SubjectIndexTimer.setInterval(500);
+  d->SubjectIndexTimer.setSingleShot(true);
+  QObject::connect(&d->FileSystemWatcher, &QFileSystemWatcher::directoryChanged, this, &qSlicerFreeSurferImporterModuleWidget::onWatchedDirectoryChanged);
+  QObject::connect(&d->SubjectIndexTimer, &QTimer::timeout, this, &qSlicerFreeSurferImporterModuleWidget::updateSubjectIndex);
   this->updateFileList();
 }
 
@@ -110,163 +324,278 @@ void qSlicerFreeSurferImporterModuleWidget::updateFileList()
 {
   Q_D(qSlicerFreeSurferImporterModuleWidget);
 
-  d->modelSelectorBox->clear();
-  d->segmentationSelectorBox->clear();
-  d->volumeSelectorBox->clear();
-
+  vtkSlicerFreeSurferImporterLogic* logic = d->logic();
   QString directory = d->fsDirectoryButton->directory();
+  d->SubjectIndex = nullptr;
+  if (logic && !directory.isEmpty())
+    {
+    // A subject indexed before was not watched since then, its index is updated
+    d->SubjectIndex = logic->getFreeSurferSubjectIndex(directory.toStdString(), true);
+    }
+  d->updateWatchedDirectories();
+  d->ChangedDirectories.clear();
+  d->updateSelectorBoxes(false);
 
-  QString origFile = directory + "/mri/orig.mgz";
-  if (!QFile::exists(origFile))
+  if (!d->SubjectIndex || !d->SubjectIndex->GetFileInfo("mri/orig.mgz"))
     {
     d->updateStatus(false, "Could not find orig.mgz!");
     return;
     }
+  d->updateStatus(true);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::onWatchedDirectoryChanged(const QString& path)
+{
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+  d->ChangedDirectories.insert(path);
+  d->SubjectIndexTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::updateSubjectIndex()
+{
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+  if (!d->SubjectIndex)
+    {
+    d->ChangedDirectories.clear();
+    return;
+    }
 
-  QDir mriDirectory(directory + "/mri");
-  mriDirectory.setNameFilters(QStringList() << "*.mgz" << "*.cor" << "*.bshort");
-  QStringList mgzFiles = mriDirectory.entryList();
-  for (QString mgzFile : mgzFiles)
+  // Only the directories that changed are listed again
+  QString subjectDirectory = QString::fromStdString(d->SubjectIndex->GetSubjectDirectory());
+  bool changed = false;
+  bool subjectDirectoryChanged = false;
+  for (const QString& path : d->ChangedDirectories)
     {
-    if (vtksys::SystemTools::GetFilenameExtension(mgzFile.toStdString()) == ".seg.mgz")
+    if (QDir(path) == QDir(subjectDirectory))
       {
-      continue;
+      subjectDirectoryChanged = true;
+      changed |= d->SubjectIndex->Update();
+      }
+    else
+      {
+      changed |= d->SubjectIndex->UpdatePath(path.toStdString());
       }
-    d->volumeSelectorBox->addItem(mgzFile);
     }
+  d->ChangedDirectories.clear();
 
-  QDir segDirectory(directory + "/mri");
-  segDirectory.setNameFilters(QStringList() << "*seg*.mgz");
-  QStringList segFiles = segDirectory.entryList();
-  for (QString segFile : segFiles)
+  if (subjectDirectoryChanged)
     {
-    d->segmentationSelectorBox->addItem(segFile);
+    d->updateWatchedDirectories();
     }
-
-  QDir surfDirectory(directory + "/surf");
-  surfDirectory.setNameFilters(QStringList() << "*h.white" << "*h.pial" << "*h.inflated" << "*h.sphere" << "*h.sphere.reg" << "*h.orig");
-  QStringList surfFiles = surfDirectory.entryList();
-  for (QString surfFile : surfFiles)
+  if (!changed)
     {
-    d->modelSelectorBox->addItem(surfFile);
+    return;
     }
-
-  QDir scalarDirectory(directory + "/surf");
-  scalarDirectory.setNameFilters(QStringList() << "*.area*" << "*.curv*" << "*.sulc" << "*.W");
-  QStringList scalarFiles = scalarDirectory.entryList();
-  for (QString scalarFile : scalarFiles)
+  d->updateSelectorBoxes(true);
+  if (d->SubjectIndex->GetFileInfo("mri/orig.mgz"))
     {
-    d->scalarOverlaySelectorBox->addItem(scalarFile);
+    d->updateStatus(true);
+    }
+  else
+    {
+    d->updateStatus(false, "Could not find orig.mgz!");
     }
-
-  d->updateStatus(true);
 }
 
-
 //-----------------------------------------------------------------------------
 bool qSlicerFreeSurferImporterModuleWidget::loadSelectedFiles()
 {
   Q_D(qSlicerFreeSurferImporterModuleWidget);
 
-  qSlicerFreeSurferImporterModule* module = qobject_cast<qSlicerFreeSurferImporterModule*>(this->module());
-  vtkSlicerFreeSurferImporterLogic* logic = vtkSlicerFreeSurferImporterLogic::SafeDownCast(module->logic());
+  vtkSlicerFreeSurferImporterLogic* logic = d->logic();
+  if (!logic)
+    {
+    return false;
+    }
 
-  QString directory = d->fsDirectoryButton->directory();
-  QString mriDirectory = directory + "/mri/";
-  vtkMRMLScalarVolumeNode* origNode = nullptr;
+  // The load button cancels the import while one is running in the background
+  if (d->ImportTimer.isActive())
+    {
+    logic->cancelFreeSurferFilesImport();
+    d->statusLabel->setText("Canceling...");
+    return false;
+    }
 
-  QApplication::setOverrideCursor(Qt::WaitCursor);
+  QString directory = d->fsDirectoryButton->directory();
+  std::string mriDirectory = (directory + "/mri/").toStdString();
+  std::string surfDirectory = (directory + "/surf/").toStdString();
+  std::string labelDirectory = (directory + "/label/").toStdString();
 
-  QModelIndexList selectedVolumes = d->volumeSelectorBox->checkedIndexes();
-  for (QModelIndex selectedVolume : selectedVolumes)
+  vtkNew<vtkMatrix4x4> surfaceToRAS;
+  if (!d->modelSelectorBox->checkedIndexes().isEmpty())
     {
-    QString volumeName = d->volumeSelectorBox->itemText(selectedVolume.row());
-    vtkMRMLScalarVolumeNode* volumeNode = logic->loadFreeSurferVolume(mriDirectory.toStdString(), volumeName.toStdString());
-    if (!volumeNode)
-      {
-      d->updateStatus(true, "Could not load surface " + volumeName + "!");
-      continue;
-      }
-    if (volumeName == "orig.mgz")
+    // Only the header of orig.mgz is needed to place the surfaces
+    if (!logic->getFreeSurferSurfaceToRASTransform(mriDirectory + "orig.mgz", surfaceToRAS))
       {
-      origNode = volumeNode;
+      d->updateStatus(true, "Could not find orig.mgz!");
+      return false;
       }
-    d->segmentationSelectorBox->setCheckState(selectedVolume, Qt::CheckState::Unchecked);
     }
 
-  QModelIndexList selectedSegmentations = d->segmentationSelectorBox->checkedIndexes();
-  for (QModelIndex selectedSegmentation : selectedSegmentations)
+  // Collect all checked files, the logic reads them in parallel
+  std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> items;
+  d->ImportItemSources.clear();
+  auto addCheckedItems = [&](ctkCheckableComboBox* selectorBox, int type, const std::string& fileDirectory)
     {
-    QString segmentationName = d->segmentationSelectorBox->itemText(selectedSegmentation.row());
-    vtkMRMLSegmentationNode* segmentationNode = logic->loadFreeSurferSegmentation(mriDirectory.toStdString(), segmentationName.toStdString());
-    if (!segmentationNode)
+    for (QModelIndex selectedIndex : selectorBox->checkedIndexes())
       {
-      d->updateStatus(true, "Could not load surface " + segmentationName + "!");
-      continue;
+      vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem item;
+      item.Type = type;
+      item.Directory = fileDirectory;
+      item.Name = selectorBox->itemText(selectedIndex.row()).toStdString();
+      item.Id = d->ImportItemSources.size();
+      std::string extension = vtksys::SystemTools::GetFilenameLastExtension(item.Name);
+      if (type == vtkSlicerFreeSurferImporterLogic::ModelFile
+        && (extension == ".pial" || extension == ".white" || extension == ".orig"))
+        {
+        item.SurfaceToRAS = surfaceToRAS.GetPointer();
+        }
+      items.push_back(item);
+      d->ImportItemSources << qMakePair(selectorBox, QPersistentModelIndex(selectedIndex));
       }
-    d->segmentationSelectorBox->setCheckState(selectedSegmentation, Qt::CheckState::Unchecked);
+    };
+  addCheckedItems(d->volumeSelectorBox, vtkSlicerFreeSurferImporterLogic::VolumeFile, mriDirectory);
+  addCheckedItems(d->segmentationSelectorBox, vtkSlicerFreeSurferImporterLogic::SegmentationFile, mriDirectory);
+  addCheckedItems(d->modelSelectorBox, vtkSlicerFreeSurferImporterLogic::ModelFile, surfDirectory);
+  addCheckedItems(d->scalarOverlaySelectorBox, vtkSlicerFreeSurferImporterLogic::ScalarOverlayFile, surfDirectory);
+  addCheckedItems(d->annotationSelectorBox, vtkSlicerFreeSurferImporterLogic::AnnotationFile, labelDirectory);
+
+  logic->SetNumberOfSurfaceLevelsOfDetail(d->levelsOfDetailCheckBox->isChecked() ? 3 : 1);
+  logic->SetNumberOfVolumePreviewLevels(d->volumePreviewCheckBox->isEnabled() && d->volumePreviewCheckBox->isChecked() ? 3 : 1);
+  if (d->levelsOfDetailCheckBox->isChecked())
+    {
+    this->observeThreeDViewInteraction();
     }
 
-  std::vector<vtkMRMLModelNode*> modelNodes;
-  QString surfDirectory = directory + "/surf/";
-  QModelIndexList selectedModels = d->modelSelectorBox->checkedIndexes();
-
-  bool removeOrigNode = false;
-  if (!origNode)
+  // Placeholders only need the file headers, they are added without reading in the background
+  logic->SetLazyLoading(d->lazyLoadingCheckBox->isChecked());
+  logic->clearFreeSurferImportReport();
+  d->FailedFileNames.clear();
+  if (d->asynchronousCheckBox->isChecked() && !logic->GetLazyLoading())
     {
-    removeOrigNode = true;
-    origNode = logic->loadFreeSurferVolume(mriDirectory.toStdString(), "orig.mgz");
-    if (!origNode)
+    if (!logic->startFreeSurferFilesImport(items))
       {
-      d->updateStatus(true, "Could not find orig.mgz!");
       return false;
       }
+    d->loadButton->setText("Cancel");
+    d->statusLabel->setText("Loading...");
+    d->ImportTimer.start();
+    return true;
     }
 
-  for (QModelIndex selectedModel : selectedModels)
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  bool success = logic->loadFreeSurferFiles(items);
+  for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : items)
+    {
+    d->updateCompletedItem(item);
+    }
+  if (success)
+    {
+    d->statusLabel->setText(QString::fromStdString(logic->getFreeSurferImportReportSummary()));
+    }
+  else if (!d->FailedFileNames.isEmpty())
     {
-    QString modelName = d->modelSelectorBox->itemText(selectedModel.row());
+    d->statusLabel->setText(d->failedFilesStatus());
+    }
+  QApplication::restoreOverrideCursor();
 
-    vtkMRMLModelNode* modelNode = logic->loadFreeSurferModel(surfDirectory.toStdString(), modelName.toStdString());
-    if (!modelNode)
-      {
-      d->updateStatus(true, "Could not load surface " + modelName + "!");
-      continue;
-      }
-    d->modelSelectorBox->setCheckState(selectedModel, Qt::CheckState::Unchecked);
-    modelNodes.push_back(modelNode);
-    if (vtksys::SystemTools::GetFilenameLastExtension(modelName.toStdString()) == ".pial"
-      || vtksys::SystemTools::GetFilenameLastExtension(modelName.toStdString()) == ".white"
-      || vtksys::SystemTools::GetFilenameLastExtension(modelName.toStdString()) == ".orig")
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::updateImportProgress()
+{
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+
+  vtkSlicerFreeSurferImporterLogic* logic = d->logic();
+  if (!logic)
+    {
+    d->ImportTimer.stop();
+    return;
+    }
+
+  // Files that finished reading are added to the scene here, on the main thread
+  std::vector<vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem> completedItems = logic->processFreeSurferFilesImport();
+  for (const vtkSlicerFreeSurferImporterLogic::FreeSurferImportItem& item : completedItems)
+    {
+    d->updateCompletedItem(item);
+    }
+
+  vtkSlicerFreeSurferImporterLogic::FreeSurferImportProgress progress = logic->getFreeSurferFilesImportProgress();
+  QString status = QString("%1 %2/%3 files (%4 MB/s)")
+    .arg(progress.Running ? "Loading" : (progress.Canceled ? "Canceled after" : "Loaded"))
+    .arg(progress.NumberOfFilesCompleted + progress.NumberOfFilesFailed)
+    .arg(progress.NumberOfFiles)
+    .arg(progress.GetThroughput(), 0, 'f', 1);
+  if (progress.Running && !progress.LastCompletedFileName.empty())
+    {
+    status += QString(", last: %1").arg(QString::fromStdString(progress.LastCompletedFileName));
+    }
+  if (progress.NumberOfOverlaysDropped > 0)
+    {
+    status += QString(", %1 overlays not added").arg(progress.NumberOfOverlaysDropped);
+    }
+  // Failures are kept in the status until the next import, the progress is updated on every tick
+  if (!d->FailedFileNames.isEmpty())
+    {
+    status += "\n" + d->failedFilesStatus();
+    }
+  d->statusLabel->setText(status);
+
+  if (!progress.Running)
+    {
+    // Time spent in each stage, to see whether reading, decompression or the scene dominates
+    std::string summary = logic->getFreeSurferImportReportSummary();
+    if (!summary.empty())
       {
-      logic->transformFreeSurferModelToRAS(modelNode, origNode);
+      d->statusLabel->setText(status + "\n" + QString::fromStdString(summary));
       }
+    d->ImportTimer.stop();
+    d->loadButton->setText("Load");
     }
+}
 
-  for (vtkMRMLModelNode* modelNode : modelNodes)
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::observeThreeDViewInteraction()
+{
+  qSlicerLayoutManager* layoutManager = qSlicerApplication::application() ? qSlicerApplication::application()->layoutManager() : nullptr;
+  if (!layoutManager)
     {
-    modelNode->CreateDefaultDisplayNodes();
+    return;
     }
-
-  QModelIndexList selectedScalarOverlays = d->scalarOverlaySelectorBox->checkedIndexes();
-  for (QModelIndex selectedScalarOverlay : selectedScalarOverlays)
+  for (int i = 0; i < layoutManager->threeDViewCount(); ++i)
     {
-    QString scalarOverlayName = d->scalarOverlaySelectorBox->itemText(selectedScalarOverlay.row());
-    bool success = logic->loadFreeSurferScalarOverlay(surfDirectory.toStdString(), scalarOverlayName.toStdString(), modelNodes);
-    if (!success)
+    qMRMLThreeDWidget* threeDWidget = layoutManager->threeDWidget(i);
+    vtkRenderWindowInteractor* interactor = threeDWidget ? threeDWidget->threeDView()->interactor() : nullptr;
+    vtkInteractorObserver* interactorStyle = interactor ? interactor->GetInteractorStyle() : nullptr;
+    if (!interactorStyle
+      || this->qvtkIsConnected(interactorStyle, vtkCommand::StartInteractionEvent, this, SLOT(onThreeDViewInteractionStarted())))
       {
-      d->updateStatus(true, "Could not load scalar overlay " + scalarOverlayName + "!");
       continue;
       }
-    d->scalarOverlaySelectorBox->setCheckState(selectedScalarOverlay, Qt::CheckState::Unchecked);
+    this->qvtkConnect(interactorStyle, vtkCommand::StartInteractionEvent, this, SLOT(onThreeDViewInteractionStarted()));
+    this->qvtkConnect(interactorStyle, vtkCommand::EndInteractionEvent, this, SLOT(onThreeDViewInteractionEnded()));
     }
+}
 
-  if (removeOrigNode)
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::onThreeDViewInteractionStarted()
+{
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+  if (d->logic())
     {
-    this->mrmlScene()->RemoveNode(origNode);
+    d->logic()->setFreeSurferModelsInteracting(true);
     }
+}
 
-  QApplication::restoreOverrideCursor();
-
-  return true;
+//-----------------------------------------------------------------------------
+void qSlicerFreeSurferImporterModuleWidget::onThreeDViewInteractionEnded()
+{
+  Q_D(qSlicerFreeSurferImporterModuleWidget);
+  if (d->logic())
+    {
+    d->logic()->setFreeSurferModelsInteracting(false);
+    }
 }
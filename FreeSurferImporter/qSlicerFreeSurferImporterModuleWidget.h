@@ -41,11 +41,27 @@ public slots:
   void updateFileList();
   bool loadSelectedFiles();
 
+protected slots:
+  /// Add the files read by the background import to the scene and update the status
+  void updateImportProgress();
+
+  /// Schedule an update of the subject index for a directory reported by the file system watcher
+  void onWatchedDirectoryChanged(const QString& path);
+  /// Rescan the changed directories and update the file lists if the index changed
+  void updateSubjectIndex();
+
+  /// Show the coarse levels of detail of the models while a 3D view is rotated or zoomed
+  void onThreeDViewInteractionStarted();
+  void onThreeDViewInteractionEnded();
+
 protected:
   QScopedPointer<qSlicerFreeSurferImporterModuleWidgetPrivate> d_ptr;
 
   virtual void setup();
 
+  /// Observe the start and end of interactions in all 3D views
+  void observeThreeDViewInteraction();
+
 private:
   Q_DECLARE_PRIVATE(qSlicerFreeSurferImporterModuleWidget);
   Q_DISABLE_COPY(qSlicerFreeSurferImporterModuleWidget);